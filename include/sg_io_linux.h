@@ -2,7 +2,7 @@
 #define SG_IO_LINUX_H
 
 /*
- * Copyright (c) 2004-2018 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -11,7 +11,7 @@
  */
 
 /*
- * Version 1.07 [20181211]
+ * Version 1.08 [20261018]
  */
 
 /*
@@ -184,6 +184,45 @@ int sg_err_category_new(int scsi_status, int host_status, int driver_status,
 int sg_err_category3(struct sg_io_hdr * hp);
 
 
+/* A contiguous data buffer that, via sg_iov_buf_segs(), can also be given
+ * to the sg driver as a scatter gather list (iovec) of chunk_sz elements.
+ * The sg driver copies iovec transfers through its own kernel buffer (it
+ * does not do direct IO on them) so its buffer size limits still apply. */
+#define SG_IOV_DEF_CHUNK_SZ (2 * 1024 * 1024)
+#define SG_IOV_1G_SZ (1024 * 1024 * 1024)
+
+struct sg_iov_buf {
+    uint8_t * base;     /* start of first chunk, page aligned */
+    int len;            /* bytes requested */
+    int chunk_sz;       /* multiple of the page (or hugepage) size */
+    int num_chunks;
+    int hp_mode;        /* SG_LIB_HP_* asked, from sg_get_hugepage_mode() */
+    int hp_used;        /* SG_LIB_HP_* obtained (THP: advised) */
+    uint8_t * resv;     /* mapping holding the buffer */
+    size_t resv_len;
+};
+
+/* Allocates a zeroed buffer of len bytes in ibp, described as chunks of
+ * chunk_sz bytes (rounded up to a page multiple; 0 -> SG_IOV_DEF_CHUNK_SZ).
+ * Returns ibp->base or NULL on failure (errno set). Release with
+ * sg_iov_buf_free(). The memory is touched so its pages are placed near
+ * the calling thread. If SG3_UTILS_HUGEPAGES asks for hugepages (see
+ * sg_get_hugepage_mode()) chunks are rounded up to the hugepage size and
+ * the whole buffer is backed by hugetlb pages if enough are free, else
+ * advised to use THP, else uses base pages. With vb the backing used is
+ * reported. */
+uint8_t * sg_iov_buf_alloc(struct sg_iov_buf * ibp, int len, int chunk_sz,
+                           bool vb);
+
+void sg_iov_buf_free(struct sg_iov_buf * ibp);
+
+/* Fills iov with the elements, split at chunk boundaries, that cover the
+ * blen bytes starting at bp (which must lie within ibp). Returns the number
+ * of elements written or -1 if more than max_iov are needed or bp is out
+ * of range. */
+int sg_iov_buf_segs(const struct sg_iov_buf * ibp, const uint8_t * bp,
+                    int blen, sg_iovec_t * iov, int max_iov);
+
 /* Note about SCSI status codes found in older versions of Linux.
    Linux has traditionally used a 1 bit right shifted and masked
    version of SCSI standard status codes. Now CHECK_CONDITION
@@ -2,7 +2,7 @@
 #define SG_LIB_H
 
 /*
- * Copyright (c) 2004-2019 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -388,6 +388,20 @@ void sg_print_scsi_status(int scsi_status);
  * environment variable SG3_UTILS_DSENSE. Only (currently) used in SNTL. */
 bool sg_get_initial_dsense(void);
 
+/* Hugepage modes for large data buffers (e.g. those of the dd utilities) */
+#define SG_LIB_HP_NONE 0        /* base pages (e.g. 4 KiB) */
+#define SG_LIB_HP_THP 1         /* transparent hugepages, via madvise() */
+#define SG_LIB_HP_2M 2          /* hugetlb 2 MiB pages, else THP */
+#define SG_LIB_HP_1G 3          /* hugetlb 1 GiB pages, else as 2M */
+#define SG_LIB_THP_SZ (2 * 1024 * 1024)
+
+/* Reads environment variable SG3_UTILS_HUGEPAGES which may be "thp" (or
+ * "1"), "2m" or "1g". Returns SG_LIB_HP_NONE if it is not set, is "0" or is
+ * not recognised. Only Linux acts on the other modes: sg_memalign() of
+ * SG_LIB_THP_SZ bytes or more advises THP and, in sg_io_linux,
+ * sg_iov_buf_alloc() tries hugetlb pages. Both quietly fall back. */
+int sg_get_hugepage_mode(void);
+
 /* 'leadin' is string prepended to each line printed out, NULL treated as
  * "". N.B. prior to sg3_utils v 1.42 'leadin' was only prepended to the
  * first line printed. */
@@ -534,6 +548,11 @@ int sg_vpd_dev_id_iter(const uint8_t * initial_desig_desc, int page_len,
  * If errnum is negative, flip its sign. */
 char * safe_strerror(int errnum);
 
+/* Like safe_strerror() but places the string in 'b' (of 'b_len' bytes)
+ * rather than a static buffer, so it may be called from several threads
+ * at once. Returns 'b'. */
+char * safe_strerror_r(int errnum, char * b, int b_len);
+
 
 /* Print (to stdout) 'str' of bytes in hex, 16 bytes per line optionally
  * followed at the right hand side of the line with an ASCII interpretation.
@@ -579,6 +598,14 @@ int hex2str(const uint8_t * b_str, int len, const char * leadin, int format,
 int sg_f2hex_arr(const char * fname, bool as_binary, bool no_space,
                  uint8_t * mp_arr, int * mp_arr_len, int max_arr_len);
 
+/* Like sg_f2hex_arr() but the output array is allocated on the heap and
+ * grown as needed. On success *arr_pp points to *arr_lenp bytes which the
+ * caller should free(). If max_arr_len > 0 then it caps the array size,
+ * otherwise there is no limit (other than INT_MAX). Returns 0 if ok, or an
+ * error code (and *arr_pp is set to NULL). */
+int sg_f2hex_arr_alloc(const char * fname, bool as_binary, bool no_space,
+                       uint8_t ** arr_pp, int * arr_lenp, int max_arr_len);
+
 /* Returns true when executed on big endian machine; else returns false.
  * Useful for displaying ATA identify words (which need swapping on a
  * big endian machine). */
@@ -590,6 +617,31 @@ bool sg_is_big_endian();
 bool sg_all_zeros(const uint8_t * bp, int b_len);
 bool sg_all_ffs(const uint8_t * bp, int b_len);
 
+/* Returns the T10 DIF CRC16 (polynomial 0x8bb7, as used in the guard tag
+ * of protection information) of 'len' bytes at 'bp'. Give 0 as 'crc' to
+ * start, or a previous result to continue over more bytes. */
+uint16_t sg_t10_crc16(uint16_t crc, const uint8_t * bp, uint32_t len);
+
+/* With RDPROTECT or WRPROTECT non-zero each logical block is followed by 8
+ * bytes of protection information (PI): a guard tag (CRC16 of the block),
+ * an application tag and a reference tag (all big endian). The following
+ * work on 'num' such blocks at 'bp', each 'lb_sz' bytes plus 8, the first
+ * being at 'lba'. 'pi_type' is 1, 2 or 3; for types 1 and 2 the reference
+ * tag is the lower 32 bits of the LBA. For type 3 the reference tag is
+ * owned by the application client and is not checked by the device;
+ * sg_pi_generate() also sets it to the lower 32 bits of the LBA. */
+void sg_pi_generate(uint8_t * bp, int lb_sz, int num, uint64_t lba,
+                    uint16_t app_tag, int pi_type);
+
+/* Checks protection information like a device would when RDPROTECT is 1:
+ * blocks whose application tag is 0xffff (and, for type 3, reference tag
+ * is 0xffffffff) are skipped; the type 3 reference tag is not checked.
+ * Returns -1 if all blocks are good, else the index of the first bad one
+ * with the offset of the failing tag (0: guard, 4: reference) in
+ * '*tag_offp' (if not NULL). */
+int sg_pi_verify(const uint8_t * bp, int lb_sz, int num, uint64_t lba,
+                 int pi_type, int * tag_offp);
+
 /* Extract character sequence from ATA words as in the model string
  * in a IDENTIFY DEVICE response. Returns number of characters
  * written to 'ochars' before 0 character is found or 'num' words
@@ -660,6 +712,15 @@ uint8_t * sg_memalign(uint32_t num_bytes, uint32_t align_to,
 /* Returns OS page size in bytes. If uncertain returns 4096. */
 uint32_t sg_get_page_size(void);
 
+/* Returns a monotonic time in nanoseconds, suitable for measuring intervals.
+ * Falls back to the wall clock when no monotonic clock is available. */
+uint64_t sg_get_monotonic_ns(void);
+
+/* Reads from 'fd' until 'len' bytes have been placed in 'up' or end of file
+ * is reached, as pipes may return less. Retries after EINTR. Returns the
+ * number of bytes read or a negated errno value. */
+int sg_full_read(int fd, uint8_t * up, uint32_t len);
+
 /* If byte_count is 0 or less then the OS page size is used as denominator.
  * Returns true  if the remainder of ((unsigned)pointer % byte_count) is 0,
  * else returns false. */
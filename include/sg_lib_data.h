@@ -134,6 +134,8 @@ extern struct sg_lib_4tuple_u8 sg_lib_scsi_status_sense_arr[];
 
 extern struct sg_value_2names_t sg_exit_str_arr[];
 
+extern const uint16_t sg_lib_t10dif_crc_tbl[8][256];
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,7 +2,7 @@
 #define SG_PT_H
 
 /*
- * Copyright (c) 2005-2019 Douglas Gilbert.
+ * Copyright (c) 2005-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -245,6 +245,40 @@ uint32_t get_pt_nvme_nsid(const struct sg_pt_base * objp);
  * scsi_pt_close_device() ).  */
 void destruct_scsi_pt_obj(struct sg_pt_base * objp);
 
+/* Per device command timeouts. sg_pt_tmo_learn() sends REPORT SUPPORTED
+ * OPERATION CODES with RCTD set to dev_fd and keeps the recommended
+ * command timeout of each command reported. Thereafter do_scsi_pt() on
+ * dev_fd uses that timeout for those commands in place of a
+ * 'timeout_secs' argument of at most SG_PT_TMO_DEF_SECS (taken to be a
+ * library or utility default); longer 'timeout_secs' values (e.g. given
+ * explicitly or computed for a FORMAT UNIT) are only ever lengthened by it.
+ * Tables are shared between file
+ * descriptors opened with the same (non-NULL) 'device_name'. If
+ * 'cache_dir' is non-NULL, the table is read from (or if absent written
+ * to) a file in that directory named after the logical unit name (e.g.
+ * "naa.5000c500a1b2c3d4.tmo") so RSOC is only needed once per device.
+ * Returns the number of commands with a learnt timeout (0 if the device
+ * reports none) or a negated errno value.
+ * If the SG3_UTILS_PT_TIMEOUTS environment variable is set then
+ * scsi_pt_open_device() and scsi_pt_open_flags() call sg_pt_tmo_learn()
+ * after a successful open; if its value starts with '/' it is used as
+ * 'cache_dir'. The use by do_scsi_pt(), that environment variable and the
+ * call from scsi_pt_close_device() are Linux only at present. */
+int sg_pt_tmo_learn(int dev_fd, const char * device_name,
+                    const char * cache_dir, int verbose);
+
+#define SG_PT_TMO_DEF_SECS 60   /* the usual default command timeout */
+
+/* Returns the learnt timeout in seconds of the command in 'cdb' for
+ * dev_fd, or 'def_secs' if there is none. */
+int sg_pt_tmo_lookup(int dev_fd, const uint8_t * cdb, int cdb_len,
+                     int def_secs);
+
+/* Drops the association between dev_fd and its learnt timeouts, freeing
+ * the table when no other file descriptor uses it. Called by
+ * scsi_pt_close_device(). */
+void sg_pt_tmo_forget(int dev_fd);
+
 #ifdef SG_LIB_WIN32
 #define SG_LIB_WIN32_DIRECT 1
 
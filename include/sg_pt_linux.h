@@ -112,11 +112,14 @@ struct sg_io_v4 {
 #endif
 
 
+struct sg_mock_dev;    /* opaque, see sg_pt_linux_mock.c */
+
 struct sg_pt_linux_scsi {
     struct sg_io_v4 io_hdr;     /* use v4 header as it is more general */
     /* Leave io_hdr in first place of this structure */
     bool is_sg;
     bool is_bsg;
+    bool is_mock;       /* dev_fd from "mock:" device name */
     bool is_nvme;       /* OS device type, if false ignore nvme_direct */
     bool nvme_direct;   /* false: our SNTL; true: received NVMe command */
     bool nvme_stat_dnr; /* Do No Retry, part of completion status field */
@@ -138,6 +141,7 @@ struct sg_pt_linux_scsi {
     uint32_t mdxfer_len;
     struct sg_sntl_dev_state_t dev_stat;
     void * mdxferp;
+    struct sg_mock_dev * mock_devp;     /* non-NULL when is_mock */
     uint8_t * nvme_id_ctlp;     /* cached response to controller IDENTIFY */
     uint8_t * free_nvme_id_ctlp;
     uint8_t tmf_request[4];
@@ -188,6 +192,22 @@ int sg_linux_get_sg_version(const struct sg_pt_base * vp);
 bool sg_get_nvme_char_devname(const char * nvme_block_devname, uint32_t b_len,
                               char * b);
 
+/* Device names starting with this prefix are not opened by the OS but
+ * emulated in-process by sg_pt_linux_mock.c . For example:
+ * "mock:size=2g,bs=4096,lat=100" . */
+#define SG_MOCK_PREFIX "mock:"
+#define SG_MOCK_PREFIX_LEN 5
+
+/* Returns a file descriptor (of /dev/null) associated with the emulated
+ * device described by 'spec' (the device name after SG_MOCK_PREFIX), or
+ * a negated errno value. */
+int sg_mock_open(const char * spec, int flags, int verbose);
+/* Returns the emulated device associated with 'fd' or NULL */
+struct sg_mock_dev * sg_mock_find(int fd);
+/* Returns true if 'fd' was a mock file descriptor, which is now closed */
+bool sg_mock_close(int fd);
+int sg_do_mock_pt(struct sg_pt_linux_scsi * ptp, int time_secs, int vb);
+
 #ifdef __cplusplus
 }
 #endif
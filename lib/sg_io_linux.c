@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2018 Douglas Gilbert.
+ * Copyright (c) 1999-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -13,6 +13,8 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -20,11 +22,13 @@
 
 #ifdef SG_LIB_LINUX
 
+#include <sys/mman.h>
+
 #include "sg_io_linux.h"
 #include "sg_pr2serr.h"
 
 
-/* Version 1.10 20180613 */
+/* Version 1.11 20261018 */
 
 
 void
@@ -236,4 +240,152 @@ sg_err_category_new(int scsi_status, int host_status, int driver_status,
     return SG_LIB_CAT_OTHER;
 }
 
+#ifdef MAP_HUGETLB
+/* Maps len bytes with hugetlb pages of (1 << shift) bytes, letting the
+ * kernel pick (and align) the address. Returns NULL on failure. MAP_HUGETLB
+ * reserves the pages at mmap() time so later touching them cannot fail. */
+static uint8_t *
+map_hugetlb(size_t len, int shift)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+    void * p;
+
+#ifdef MAP_HUGE_SHIFT
+    flags |= (shift << MAP_HUGE_SHIFT);
+#else
+    if (30 == shift)
+        return NULL;    /* can only ask for the default hugepage size */
+#endif
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return (MAP_FAILED == p) ? NULL : (uint8_t *)p;
+}
+#endif
+
+static const char *
+hp_used_str(int hp_used)
+{
+    switch (hp_used) {
+    case SG_LIB_HP_1G:
+        return "1 GiB hugetlb pages";
+    case SG_LIB_HP_2M:
+        return "2 MiB hugetlb pages";
+    case SG_LIB_HP_THP:
+        return "transparent hugepages advised";
+    default:
+        return "none, base pages";
+    }
+}
+
+uint8_t *
+sg_iov_buf_alloc(struct sg_iov_buf * ibp, int len, int chunk_sz, bool vb)
+{
+    int pg_sz, align, mode, err;
+    size_t map_len;
+    uint8_t * base = NULL;
+
+    memset(ibp, 0, sizeof(*ibp));
+    if (len <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    pg_sz = sysconf(_SC_PAGESIZE);
+    if (pg_sz <= 0)
+        pg_sz = 4096;
+    if (chunk_sz <= 0)
+        chunk_sz = SG_IOV_DEF_CHUNK_SZ;
+    mode = sg_get_hugepage_mode();
+    /* 1 GiB pages only when the buffer can fill at least one of them */
+    if ((SG_LIB_HP_1G == mode) && (len < SG_IOV_1G_SZ))
+        mode = SG_LIB_HP_2M;
+    if (SG_LIB_HP_1G == mode)
+        align = SG_IOV_1G_SZ;
+    else if (SG_LIB_HP_NONE != mode)
+        align = SG_LIB_THP_SZ;
+    else
+        align = pg_sz;
+    chunk_sz = ((chunk_sz + align - 1) / align) * align;
+    ibp->num_chunks = (len + chunk_sz - 1) / chunk_sz;
+    ibp->hp_mode = mode;
+    map_len = (size_t)ibp->num_chunks * chunk_sz;
+#ifdef MAP_HUGETLB
+    /* the whole buffer from hugetlb pages, else none of it: a MAP_FIXED
+     * attempt that fails may leave a hole another thread can map into */
+    if ((SG_LIB_HP_1G == mode) && (base = map_hugetlb(map_len, 30)))
+        ibp->hp_used = SG_LIB_HP_1G;
+    else if ((mode >= SG_LIB_HP_2M) && (base = map_hugetlb(map_len, 21)))
+        ibp->hp_used = SG_LIB_HP_2M;
+    if (base) {
+        ibp->resv = base;
+        ibp->resv_len = map_len;
+    }
+#endif
+    if (NULL == base) {
+        /* THP needs an aligned start so map extra then round up */
+        ibp->resv_len = map_len + ((align > pg_sz) ? align : 0);
+        ibp->resv = (uint8_t *)mmap(NULL, ibp->resv_len,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == (void *)ibp->resv) {
+            err = errno;
+            if (vb)
+                pr2ws("%s: mapping %zu bytes failed: %s\n", __func__,
+                      ibp->resv_len, safe_strerror(err));
+            memset(ibp, 0, sizeof(*ibp));
+            errno = err;
+            return NULL;
+        }
+        base = (uint8_t *)(((sg_uintptr_t)ibp->resv + align - 1) &
+                           ~((sg_uintptr_t)align - 1));
+#ifdef MADV_HUGEPAGE
+        if ((SG_LIB_HP_NONE != mode) &&
+            (0 == madvise(base, map_len, MADV_HUGEPAGE)))
+            ibp->hp_used = SG_LIB_HP_THP;
+#endif
+    }
+    memset(base, 0, map_len);   /* places pages near the calling thread */
+    ibp->base = base;
+    ibp->len = len;
+    ibp->chunk_sz = chunk_sz;
+    if (vb) {
+        pr2ws("%s: %d bytes in %d chunk%s of %d bytes at %p\n", __func__,
+              len, ibp->num_chunks, ((1 == ibp->num_chunks) ? "" : "s"),
+              chunk_sz, (void *)base);
+        if (SG_LIB_HP_NONE != mode)
+            pr2ws("    hugepages: %s\n", hp_used_str(ibp->hp_used));
+    }
+    return base;
+}
+
+void
+sg_iov_buf_free(struct sg_iov_buf * ibp)
+{
+    if (ibp && ibp->resv) {
+        munmap(ibp->resv, ibp->resv_len);
+        memset(ibp, 0, sizeof(*ibp));
+    }
+}
+
+int
+sg_iov_buf_segs(const struct sg_iov_buf * ibp, const uint8_t * bp, int blen,
+                sg_iovec_t * iov, int max_iov)
+{
+    int n, off, seg;
+
+    if ((NULL == ibp->base) || (bp < ibp->base) || (blen < 0))
+        return -1;
+    off = (int)(bp - ibp->base);
+    if ((off + blen) > (ibp->num_chunks * ibp->chunk_sz))
+        return -1;
+    for (n = 0; blen > 0; ++n, off += seg, blen -= seg) {
+        if (n >= max_iov)
+            return -1;
+        seg = ibp->chunk_sz - (off % ibp->chunk_sz);
+        if (seg > blen)
+            seg = blen;
+        iov[n].iov_base = ibp->base + off;
+        iov[n].iov_len = seg;
+    }
+    return n;
+}
+
 #endif  /* if SG_LIB_LINUX defined */
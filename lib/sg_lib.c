@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2019 Douglas Gilbert.
+ * Copyright (c) 1999-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -30,6 +30,9 @@
  */
 
 #define _POSIX_C_SOURCE 200809L         /* for posix_memalign() */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE 1       /* for madvise() and MADV_HUGEPAGE */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -42,13 +45,25 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#if ! (defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC))
+#ifdef HAVE_GETTIMEOFDAY
+#include <sys/time.h>
+#endif
+#endif
+
+#ifndef SG_LIB_MINGW
+#include <sys/mman.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_unaligned.h"
@@ -121,6 +136,23 @@ sg_get_initial_dsense(void)
     return false;
 }
 
+int
+sg_get_hugepage_mode(void)
+{
+    const char * cp;
+
+    cp = getenv("SG3_UTILS_HUGEPAGES");
+    if ((NULL == cp) || ('\0' == *cp))
+        return SG_LIB_HP_NONE;
+    if ((0 == strcmp(cp, "1")) || (0 == strcmp(cp, "thp")))
+        return SG_LIB_HP_THP;
+    if ((0 == strcmp(cp, "2m")) || (0 == strcmp(cp, "2M")))
+        return SG_LIB_HP_2M;
+    if ((0 == strcmp(cp, "1g")) || (0 == strcmp(cp, "1G")))
+        return SG_LIB_HP_1G;
+    return SG_LIB_HP_NONE;
+}
+
 /* Searches 'arr' for match on 'value' then 'peri_type'. If matches
    'value' but not 'peri_type' then yields first 'value' match entry.
    Last element of 'arr' has NULL 'name'. If no match returns NULL. */
@@ -2701,17 +2733,110 @@ safe_strerror(int errnum)
     return errstr;
 }
 
-static void
-trimTrailingSpaces(char * b)
+char *
+safe_strerror_r(int errnum, char * b, int b_len)
 {
-    int k;
+    int res;
 
-    for (k = ((int)strlen(b) - 1); k >= 0; --k) {
-        if (' ' != b[k])
-            break;
+    if ((NULL == b) || (b_len < 1))
+        return b;
+    if (errnum < 0)
+        errnum = -errnum;
+#if defined(SG_LIB_WIN32)
+    res = strerror_s(b, b_len, errnum);
+#elif defined(_GNU_SOURCE) && defined(__GLIBC__)
+    {   /* GNU variant may return a static string rather than fill 'b' */
+        const char * cp = strerror_r(errnum, b, b_len);
+
+        if (cp != b)
+            snprintf(b, b_len, "%s", cp);
+        res = 0;
+    }
+#else
+    res = strerror_r(errnum, b, b_len);
+#endif
+    if (res)
+        snprintf(b, b_len, "unknown errno: %d", errnum);
+    return b;
+}
+
+/* The ASCII-hex dumpers below format a line at a time using a nibble to
+ * character lookup rather than calling snprintf() for each byte. Lines
+ * from dStrHexFp() are collected in an output buffer that is written to
+ * the FILE stream when it fills (typically once per call). */
+static const char sg_hex_lc[] = "0123456789abcdef";
+
+#define DSH_LINE_BLEN 82        /* dStrHexFp() line buffer length */
+#define DSH_OBUF_MAX (256 * 1024)
+
+/* Writes 'c' as 2 lower case hex digits followed by a space to 'cp' */
+static inline void
+hex_byte_sp(char * cp, uint8_t c)
+{
+    cp[0] = sg_hex_lc[c >> 4];
+    cp[1] = sg_hex_lc[c & 0xf];
+    cp[2] = ' ';
+}
+
+/* Equivalent to sprintf(cp, "%.2x", a) but without the trailing '\0'.
+ * Returns number of characters written. */
+static int
+hex_addr(char * cp, unsigned int a)
+{
+    int k, n;
+    unsigned int t;
+
+    for (n = 1, t = a >> 4; t; t >>= 4)
+        ++n;
+    if (n < 2)
+        n = 2;
+    for (k = n - 1; k >= 0; --k, a >>= 4)
+        cp[k] = sg_hex_lc[a & 0xf];
+    return n;
+}
+
+/* Returns length of 'b' (of 'len' characters) less trailing spaces */
+static inline int
+trim_len(const char * b, int len)
+{
+    while ((len > 0) && (' ' == b[len - 1]))
+        --len;
+    return len;
+}
+
+/* Formats one line, of up to 16 bytes from 'bp', as output by dStrHexFp()
+ * into 'out' (at least DSH_LINE_BLEN bytes long). 'addr' is the offset of
+ * bp[0]. Returns number of characters written, including the trailing
+ * newline. */
+static int
+dsh_fmt_line(const uint8_t * bp, int n, int addr, int no_ascii, char * out)
+{
+    int k, len;
+    uint8_t c;
+
+    memset(out, ' ', 80);
+    if (no_ascii < 0) {
+        /* bytes at 0, 3, ... 21 then 25, 28 ... 46 */
+        for (k = 0; k < n; ++k)
+            hex_byte_sp(out + (3 * k) + (k >= 8), bp[k]);
+        len = trim_len(out, 80);
+    } else {
+        /* address (offset) at 1, bytes at 8 ... 29 then 33 ... 54 and, if
+         * wanted, ASCII representation starting at 60 */
+        hex_addr(out + 1, (unsigned int)addr);
+        for (k = 0; k < n; ++k) {
+            c = bp[k];
+            hex_byte_sp(out + 8 + (3 * k) + (k >= 8), c);
+            if (0 == no_ascii)
+                out[60 + k] = my_isprint(c) ? c : '.';
+        }
+        if (no_ascii)
+            len = trim_len(out, 80);
+        else
+            len = 60 + n;       /* for a full line this is 76 */
     }
-    if ('\0' != b[k + 1])
-        b[k + 1] = '\0';
+    out[len++] = '\n';
+    return len;
 }
 
 /* Note the ASCII-hex output goes to stdout. [Most other output from functions
@@ -2723,85 +2848,36 @@ trimTrailingSpaces(char * b)
 static void
 dStrHexFp(const char* str, int len, int no_ascii, FILE * fp)
 {
-    const char * p = str;
-    const char * formatstr;
-    uint8_t c;
-    char buff[82];
+    const uint8_t * p = (const uint8_t *)str;
+    int k, n, ob_len;
     int a = 0;
-    int bpstart = 5;
-    const int cpstart = 60;
-    int cpos = cpstart;
-    int bpos = bpstart;
-    int i, k, blen;
+    int olen = 0;
+    char * obuf;
+    char line[DSH_LINE_BLEN];
 
     if (len <= 0)
         return;
-    blen = (int)sizeof(buff);
-    if (0 == no_ascii)  /* address at left and ASCII at right */
-        formatstr = "%.76s\n";
-    else                        /* previously when > 0 str was "%.58s\n" */
-        formatstr = "%s\n";     /* when < 0 str was: "%.48s\n" */
-    memset(buff, ' ', 80);
-    buff[80] = '\0';
-    if (no_ascii < 0) {
-        bpstart = 0;
-        bpos = bpstart;
-        for (k = 0; k < len; k++) {
-            c = *p++;
-            if (bpos == (bpstart + (8 * 3)))
-                bpos++;
-            sg_scnpr(&buff[bpos], blen - bpos, "%.2x", (int)(uint8_t)c);
-            buff[bpos + 2] = ' ';
-            if ((k > 0) && (0 == ((k + 1) % 16))) {
-                trimTrailingSpaces(buff);
-                fprintf(fp, formatstr, buff);
-                bpos = bpstart;
-                memset(buff, ' ', 80);
-            } else
-                bpos += 3;
-        }
-        if (bpos > bpstart) {
-            buff[bpos + 2] = '\0';
-            trimTrailingSpaces(buff);
-            fprintf(fp, "%s\n", buff);
+    ob_len = ((len + 15) / 16) * DSH_LINE_BLEN;
+    if (ob_len > DSH_OBUF_MAX)
+        ob_len = DSH_OBUF_MAX;
+    obuf = (char *)malloc(ob_len);
+    for (k = 0; k < len; k += 16, p += 16, a += 16) {
+        n = ((len - k) > 16) ? 16 : (len - k);
+        if (NULL == obuf) {     /* no output buffer, so line at a time */
+            n = dsh_fmt_line(p, n, a, no_ascii, line);
+            fwrite(line, 1, n, fp);
+            continue;
         }
-        return;
-    }
-    /* no_ascii>=0, start each line with address (offset) */
-    k = sg_scnpr(buff + 1, blen - 1, "%.2x", a);
-    buff[k + 1] = ' ';
-
-    for (i = 0; i < len; i++) {
-        c = *p++;
-        bpos += 3;
-        if (bpos == (bpstart + (9 * 3)))
-            bpos++;
-        sg_scnpr(&buff[bpos], blen - bpos, "%.2x", (int)(uint8_t)c);
-        buff[bpos + 2] = ' ';
-        if (no_ascii)
-            buff[cpos++] = ' ';
-        else {
-            if (! my_isprint(c))
-                c = '.';
-            buff[cpos++] = c;
-        }
-        if (cpos > (cpstart + 15)) {
-            if (no_ascii)
-                trimTrailingSpaces(buff);
-            fprintf(fp, formatstr, buff);
-            bpos = bpstart;
-            cpos = cpstart;
-            a += 16;
-            memset(buff, ' ', 80);
-            k = sg_scnpr(buff + 1, blen - 1, "%.2x", a);
-            buff[k + 1] = ' ';
+        if ((olen + DSH_LINE_BLEN) > ob_len) {
+            fwrite(obuf, 1, olen, fp);
+            olen = 0;
         }
+        olen += dsh_fmt_line(p, n, a, no_ascii, obuf + olen);
     }
-    if (cpos > cpstart) {
-        buff[cpos] = '\0';
-        if (no_ascii)
-            trimTrailingSpaces(buff);
-        fprintf(fp, "%s\n", buff);
+    if (obuf) {
+        if (olen > 0)
+            fwrite(obuf, 1, olen, fp);
+        free(obuf);
     }
 }
 
@@ -2821,6 +2897,21 @@ dStrHexErr(const char* str, int len, int no_ascii)
 #define DSHS_LINE_BLEN 160
 #define DSHS_BPL 16
 
+/* Copies 's_len' characters from 's' to 'b' followed by a '\0', not to
+ * exceed 'b_len' characters. Same result as sg_scnpr(b, b_len, "%.*s",
+ * s_len, s) but quicker. */
+static inline int
+scn_copy(char * b, int b_len, const char * s, int s_len)
+{
+    if (b_len < 2)
+        return 0;
+    if (s_len > (b_len - 1))
+        s_len = b_len - 1;
+    memcpy(b, s, s_len);
+    b[s_len] = '\0';
+    return s_len;
+}
+
 /* Read 'len' bytes from 'str' and output as ASCII-Hex bytes (space
  * separated) to 'b' not to exceed 'b_len' characters. Each line
  * starts with 'leadin' (NULL for no leadin) and there are 16 bytes
@@ -2832,12 +2923,11 @@ int
 dStrHexStr(const char * str, int len, const char * leadin, int format,
            int b_len, char * b)
 {
-    uint8_t c;
-    int bpstart, bpos, k, n, prior_ascii_len;
     bool want_ascii;
-    char buff[DSHS_LINE_BLEN + 2];
-    char a[DSHS_BPL + 1];
-    const char * p = str;
+    uint8_t c;
+    int bpstart, j, k, m, n, prior_ascii_len;
+    const uint8_t * p = (const uint8_t *)str;
+    char buff[DSHS_LINE_BLEN + DSHS_BPL + 8];
 
     if (len <= 0) {
         if (b_len > 0)
@@ -2847,10 +2937,6 @@ dStrHexStr(const char * str, int len, const char * leadin, int format,
     if (b_len <= 0)
         return 0;
     want_ascii = !format;
-    if (want_ascii) {
-        memset(a, ' ', DSHS_BPL);
-        a[DSHS_BPL] = '\0';
-    }
     if (leadin) {
         bpstart = strlen(leadin);
         /* Cap leadin at (DSHS_LINE_BLEN - 70) characters */
@@ -2858,46 +2944,28 @@ dStrHexStr(const char * str, int len, const char * leadin, int format,
             bpstart = DSHS_LINE_BLEN - 70;
     } else
         bpstart = 0;
-    bpos = bpstart;
     prior_ascii_len = bpstart + (DSHS_BPL * 3) + 1;
     n = 0;
-    memset(buff, ' ', DSHS_LINE_BLEN);
-    buff[DSHS_LINE_BLEN] = '\0';
-    if (bpstart > 0)
-        memcpy(buff, leadin, bpstart);
-    for (k = 0; k < len; k++) {
-        c = *p++;
-        if (bpos == (bpstart + ((DSHS_BPL / 2) * 3)))
-            bpos++;     /* for extra space in middle of each line's hex */
-        sg_scnpr(buff + bpos, (int)sizeof(buff) - bpos, "%.2x",
-                 (int)(uint8_t)c);
-        buff[bpos + 2] = ' ';
-        if (want_ascii)
-            a[k % DSHS_BPL] = my_isprint(c) ? c : '.';
-        if ((k > 0) && (0 == ((k + 1) % DSHS_BPL))) {
-            trimTrailingSpaces(buff);
-            if (want_ascii) {
-                n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n",
-                              prior_ascii_len, buff, a);
-                memset(a, ' ', DSHS_BPL);
-            } else
-                n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
-            if (n >= (b_len - 1))
-                return n;
-            memset(buff, ' ', DSHS_LINE_BLEN);
-            bpos = bpstart;
-            if (bpstart > 0)
-                memcpy(buff, leadin, bpstart);
-        } else
-            bpos += 3;
-    }
-    if (bpos > bpstart) {
-        trimTrailingSpaces(buff);
+    for (k = 0; k < len; k += DSHS_BPL, p += DSHS_BPL) {
+        m = ((len - k) > DSHS_BPL) ? DSHS_BPL : (len - k);
+        memset(buff, ' ', prior_ascii_len + 3 + DSHS_BPL);
+        if (bpstart > 0)
+            memcpy(buff, leadin, bpstart);
+        for (j = 0; j < m; ++j) {
+            c = p[j];
+            /* extra space in middle of each line's hex */
+            hex_byte_sp(buff + bpstart + (3 * j) + (j >= (DSHS_BPL / 2)), c);
+            if (want_ascii)
+                buff[prior_ascii_len + 3 + j] = my_isprint(c) ? c : '.';
+        }
         if (want_ascii)
-            n += sg_scnpr(b + n, b_len - n, "%-*s   %s\n", prior_ascii_len,
-                          buff, a);
+            j = prior_ascii_len + 3 + DSHS_BPL;
         else
-            n += sg_scnpr(b + n, b_len - n, "%s\n", buff);
+            j = trim_len(buff, bpstart + (DSHS_BPL * 3) + 1);
+        buff[j++] = '\n';
+        n += scn_copy(b + n, b_len - n, buff, j);
+        if (n >= (b_len - 1))
+            return n;
     }
     return n;
 }
@@ -2961,6 +3029,69 @@ sg_all_ffs(const uint8_t * bp, int b_len)
     return true;
 }
 
+/* Slice-by-8: the CRC state and 8 input bytes are folded in each step,
+ * which is several times faster than a byte at a time */
+uint16_t
+sg_t10_crc16(uint16_t crc, const uint8_t * bp, uint32_t len)
+{
+    const uint16_t (*t)[256] = sg_lib_t10dif_crc_tbl;
+
+    for ( ; len >= 8; len -= 8, bp += 8) {
+        crc ^= (bp[0] << 8) | bp[1];
+        crc = t[7][crc >> 8] ^ t[6][crc & 0xff] ^ t[5][bp[2]] ^
+              t[4][bp[3]] ^ t[3][bp[4]] ^ t[2][bp[5]] ^ t[1][bp[6]] ^
+              t[0][bp[7]];
+    }
+    for ( ; len > 0; --len, ++bp)
+        crc = (crc << 8) ^ t[0][(crc >> 8) ^ *bp];
+    return crc;
+}
+
+void
+sg_pi_generate(uint8_t * bp, int lb_sz, int num, uint64_t lba,
+               uint16_t app_tag, int pi_type)
+{
+    int k;
+
+    /* Types 1 and 2 require the reference tag to be the LBA. In type 3 the
+     * application client owns it; the LBA is used here as well. */
+    (void)pi_type;
+    for (k = 0; k < num; ++k, ++lba, bp += lb_sz + 8) {
+        sg_put_unaligned_be16(sg_t10_crc16(0, bp, lb_sz), bp + lb_sz);
+        sg_put_unaligned_be16(app_tag, bp + lb_sz + 2);
+        sg_put_unaligned_be32((uint32_t)lba, bp + lb_sz + 4);
+    }
+}
+
+int
+sg_pi_verify(const uint8_t * bp, int lb_sz, int num, uint64_t lba,
+             int pi_type, int * tag_offp)
+{
+    int k, off;
+    const uint8_t * pip;
+
+    for (k = 0; k < num; ++k, ++lba, bp += lb_sz + 8) {
+        pip = bp + lb_sz;
+        if ((0xff == pip[2]) && (0xff == pip[3])) {     /* app tag escape */
+            if (3 != pi_type)
+                continue;
+            if (0xffffffff == sg_get_unaligned_be32(pip + 4))
+                continue;
+        }
+        if (sg_get_unaligned_be16(pip) != sg_t10_crc16(0, bp, lb_sz))
+            off = 0;
+        else if ((3 != pi_type) &&
+                 (sg_get_unaligned_be32(pip + 4) != (uint32_t)lba))
+            off = 4;
+        else
+            continue;
+        if (tag_offp)
+            *tag_offp = off;
+        return k;
+    }
+    return -1;
+}
+
 static uint16_t
 swapb_uint16(uint16_t u)
 {
@@ -3406,6 +3537,291 @@ sg_get_llnum_nomult(const char * buf)
     return (1 == res) ? num : -1;
 }
 
+/* Classes of input characters for the ASCII hex parser: 0 to 15 are hex
+ * digits (the value being the class), then separators (space, comma and
+ * tab), a '#' or '\r' which end the parseable part of a line, newline, and
+ * everything else (bad). */
+#define HS 16
+#define HE 17
+#define HN 18
+#define HB 19
+
+static const uint8_t sg_hex_cls[256] = {
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HS, HN, HB, HB, HE, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HS, HB, HB, HE, HB, HB, HB, HB, HB, HB, HB, HB, HS, HB, HB, HB,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, HB, HB, HB, HB, HB, HB,
+    HB, 10, 11, 12, 13, 14, 15, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, 10, 11, 12, 13, 14, 15, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+    HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB, HB,
+};
+
+#undef HS
+#undef HE
+#undef HN
+#undef HB
+#define SG_HEX_CLS_SEP 16
+#define SG_HEX_CLS_END 17
+#define SG_HEX_CLS_NL 18
+
+/* Output array for the ASCII hex parser. If 'can_grow' is true then 'arr'
+ * is heap memory which is realloc()-ed, up to 'max' bytes, as needed. */
+struct sg_hex_out {
+    bool can_grow;
+    int len;
+    int cap;
+    int max;
+    uint8_t * arr;
+};
+
+/* Returns 0 if room for one more byte in hop->arr, else an error code */
+static int
+hex_out_room(struct sg_hex_out * hop)
+{
+    int new_cap;
+    uint8_t * np;
+
+    if (hop->len < hop->cap)
+        return 0;
+    if ((! hop->can_grow) || (hop->cap >= hop->max)) {
+        pr2serr("%s: array length exceeded\n", "sg_f2hex_arr");
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    }
+    new_cap = (hop->cap < (hop->max / 2)) ? (hop->cap * 2) : hop->max;
+    if (new_cap < 4096)
+        new_cap = (hop->max < 4096) ? hop->max : 4096;
+    np = (uint8_t *)realloc(hop->arr, new_cap);
+    if (NULL == np) {
+        pr2serr("%s: unable to grow array to %d bytes\n", "sg_f2hex_arr",
+                new_cap);
+        return sg_convert_errno(ENOMEM);
+    }
+    hop->arr = np;
+    hop->cap = new_cap;
+    return 0;
+}
+
+/* Parses the ASCII hex in bp[0..blen-1] into hop in a single pass using
+ * the sg_hex_cls[] table (no copying, no sscanf()) so 'bp' may be a read
+ * only mapping of the input file. See sg_f2hex_arr() for the accepted
+ * syntax. Returns 0 if ok, else an error code. */
+static int
+hex_parse_buf(const char * bp, int blen, bool no_space,
+              struct sg_hex_out * hop)
+{
+    bool in_pairs;
+    int lnum, k, d, v, res;
+    const char * lp;            /* start of current line */
+    const char * cp;
+    const char * tp = bp;       /* start of current hex number */
+    const char * bend = bp + blen;
+    const char * fn = "sg_f2hex_arr";
+
+    for (lnum = 1, cp = bp; cp < bend; ++lnum) {
+        lp = cp;
+        while ((cp < bend) && ((' ' == *cp) || ('\t' == *cp)))
+            ++cp;
+        if ((cp < bend) && (',' == *cp) && (! no_space)) {
+            pr2serr("%s: error in line %d, at pos %d\n", fn, lnum,
+                    (int)(cp - lp + 1));
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        in_pairs = no_space;
+        v = -1;                 /* no hex number in progress */
+        for ( ; cp < bend; ++cp) {
+            k = sg_hex_cls[(uint8_t)*cp];
+            if (in_pairs) {
+                /* string of hex digits, 2 per byte, up to first non pair */
+                if ((k < SG_HEX_CLS_SEP) && ((cp + 1) < bend) &&
+                    ((d = sg_hex_cls[(uint8_t)cp[1]]) < SG_HEX_CLS_SEP)) {
+                    if ((hop->len >= hop->cap) && (res = hex_out_room(hop)))
+                        return res;
+                    hop->arr[hop->len++] = (k << 4) | d;
+                    ++cp;
+                    continue;
+                }
+                in_pairs = false;
+            }
+            if (k < SG_HEX_CLS_SEP) {
+                if (no_space)   /* after the pairs, only check syntax */
+                    continue;
+                if (v < 0) {
+                    /* fast path for the usual 2 digit number */
+                    if (((cp + 2) < bend) &&
+                        ((d = sg_hex_cls[(uint8_t)cp[1]]) < SG_HEX_CLS_SEP) &&
+                        (sg_hex_cls[(uint8_t)cp[2]] >= SG_HEX_CLS_SEP)) {
+                        if ((hop->len >= hop->cap) &&
+                            (res = hex_out_room(hop)))
+                            return res;
+                        hop->arr[hop->len++] = (k << 4) | d;
+                        ++cp;
+                        continue;
+                    }
+                    tp = cp;
+                    v = k;
+                } else if (v <= 0xff)
+                    v = (v << 4) | k;
+                continue;
+            }
+            if (v >= 0) {
+                if (v > 0xff)
+                    goto too_big;
+                if ((hop->len >= hop->cap) && (res = hex_out_room(hop)))
+                    return res;
+                hop->arr[hop->len++] = v;
+                v = -1;
+            }
+            if (SG_HEX_CLS_SEP == k)
+                continue;
+            if (SG_HEX_CLS_END == k) {   /* ignore rest of line */
+                cp = (const char *)memchr(cp, '\n', bend - cp);
+                if (NULL == cp)
+                    cp = bend;
+                break;
+            }
+            if (SG_HEX_CLS_NL == k)
+                break;
+            pr2serr("%s: syntax error at line %d, pos %d\n", fn, lnum,
+                    (int)(cp - lp + 1));
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (v >= 0) {           /* last line without trailing newline */
+            if (v > 0xff)
+                goto too_big;
+            if ((hop->len >= hop->cap) && (res = hex_out_room(hop)))
+                return res;
+            hop->arr[hop->len++] = v;
+        }
+        if (cp < bend)
+            ++cp;               /* step over newline */
+    }
+    return 0;
+too_big:
+    pr2serr("%s: hex number larger than 0xff in line %d, pos %d\n", fn,
+            lnum, (int)(tp - lp + 1));
+    return SG_LIB_SYNTAX_ERROR;
+}
+
+/* Reads the whole of fname (a file named '-' taken as stdin) into memory.
+ * When 'allow_mmap' is true a non-empty regular file is mmap()-ed rather
+ * than read. Yields the contents in *bpp and its length in *blenp; *mappedp
+ * is set when munmap() rather than free() is needed to release *bpp.
+ * Returns 0 if ok, else an error code. */
+static int
+f2mem(const char * fname, bool allow_mmap, uint8_t ** bpp, int * blenp,
+      bool * mappedp)
+{
+    bool has_stdin = (0 == strcmp(fname, "-"));
+    int fd, err, n;
+    int ret = 0;
+    int cap = 64 * 1024;
+    int len = 0;
+    uint8_t * bp = NULL;
+    uint8_t * np;
+    struct stat a_stat;
+
+    *bpp = NULL;
+    *blenp = 0;
+    *mappedp = false;
+    if (has_stdin)
+        fd = STDIN_FILENO;
+    else {
+        fd = open(fname, O_RDONLY);
+        if (fd < 0) {
+            err = errno;
+            pr2serr("Unable to open %s for reading: %s\n", fname,
+                    safe_strerror(err));
+            return sg_convert_errno(err);
+        }
+    }
+    if ((0 == fstat(fd, &a_stat)) && S_ISREG(a_stat.st_mode)) {
+        if (a_stat.st_size >= INT_MAX) {
+            pr2serr("%s: %s is too large\n", __func__, fname);
+            ret = SG_LIB_FILE_ERROR;
+            goto fini;
+        }
+#ifndef SG_LIB_MINGW
+        if (allow_mmap && (a_stat.st_size > 0)) {
+            bp = (uint8_t *)mmap(NULL, a_stat.st_size, PROT_READ,
+                                 MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED != bp) {
+                *bpp = bp;
+                *blenp = (int)a_stat.st_size;
+                *mappedp = true;
+                bp = NULL;
+                goto fini;
+            }
+            bp = NULL;          /* fall back to read() */
+        }
+#endif
+        if (a_stat.st_size > 0)
+            cap = (int)a_stat.st_size + 1;  /* + 1 so EOF seen first read */
+    }
+    if (NULL == (bp = (uint8_t *)malloc(cap))) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    while (true) {
+        if (len >= cap) {
+            if (cap >= (INT_MAX / 2)) {
+                pr2serr("%s: %s is too large\n", __func__, fname);
+                ret = SG_LIB_FILE_ERROR;
+                goto fini;
+            }
+            cap *= 2;
+            if (NULL == (np = (uint8_t *)realloc(bp, cap))) {
+                ret = sg_convert_errno(ENOMEM);
+                goto fini;
+            }
+            bp = np;
+        }
+        n = read(fd, bp + len, cap - len);
+        if (0 == n)
+            break;
+        if (n < 0) {
+            err = errno;
+            if (EINTR == err)
+                continue;
+            pr2serr("read from %s: %s\n", fname, safe_strerror(err));
+            ret = sg_convert_errno(err);
+            goto fini;
+        }
+        len += n;
+    }
+    *bpp = bp;
+    *blenp = len;
+    bp = NULL;
+fini:
+    free(bp);
+    if (! has_stdin)
+        close(fd);
+    return ret;
+}
+
+static void
+f2mem_free(uint8_t * bp, int blen, bool mapped)
+{
+#ifndef SG_LIB_MINGW
+    if (mapped)
+        munmap(bp, blen);
+    else
+        free(bp);
+#else
+    if (blen) { ; }     /* unused, suppress warning */
+    if (mapped) { ; }   /* never mapped on MinGW */
+    free(bp);
+#endif
+}
+
 /* Read ASCII hex bytes or binary from fname (a file named '-' taken as
  * stdin). If reading ASCII hex then there should be either one entry per
  * line or a comma, space or tab separated list of bytes. If no_space is
@@ -3417,16 +3833,12 @@ int
 sg_f2hex_arr(const char * fname, bool as_binary, bool no_space,
              uint8_t * mp_arr, int * mp_arr_len, int max_arr_len)
 {
-    bool has_stdin, split_line;
-    int fn_len, in_len, k, j, m, fd, err;
-    int off = 0;
+    bool has_stdin, mapped;
+    int fn_len, k, m, fd, err, b_len;
     int ret = 0;
-    unsigned int h;
-    const char * lcp;
-    FILE * fp;
+    uint8_t * bp;
     struct stat a_stat;
-    char line[512];
-    char carry_over[4];
+    struct sg_hex_out ho;
 
     if ((NULL == fname) || (NULL == mp_arr) || (NULL == mp_arr_len))
         return SG_LIB_LOGIC_ERROR;
@@ -3482,139 +3894,81 @@ bin_fini:
     }
 
     /* So read the file as ASCII hex */
-    if (has_stdin)
-        fp = stdin;
-    else {
-        fp = fopen(fname, "r");
-        if (NULL == fp) {
-            err = errno;
-            pr2serr("Unable to open %s for reading: %s\n", fname,
-                    safe_strerror(err));
-            ret = sg_convert_errno(err);
-            goto fini;
-        }
-    }
+    ret = f2mem(fname, true, &bp, &b_len, &mapped);
+    if (ret)
+        return ret;
+    memset(&ho, 0, sizeof(ho));
+    ho.arr = mp_arr;
+    ho.cap = max_arr_len;
+    ho.max = max_arr_len;
+    ret = hex_parse_buf((const char *)bp, b_len, no_space, &ho);
+    if (0 == ret)
+        *mp_arr_len = ho.len;
+    else if (SG_LIB_LBA_OUT_OF_RANGE == ret)
+        *mp_arr_len = max_arr_len;
+    f2mem_free(bp, b_len, mapped);
+    return ret;
+}
 
-    carry_over[0] = 0;
-    for (j = 0; j < 512; ++j) {
-        if (NULL == fgets(line, sizeof(line), fp))
-            break;
-        in_len = strlen(line);
-        if (in_len > 0) {
-            if ('\n' == line[in_len - 1]) {
-                --in_len;
-                line[in_len] = '\0';
-                split_line = false;
-            } else
-                split_line = true;
-        }
-        if (in_len < 1) {
-            carry_over[0] = 0;
-            continue;
-        }
-        if (carry_over[0]) {
-            if (isxdigit(line[0])) {
-                carry_over[1] = line[0];
-                carry_over[2] = '\0';
-                if (1 == sscanf(carry_over, "%4x", &h))
-                    mp_arr[off - 1] = h;       /* back up and overwrite */
-                else {
-                    pr2serr("%s: carry_over error ['%s'] around line %d\n",
-                            __func__, carry_over, j + 1);
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-                lcp = line + 1;
-                --in_len;
-            } else
-                lcp = line;
-            carry_over[0] = 0;
-        } else
-            lcp = line;
+/* Like sg_f2hex_arr() but rather than filling a caller supplied array, this
+ * function allocates (and grows) one on the heap. On success *arr_pp points
+ * to *arr_lenp bytes that the caller should free(). If max_arr_len is
+ * greater than 0 it limits the size of that array (exceeding it gives
+ * SG_LIB_LBA_OUT_OF_RANGE); otherwise the limit is INT_MAX. On error *arr_pp
+ * is set to NULL and an error code is returned. Regular files are mmap()-ed
+ * so large ASCII hex files (e.g. microcode images) load quickly. */
+int
+sg_f2hex_arr_alloc(const char * fname, bool as_binary, bool no_space,
+                   uint8_t ** arr_pp, int * arr_lenp, int max_arr_len)
+{
+    bool mapped;
+    int ret, b_len;
+    uint8_t * bp;
+    struct sg_hex_out ho;
 
-        m = strspn(lcp, " \t");
-        if (m == in_len)
-            continue;
-        lcp += m;
-        in_len -= m;
-        if ('#' == *lcp)
-            continue;
-        k = strspn(lcp, "0123456789aAbBcCdDeEfF ,\t");
-        if ((k < in_len) && ('#' != lcp[k]) && ('\r' != lcp[k])) {
-            pr2serr("%s: syntax error at line %d, pos %d\n", __func__,
-                    j + 1, m + k + 1);
-            ret = SG_LIB_SYNTAX_ERROR;
-            goto fini;
+    if ((NULL == fname) || (NULL == arr_pp) || (NULL == arr_lenp))
+        return SG_LIB_LOGIC_ERROR;
+    *arr_pp = NULL;
+    if (0 == strlen(fname))
+        return SG_LIB_SYNTAX_ERROR;
+    ret = f2mem(fname, ! as_binary, &bp, &b_len, &mapped);
+    if (ret)
+        return ret;
+    if (as_binary) {            /* f2mem() did not mmap() */
+        if (0 == b_len) {
+            pr2serr("read 0 bytes from binary file %s\n", fname);
+            free(bp);
+            return SG_LIB_SYNTAX_ERROR;
         }
-        if (no_space) {
-            for (k = 0; isxdigit(*lcp) && isxdigit(*(lcp + 1));
-                 ++k, lcp += 2) {
-                if (1 != sscanf(lcp, "%2x", &h)) {
-                    pr2serr("%s: bad hex number in line %d, pos %d\n",
-                            __func__, j + 1, (int)(lcp - line + 1));
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-                if ((off + k) >= max_arr_len) {
-                    pr2serr("%s: array length exceeded\n", __func__);
-                    *mp_arr_len = max_arr_len;
-                    ret = SG_LIB_LBA_OUT_OF_RANGE;
-                    goto fini;
-                }
-                mp_arr[off + k] = h;
-            }
-            if (isxdigit(*lcp) && (! isxdigit(*(lcp + 1))))
-                carry_over[0] = *lcp;
-            off += k;
-        } else {
-            for (k = 0; k < 1024; ++k) {
-                if (1 == sscanf(lcp, "%10x", &h)) {
-                    if (h > 0xff) {
-                        pr2serr("%s: hex number larger than 0xff in line "
-                                "%d, pos %d\n", __func__, j + 1,
-                                (int)(lcp - line + 1));
-                        ret = SG_LIB_SYNTAX_ERROR;
-                        goto fini;
-                    }
-                    if (split_line && (1 == strlen(lcp))) {
-                        /* single trailing hex digit might be a split pair */
-                        carry_over[0] = *lcp;
-                    }
-                    if ((off + k) >= max_arr_len) {
-                        pr2serr("%s: array length exceeded\n", __func__);
-                        ret = SG_LIB_LBA_OUT_OF_RANGE;
-                        *mp_arr_len = max_arr_len;
-                        goto fini;
-                    }
-                    mp_arr[off + k] = h;
-                    lcp = strpbrk(lcp, " ,\t");
-                    if (NULL == lcp)
-                        break;
-                    lcp += strspn(lcp, " ,\t");
-                    if ('\0' == *lcp)
-                        break;
-                } else {
-                    if (('#' == *lcp) || ('\r' == *lcp)) {
-                        --k;
-                        break;
-                    }
-                    pr2serr("%s: error in line %d, at pos %d\n", __func__,
-                            j + 1, (int)(lcp - line + 1));
-                    ret = SG_LIB_SYNTAX_ERROR;
-                    goto fini;
-                }
-            }
-            off += (k + 1);
+        if ((max_arr_len > 0) && (b_len > max_arr_len)) {
+            pr2serr("%s: array length exceeded\n", __func__);
+            free(bp);
+            return SG_LIB_LBA_OUT_OF_RANGE;
         }
+        *arr_pp = bp;
+        *arr_lenp = b_len;
+        return 0;
+    }
+    memset(&ho, 0, sizeof(ho));
+    ho.can_grow = true;
+    ho.max = (max_arr_len > 0) ? max_arr_len : INT_MAX;
+    /* initial guess: 3 characters (2 hex digits and separator) per byte */
+    ho.cap = (b_len / 3) + 16;
+    if (ho.cap > ho.max)
+        ho.cap = ho.max;
+    ho.arr = (uint8_t *)malloc(ho.cap);
+    if (NULL == ho.arr)
+        ret = sg_convert_errno(ENOMEM);
+    else
+        ret = hex_parse_buf((const char *)bp, b_len, no_space, &ho);
+    f2mem_free(bp, b_len, mapped);
+    if (ret) {
+        free(ho.arr);
+        return ret;
     }
-    *mp_arr_len = off;
-    if (stdin != fp)
-        fclose(fp);
+    *arr_pp = ho.arr;
+    *arr_lenp = ho.len;
     return 0;
-fini:
-    if (stdin != fp)
-        fclose(fp);
-    return ret;
 }
 
 /* Extract character sequence from ATA words as in the model string
@@ -3691,6 +4045,46 @@ sg_get_page_size(void)
 #endif
 }
 
+uint64_t
+sg_get_monotonic_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+    return (uint64_t)time(NULL) * 1000000000;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((uint64_t)tv.tv_sec * 1000000000) + (tv.tv_usec * 1000);
+#else
+    return (uint64_t)time(NULL) * 1000000000;
+#endif
+}
+
+int
+sg_full_read(int fd, uint8_t * up, uint32_t len)
+{
+    int res;
+    uint32_t k;
+
+    for (k = 0; k < len; k += res) {
+        res = read(fd, up + k, len - k);
+        if (res < 0) {
+            if (EINTR == errno) {
+                res = 0;
+                continue;
+            }
+            return -errno;
+        }
+        if (0 == res)
+            break;
+    }
+    return (int)k;
+}
+
 /* Returns pointer to heap (or NULL) that is aligned to a align_to byte
  * boundary. Sends back *buff_to_free pointer in third argument that may be
  * different from the return value. If it is different then the *buff_to_free
@@ -3701,6 +4095,7 @@ uint8_t *
 sg_memalign(uint32_t num_bytes, uint32_t align_to, uint8_t ** buff_to_free,
             bool vb)
 {
+    bool thp = false;
     size_t psz;
     uint8_t * res;
 
@@ -3709,6 +4104,15 @@ sg_memalign(uint32_t num_bytes, uint32_t align_to, uint8_t ** buff_to_free,
     psz = (align_to > 0) ? align_to : sg_get_page_size();
     if (0 == num_bytes)
         num_bytes = psz;        /* ugly to handle otherwise */
+#if defined(SG_LIB_LINUX) && defined(MADV_HUGEPAGE)
+    /* large buffer, user wants hugepages: align for THP then advise it */
+    if ((num_bytes >= SG_LIB_THP_SZ) &&
+        (SG_LIB_HP_NONE != sg_get_hugepage_mode())) {
+        thp = true;
+        if (psz < SG_LIB_THP_SZ)
+            psz = SG_LIB_THP_SZ;
+    }
+#endif
 
 #ifdef HAVE_POSIX_MEMALIGN
     {
@@ -3721,7 +4125,15 @@ sg_memalign(uint32_t num_bytes, uint32_t align_to, uint8_t ** buff_to_free,
                   __func__, err);
             return NULL;
         }
-        memset(wp, 0, num_bytes);
+#if defined(SG_LIB_LINUX) && defined(MADV_HUGEPAGE)
+        if (thp && madvise(wp, num_bytes, MADV_HUGEPAGE)) {
+            thp = false;
+            if (vb)
+                pr2ws("%s: madvise(MADV_HUGEPAGE): %s, use base pages\n",
+                      __func__, safe_strerror(errno));
+        }
+#endif
+        memset(wp, 0, num_bytes);       /* places pages, THP if advised */
         if (buff_to_free)
             *buff_to_free = (uint8_t *)wp;
         res = (uint8_t *)wp;
@@ -3729,7 +4141,8 @@ sg_memalign(uint32_t num_bytes, uint32_t align_to, uint8_t ** buff_to_free,
             pr2ws("%s: posix_ma, len=%d, ", __func__, num_bytes);
             if (buff_to_free)
                 pr2ws("wrkBuffp=%p, ", (void *)res);
-            pr2ws("psz=%u, rp=%p\n", (unsigned int)psz, (void *)res);
+            pr2ws("psz=%u, rp=%p%s\n", (unsigned int)psz, (void *)res,
+                  (thp ? ", THP advised" : ""));
         }
         return res;
     }
@@ -19,7 +19,7 @@
 #include "sg_lib_data.h"
 
 
-const char * sg_lib_version_str = "2.68 20190904";/* spc5r22, sbc4r17 */
+const char * sg_lib_version_str = "2.69 20261018";/* spc5r22, sbc4r17 */
 
 
 /* indexed by pdt; those that map to own index do not decay */
@@ -1873,3 +1873,281 @@ struct sg_value_2names_t sg_exit_str_arr[] = {
 };
 
 #endif           /* (SG_SCSI_STRINGS && HAVE_NVME && (! IGNORE_NVME)) */
+
+/* CRC16 T10 DIF (polynomial 0x8bb7) lookup tables for a slice-by-8
+ * implementation. Row 0 is the classic byte at a time table, row k gives
+ * the CRC of a byte followed by k zero bytes. Used by sg_t10_crc16(). */
+const uint16_t sg_lib_t10dif_crc_tbl[8][256] = {
+    {
+        0x0000, 0x8bb7, 0x9cd9, 0x176e, 0xb205, 0x39b2, 0x2edc, 0xa56b,
+        0xefbd, 0x640a, 0x7364, 0xf8d3, 0x5db8, 0xd60f, 0xc161, 0x4ad6,
+        0x54cd, 0xdf7a, 0xc814, 0x43a3, 0xe6c8, 0x6d7f, 0x7a11, 0xf1a6,
+        0xbb70, 0x30c7, 0x27a9, 0xac1e, 0x0975, 0x82c2, 0x95ac, 0x1e1b,
+        0xa99a, 0x222d, 0x3543, 0xbef4, 0x1b9f, 0x9028, 0x8746, 0x0cf1,
+        0x4627, 0xcd90, 0xdafe, 0x5149, 0xf422, 0x7f95, 0x68fb, 0xe34c,
+        0xfd57, 0x76e0, 0x618e, 0xea39, 0x4f52, 0xc4e5, 0xd38b, 0x583c,
+        0x12ea, 0x995d, 0x8e33, 0x0584, 0xa0ef, 0x2b58, 0x3c36, 0xb781,
+        0xd883, 0x5334, 0x445a, 0xcfed, 0x6a86, 0xe131, 0xf65f, 0x7de8,
+        0x373e, 0xbc89, 0xabe7, 0x2050, 0x853b, 0x0e8c, 0x19e2, 0x9255,
+        0x8c4e, 0x07f9, 0x1097, 0x9b20, 0x3e4b, 0xb5fc, 0xa292, 0x2925,
+        0x63f3, 0xe844, 0xff2a, 0x749d, 0xd1f6, 0x5a41, 0x4d2f, 0xc698,
+        0x7119, 0xfaae, 0xedc0, 0x6677, 0xc31c, 0x48ab, 0x5fc5, 0xd472,
+        0x9ea4, 0x1513, 0x027d, 0x89ca, 0x2ca1, 0xa716, 0xb078, 0x3bcf,
+        0x25d4, 0xae63, 0xb90d, 0x32ba, 0x97d1, 0x1c66, 0x0b08, 0x80bf,
+        0xca69, 0x41de, 0x56b0, 0xdd07, 0x786c, 0xf3db, 0xe4b5, 0x6f02,
+        0x3ab1, 0xb106, 0xa668, 0x2ddf, 0x88b4, 0x0303, 0x146d, 0x9fda,
+        0xd50c, 0x5ebb, 0x49d5, 0xc262, 0x6709, 0xecbe, 0xfbd0, 0x7067,
+        0x6e7c, 0xe5cb, 0xf2a5, 0x7912, 0xdc79, 0x57ce, 0x40a0, 0xcb17,
+        0x81c1, 0x0a76, 0x1d18, 0x96af, 0x33c4, 0xb873, 0xaf1d, 0x24aa,
+        0x932b, 0x189c, 0x0ff2, 0x8445, 0x212e, 0xaa99, 0xbdf7, 0x3640,
+        0x7c96, 0xf721, 0xe04f, 0x6bf8, 0xce93, 0x4524, 0x524a, 0xd9fd,
+        0xc7e6, 0x4c51, 0x5b3f, 0xd088, 0x75e3, 0xfe54, 0xe93a, 0x628d,
+        0x285b, 0xa3ec, 0xb482, 0x3f35, 0x9a5e, 0x11e9, 0x0687, 0x8d30,
+        0xe232, 0x6985, 0x7eeb, 0xf55c, 0x5037, 0xdb80, 0xccee, 0x4759,
+        0x0d8f, 0x8638, 0x9156, 0x1ae1, 0xbf8a, 0x343d, 0x2353, 0xa8e4,
+        0xb6ff, 0x3d48, 0x2a26, 0xa191, 0x04fa, 0x8f4d, 0x9823, 0x1394,
+        0x5942, 0xd2f5, 0xc59b, 0x4e2c, 0xeb47, 0x60f0, 0x779e, 0xfc29,
+        0x4ba8, 0xc01f, 0xd771, 0x5cc6, 0xf9ad, 0x721a, 0x6574, 0xeec3,
+        0xa415, 0x2fa2, 0x38cc, 0xb37b, 0x1610, 0x9da7, 0x8ac9, 0x017e,
+        0x1f65, 0x94d2, 0x83bc, 0x080b, 0xad60, 0x26d7, 0x31b9, 0xba0e,
+        0xf0d8, 0x7b6f, 0x6c01, 0xe7b6, 0x42dd, 0xc96a, 0xde04, 0x55b3
+    },
+    {
+        0x0000, 0x7562, 0xeac4, 0x9fa6, 0x5e3f, 0x2b5d, 0xb4fb, 0xc199,
+        0xbc7e, 0xc91c, 0x56ba, 0x23d8, 0xe241, 0x9723, 0x0885, 0x7de7,
+        0xf34b, 0x8629, 0x198f, 0x6ced, 0xad74, 0xd816, 0x47b0, 0x32d2,
+        0x4f35, 0x3a57, 0xa5f1, 0xd093, 0x110a, 0x6468, 0xfbce, 0x8eac,
+        0x6d21, 0x1843, 0x87e5, 0xf287, 0x331e, 0x467c, 0xd9da, 0xacb8,
+        0xd15f, 0xa43d, 0x3b9b, 0x4ef9, 0x8f60, 0xfa02, 0x65a4, 0x10c6,
+        0x9e6a, 0xeb08, 0x74ae, 0x01cc, 0xc055, 0xb537, 0x2a91, 0x5ff3,
+        0x2214, 0x5776, 0xc8d0, 0xbdb2, 0x7c2b, 0x0949, 0x96ef, 0xe38d,
+        0xda42, 0xaf20, 0x3086, 0x45e4, 0x847d, 0xf11f, 0x6eb9, 0x1bdb,
+        0x663c, 0x135e, 0x8cf8, 0xf99a, 0x3803, 0x4d61, 0xd2c7, 0xa7a5,
+        0x2909, 0x5c6b, 0xc3cd, 0xb6af, 0x7736, 0x0254, 0x9df2, 0xe890,
+        0x9577, 0xe015, 0x7fb3, 0x0ad1, 0xcb48, 0xbe2a, 0x218c, 0x54ee,
+        0xb763, 0xc201, 0x5da7, 0x28c5, 0xe95c, 0x9c3e, 0x0398, 0x76fa,
+        0x0b1d, 0x7e7f, 0xe1d9, 0x94bb, 0x5522, 0x2040, 0xbfe6, 0xca84,
+        0x4428, 0x314a, 0xaeec, 0xdb8e, 0x1a17, 0x6f75, 0xf0d3, 0x85b1,
+        0xf856, 0x8d34, 0x1292, 0x67f0, 0xa669, 0xd30b, 0x4cad, 0x39cf,
+        0x3f33, 0x4a51, 0xd5f7, 0xa095, 0x610c, 0x146e, 0x8bc8, 0xfeaa,
+        0x834d, 0xf62f, 0x6989, 0x1ceb, 0xdd72, 0xa810, 0x37b6, 0x42d4,
+        0xcc78, 0xb91a, 0x26bc, 0x53de, 0x9247, 0xe725, 0x7883, 0x0de1,
+        0x7006, 0x0564, 0x9ac2, 0xefa0, 0x2e39, 0x5b5b, 0xc4fd, 0xb19f,
+        0x5212, 0x2770, 0xb8d6, 0xcdb4, 0x0c2d, 0x794f, 0xe6e9, 0x938b,
+        0xee6c, 0x9b0e, 0x04a8, 0x71ca, 0xb053, 0xc531, 0x5a97, 0x2ff5,
+        0xa159, 0xd43b, 0x4b9d, 0x3eff, 0xff66, 0x8a04, 0x15a2, 0x60c0,
+        0x1d27, 0x6845, 0xf7e3, 0x8281, 0x4318, 0x367a, 0xa9dc, 0xdcbe,
+        0xe571, 0x9013, 0x0fb5, 0x7ad7, 0xbb4e, 0xce2c, 0x518a, 0x24e8,
+        0x590f, 0x2c6d, 0xb3cb, 0xc6a9, 0x0730, 0x7252, 0xedf4, 0x9896,
+        0x163a, 0x6358, 0xfcfe, 0x899c, 0x4805, 0x3d67, 0xa2c1, 0xd7a3,
+        0xaa44, 0xdf26, 0x4080, 0x35e2, 0xf47b, 0x8119, 0x1ebf, 0x6bdd,
+        0x8850, 0xfd32, 0x6294, 0x17f6, 0xd66f, 0xa30d, 0x3cab, 0x49c9,
+        0x342e, 0x414c, 0xdeea, 0xab88, 0x6a11, 0x1f73, 0x80d5, 0xf5b7,
+        0x7b1b, 0x0e79, 0x91df, 0xe4bd, 0x2524, 0x5046, 0xcfe0, 0xba82,
+        0xc765, 0xb207, 0x2da1, 0x58c3, 0x995a, 0xec38, 0x739e, 0x06fc
+    },
+    {
+        0x0000, 0x7e66, 0xfccc, 0x82aa, 0x722f, 0x0c49, 0x8ee3, 0xf085,
+        0xe45e, 0x9a38, 0x1892, 0x66f4, 0x9671, 0xe817, 0x6abd, 0x14db,
+        0x430b, 0x3d6d, 0xbfc7, 0xc1a1, 0x3124, 0x4f42, 0xcde8, 0xb38e,
+        0xa755, 0xd933, 0x5b99, 0x25ff, 0xd57a, 0xab1c, 0x29b6, 0x57d0,
+        0x8616, 0xf870, 0x7ada, 0x04bc, 0xf439, 0x8a5f, 0x08f5, 0x7693,
+        0x6248, 0x1c2e, 0x9e84, 0xe0e2, 0x1067, 0x6e01, 0xecab, 0x92cd,
+        0xc51d, 0xbb7b, 0x39d1, 0x47b7, 0xb732, 0xc954, 0x4bfe, 0x3598,
+        0x2143, 0x5f25, 0xdd8f, 0xa3e9, 0x536c, 0x2d0a, 0xafa0, 0xd1c6,
+        0x879b, 0xf9fd, 0x7b57, 0x0531, 0xf5b4, 0x8bd2, 0x0978, 0x771e,
+        0x63c5, 0x1da3, 0x9f09, 0xe16f, 0x11ea, 0x6f8c, 0xed26, 0x9340,
+        0xc490, 0xbaf6, 0x385c, 0x463a, 0xb6bf, 0xc8d9, 0x4a73, 0x3415,
+        0x20ce, 0x5ea8, 0xdc02, 0xa264, 0x52e1, 0x2c87, 0xae2d, 0xd04b,
+        0x018d, 0x7feb, 0xfd41, 0x8327, 0x73a2, 0x0dc4, 0x8f6e, 0xf108,
+        0xe5d3, 0x9bb5, 0x191f, 0x6779, 0x97fc, 0xe99a, 0x6b30, 0x1556,
+        0x4286, 0x3ce0, 0xbe4a, 0xc02c, 0x30a9, 0x4ecf, 0xcc65, 0xb203,
+        0xa6d8, 0xd8be, 0x5a14, 0x2472, 0xd4f7, 0xaa91, 0x283b, 0x565d,
+        0x8481, 0xfae7, 0x784d, 0x062b, 0xf6ae, 0x88c8, 0x0a62, 0x7404,
+        0x60df, 0x1eb9, 0x9c13, 0xe275, 0x12f0, 0x6c96, 0xee3c, 0x905a,
+        0xc78a, 0xb9ec, 0x3b46, 0x4520, 0xb5a5, 0xcbc3, 0x4969, 0x370f,
+        0x23d4, 0x5db2, 0xdf18, 0xa17e, 0x51fb, 0x2f9d, 0xad37, 0xd351,
+        0x0297, 0x7cf1, 0xfe5b, 0x803d, 0x70b8, 0x0ede, 0x8c74, 0xf212,
+        0xe6c9, 0x98af, 0x1a05, 0x6463, 0x94e6, 0xea80, 0x682a, 0x164c,
+        0x419c, 0x3ffa, 0xbd50, 0xc336, 0x33b3, 0x4dd5, 0xcf7f, 0xb119,
+        0xa5c2, 0xdba4, 0x590e, 0x2768, 0xd7ed, 0xa98b, 0x2b21, 0x5547,
+        0x031a, 0x7d7c, 0xffd6, 0x81b0, 0x7135, 0x0f53, 0x8df9, 0xf39f,
+        0xe744, 0x9922, 0x1b88, 0x65ee, 0x956b, 0xeb0d, 0x69a7, 0x17c1,
+        0x4011, 0x3e77, 0xbcdd, 0xc2bb, 0x323e, 0x4c58, 0xcef2, 0xb094,
+        0xa44f, 0xda29, 0x5883, 0x26e5, 0xd660, 0xa806, 0x2aac, 0x54ca,
+        0x850c, 0xfb6a, 0x79c0, 0x07a6, 0xf723, 0x8945, 0x0bef, 0x7589,
+        0x6152, 0x1f34, 0x9d9e, 0xe3f8, 0x137d, 0x6d1b, 0xefb1, 0x91d7,
+        0xc607, 0xb861, 0x3acb, 0x44ad, 0xb428, 0xca4e, 0x48e4, 0x3682,
+        0x2259, 0x5c3f, 0xde95, 0xa0f3, 0x5076, 0x2e10, 0xacba, 0xd2dc
+    },
+    {
+        0x0000, 0x82b5, 0x8edd, 0x0c68, 0x960d, 0x14b8, 0x18d0, 0x9a65,
+        0xa7ad, 0x2518, 0x2970, 0xabc5, 0x31a0, 0xb315, 0xbf7d, 0x3dc8,
+        0xc4ed, 0x4658, 0x4a30, 0xc885, 0x52e0, 0xd055, 0xdc3d, 0x5e88,
+        0x6340, 0xe1f5, 0xed9d, 0x6f28, 0xf54d, 0x77f8, 0x7b90, 0xf925,
+        0x026d, 0x80d8, 0x8cb0, 0x0e05, 0x9460, 0x16d5, 0x1abd, 0x9808,
+        0xa5c0, 0x2775, 0x2b1d, 0xa9a8, 0x33cd, 0xb178, 0xbd10, 0x3fa5,
+        0xc680, 0x4435, 0x485d, 0xcae8, 0x508d, 0xd238, 0xde50, 0x5ce5,
+        0x612d, 0xe398, 0xeff0, 0x6d45, 0xf720, 0x7595, 0x79fd, 0xfb48,
+        0x04da, 0x866f, 0x8a07, 0x08b2, 0x92d7, 0x1062, 0x1c0a, 0x9ebf,
+        0xa377, 0x21c2, 0x2daa, 0xaf1f, 0x357a, 0xb7cf, 0xbba7, 0x3912,
+        0xc037, 0x4282, 0x4eea, 0xcc5f, 0x563a, 0xd48f, 0xd8e7, 0x5a52,
+        0x679a, 0xe52f, 0xe947, 0x6bf2, 0xf197, 0x7322, 0x7f4a, 0xfdff,
+        0x06b7, 0x8402, 0x886a, 0x0adf, 0x90ba, 0x120f, 0x1e67, 0x9cd2,
+        0xa11a, 0x23af, 0x2fc7, 0xad72, 0x3717, 0xb5a2, 0xb9ca, 0x3b7f,
+        0xc25a, 0x40ef, 0x4c87, 0xce32, 0x5457, 0xd6e2, 0xda8a, 0x583f,
+        0x65f7, 0xe742, 0xeb2a, 0x699f, 0xf3fa, 0x714f, 0x7d27, 0xff92,
+        0x09b4, 0x8b01, 0x8769, 0x05dc, 0x9fb9, 0x1d0c, 0x1164, 0x93d1,
+        0xae19, 0x2cac, 0x20c4, 0xa271, 0x3814, 0xbaa1, 0xb6c9, 0x347c,
+        0xcd59, 0x4fec, 0x4384, 0xc131, 0x5b54, 0xd9e1, 0xd589, 0x573c,
+        0x6af4, 0xe841, 0xe429, 0x669c, 0xfcf9, 0x7e4c, 0x7224, 0xf091,
+        0x0bd9, 0x896c, 0x8504, 0x07b1, 0x9dd4, 0x1f61, 0x1309, 0x91bc,
+        0xac74, 0x2ec1, 0x22a9, 0xa01c, 0x3a79, 0xb8cc, 0xb4a4, 0x3611,
+        0xcf34, 0x4d81, 0x41e9, 0xc35c, 0x5939, 0xdb8c, 0xd7e4, 0x5551,
+        0x6899, 0xea2c, 0xe644, 0x64f1, 0xfe94, 0x7c21, 0x7049, 0xf2fc,
+        0x0d6e, 0x8fdb, 0x83b3, 0x0106, 0x9b63, 0x19d6, 0x15be, 0x970b,
+        0xaac3, 0x2876, 0x241e, 0xa6ab, 0x3cce, 0xbe7b, 0xb213, 0x30a6,
+        0xc983, 0x4b36, 0x475e, 0xc5eb, 0x5f8e, 0xdd3b, 0xd153, 0x53e6,
+        0x6e2e, 0xec9b, 0xe0f3, 0x6246, 0xf823, 0x7a96, 0x76fe, 0xf44b,
+        0x0f03, 0x8db6, 0x81de, 0x036b, 0x990e, 0x1bbb, 0x17d3, 0x9566,
+        0xa8ae, 0x2a1b, 0x2673, 0xa4c6, 0x3ea3, 0xbc16, 0xb07e, 0x32cb,
+        0xcbee, 0x495b, 0x4533, 0xc786, 0x5de3, 0xdf56, 0xd33e, 0x518b,
+        0x6c43, 0xeef6, 0xe29e, 0x602b, 0xfa4e, 0x78fb, 0x7493, 0xf626
+    },
+    {
+        0x0000, 0x1368, 0x26d0, 0x35b8, 0x4da0, 0x5ec8, 0x6b70, 0x7818,
+        0x9b40, 0x8828, 0xbd90, 0xaef8, 0xd6e0, 0xc588, 0xf030, 0xe358,
+        0xbd37, 0xae5f, 0x9be7, 0x888f, 0xf097, 0xe3ff, 0xd647, 0xc52f,
+        0x2677, 0x351f, 0x00a7, 0x13cf, 0x6bd7, 0x78bf, 0x4d07, 0x5e6f,
+        0xf1d9, 0xe2b1, 0xd709, 0xc461, 0xbc79, 0xaf11, 0x9aa9, 0x89c1,
+        0x6a99, 0x79f1, 0x4c49, 0x5f21, 0x2739, 0x3451, 0x01e9, 0x1281,
+        0x4cee, 0x5f86, 0x6a3e, 0x7956, 0x014e, 0x1226, 0x279e, 0x34f6,
+        0xd7ae, 0xc4c6, 0xf17e, 0xe216, 0x9a0e, 0x8966, 0xbcde, 0xafb6,
+        0x6805, 0x7b6d, 0x4ed5, 0x5dbd, 0x25a5, 0x36cd, 0x0375, 0x101d,
+        0xf345, 0xe02d, 0xd595, 0xc6fd, 0xbee5, 0xad8d, 0x9835, 0x8b5d,
+        0xd532, 0xc65a, 0xf3e2, 0xe08a, 0x9892, 0x8bfa, 0xbe42, 0xad2a,
+        0x4e72, 0x5d1a, 0x68a2, 0x7bca, 0x03d2, 0x10ba, 0x2502, 0x366a,
+        0x99dc, 0x8ab4, 0xbf0c, 0xac64, 0xd47c, 0xc714, 0xf2ac, 0xe1c4,
+        0x029c, 0x11f4, 0x244c, 0x3724, 0x4f3c, 0x5c54, 0x69ec, 0x7a84,
+        0x24eb, 0x3783, 0x023b, 0x1153, 0x694b, 0x7a23, 0x4f9b, 0x5cf3,
+        0xbfab, 0xacc3, 0x997b, 0x8a13, 0xf20b, 0xe163, 0xd4db, 0xc7b3,
+        0xd00a, 0xc362, 0xf6da, 0xe5b2, 0x9daa, 0x8ec2, 0xbb7a, 0xa812,
+        0x4b4a, 0x5822, 0x6d9a, 0x7ef2, 0x06ea, 0x1582, 0x203a, 0x3352,
+        0x6d3d, 0x7e55, 0x4bed, 0x5885, 0x209d, 0x33f5, 0x064d, 0x1525,
+        0xf67d, 0xe515, 0xd0ad, 0xc3c5, 0xbbdd, 0xa8b5, 0x9d0d, 0x8e65,
+        0x21d3, 0x32bb, 0x0703, 0x146b, 0x6c73, 0x7f1b, 0x4aa3, 0x59cb,
+        0xba93, 0xa9fb, 0x9c43, 0x8f2b, 0xf733, 0xe45b, 0xd1e3, 0xc28b,
+        0x9ce4, 0x8f8c, 0xba34, 0xa95c, 0xd144, 0xc22c, 0xf794, 0xe4fc,
+        0x07a4, 0x14cc, 0x2174, 0x321c, 0x4a04, 0x596c, 0x6cd4, 0x7fbc,
+        0xb80f, 0xab67, 0x9edf, 0x8db7, 0xf5af, 0xe6c7, 0xd37f, 0xc017,
+        0x234f, 0x3027, 0x059f, 0x16f7, 0x6eef, 0x7d87, 0x483f, 0x5b57,
+        0x0538, 0x1650, 0x23e8, 0x3080, 0x4898, 0x5bf0, 0x6e48, 0x7d20,
+        0x9e78, 0x8d10, 0xb8a8, 0xabc0, 0xd3d8, 0xc0b0, 0xf508, 0xe660,
+        0x49d6, 0x5abe, 0x6f06, 0x7c6e, 0x0476, 0x171e, 0x22a6, 0x31ce,
+        0xd296, 0xc1fe, 0xf446, 0xe72e, 0x9f36, 0x8c5e, 0xb9e6, 0xaa8e,
+        0xf4e1, 0xe789, 0xd231, 0xc159, 0xb941, 0xaa29, 0x9f91, 0x8cf9,
+        0x6fa1, 0x7cc9, 0x4971, 0x5a19, 0x2201, 0x3169, 0x04d1, 0x17b9
+    },
+    {
+        0x0000, 0x2ba3, 0x5746, 0x7ce5, 0xae8c, 0x852f, 0xf9ca, 0xd269,
+        0xd6af, 0xfd0c, 0x81e9, 0xaa4a, 0x7823, 0x5380, 0x2f65, 0x04c6,
+        0x26e9, 0x0d4a, 0x71af, 0x5a0c, 0x8865, 0xa3c6, 0xdf23, 0xf480,
+        0xf046, 0xdbe5, 0xa700, 0x8ca3, 0x5eca, 0x7569, 0x098c, 0x222f,
+        0x4dd2, 0x6671, 0x1a94, 0x3137, 0xe35e, 0xc8fd, 0xb418, 0x9fbb,
+        0x9b7d, 0xb0de, 0xcc3b, 0xe798, 0x35f1, 0x1e52, 0x62b7, 0x4914,
+        0x6b3b, 0x4098, 0x3c7d, 0x17de, 0xc5b7, 0xee14, 0x92f1, 0xb952,
+        0xbd94, 0x9637, 0xead2, 0xc171, 0x1318, 0x38bb, 0x445e, 0x6ffd,
+        0x9ba4, 0xb007, 0xcce2, 0xe741, 0x3528, 0x1e8b, 0x626e, 0x49cd,
+        0x4d0b, 0x66a8, 0x1a4d, 0x31ee, 0xe387, 0xc824, 0xb4c1, 0x9f62,
+        0xbd4d, 0x96ee, 0xea0b, 0xc1a8, 0x13c1, 0x3862, 0x4487, 0x6f24,
+        0x6be2, 0x4041, 0x3ca4, 0x1707, 0xc56e, 0xeecd, 0x9228, 0xb98b,
+        0xd676, 0xfdd5, 0x8130, 0xaa93, 0x78fa, 0x5359, 0x2fbc, 0x041f,
+        0x00d9, 0x2b7a, 0x579f, 0x7c3c, 0xae55, 0x85f6, 0xf913, 0xd2b0,
+        0xf09f, 0xdb3c, 0xa7d9, 0x8c7a, 0x5e13, 0x75b0, 0x0955, 0x22f6,
+        0x2630, 0x0d93, 0x7176, 0x5ad5, 0x88bc, 0xa31f, 0xdffa, 0xf459,
+        0xbcff, 0x975c, 0xebb9, 0xc01a, 0x1273, 0x39d0, 0x4535, 0x6e96,
+        0x6a50, 0x41f3, 0x3d16, 0x16b5, 0xc4dc, 0xef7f, 0x939a, 0xb839,
+        0x9a16, 0xb1b5, 0xcd50, 0xe6f3, 0x349a, 0x1f39, 0x63dc, 0x487f,
+        0x4cb9, 0x671a, 0x1bff, 0x305c, 0xe235, 0xc996, 0xb573, 0x9ed0,
+        0xf12d, 0xda8e, 0xa66b, 0x8dc8, 0x5fa1, 0x7402, 0x08e7, 0x2344,
+        0x2782, 0x0c21, 0x70c4, 0x5b67, 0x890e, 0xa2ad, 0xde48, 0xf5eb,
+        0xd7c4, 0xfc67, 0x8082, 0xab21, 0x7948, 0x52eb, 0x2e0e, 0x05ad,
+        0x016b, 0x2ac8, 0x562d, 0x7d8e, 0xafe7, 0x8444, 0xf8a1, 0xd302,
+        0x275b, 0x0cf8, 0x701d, 0x5bbe, 0x89d7, 0xa274, 0xde91, 0xf532,
+        0xf1f4, 0xda57, 0xa6b2, 0x8d11, 0x5f78, 0x74db, 0x083e, 0x239d,
+        0x01b2, 0x2a11, 0x56f4, 0x7d57, 0xaf3e, 0x849d, 0xf878, 0xd3db,
+        0xd71d, 0xfcbe, 0x805b, 0xabf8, 0x7991, 0x5232, 0x2ed7, 0x0574,
+        0x6a89, 0x412a, 0x3dcf, 0x166c, 0xc405, 0xefa6, 0x9343, 0xb8e0,
+        0xbc26, 0x9785, 0xeb60, 0xc0c3, 0x12aa, 0x3909, 0x45ec, 0x6e4f,
+        0x4c60, 0x67c3, 0x1b26, 0x3085, 0xe2ec, 0xc94f, 0xb5aa, 0x9e09,
+        0x9acf, 0xb16c, 0xcd89, 0xe62a, 0x3443, 0x1fe0, 0x6305, 0x48a6
+    },
+    {
+        0x0000, 0xf249, 0x6f25, 0x9d6c, 0xde4a, 0x2c03, 0xb16f, 0x4326,
+        0x3723, 0xc56a, 0x5806, 0xaa4f, 0xe969, 0x1b20, 0x864c, 0x7405,
+        0x6e46, 0x9c0f, 0x0163, 0xf32a, 0xb00c, 0x4245, 0xdf29, 0x2d60,
+        0x5965, 0xab2c, 0x3640, 0xc409, 0x872f, 0x7566, 0xe80a, 0x1a43,
+        0xdc8c, 0x2ec5, 0xb3a9, 0x41e0, 0x02c6, 0xf08f, 0x6de3, 0x9faa,
+        0xebaf, 0x19e6, 0x848a, 0x76c3, 0x35e5, 0xc7ac, 0x5ac0, 0xa889,
+        0xb2ca, 0x4083, 0xddef, 0x2fa6, 0x6c80, 0x9ec9, 0x03a5, 0xf1ec,
+        0x85e9, 0x77a0, 0xeacc, 0x1885, 0x5ba3, 0xa9ea, 0x3486, 0xc6cf,
+        0x32af, 0xc0e6, 0x5d8a, 0xafc3, 0xece5, 0x1eac, 0x83c0, 0x7189,
+        0x058c, 0xf7c5, 0x6aa9, 0x98e0, 0xdbc6, 0x298f, 0xb4e3, 0x46aa,
+        0x5ce9, 0xaea0, 0x33cc, 0xc185, 0x82a3, 0x70ea, 0xed86, 0x1fcf,
+        0x6bca, 0x9983, 0x04ef, 0xf6a6, 0xb580, 0x47c9, 0xdaa5, 0x28ec,
+        0xee23, 0x1c6a, 0x8106, 0x734f, 0x3069, 0xc220, 0x5f4c, 0xad05,
+        0xd900, 0x2b49, 0xb625, 0x446c, 0x074a, 0xf503, 0x686f, 0x9a26,
+        0x8065, 0x722c, 0xef40, 0x1d09, 0x5e2f, 0xac66, 0x310a, 0xc343,
+        0xb746, 0x450f, 0xd863, 0x2a2a, 0x690c, 0x9b45, 0x0629, 0xf460,
+        0x655e, 0x9717, 0x0a7b, 0xf832, 0xbb14, 0x495d, 0xd431, 0x2678,
+        0x527d, 0xa034, 0x3d58, 0xcf11, 0x8c37, 0x7e7e, 0xe312, 0x115b,
+        0x0b18, 0xf951, 0x643d, 0x9674, 0xd552, 0x271b, 0xba77, 0x483e,
+        0x3c3b, 0xce72, 0x531e, 0xa157, 0xe271, 0x1038, 0x8d54, 0x7f1d,
+        0xb9d2, 0x4b9b, 0xd6f7, 0x24be, 0x6798, 0x95d1, 0x08bd, 0xfaf4,
+        0x8ef1, 0x7cb8, 0xe1d4, 0x139d, 0x50bb, 0xa2f2, 0x3f9e, 0xcdd7,
+        0xd794, 0x25dd, 0xb8b1, 0x4af8, 0x09de, 0xfb97, 0x66fb, 0x94b2,
+        0xe0b7, 0x12fe, 0x8f92, 0x7ddb, 0x3efd, 0xccb4, 0x51d8, 0xa391,
+        0x57f1, 0xa5b8, 0x38d4, 0xca9d, 0x89bb, 0x7bf2, 0xe69e, 0x14d7,
+        0x60d2, 0x929b, 0x0ff7, 0xfdbe, 0xbe98, 0x4cd1, 0xd1bd, 0x23f4,
+        0x39b7, 0xcbfe, 0x5692, 0xa4db, 0xe7fd, 0x15b4, 0x88d8, 0x7a91,
+        0x0e94, 0xfcdd, 0x61b1, 0x93f8, 0xd0de, 0x2297, 0xbffb, 0x4db2,
+        0x8b7d, 0x7934, 0xe458, 0x1611, 0x5537, 0xa77e, 0x3a12, 0xc85b,
+        0xbc5e, 0x4e17, 0xd37b, 0x2132, 0x6214, 0x905d, 0x0d31, 0xff78,
+        0xe53b, 0x1772, 0x8a1e, 0x7857, 0x3b71, 0xc938, 0x5454, 0xa61d,
+        0xd218, 0x2051, 0xbd3d, 0x4f74, 0x0c52, 0xfe1b, 0x6377, 0x913e
+    },
+    {
+        0x0000, 0xcabc, 0x1ecf, 0xd473, 0x3d9e, 0xf722, 0x2351, 0xe9ed,
+        0x7b3c, 0xb180, 0x65f3, 0xaf4f, 0x46a2, 0x8c1e, 0x586d, 0x92d1,
+        0xf678, 0x3cc4, 0xe8b7, 0x220b, 0xcbe6, 0x015a, 0xd529, 0x1f95,
+        0x8d44, 0x47f8, 0x938b, 0x5937, 0xb0da, 0x7a66, 0xae15, 0x64a9,
+        0x6747, 0xadfb, 0x7988, 0xb334, 0x5ad9, 0x9065, 0x4416, 0x8eaa,
+        0x1c7b, 0xd6c7, 0x02b4, 0xc808, 0x21e5, 0xeb59, 0x3f2a, 0xf596,
+        0x913f, 0x5b83, 0x8ff0, 0x454c, 0xaca1, 0x661d, 0xb26e, 0x78d2,
+        0xea03, 0x20bf, 0xf4cc, 0x3e70, 0xd79d, 0x1d21, 0xc952, 0x03ee,
+        0xce8e, 0x0432, 0xd041, 0x1afd, 0xf310, 0x39ac, 0xeddf, 0x2763,
+        0xb5b2, 0x7f0e, 0xab7d, 0x61c1, 0x882c, 0x4290, 0x96e3, 0x5c5f,
+        0x38f6, 0xf24a, 0x2639, 0xec85, 0x0568, 0xcfd4, 0x1ba7, 0xd11b,
+        0x43ca, 0x8976, 0x5d05, 0x97b9, 0x7e54, 0xb4e8, 0x609b, 0xaa27,
+        0xa9c9, 0x6375, 0xb706, 0x7dba, 0x9457, 0x5eeb, 0x8a98, 0x4024,
+        0xd2f5, 0x1849, 0xcc3a, 0x0686, 0xef6b, 0x25d7, 0xf1a4, 0x3b18,
+        0x5fb1, 0x950d, 0x417e, 0x8bc2, 0x622f, 0xa893, 0x7ce0, 0xb65c,
+        0x248d, 0xee31, 0x3a42, 0xf0fe, 0x1913, 0xd3af, 0x07dc, 0xcd60,
+        0x16ab, 0xdc17, 0x0864, 0xc2d8, 0x2b35, 0xe189, 0x35fa, 0xff46,
+        0x6d97, 0xa72b, 0x7358, 0xb9e4, 0x5009, 0x9ab5, 0x4ec6, 0x847a,
+        0xe0d3, 0x2a6f, 0xfe1c, 0x34a0, 0xdd4d, 0x17f1, 0xc382, 0x093e,
+        0x9bef, 0x5153, 0x8520, 0x4f9c, 0xa671, 0x6ccd, 0xb8be, 0x7202,
+        0x71ec, 0xbb50, 0x6f23, 0xa59f, 0x4c72, 0x86ce, 0x52bd, 0x9801,
+        0x0ad0, 0xc06c, 0x141f, 0xdea3, 0x374e, 0xfdf2, 0x2981, 0xe33d,
+        0x8794, 0x4d28, 0x995b, 0x53e7, 0xba0a, 0x70b6, 0xa4c5, 0x6e79,
+        0xfca8, 0x3614, 0xe267, 0x28db, 0xc136, 0x0b8a, 0xdff9, 0x1545,
+        0xd825, 0x1299, 0xc6ea, 0x0c56, 0xe5bb, 0x2f07, 0xfb74, 0x31c8,
+        0xa319, 0x69a5, 0xbdd6, 0x776a, 0x9e87, 0x543b, 0x8048, 0x4af4,
+        0x2e5d, 0xe4e1, 0x3092, 0xfa2e, 0x13c3, 0xd97f, 0x0d0c, 0xc7b0,
+        0x5561, 0x9fdd, 0x4bae, 0x8112, 0x68ff, 0xa243, 0x7630, 0xbc8c,
+        0xbf62, 0x75de, 0xa1ad, 0x6b11, 0x82fc, 0x4840, 0x9c33, 0x568f,
+        0xc45e, 0x0ee2, 0xda91, 0x102d, 0xf9c0, 0x337c, 0xe70f, 0x2db3,
+        0x491a, 0x83a6, 0x57d5, 0x9d69, 0x7484, 0xbe38, 0x6a4b, 0xa0f7,
+        0x3226, 0xf89a, 0x2ce9, 0xe655, 0x0fb8, 0xc504, 0x1177, 0xdbcb
+    }
+};
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2019 Douglas Gilbert.
+ * Copyright (c) 2009-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -13,8 +13,14 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
+#ifdef _POSIX_PRIORITY_SCHEDULING
+#include <sched.h>      /* for sched_yield() */
+#endif
 
 
 #ifdef HAVE_CONFIG_H
@@ -31,7 +37,7 @@
 #include "sg_pt_nvme.h"
 #endif
 
-static const char * scsi_pt_version_str = "3.12 20190612";
+static const char * scsi_pt_version_str = "3.13 20261018";
 
 
 const char *
@@ -546,3 +552,459 @@ err_out:
 }
 
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) [near line 140] */
+
+
+/* Per device command timeouts learnt from REPORT SUPPORTED OPERATION CODES
+ * (RSOC) with RCTD set. A table is kept per device and each open file
+ * descriptor of that device points at it. The critical sections are short
+ * so a spin lock (that yields the CPU while waiting) is used rather
+ * than making the library depend on pthreads. */
+
+#define SG_PT_TMO_MAX_FDS 256
+#define SG_PT_TMO_RSOC_LEN (64 * 1024)
+#define SG_PT_TMO_VPD_LEN 1024
+#define SG_PT_TMO_CMD_SECS 60   /* for RSOC and INQUIRY sent here */
+#define SG_PT_TMO_LU_NAME_LEN 160
+
+struct sg_pt_tmo_ent {
+    uint32_t key;               /* (opcode << 16) | service action */
+    bool sav;                   /* service action valid */
+    uint32_t nominal;           /* seconds, 0 if not reported */
+    uint32_t recommended;       /* seconds, 0 if not reported */
+};
+
+struct sg_pt_tmo_tbl {
+    int refs;                   /* number of file descriptors using it */
+    int num;
+    int max;
+    uint8_t sa_ops[32];         /* bitmap of opcodes with service actions */
+    char * dev_name;            /* NULL if not shareable */
+    struct sg_pt_tmo_ent * arr; /* sorted by key */
+};
+
+struct sg_pt_tmo_fd {
+    int fd;
+    struct sg_pt_tmo_tbl * tp;  /* NULL when slot is free */
+};
+
+static struct sg_pt_tmo_fd sg_pt_tmo_fds[SG_PT_TMO_MAX_FDS];
+static int sg_pt_tmo_num_fds = 0;       /* fast path when 0 */
+static bool sg_pt_tmo_busy = false;
+
+
+static void
+sg_pt_tmo_lock(void)
+{
+    while (__atomic_test_and_set(&sg_pt_tmo_busy, __ATOMIC_ACQUIRE)) {
+#ifdef _POSIX_PRIORITY_SCHEDULING
+        sched_yield();
+#endif
+    }
+}
+
+static void
+sg_pt_tmo_unlock(void)
+{
+    __atomic_clear(&sg_pt_tmo_busy, __ATOMIC_RELEASE);
+}
+
+static int
+sg_pt_tmo_cmp(const void * a, const void * b)
+{
+    uint32_t ka = ((const struct sg_pt_tmo_ent *)a)->key;
+    uint32_t kb = ((const struct sg_pt_tmo_ent *)b)->key;
+
+    return (ka < kb) ? -1 : (ka > kb);
+}
+
+static void
+sg_pt_tmo_free(struct sg_pt_tmo_tbl * tp)
+{
+    if (tp) {
+        free(tp->arr);
+        free(tp->dev_name);
+        free(tp);
+    }
+}
+
+static int
+sg_pt_tmo_add(struct sg_pt_tmo_tbl * tp, int opcode, bool sav, int sa,
+              uint32_t nominal, uint32_t recommended)
+{
+    struct sg_pt_tmo_ent * ep;
+
+    if (sav)
+        tp->sa_ops[opcode >> 3] |= (1 << (opcode & 0x7));
+    if ((0 == nominal) && (0 == recommended))
+        return 0;
+    if (tp->num >= tp->max) {
+        tp->max = tp->max ? (2 * tp->max) : 64;
+        ep = (struct sg_pt_tmo_ent *)realloc(tp->arr,
+                                     tp->max * sizeof(struct sg_pt_tmo_ent));
+        if (NULL == ep)
+            return -ENOMEM;
+        tp->arr = ep;
+    }
+    ep = tp->arr + tp->num++;
+    ep->key = ((uint32_t)opcode << 16) | (sav ? (sa & 0xffff) : 0);
+    ep->sav = sav;
+    ep->nominal = nominal;
+    ep->recommended = recommended;
+    return 0;
+}
+
+/* Sends a data-in command to dev_fd. Returns the number of bytes received,
+ * -EIO if the command failed or another negated errno value. */
+static int
+sg_pt_tmo_cmd(int dev_fd, const uint8_t * cdb, int cdb_len, uint8_t * bp,
+              int len, int verbose)
+{
+    int res;
+    struct sg_pt_base * ptvp;
+    uint8_t sense_b[32];
+
+    ptvp = construct_scsi_pt_obj_with_fd(dev_fd, verbose);
+    if (NULL == ptvp)
+        return -ENOMEM;
+    if (pt_device_is_nvme(ptvp)) {
+        destruct_scsi_pt_obj(ptvp);
+        return -EIO;
+    }
+    set_scsi_pt_cdb(ptvp, cdb, cdb_len);
+    set_scsi_pt_data_in(ptvp, bp, len);
+    set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+    res = do_scsi_pt(ptvp, -1, SG_PT_TMO_CMD_SECS, verbose);
+    if (0 == res) {
+        if (SCSI_PT_RESULT_GOOD == get_scsi_pt_result_category(ptvp))
+            res = len - get_scsi_pt_resid(ptvp);
+        else
+            res = -EIO;
+    } else if (res > 0)
+        res = -EIO;
+    destruct_scsi_pt_obj(ptvp);
+    return res;
+}
+
+/* Builds a logical unit name (e.g. "naa.5000c500a1b2c3d4") from the Device
+ * Identification VPD page, for naming cache files. Returns 0 if found. */
+static int
+sg_pt_tmo_lu_name(int dev_fd, char * b, int blen, int verbose)
+{
+    static const int desig_types[] = {3 /* NAA */, 2 /* EUI-64 */,
+                                      8 /* SCSI name string */};
+    int k, j, n, off, len, res;
+    uint8_t cdb[6] = {0x12, 0x1, 0x83, 0, 0, 0};
+    uint8_t * bp;
+    const uint8_t * dp;
+
+    bp = (uint8_t *)calloc(1, SG_PT_TMO_VPD_LEN);
+    if (NULL == bp)
+        return -ENOMEM;
+    sg_put_unaligned_be16(SG_PT_TMO_VPD_LEN, cdb + 3);
+    res = sg_pt_tmo_cmd(dev_fd, cdb, sizeof(cdb), bp, SG_PT_TMO_VPD_LEN,
+                        verbose);
+    if ((res < 4) || (0x83 != bp[1])) {
+        free(bp);
+        return (res < 0) ? res : -EIO;
+    }
+    len = sg_get_unaligned_be16(bp + 2);
+    if (len > (res - 4))
+        len = res - 4;
+    res = -ENOENT;
+    for (k = 0; k < (int)(sizeof(desig_types) / sizeof(desig_types[0]));
+         ++k) {
+        off = -1;
+        if (sg_vpd_dev_id_iter(bp + 4, len, &off, 0, desig_types[k], -1))
+            continue;
+        dp = bp + 4 + off;
+        n = snprintf(b, blen, "%s", (8 == desig_types[k]) ? "" :
+                     ((3 == desig_types[k]) ? "naa." : "eui."));
+        for (j = 0; (j < dp[3]) && (n < (blen - 3)); ++j) {
+            if (8 != desig_types[k])
+                n += snprintf(b + n, blen - n, "%02x", dp[4 + j]);
+            else if ('\0' == dp[4 + j])
+                break;
+            else
+                b[n++] = isalnum(dp[4 + j]) ? dp[4 + j] : '_';
+        }
+        b[n] = '\0';
+        if (n > 4) {
+            res = 0;
+            break;
+        }
+    }
+    free(bp);
+    return res;
+}
+
+/* Fills 'tp' from RSOC (all commands) with RCTD set. A device that does
+ * not support RSOC (or RCTD) yields an empty table. */
+static int
+sg_pt_tmo_rsoc(int dev_fd, struct sg_pt_tmo_tbl * tp, int verbose)
+{
+    int k, len, dlen, res;
+    uint8_t cdb[12] = {0xa3, 0xc, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t * bp;
+    const uint8_t * dp;
+
+    bp = (uint8_t *)malloc(SG_PT_TMO_RSOC_LEN);
+    if (NULL == bp)
+        return -ENOMEM;
+    sg_put_unaligned_be32(SG_PT_TMO_RSOC_LEN, cdb + 6);
+    res = sg_pt_tmo_cmd(dev_fd, cdb, sizeof(cdb), bp, SG_PT_TMO_RSOC_LEN,
+                        verbose);
+    if (res < 4) {
+        if (verbose)
+            pr2ws("%s: Report supported operation codes failed, no "
+                  "timeouts learnt\n", __func__);
+        free(bp);
+        return ((res < 0) && (-EIO != res)) ? res : 0;
+    }
+    len = sg_get_unaligned_be32(bp + 0) + 4;
+    if (len > res)
+        len = res;
+    for (k = 4; (k + 8) <= len; k += dlen) {
+        dp = bp + k;
+        dlen = (0x2 & dp[5]) ? 20 : 8;          /* CTDP */
+        if ((20 == dlen) && ((k + dlen) <= len))
+            res = sg_pt_tmo_add(tp, dp[0], !! (0x1 & dp[5]),
+                                sg_get_unaligned_be16(dp + 2),
+                                sg_get_unaligned_be32(dp + 12),
+                                sg_get_unaligned_be32(dp + 16));
+        else
+            res = sg_pt_tmo_add(tp, dp[0], !! (0x1 & dp[5]),
+                                sg_get_unaligned_be16(dp + 2), 0, 0);
+        if (res) {
+            free(bp);
+            return res;
+        }
+    }
+    free(bp);
+    return 0;
+}
+
+/* Reads a table previously written by sg_pt_tmo_save(). Returns 0 if
+ * successful. */
+static int
+sg_pt_tmo_load(struct sg_pt_tmo_tbl * tp, const char * path, int verbose)
+{
+    int n, res;
+    unsigned int op, sa;
+    unsigned int nominal, recommended;
+    char line[128];
+    FILE * fp;
+
+    fp = fopen(path, "r");
+    if (NULL == fp)
+        return -errno;
+    res = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (('#' == line[0]) || ('\n' == line[0]))
+            continue;
+        if (4 == sscanf(line, "%x,%x %u %u", &op, &sa, &nominal,
+                        &recommended))
+            n = 1;
+        else if (3 == sscanf(line, "%x %u %u", &op, &nominal,
+                             &recommended))
+            n = sa = 0;
+        else
+            n = -1;
+        if ((n < 0) || (op > 0xff) || (sa > 0xffff)) {
+            if (verbose)
+                pr2ws("%s: %s: unable to decode: %s", __func__, path, line);
+            res = -EINVAL;
+            break;
+        }
+        res = sg_pt_tmo_add(tp, op, !! n, sa, nominal, recommended);
+        if (res)
+            break;
+    }
+    fclose(fp);
+    if (res) {
+        tp->num = 0;
+        memset(tp->sa_ops, 0, sizeof(tp->sa_ops));
+    } else if (verbose > 1)
+        pr2ws("%s: %d command timeouts from %s\n", __func__, tp->num,
+              path);
+    return res;
+}
+
+/* Writes the table to a temporary file then renames it to 'path' so
+ * concurrent readers never see a partial file. */
+static void
+sg_pt_tmo_save(const struct sg_pt_tmo_tbl * tp, const char * path,
+               const char * lu_name, int verbose)
+{
+    int k;
+    char tmp[PATH_MAX + 16];
+    FILE * fp;
+    const struct sg_pt_tmo_ent * ep;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    fp = fopen(tmp, "w");
+    if (NULL == fp) {
+        if (verbose)
+            pr2ws("%s: unable to create %s: %s\n", __func__, tmp,
+                  safe_strerror(errno));
+        return;
+    }
+    fprintf(fp, "# sg3_utils command timeouts of %s\n", lu_name);
+    fprintf(fp, "# opcode[,service_action] (hex) nominal recommended "
+            "(seconds)\n");
+    for (k = 0, ep = tp->arr; k < tp->num; ++k, ++ep) {
+        if (ep->sav)
+            fprintf(fp, "%x,%x %u %u\n", ep->key >> 16, ep->key & 0xffff,
+                    ep->nominal, ep->recommended);
+        else
+            fprintf(fp, "%x %u %u\n", ep->key >> 16, ep->nominal,
+                    ep->recommended);
+    }
+    if ((fclose(fp) < 0) || (rename(tmp, path) < 0)) {
+        if (verbose)
+            pr2ws("%s: unable to write %s: %s\n", __func__, path,
+                  safe_strerror(errno));
+        remove(tmp);
+    } else if (verbose > 1)
+        pr2ws("%s: wrote %d command timeouts to %s\n", __func__, tp->num,
+              path);
+}
+
+void
+sg_pt_tmo_forget(int dev_fd)
+{
+    int k;
+    struct sg_pt_tmo_tbl * tp = NULL;
+
+    if (0 == __atomic_load_n(&sg_pt_tmo_num_fds, __ATOMIC_ACQUIRE))
+        return;
+    sg_pt_tmo_lock();
+    for (k = 0; k < SG_PT_TMO_MAX_FDS; ++k) {
+        if (sg_pt_tmo_fds[k].tp && (dev_fd == sg_pt_tmo_fds[k].fd)) {
+            tp = sg_pt_tmo_fds[k].tp;
+            sg_pt_tmo_fds[k].tp = NULL;
+            __atomic_store_n(&sg_pt_tmo_num_fds, sg_pt_tmo_num_fds - 1,
+                             __ATOMIC_RELEASE);
+            if (--tp->refs > 0)
+                tp = NULL;
+            break;
+        }
+    }
+    sg_pt_tmo_unlock();
+    sg_pt_tmo_free(tp);
+}
+
+int
+sg_pt_tmo_learn(int dev_fd, const char * device_name,
+                const char * cache_dir, int verbose)
+{
+    bool loaded = false;
+    int k, res;
+    struct sg_pt_tmo_tbl * tp = NULL;
+    char lu_name[SG_PT_TMO_LU_NAME_LEN];
+    char path[PATH_MAX];
+
+    if (dev_fd < 0)
+        return -EBADF;
+    sg_pt_tmo_forget(dev_fd);       /* in case dev_fd has been reused */
+    if (device_name) {      /* share table of another fd to same device */
+        sg_pt_tmo_lock();
+        for (k = 0; k < SG_PT_TMO_MAX_FDS; ++k) {
+            tp = sg_pt_tmo_fds[k].tp;
+            if (tp && tp->dev_name && (0 == strcmp(device_name,
+                                                   tp->dev_name))) {
+                ++tp->refs;
+                break;
+            }
+            tp = NULL;
+        }
+        sg_pt_tmo_unlock();
+    }
+    if (NULL == tp) {
+        tp = (struct sg_pt_tmo_tbl *)calloc(1, sizeof(*tp));
+        if (NULL == tp)
+            return -ENOMEM;
+        lu_name[0] = '\0';
+        if (cache_dir && (0 == sg_pt_tmo_lu_name(dev_fd, lu_name,
+                                                 sizeof(lu_name), verbose))) {
+            snprintf(path, sizeof(path), "%s/%s.tmo", cache_dir, lu_name);
+            loaded = (0 == sg_pt_tmo_load(tp, path, verbose));
+        }
+        if (! loaded) {
+            res = sg_pt_tmo_rsoc(dev_fd, tp, verbose);
+            if (res) {
+                sg_pt_tmo_free(tp);
+                return res;
+            }
+            if (lu_name[0])
+                sg_pt_tmo_save(tp, path, lu_name, verbose);
+        }
+        if (0 == tp->num) {
+            sg_pt_tmo_free(tp);
+            return 0;
+        }
+        qsort(tp->arr, tp->num, sizeof(struct sg_pt_tmo_ent), sg_pt_tmo_cmp);
+        if (device_name)
+            tp->dev_name = strdup(device_name);
+        tp->refs = 1;
+    }
+    sg_pt_tmo_lock();
+    for (k = 0; k < SG_PT_TMO_MAX_FDS; ++k) {
+        if (NULL == sg_pt_tmo_fds[k].tp) {
+            sg_pt_tmo_fds[k].fd = dev_fd;
+            sg_pt_tmo_fds[k].tp = tp;
+            __atomic_store_n(&sg_pt_tmo_num_fds, sg_pt_tmo_num_fds + 1,
+                             __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    res = tp->num;
+    if ((k >= SG_PT_TMO_MAX_FDS) && (--tp->refs > 0))
+        tp = NULL;
+    sg_pt_tmo_unlock();
+    if (k >= SG_PT_TMO_MAX_FDS) {
+        sg_pt_tmo_free(tp);
+        return -ENFILE;
+    }
+    if (verbose > 1)
+        pr2ws("%s: fd=%d has %d learnt command timeouts\n", __func__,
+              dev_fd, res);
+    return res;
+}
+
+int
+sg_pt_tmo_lookup(int dev_fd, const uint8_t * cdb, int cdb_len, int def_secs)
+{
+    int k, op;
+    uint32_t sa = 0;
+    struct sg_pt_tmo_ent key;
+    const struct sg_pt_tmo_tbl * tp = NULL;
+    const struct sg_pt_tmo_ent * ep;
+
+    if ((0 == __atomic_load_n(&sg_pt_tmo_num_fds, __ATOMIC_ACQUIRE)) ||
+        (dev_fd < 0) || (NULL == cdb) || (cdb_len < 6))
+        return def_secs;
+    op = cdb[0];
+    sg_pt_tmo_lock();
+    for (k = 0; k < SG_PT_TMO_MAX_FDS; ++k) {
+        tp = sg_pt_tmo_fds[k].tp;
+        if (tp && (dev_fd == sg_pt_tmo_fds[k].fd))
+            break;
+    }
+    if (k < SG_PT_TMO_MAX_FDS) {
+        if (tp->sa_ops[op >> 3] & (1 << (op & 0x7))) {
+            if (0x7f == op)     /* variable length cdb */
+                sa = (cdb_len >= 10) ? sg_get_unaligned_be16(cdb + 8) : 0;
+            else
+                sa = cdb[1] & 0x1f;
+        }
+        key.key = ((uint32_t)op << 16) | sa;
+        ep = (const struct sg_pt_tmo_ent *)
+             bsearch(&key, tp->arr, tp->num, sizeof(struct sg_pt_tmo_ent),
+                     sg_pt_tmo_cmp);
+        if (ep && ep->recommended)
+            def_secs = (ep->recommended > INT32_MAX) ? INT32_MAX :
+                                                       (int)ep->recommended;
+    }
+    sg_pt_tmo_unlock();
+    return def_secs;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2005-2019 Douglas Gilbert.
+ * Copyright (c) 2005-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -7,7 +7,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-/* sg_pt_linux version 1.47 20190612 */
+/* sg_pt_linux version 1.49 20261018 */
 
 
 #include <stdio.h>
@@ -278,6 +278,8 @@ check_pt_file_handle(int dev_fd, const char * device_name, int verbose)
         uint32_t nsid;
         struct stat a_stat;
 
+        if (sg_mock_find(dev_fd))
+            return 1;   /* emulated device looks like sg */
         is_sg = check_file_type(dev_fd, &a_stat, &is_bsg, &is_nvme, &nsid,
                                 &err, verbose);
         if (err)
@@ -335,6 +337,7 @@ int
 scsi_pt_open_flags(const char * device_name, int flags, int verbose)
 {
     int fd;
+    const char * cp;
 
     if (! sg_bsg_nvme_char_major_checked) {
         sg_bsg_nvme_char_major_checked = true;
@@ -343,13 +346,23 @@ scsi_pt_open_flags(const char * device_name, int flags, int verbose)
     if (verbose > 1) {
         pr2ws("open %s with flags=0x%x\n", device_name, flags);
     }
-    fd = open(device_name, flags);
-    if (fd < 0) {
-        fd = -errno;
-        if (verbose > 1)
-            pr2ws("%s: open(%s, 0x%x) failed: %s\n", __func__, device_name,
-                  flags, safe_strerror(-fd));
+    if (0 == strncmp(device_name, SG_MOCK_PREFIX, SG_MOCK_PREFIX_LEN)) {
+        fd = sg_mock_open(device_name + SG_MOCK_PREFIX_LEN, flags, verbose);
+        if ((fd < 0) && verbose)
+            pr2ws("%s: unable to set up %s: %s\n", __func__, device_name,
+                  safe_strerror(-fd));
+    } else {
+        fd = open(device_name, flags);
+        if (fd < 0) {
+            fd = -errno;
+            if (verbose > 1)
+                pr2ws("%s: open(%s, 0x%x) failed: %s\n", __func__,
+                      device_name, flags, safe_strerror(-fd));
+        }
     }
+    if ((fd >= 0) && (cp = getenv("SG3_UTILS_PT_TIMEOUTS")))
+        sg_pt_tmo_learn(fd, device_name, ('/' == cp[0]) ? cp : NULL,
+                        verbose);
     return fd;
 }
 
@@ -369,6 +382,9 @@ scsi_pt_close_device(int device_fd)
 {
     int res;
 
+    sg_pt_tmo_forget(device_fd);
+    if (sg_mock_close(device_fd))
+        return 0;
     res = close(device_fd);
     if (res < 0)
         res = -errno;
@@ -444,16 +460,19 @@ destruct_scsi_pt_obj(struct sg_pt_base * vp)
 void
 clear_scsi_pt_obj(struct sg_pt_base * vp)
 {
-    bool is_sg, is_bsg, is_nvme;
+    bool is_sg, is_bsg, is_nvme, is_mock;
     int fd;
     uint32_t nvme_nsid;
     struct sg_sntl_dev_state_t dev_stat;
+    struct sg_mock_dev * mock_devp;
     struct sg_pt_linux_scsi * ptp = &vp->impl;
 
     if (ptp) {
         fd = ptp->dev_fd;
         is_sg = ptp->is_sg;
         is_bsg = ptp->is_bsg;
+        is_mock = ptp->is_mock;
+        mock_devp = ptp->mock_devp;
         is_nvme = ptp->is_nvme;
         nvme_nsid = ptp->nvme_nsid;
         dev_stat = ptp->dev_stat;
@@ -470,6 +489,8 @@ clear_scsi_pt_obj(struct sg_pt_base * vp)
         ptp->dev_fd = fd;
         ptp->is_sg = is_sg;
         ptp->is_bsg = is_bsg;
+        ptp->is_mock = is_mock;
+        ptp->mock_devp = mock_devp;
         ptp->is_nvme = is_nvme;
         ptp->nvme_direct = false;
         ptp->nvme_nsid = nvme_nsid;
@@ -522,7 +543,14 @@ set_pt_file_handle(struct sg_pt_base * vp, int dev_fd, int verbose)
         sg_find_bsg_nvme_char_major(verbose);
     }
     ptp->dev_fd = dev_fd;
-    if (dev_fd >= 0) {
+    ptp->mock_devp = sg_mock_find(dev_fd);
+    ptp->is_mock = (NULL != ptp->mock_devp);
+    if (ptp->is_mock) {
+        ptp->is_sg = false;
+        ptp->is_bsg = false;
+        ptp->is_nvme = false;
+        ptp->os_err = 0;
+    } else if (dev_fd >= 0) {
         ptp->is_sg = check_file_type(dev_fd, &a_stat, &ptp->is_bsg,
                                      &ptp->is_nvme, &ptp->nvme_nsid,
                                      &ptp->os_err, verbose);
@@ -1119,6 +1147,22 @@ do_scsi_pt(struct sg_pt_base * vp, int fd, int time_secs, int verbose)
     }
     if (ptp->os_err)
         return -ptp->os_err;
+    if (! ptp->is_nvme) {
+        int tmo = sg_pt_tmo_lookup(fd, (const uint8_t *)(sg_uintptr_t)
+                                   ptp->io_hdr.request,
+                                   ptp->io_hdr.request_len, time_secs);
+
+        /* a default may be shortened, longer timeouts only lengthened */
+        if ((tmo != time_secs) &&
+            ((time_secs <= SG_PT_TMO_DEF_SECS) || (tmo > time_secs))) {
+            if (verbose > 2)
+                pr2ws("%s: learnt timeout %d secs replaces %d secs\n",
+                      __func__, tmo, time_secs);
+            time_secs = tmo;
+        }
+    }
+    if (ptp->is_mock)
+        return sg_do_mock_pt(ptp, time_secs, verbose);
     if (ptp->is_nvme)
         return sg_do_nvme_pt(vp, -1, time_secs, verbose);
     else if (ptp->is_sg) {
@@ -0,0 +1,1679 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* sg_pt_linux_mock version 1.06 20261018 */
+
+/* This file contains an in-process emulation of a SCSI direct access
+ * (disk) device. It is selected by giving a device name starting with
+ * "mock:" to scsi_pt_open_device() or scsi_pt_open_flags(). What follows
+ * that prefix is a comma separated list of NAME=VALUE pairs:
+ *     bs=LB_SZ        logical block size (def: 512)
+ *     dsense=0|1      descriptor sense format when 1 (def: 0, fixed)
+ *     err_every=N     every Nth media access command fails (def: 0)
+ *     err_lba=LBA     media access commands covering LBA fail
+ *     err_sense=SK:ASC:ASCQ    sense data (hex) for injected errors
+ *                     (def: 3:11:0 for reads, 3:c:0 for writes)
+ *     file=PATH       use PATH as the medium (def: anonymous memory), must
+ *                     be last as PATH may contain commas
+ *     lat=USECS       delay for each media access command (def: 0)
+ *     luns=N          REPORT LUNS lists LUNs 0 to N-1, 1 to 256 (def: 1)
+ *     size=BYTES      capacity (def: 1g or size of PATH if it exists)
+ *     streams=N       maximum number of open streams, 0 to 32 (def: 16)
+ *     ua=0|1          first command yields POWER ON RESET UA when 1
+ *     ugran=BLOCKS    optimal unmap granularity reported (def: 1)
+ *     ws_max=BLOCKS   maximum WRITE SAME length reported (def: 65536)
+ *     zone=BLOCKS     zone size, implies host aware zoned (def: 0); write
+ *                     pointers are kept in memory, starting empty
+ * Emulated devices with the same description share their medium.
+ *
+ * The commands supported are: COMPARE AND WRITE, INQUIRY (with several VPD
+ * pages), LOG SENSE, READ(6,10,12,16), READ CAPACITY(10,16), REPORT LUNS,
+ * REPORT SUPPORTED OPERATION CODES (with command timeouts descriptors),
+ * REPORT ZONES, REQUEST SENSE, GET STREAM STATUS, STREAM CONTROL,
+ * SYNCHRONIZE CACHE(10,16), TEST UNIT READY, UNMAP, VERIFY(10,16),
+ * WRITE(6,10,12,16), WRITE SAME(10,16), WRITE SCATTERED(16) and WRITE
+ * STREAM(16). Others yield ILLEGAL REQUEST, INVALID COMMAND OPERATION
+ * CODE.
+ *
+ * Mock devices may be opened, used and closed from several threads.
+ * Commands (on different file descriptors) are serialized per emulated
+ * device, apart from the lat= delay. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sched.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_pt.h"
+#include "sg_lib.h"
+#include "sg_linux_inc.h"
+#include "sg_pt_linux.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#define MOCK_MAX_DEVS 64
+#define MOCK_DEF_SIZE (1024LL * 1024 * 1024)
+#define MOCK_DEF_LB_SZ 512
+#define MOCK_MAX_ZONES (1024 * 1024)
+#define MOCK_DEF_WS_MAX 65536
+#define MOCK_SCAT_MAX_RDS 256   /* reported in Block limits extension VPD */
+#define MOCK_SCAT_MAX_BLKS 65536
+#define MOCK_DEF_STREAMS 16
+#define MOCK_MAX_STREAMS 32     /* stream ids 1 to 32, see str_open */
+#define MOCK_MAX_LUNS 256
+#define MOCK_INQ_RESP_LEN 36
+
+/* Additional Sense Code (ASC) */
+#define WRITE_ERROR_ASC 0xc
+#define UNRECOVERED_READ_ERR 0x11
+#define PARAMETER_LIST_LENGTH_ERR 0x1a
+#define MISCOMPARE_VERIFY_ASC 0x1d
+#define INVALID_OPCODE 0x20
+#define LBA_OUT_OF_RANGE 0x21
+#define INVALID_FIELD_IN_CDB 0x24
+#define INVALID_FIELD_IN_PARAM_LIST 0x26
+#define UA_RESET_ASC 0x29
+#define SYSTEM_RESOURCE_FAILURE_ASC 0x55
+#define POWER_ON_RESET_ASCQ 0x0
+
+struct sg_mock_dev {
+    bool dsense;
+    bool ua_pending;
+    bool busy;          /* spin lock, see mock_lock() */
+    int refs;
+    int lb_sz;
+    int fd;             /* of file=PATH, else -1 */
+    int err_sk;         /* when 0 use defaults */
+    int err_asc;
+    int err_ascq;
+    uint32_t lat_us;
+    uint32_t err_every;
+    uint32_t num_zones;
+    uint32_t ugran;
+    uint32_t ws_max;
+    uint32_t max_streams;
+    uint32_t num_luns;
+    uint32_t str_open;  /* bit (N - 1) set when stream id N is open */
+    uint64_t num_lbs;
+    uint64_t zone_lbs;
+    int64_t err_lba;    /* -1 for none */
+    uint64_t media_cmds;
+    uint64_t rd_errs;
+    uint64_t wr_errs;
+    uint64_t rd_bytes;
+    uint64_t wr_bytes;
+    uint64_t * wps;     /* write pointer of each zone */
+    uint8_t * mem;      /* medium when fd < 0 */
+    char * spec;
+};
+
+struct mock_opcode {
+    uint8_t opcode;
+    bool sav;           /* service action valid */
+    uint16_t sa;
+    uint16_t cdb_len;
+    uint32_t nominal;   /* command timeouts descriptor, in seconds */
+    uint32_t recommended;
+};
+
+/* Reported by REPORT SUPPORTED OPERATION CODES */
+static const struct mock_opcode mock_opcodes[] = {
+    {0x00, false, 0, 6, 0, 5},          /* TEST UNIT READY */
+    {0x03, false, 0, 6, 0, 5},          /* REQUEST SENSE */
+    {0x08, false, 0, 6, 1, 10},         /* READ(6) */
+    {0x0a, false, 0, 6, 1, 10},         /* WRITE(6) */
+    {0x12, false, 0, 6, 0, 5},          /* INQUIRY */
+    {0x25, false, 0, 10, 0, 5},         /* READ CAPACITY(10) */
+    {0x28, false, 0, 10, 1, 10},        /* READ(10) */
+    {0x2a, false, 0, 10, 1, 10},        /* WRITE(10) */
+    {0x2f, false, 0, 10, 1, 10},        /* VERIFY(10) */
+    {0x35, false, 0, 10, 5, 60},        /* SYNCHRONIZE CACHE(10) */
+    {0x41, false, 0, 10, 10, 120},      /* WRITE SAME(10) */
+    {0x42, false, 0, 10, 10, 120},      /* UNMAP */
+    {0x4d, false, 0, 10, 0, 5},         /* LOG SENSE */
+    {0x88, false, 0, 16, 1, 10},        /* READ(16) */
+    {0x89, false, 0, 16, 1, 10},        /* COMPARE AND WRITE */
+    {0x8a, false, 0, 16, 1, 10},        /* WRITE(16) */
+    {0x8f, false, 0, 16, 1, 10},        /* VERIFY(16) */
+    {0x91, false, 0, 16, 5, 60},        /* SYNCHRONIZE CACHE(16) */
+    {0x93, false, 0, 16, 10, 120},      /* WRITE SAME(16) */
+    {0x95, true, 0x0, 16, 0, 5},        /* REPORT ZONES */
+    {0x9a, false, 0, 16, 1, 10},        /* WRITE STREAM(16) */
+    {0x9e, true, 0x10, 16, 0, 5},       /* READ CAPACITY(16) */
+    {0x9e, true, 0x14, 16, 0, 5},       /* STREAM CONTROL */
+    {0x9e, true, 0x16, 16, 0, 5},       /* GET STREAM STATUS */
+    {0x9f, true, 0x12, 16, 1, 10},      /* WRITE SCATTERED(16) */
+    {0xa0, false, 0, 12, 0, 5},         /* REPORT LUNS */
+    {0xa3, true, 0xc, 12, 0, 5},        /* REPORT SUPPORTED OP CODES */
+    {0xa8, false, 0, 12, 1, 10},        /* READ(12) */
+    {0xaa, false, 0, 12, 1, 10},        /* WRITE(12) */
+};
+
+struct mock_fd_map {
+    int fd;
+    struct sg_mock_dev * mdp;
+};
+
+/* mock_devs[], mock_fds[] and each device's refs are protected by
+ * mock_tbl_lock() */
+static struct sg_mock_dev * mock_devs[MOCK_MAX_DEVS];
+static struct mock_fd_map mock_fds[MOCK_MAX_DEVS * 4];
+static const int mock_fds_max = sizeof(mock_fds) / sizeof(mock_fds[0]);
+static bool mock_tbl_busy = false;
+
+static void
+mock_tbl_lock(void)
+{
+    while (__atomic_test_and_set(&mock_tbl_busy, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static void
+mock_tbl_unlock(void)
+{
+    __atomic_clear(&mock_tbl_busy, __ATOMIC_RELEASE);
+}
+
+static void
+mock_free(struct sg_mock_dev * mdp)
+{
+    if (mdp->mem)
+        munmap(mdp->mem, mdp->num_lbs * mdp->lb_sz);
+    if (mdp->fd >= 0)
+        close(mdp->fd);
+    if (mdp->wps)
+        free(mdp->wps);
+    if (mdp->spec)
+        free(mdp->spec);
+    free(mdp);
+}
+
+/* Parses 'spec' (NAME=VALUE,...) and sets up the medium. Returns 0 or a
+ * positive errno value. */
+static int
+mock_parse(struct sg_mock_dev * mdp, const char * spec, int verbose)
+{
+    int err;
+    uint32_t k;
+    int64_t ll;
+    int64_t size = -1;
+    const char * cp;
+    const char * vp;
+    const char * np;
+    char * path = NULL;
+    struct stat a_stat;
+
+    mdp->lb_sz = MOCK_DEF_LB_SZ;
+    mdp->fd = -1;
+    mdp->err_lba = -1;
+    mdp->ugran = 1;
+    mdp->ws_max = MOCK_DEF_WS_MAX;
+    mdp->max_streams = MOCK_DEF_STREAMS;
+    mdp->num_luns = 1;
+    for (cp = spec; cp && *cp; cp = np) {
+        np = strchr(cp, ',');
+        vp = strchr(cp, '=');
+        if ((NULL == vp) || (np && (vp > np)))
+            goto bad;
+        ++vp;
+        if (0 == strncmp(cp, "file=", 5)) {
+            /* PATH may contain commas so it takes the rest of 'spec' */
+            path = strdup(vp);
+            if (NULL == path)
+                return ENOMEM;
+            np = NULL;
+            continue;
+        }
+        if (np)
+            ++np;
+        if (0 == strncmp(cp, "err_sense=", 10)) {
+            if (3 != sscanf(vp, "%x:%x:%x", (unsigned int *)&mdp->err_sk,
+                            (unsigned int *)&mdp->err_asc,
+                            (unsigned int *)&mdp->err_ascq))
+                goto bad;
+            continue;
+        }
+        ll = sg_get_llnum(vp);
+        if (ll < 0)
+            goto bad;
+        if (0 == strncmp(cp, "bs=", 3)) {
+            if ((ll < 512) || (ll > 65536) || (ll & (ll - 1)))
+                goto bad;
+            mdp->lb_sz = (int)ll;
+        } else if (0 == strncmp(cp, "dsense=", 7))
+            mdp->dsense = !! ll;
+        else if (0 == strncmp(cp, "err_every=", 10))
+            mdp->err_every = (uint32_t)ll;
+        else if (0 == strncmp(cp, "err_lba=", 8))
+            mdp->err_lba = ll;
+        else if (0 == strncmp(cp, "lat=", 4))
+            mdp->lat_us = (uint32_t)ll;
+        else if (0 == strncmp(cp, "luns=", 5)) {
+            if ((ll < 1) || (ll > MOCK_MAX_LUNS))
+                goto bad;
+            mdp->num_luns = (uint32_t)ll;
+        }
+        else if (0 == strncmp(cp, "size=", 5))
+            size = ll;
+        else if (0 == strncmp(cp, "streams=", 8)) {
+            if (ll > MOCK_MAX_STREAMS)
+                goto bad;
+            mdp->max_streams = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "ua=", 3))
+            mdp->ua_pending = !! ll;
+        else if (0 == strncmp(cp, "ugran=", 6)) {
+            if ((0 == ll) || (ll > 0xffffffffLL))
+                goto bad;
+            mdp->ugran = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "ws_max=", 7)) {
+            if (ll > 0xffffffffLL)
+                goto bad;
+            mdp->ws_max = (uint32_t)ll;
+        } else if (0 == strncmp(cp, "zone=", 5))
+            mdp->zone_lbs = ll;
+        else
+            goto bad;
+    }
+    if (path) {
+        mdp->fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (mdp->fd < 0) {
+            err = errno;
+            if (verbose)
+                pr2ws("%s: unable to open %s: %s\n", __func__, path,
+                      safe_strerror(err));
+            free(path);
+            return err;
+        }
+        free(path);
+        if ((size < 0) && (0 == fstat(mdp->fd, &a_stat)) &&
+            (a_stat.st_size > 0))
+            size = a_stat.st_size;
+    }
+    if (size < 0)
+        size = MOCK_DEF_SIZE;
+    mdp->num_lbs = (uint64_t)size / mdp->lb_sz;
+    if (0 == mdp->num_lbs) {
+        if (verbose)
+            pr2ws("%s: size must be at least one block\n", __func__);
+        return EINVAL;
+    }
+    if (mdp->fd < 0) {
+        /* only pages actually written consume memory */
+        mdp->mem = (uint8_t *)mmap(NULL, mdp->num_lbs * mdp->lb_sz,
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS |
+                                   MAP_NORESERVE, -1, 0);
+        if (MAP_FAILED == mdp->mem) {
+            mdp->mem = NULL;
+            return ENOMEM;
+        }
+    }
+    if (mdp->zone_lbs > 0) {
+        ll = (mdp->num_lbs + mdp->zone_lbs - 1) / mdp->zone_lbs;
+        if (ll > MOCK_MAX_ZONES) {
+            if (verbose)
+                pr2ws("%s: too many zones, maximum is %d\n", __func__,
+                      MOCK_MAX_ZONES);
+            return EINVAL;
+        }
+        mdp->num_zones = (uint32_t)ll;
+        mdp->wps = (uint64_t *)calloc(mdp->num_zones, sizeof(uint64_t));
+        if (NULL == mdp->wps)
+            return ENOMEM;
+        for (k = 0; k < mdp->num_zones; ++k)
+            mdp->wps[k] = k * mdp->zone_lbs;
+    }
+    return 0;
+bad:
+    if (verbose)
+        pr2ws("%s: unable to decode: %s\n", __func__, cp);
+    if (path)
+        free(path);
+    return EINVAL;
+}
+
+/* Frees emulated devices without users. Call with the table locked. */
+static void
+mock_release_unused(void)
+{
+    int k;
+
+    for (k = 0; k < MOCK_MAX_DEVS; ++k) {
+        if (mock_devs[k] && (mock_devs[k]->refs <= 0)) {
+            mock_free(mock_devs[k]);
+            mock_devs[k] = NULL;
+        }
+    }
+}
+
+int
+sg_mock_open(const char * spec, int flags, int verbose)
+{
+    int k, fd, err;
+    int free_k = -1;
+    struct sg_mock_dev * mdp = NULL;
+
+    mock_tbl_lock();
+    for (k = 0; k < MOCK_MAX_DEVS; ++k) {
+        if (NULL == mock_devs[k]) {
+            if (free_k < 0)
+                free_k = k;
+        } else if (0 == strcmp(spec, mock_devs[k]->spec)) {
+            mdp = mock_devs[k];
+            break;
+        }
+    }
+    for (k = 0; k < mock_fds_max; ++k) {
+        if (NULL == mock_fds[k].mdp)
+            break;
+    }
+    if (k >= mock_fds_max) {
+        err = EMFILE;
+        goto err_out;
+    }
+    if (NULL == mdp) {
+        if (free_k < 0) {
+            err = EMFILE;
+            goto err_out;
+        }
+        mdp = (struct sg_mock_dev *)calloc(1, sizeof(*mdp));
+        if (NULL == mdp) {
+            err = ENOMEM;
+            goto err_out;
+        }
+        mdp->spec = strdup(spec);
+        err = mdp->spec ? mock_parse(mdp, spec, verbose) : ENOMEM;
+        if (err) {
+            mock_free(mdp);
+            goto err_out;
+        }
+        mock_devs[free_k] = mdp;
+    }
+    /* a real file descriptor so the caller can close() it */
+    fd = open("/dev/null", O_RDWR | (flags & O_NONBLOCK));
+    if (fd < 0) {
+        err = errno;
+        mock_release_unused();
+        goto err_out;
+    }
+    mock_fds[k].fd = fd;
+    mock_fds[k].mdp = mdp;
+    ++mdp->refs;
+    mock_tbl_unlock();
+    if (verbose > 2)
+        pr2ws("%s: fd=%d, %" PRIu64 " blocks of %d bytes, %s medium\n",
+              __func__, fd, mdp->num_lbs, mdp->lb_sz,
+              (mdp->fd >= 0 ? "file" : "memory"));
+    return fd;
+err_out:
+    mock_tbl_unlock();
+    return -err;
+}
+
+struct sg_mock_dev *
+sg_mock_find(int fd)
+{
+    int k;
+    struct sg_mock_dev * mdp = NULL;
+
+    if (fd < 0)
+        return NULL;
+    mock_tbl_lock();
+    for (k = 0; k < mock_fds_max; ++k) {
+        if (mock_fds[k].mdp && (fd == mock_fds[k].fd)) {
+            mdp = mock_fds[k].mdp;
+            break;
+        }
+    }
+    mock_tbl_unlock();
+    return mdp;
+}
+
+/* The medium of the last user goes away when that file descriptor is
+ * closed. When fd is -1 just release emulated devices without users. */
+bool
+sg_mock_close(int fd)
+{
+    bool found = false;
+    int k;
+
+    mock_tbl_lock();
+    if (fd >= 0) {
+        for (k = 0; k < mock_fds_max; ++k) {
+            if (mock_fds[k].mdp && (fd == mock_fds[k].fd)) {
+                --mock_fds[k].mdp->refs;
+                mock_fds[k].mdp = NULL;
+                /* close under the lock so the fd number is not reused
+                 * by sg_mock_open() while this entry is changing */
+                close(fd);
+                found = true;
+                break;
+            }
+        }
+        if (! found) {
+            mock_tbl_unlock();
+            return false;
+        }
+    }
+    mock_release_unused();
+    mock_tbl_unlock();
+    return found;
+}
+
+static void
+mk_sense_asc_ascq(struct sg_pt_linux_scsi * ptp, int sk, int asc, int ascq,
+                  int vb)
+{
+    bool dsense = ptp->mock_devp->dsense;
+    int n;
+    uint8_t * sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+
+    ptp->io_hdr.device_status = SAM_STAT_CHECK_CONDITION;
+    n = ptp->io_hdr.max_response_len;
+    if ((n < 8) || ((! dsense) && (n < 14))) {
+        if (vb)
+            pr2ws("%s: max_response_len=%d too short, want 14 or more\n",
+                  __func__, n);
+        return;
+    } else
+        ptp->io_hdr.response_len = dsense ? n : ((n < 18) ? n : 18);
+    memset(sbp, 0, n);
+    sg_build_sense_buffer(dsense, sbp, sk, asc, ascq);
+    if (dsense)
+        ptp->io_hdr.response_len = 8 + sbp[7];
+    if (vb > 3)
+        pr2ws("%s:  [sense_key,asc,ascq]: [0x%x,0x%x,0x%x]\n", __func__, sk,
+              asc, ascq);
+}
+
+/* Medium errors also report the failing LBA in the INFORMATION field */
+static void
+mk_sense_info(struct sg_pt_linux_scsi * ptp, int sk, int asc, int ascq,
+              uint64_t lba, int vb)
+{
+    int n;
+    uint8_t * sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+
+    mk_sense_asc_ascq(ptp, sk, asc, ascq, vb);
+    n = ptp->io_hdr.max_response_len;
+    if (ptp->mock_devp->dsense) {
+        if (n < 20)
+            return;
+        sbp[7] = 12;
+        sbp[8] = 0x0;           /* information descriptor */
+        sbp[9] = 0xa;
+        sbp[10] = 0x80;         /* VALID */
+        sg_put_unaligned_be64(lba, sbp + 12);
+        ptp->io_hdr.response_len = 20;
+    } else if (n >= 7) {
+        sbp[0] |= 0x80;         /* VALID */
+        sg_put_unaligned_be32((lba > 0xffffffff) ? 0xffffffff :
+                              (uint32_t)lba, sbp + 3);
+    }
+}
+
+static void
+mk_sense_invalid_fld(struct sg_pt_linux_scsi * ptp, bool in_cdb, int in_byte,
+                     int in_bit, int vb)
+{
+    bool dsense = ptp->mock_devp->dsense;
+    int sl, n;
+    uint8_t * sbp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.response;
+    uint8_t sks[4];
+
+    mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, in_cdb ?
+                      INVALID_FIELD_IN_CDB : INVALID_FIELD_IN_PARAM_LIST, 0,
+                      vb);
+    n = ptp->io_hdr.max_response_len;
+    memset(sks, 0, sizeof(sks));
+    sks[0] = 0x80;
+    if (in_cdb)
+        sks[0] |= 0x40;
+    if (in_bit >= 0) {
+        sks[0] |= 0x8;
+        sks[0] |= (0x7 & in_bit);
+    }
+    sg_put_unaligned_be16(in_byte, sks + 1);
+    if (dsense) {
+        sl = sbp[7] + 8;
+        if (n < (sl + 8))
+            return;
+        sbp[7] = sl;
+        sbp[sl] = 0x2;
+        sbp[sl + 1] = 0x6;
+        memcpy(sbp + sl + 4, sks, 3);
+        ptp->io_hdr.response_len = sl + 8;
+    } else if (n >= 18)
+        memcpy(sbp + 15, sks, 3);
+}
+
+/* Copies up to 'len' bytes of 'resp' to the data-in buffer, limited by
+ * the allocation length. Sets residual count. */
+static void
+mock_din(struct sg_pt_linux_scsi * ptp, const uint8_t * resp, int len,
+         int alloc_len)
+{
+    int n = ptp->io_hdr.din_xfer_len;
+    uint8_t * bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+
+    if (len > alloc_len)
+        len = alloc_len;
+    if (len > n)
+        len = n;
+    if ((len > 0) && bp)
+        memcpy(bp, resp, len);
+    ptp->io_hdr.din_resid = n - len;
+}
+
+static void
+mock_delay(const struct sg_mock_dev * mdp)
+{
+    struct timespec ts;
+
+    if (0 == mdp->lat_us)
+        return;
+    ts.tv_sec = mdp->lat_us / 1000000;
+    ts.tv_nsec = (mdp->lat_us % 1000000) * 1000;
+    while ((nanosleep(&ts, &ts) < 0) && (EINTR == errno))
+        ;
+}
+
+/* Commands are short (memcpy() or pread()/pwrite()) so spin rather than
+ * make the library depend on pthreads */
+static void
+mock_lock(struct sg_mock_dev * mdp)
+{
+    while (__atomic_test_and_set(&mdp->busy, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static void
+mock_unlock(struct sg_mock_dev * mdp)
+{
+    __atomic_clear(&mdp->busy, __ATOMIC_RELEASE);
+}
+
+/* Returns true (after building sense data) if this media access command
+ * should fail due to err_every= or err_lba= */
+static bool
+mock_inject(struct sg_pt_linux_scsi * ptp, uint64_t lba, uint32_t num,
+            bool wr, int vb)
+{
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint64_t bad_lba = lba;
+
+    ++mdp->media_cmds;
+    if ((mdp->err_lba >= 0) && (num > 0) &&
+        ((uint64_t)mdp->err_lba >= lba) &&
+        ((uint64_t)mdp->err_lba < (lba + num)))
+        bad_lba = mdp->err_lba;
+    else if ((0 == mdp->err_every) ||
+             (0 != (mdp->media_cmds % mdp->err_every)))
+        return false;
+    if (wr)
+        ++mdp->wr_errs;
+    else
+        ++mdp->rd_errs;
+    if (mdp->err_sk)
+        mk_sense_info(ptp, mdp->err_sk, mdp->err_asc, mdp->err_ascq,
+                      bad_lba, vb);
+    else
+        mk_sense_info(ptp, SPC_SK_MEDIUM_ERROR, wr ? WRITE_ERROR_ASC :
+                      UNRECOVERED_READ_ERR, 0, bad_lba, vb);
+    return true;
+}
+
+/* Returns 0, or negated errno from pread() or pwrite() */
+static int
+mock_media_io(struct sg_mock_dev * mdp, uint64_t lba, uint8_t * bp,
+              uint32_t len, bool wr)
+{
+    off_t off = (off_t)lba * mdp->lb_sz;
+    ssize_t res;
+
+    if (mdp->fd < 0) {
+        if (wr)
+            memcpy(mdp->mem + off, bp, len);
+        else
+            memcpy(bp, mdp->mem + off, len);
+        return 0;
+    }
+    while (len > 0) {
+        res = wr ? pwrite(mdp->fd, bp, len, off) :
+                   pread(mdp->fd, bp, len, off);
+        if (res < 0) {
+            if (EINTR == errno)
+                continue;
+            return -errno;
+        }
+        if (0 == res) {         /* read beyond end of file: zeros */
+            memset(bp, 0, len);
+            break;
+        }
+        bp += res;
+        off += res;
+        len -= res;
+    }
+    return 0;
+}
+
+static void
+mock_update_wp(struct sg_mock_dev * mdp, uint64_t lba, uint32_t num)
+{
+    uint32_t z;
+    uint64_t end = lba + num;
+    uint64_t z_end;
+
+    for (z = lba / mdp->zone_lbs; (z < mdp->num_zones) &&
+         ((z * mdp->zone_lbs) < end); ++z) {
+        z_end = (z + 1) * mdp->zone_lbs;
+        if (z_end > mdp->num_lbs)
+            z_end = mdp->num_lbs;
+        if ((end > mdp->wps[z]))
+            mdp->wps[z] = (end < z_end) ? end : z_end;
+    }
+}
+
+static int
+mock_inq(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    const struct sg_mock_dev * mdp = ptp->mock_devp;
+    bool evpd = !!(0x1 & cdbp[1]);
+    int n = 0;
+    int alloc_len = sg_get_unaligned_be16(cdbp + 3);
+    uint32_t h = 5381;
+    const char * cp;
+    uint8_t resp[256];
+
+    for (cp = mdp->spec; *cp; ++cp)    /* djb2 hash gives unique serial */
+        h = (h * 33) ^ (uint8_t)*cp;
+    memset(resp, 0, sizeof(resp));
+    if (! evpd) {
+        if (cdbp[2]) {
+            mk_sense_invalid_fld(ptp, true, 2, 7, vb);
+            return 0;
+        }
+        resp[2] = 0x7;          /* SPC-5 */
+        resp[3] = 0x2;          /* response data format */
+        resp[4] = MOCK_INQ_RESP_LEN - 5;
+        resp[7] = 0x2;          /* CMDQUE */
+        memcpy(resp + 8, "SG3UTILS", 8);
+        memcpy(resp + 16, "MOCK DISK       ", 16);
+        memcpy(resp + 32, "1.00", 4);
+        mock_din(ptp, resp, MOCK_INQ_RESP_LEN, alloc_len);
+        return 0;
+    }
+    resp[1] = cdbp[2];
+    switch (cdbp[2]) {
+    case 0x0:           /* Supported VPD pages */
+        resp[4] = 0x0;
+        resp[5] = 0x80;
+        resp[6] = 0x83;
+        resp[7] = 0xb0;
+        resp[8] = 0xb1;
+        resp[9] = 0xb2;
+        n = 10;
+        if (mdp->zone_lbs > 0)
+            resp[n++] = 0xb6;
+        resp[n++] = 0xb7;
+        break;
+    case 0x80:          /* Unit serial number */
+        n = 4 + snprintf((char *)resp + 4, 17, "MOCK%08X", h);
+        break;
+    case 0x83:          /* Device identification */
+        resp[4] = 0x1;          /* binary */
+        resp[5] = 0x3;          /* LU, NAA */
+        resp[7] = 16;
+        resp[8] = 0x60;         /* NAA 6, OUI 0 (vendor specific) */
+        sg_put_unaligned_be32(h, resp + 12);
+        sg_put_unaligned_be64(mdp->num_lbs, resp + 16);
+        n = 24;
+        break;
+    case 0xb0:          /* Block limits */
+        resp[2] = 0x0;
+        sg_put_unaligned_be16(1, resp + 6);     /* OPTIMAL XFER LEN GRAN */
+        sg_put_unaligned_be32(0xffffffff, resp + 20);  /* MAX UNMAP LBA C */
+        sg_put_unaligned_be32(256, resp + 24);  /* MAX UNMAP BLOCK DESC C */
+        sg_put_unaligned_be32(mdp->ugran, resp + 28);  /* OPT UNMAP GRAN */
+        sg_put_unaligned_be64(mdp->ws_max, resp + 36); /* MAX WRITE SAME */
+        n = 64;
+        break;
+    case 0xb1:          /* Block device characteristics */
+        sg_put_unaligned_be16(1, resp + 4);     /* non-rotating medium */
+        if (mdp->zone_lbs > 0)
+            resp[8] = 0x10;     /* ZONED: host aware */
+        n = 64;
+        break;
+    case 0xb2:          /* Logical block provisioning */
+        resp[5] = 0x80 | 0x4;   /* LBPU, LBPRZ=1 (in bits 4:2) */
+        resp[6] = 0x2;          /* provisioning type: thin */
+        n = 8;
+        break;
+    case 0xb6:          /* Zoned block device characteristics */
+        if (0 == mdp->zone_lbs)
+            goto bad_pg;
+        resp[4] = 0x1;          /* URSWRZ */
+        sg_put_unaligned_be32(0xffffffff, resp + 8);
+        sg_put_unaligned_be32(0xffffffff, resp + 12);
+        n = 64;
+        break;
+    case 0xb7:          /* Block limits extension */
+        sg_put_unaligned_be32(MOCK_SCAT_MAX_BLKS, resp + 16);
+        sg_put_unaligned_be16(MOCK_SCAT_MAX_RDS, resp + 22);
+        sg_put_unaligned_be32(MOCK_SCAT_MAX_BLKS, resp + 24);
+        n = 32;
+        break;
+    default:
+bad_pg:
+        mk_sense_invalid_fld(ptp, true, 2, -1, vb);
+        return 0;
+    }
+    if (n > 4)
+        sg_put_unaligned_be16(n - 4, resp + 2);
+    mock_din(ptp, resp, n, alloc_len);
+    return 0;
+}
+
+static int
+mock_readcap(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp)
+{
+    const struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint64_t last = mdp->num_lbs - 1;
+    uint8_t resp[32];
+
+    memset(resp, 0, sizeof(resp));
+    if (0x25 == cdbp[0]) {
+        sg_put_unaligned_be32((last > 0xffffffff) ? 0xffffffff :
+                              (uint32_t)last, resp + 0);
+        sg_put_unaligned_be32(mdp->lb_sz, resp + 4);
+        mock_din(ptp, resp, 8, 8);
+    } else {
+        sg_put_unaligned_be64(last, resp + 0);
+        sg_put_unaligned_be32(mdp->lb_sz, resp + 8);
+        resp[14] = 0x80 | 0x40;         /* LBPME, LBPRZ */
+        if (mdp->zone_lbs > 0)
+            resp[12] = 0x10;            /* RC BASIS: 1 */
+        mock_din(ptp, resp, 32, sg_get_unaligned_be32(cdbp + 10));
+    }
+    return 0;
+}
+
+/* READ(6,10,12,16), WRITE(6,10,12,16), WRITE STREAM(16) and VERIFY(10,16) */
+static int
+mock_rw(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    bool wr = false;
+    bool verify = false;
+    int bytchk = 0;
+    int res;
+    uint32_t k, num, xfer_len;
+    uint64_t lba, len;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t * bp;
+    uint8_t * cmp_bp;
+
+    switch (cdbp[0]) {
+    case 0x0a:
+        wr = true;
+        /* FALL THROUGH */
+    case 0x08:
+        lba = sg_get_unaligned_be24(cdbp + 1) & 0x1fffff;
+        num = cdbp[4] ? cdbp[4] : 256;
+        break;
+    case 0x2a:
+        wr = true;
+        /* FALL THROUGH */
+    case 0x28:
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+        break;
+    case 0xaa:
+        wr = true;
+        /* FALL THROUGH */
+    case 0xa8:
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 6);
+        break;
+    case 0x8a:
+        wr = true;
+        /* FALL THROUGH */
+    case 0x88:
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+        break;
+    case 0x9a:          /* WRITE STREAM(16) */
+        k = sg_get_unaligned_be16(cdbp + 10);
+        if ((0 == k) || (k > MOCK_MAX_STREAMS) ||
+            (! (mdp->str_open & (1U << (k - 1))))) {
+            mk_sense_invalid_fld(ptp, true, 10, 7, vb);
+            return 0;
+        }
+        wr = true;
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 12);
+        break;
+    case 0x2f:
+        verify = true;
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+        break;
+    case 0x8f:
+        verify = true;
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+        break;
+    default:
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0, vb);
+        return 0;
+    }
+    if ((lba >= mdp->num_lbs) || (num > (mdp->num_lbs - lba))) {
+        mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0, lba,
+                      vb);
+        return 0;
+    }
+    if (verify) {
+        bytchk = (cdbp[1] >> 1) & 0x3;
+        if (2 == bytchk) {
+            mk_sense_invalid_fld(ptp, true, 1, 2, vb);
+            return 0;
+        }
+    }
+    if (mock_inject(ptp, lba, num, wr, vb))
+        return 0;
+    if (verify && (0 == bytchk))
+        return 0;               /* medium check only */
+    len = (uint64_t)num * mdp->lb_sz;   /* up to 2**48 so no wrap */
+    if (wr || verify) {
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+        xfer_len = ptp->io_hdr.dout_xfer_len;
+    } else {
+        bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+        xfer_len = ptp->io_hdr.din_xfer_len;
+    }
+    if (verify) {       /* BYTCHK 1: compare num blocks, 3: one block */
+        if ((NULL == bp) ||
+            (xfer_len < ((3 == bytchk) ? (uint64_t)mdp->lb_sz : len))) {
+            mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                              PARAMETER_LIST_LENGTH_ERR, 0, vb);
+            return 0;
+        }
+        cmp_bp = (uint8_t *)malloc(mdp->lb_sz);
+        if (NULL == cmp_bp)
+            return -ENOMEM;
+        for (k = 0; k < num; ++k) {
+            res = mock_media_io(mdp, lba + k, cmp_bp, mdp->lb_sz, false);
+            if (res) {
+                free(cmp_bp);
+                return res;
+            }
+            if (memcmp(cmp_bp, bp + ((3 == bytchk) ? 0 : (k * mdp->lb_sz)),
+                       mdp->lb_sz)) {
+                free(cmp_bp);
+                mk_sense_info(ptp, SPC_SK_MISCOMPARE, MISCOMPARE_VERIFY_ASC,
+                              0, lba + k, vb);
+                return 0;
+            }
+        }
+        free(cmp_bp);
+        return 0;
+    }
+    if ((len > xfer_len) || ((len > 0) && (NULL == bp))) {
+        /* like a HBA with too small a buffer: transfer nothing */
+        if (vb)
+            pr2ws("%s: data transfer length (%u) less than %u blocks\n",
+                  __func__, xfer_len, num);
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_FIELD_IN_CDB,
+                          0, vb);
+        return 0;
+    }
+    if (len > 0) {      /* len <= xfer_len so fits in 32 bits */
+        res = mock_media_io(mdp, lba, bp, (uint32_t)len, wr);
+        if (res)
+            return res;
+    }
+    if (wr) {
+        mdp->wr_bytes += len;
+        ptp->io_hdr.dout_resid = xfer_len - (uint32_t)len;
+        if (mdp->zone_lbs > 0)
+            mock_update_wp(mdp, lba, num);
+    } else {
+        mdp->rd_bytes += len;
+        ptp->io_hdr.din_resid = xfer_len - (uint32_t)len;
+    }
+    return 0;
+}
+
+/* COMPARE AND WRITE: the data-out buffer holds NUM blocks to compare
+ * followed by NUM blocks to write */
+static int
+mock_caw(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    int res;
+    uint32_t k, num, len;
+    uint64_t lba;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t * bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+    uint8_t * cmp_bp;
+
+    lba = sg_get_unaligned_be64(cdbp + 2);
+    num = cdbp[13];
+    if ((lba >= mdp->num_lbs) || (num > (mdp->num_lbs - lba))) {
+        mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0, lba,
+                      vb);
+        return 0;
+    }
+    if (0 == num)
+        return 0;
+    len = num * mdp->lb_sz;
+    if ((NULL == bp) || (ptp->io_hdr.dout_xfer_len < (2 * len))) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          PARAMETER_LIST_LENGTH_ERR, 0, vb);
+        return 0;
+    }
+    if (mock_inject(ptp, lba, num, true, vb))
+        return 0;
+    cmp_bp = (uint8_t *)malloc(len);
+    if (NULL == cmp_bp)
+        return -ENOMEM;
+    res = mock_media_io(mdp, lba, cmp_bp, len, false);
+    if (res)
+        goto fini;
+    for (k = 0; k < len; ++k) {
+        if (cmp_bp[k] != bp[k])
+            break;
+    }
+    if (k < len) {      /* INFORMATION is offset of first miscompare */
+        mk_sense_info(ptp, SPC_SK_MISCOMPARE, MISCOMPARE_VERIFY_ASC, 0, k,
+                      vb);
+        goto fini;
+    }
+    res = mock_media_io(mdp, lba, bp + len, len, true);
+    if (res)
+        goto fini;
+    mdp->rd_bytes += len;
+    mdp->wr_bytes += len;
+    if (mdp->zone_lbs > 0)
+        mock_update_wp(mdp, lba, num);
+fini:
+    free(cmp_bp);
+    return res;
+}
+
+static int
+mock_unmap(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    int k, n, res;
+    uint32_t num, len, chunk;
+    uint64_t lba;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    const uint8_t * bp = (const uint8_t *)(sg_uintptr_t)
+                         ptp->io_hdr.dout_xferp;
+    static uint8_t zeros[64 * 1024];
+
+    len = sg_get_unaligned_be16(cdbp + 7);
+    if (len > ptp->io_hdr.dout_xfer_len)
+        len = ptp->io_hdr.dout_xfer_len;
+    if (0 == len)
+        return 0;
+    if ((len < 8) || (NULL == bp)) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          PARAMETER_LIST_LENGTH_ERR, 0, vb);
+        return 0;
+    }
+    n = sg_get_unaligned_be16(bp + 2);         /* block desc data len */
+    if ((n + 8) > (int)len)
+        n = len - 8;
+    n /= 16;
+    /* check all descriptors before changing the medium */
+    for (k = 0; k < n; ++k) {
+        lba = sg_get_unaligned_be64(bp + 8 + (k * 16));
+        num = sg_get_unaligned_be32(bp + 8 + (k * 16) + 8);
+        if ((lba > mdp->num_lbs) || (num > (mdp->num_lbs - lba))) {
+            mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          lba, vb);
+            return 0;
+        }
+    }
+    for (k = 0; k < n; ++k) {
+        lba = sg_get_unaligned_be64(bp + 8 + (k * 16));
+        num = sg_get_unaligned_be32(bp + 8 + (k * 16) + 8);
+        if (mdp->fd < 0) {      /* LBPRZ=1 so unmapped blocks read zero */
+            memset(mdp->mem + (lba * mdp->lb_sz), 0,
+                   (size_t)num * mdp->lb_sz);
+            continue;
+        }
+        while (num > 0) {
+            chunk = sizeof(zeros) / mdp->lb_sz;
+            if (chunk > num)
+                chunk = num;
+            res = mock_media_io(mdp, lba, zeros, chunk * mdp->lb_sz, true);
+            if (res)
+                return res;
+            lba += chunk;
+            num -= chunk;
+        }
+    }
+    return 0;
+}
+
+/* WRITE SAME(10,16): with UNMAP or NDOB the blocks are zeroed (LBPRZ=1),
+ * otherwise the single block in the data-out buffer is replicated */
+static int
+mock_ws(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    bool zero;
+    int res;
+    uint32_t k, num, chunk;
+    uint64_t lba;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    const uint8_t * bp = (const uint8_t *)(sg_uintptr_t)
+                         ptp->io_hdr.dout_xferp;
+    uint8_t * rep_bp;
+    static uint8_t zeros[64 * 1024];
+
+    if (0x41 == cdbp[0]) {
+        lba = sg_get_unaligned_be32(cdbp + 2);
+        num = sg_get_unaligned_be16(cdbp + 7);
+        zero = !! (0x8 & cdbp[1]);              /* UNMAP */
+    } else {
+        lba = sg_get_unaligned_be64(cdbp + 2);
+        num = sg_get_unaligned_be32(cdbp + 10);
+        zero = !! (0x9 & cdbp[1]);              /* UNMAP or NDOB */
+    }
+    if (lba >= mdp->num_lbs) {
+        mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0, lba,
+                      vb);
+        return 0;
+    }
+    if (0 == num)               /* WSNZ=0: to the end of the medium */
+        num = (uint32_t)(((mdp->num_lbs - lba) > 0xffffffff) ? 0xffffffff :
+                         (mdp->num_lbs - lba));
+    if (num > (mdp->num_lbs - lba)) {
+        mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0, lba,
+                      vb);
+        return 0;
+    }
+    if (mdp->ws_max && (num > mdp->ws_max)) {
+        mk_sense_invalid_fld(ptp, true, (0x41 == cdbp[0]) ? 7 : 10, -1, vb);
+        return 0;
+    }
+    if ((! (0x1 & cdbp[1]) || (0x41 == cdbp[0])) &&
+        ((NULL == bp) || (ptp->io_hdr.dout_xfer_len <
+                          (uint32_t)mdp->lb_sz))) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          PARAMETER_LIST_LENGTH_ERR, 0, vb);
+        return 0;
+    }
+    if (mock_inject(ptp, lba, num, true, vb))
+        return 0;
+    if ((! zero) && (mdp->fd < 0)) {
+        for (k = 0; k < num; ++k)
+            memcpy(mdp->mem + ((lba + k) * mdp->lb_sz), bp, mdp->lb_sz);
+        goto fini;
+    }
+    if (zero && (mdp->fd < 0)) {
+        memset(mdp->mem + (lba * mdp->lb_sz), 0, (size_t)num * mdp->lb_sz);
+        goto fini;
+    }
+    rep_bp = zeros;
+    chunk = sizeof(zeros) / mdp->lb_sz;
+    if (! zero) {
+        rep_bp = (uint8_t *)malloc(chunk * mdp->lb_sz);
+        if (NULL == rep_bp)
+            return -ENOMEM;
+        for (k = 0; k < chunk; ++k)
+            memcpy(rep_bp + (k * mdp->lb_sz), bp, mdp->lb_sz);
+    }
+    for (k = 0, res = 0; k < num; k += chunk) {
+        if (chunk > (num - k))
+            chunk = num - k;
+        res = mock_media_io(mdp, lba + k, rep_bp, chunk * mdp->lb_sz, true);
+        if (res)
+            break;
+    }
+    if (rep_bp != zeros)
+        free(rep_bp);
+    if (res)
+        return res;
+fini:
+    mdp->wr_bytes += (uint64_t)num * mdp->lb_sz;
+    if (mdp->zone_lbs > 0)
+        mock_update_wp(mdp, lba, num);
+    return 0;
+}
+
+/* WRITE SCATTERED(16): the data-out buffer holds a 32 byte header, then
+ * the LBA range descriptors (32 bytes each), then from LB DATA OFFSET
+ * (in blocks) the data for each range in turn. All descriptors are checked
+ * (ranges may not overlap) before anything is written; each range counts
+ * as a media access. */
+static int
+mock_wscat(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    int res;
+    uint32_t k, j, num, lbdof, num_rd, btl, sum;
+    uint64_t lba, j_lba;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t * bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.dout_xferp;
+    const uint8_t * rdp;
+    const uint8_t * jp;
+
+    lbdof = sg_get_unaligned_be16(cdbp + 4);
+    num_rd = sg_get_unaligned_be16(cdbp + 8);
+    btl = sg_get_unaligned_be32(cdbp + 10);
+    if (num_rd > MOCK_SCAT_MAX_RDS) {
+        mk_sense_invalid_fld(ptp, true, 8, -1, vb);
+        return 0;
+    }
+    if (btl > MOCK_SCAT_MAX_BLKS) {
+        mk_sense_invalid_fld(ptp, true, 10, -1, vb);
+        return 0;
+    }
+    if (((uint64_t)lbdof * mdp->lb_sz) < (32 * (1 + (uint64_t)num_rd))) {
+        mk_sense_invalid_fld(ptp, true, 4, -1, vb);
+        return 0;
+    }
+    if ((NULL == bp) || (ptp->io_hdr.dout_xfer_len <
+                         ((uint64_t)lbdof + btl) * mdp->lb_sz)) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                          PARAMETER_LIST_LENGTH_ERR, 0, vb);
+        return 0;
+    }
+    for (k = 0, sum = 0, rdp = bp + 32; k < num_rd; ++k, rdp += 32) {
+        lba = sg_get_unaligned_be64(rdp + 0);
+        num = sg_get_unaligned_be32(rdp + 8);
+        if ((lba >= mdp->num_lbs) || (num > (mdp->num_lbs - lba))) {
+            mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0,
+                          lba, vb);
+            return 0;
+        }
+        sum += num;
+        if (sum > btl) {
+            mk_sense_invalid_fld(ptp, false, 32 * (k + 1) + 8, -1, vb);
+            return 0;
+        }
+        for (j = 0, jp = bp + 32; j < k; ++j, jp += 32) {
+            j_lba = sg_get_unaligned_be64(jp + 0);
+            if ((lba < (j_lba + sg_get_unaligned_be32(jp + 8))) &&
+                (j_lba < (lba + num))) {
+                mk_sense_invalid_fld(ptp, false, 32 * (k + 1), -1, vb);
+                return 0;
+            }
+        }
+    }
+    rdp = bp + 32;
+    bp += lbdof * mdp->lb_sz;
+    for (k = 0; k < num_rd; ++k, rdp += 32) {
+        lba = sg_get_unaligned_be64(rdp + 0);
+        num = sg_get_unaligned_be32(rdp + 8);
+        if (mock_inject(ptp, lba, num, true, vb))
+            return 0;
+        if (num > 0) {
+            res = mock_media_io(mdp, lba, bp, num * mdp->lb_sz, true);
+            if (res)
+                return res;
+        }
+        bp += num * mdp->lb_sz;
+        if (mdp->zone_lbs > 0)
+            mock_update_wp(mdp, lba, num);
+    }
+    mdp->wr_bytes += (uint64_t)sum * mdp->lb_sz;
+    return 0;
+}
+
+/* Puts a command timeouts descriptor at 'bp', returns its length */
+static int
+mock_ctd(uint8_t * bp, const struct mock_opcode * mop)
+{
+    memset(bp, 0, 12);
+    sg_put_unaligned_be16(0xa, bp + 0);
+    sg_put_unaligned_be32(mop->nominal, bp + 4);
+    sg_put_unaligned_be32(mop->recommended, bp + 8);
+    return 12;
+}
+
+/* REPORT SUPPORTED OPERATION CODES, all commands or one command */
+static int
+mock_rsoc(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    bool rctd = !! (0x80 & cdbp[2]);
+    int k, n;
+    int rep_opts = cdbp[2] & 0x7;
+    int num = sizeof(mock_opcodes) / sizeof(mock_opcodes[0]);
+    uint16_t sa = sg_get_unaligned_be16(cdbp + 4);
+    const struct mock_opcode * mop;
+    uint8_t resp[4 + (20 * (sizeof(mock_opcodes) / sizeof(mock_opcodes[0])))];
+
+    memset(resp, 0, sizeof(resp));
+    if (0 == rep_opts) {
+        for (k = 0, n = 4, mop = mock_opcodes; k < num; ++k, ++mop) {
+            resp[n] = mop->opcode;
+            sg_put_unaligned_be16(mop->sa, resp + n + 2);
+            resp[n + 5] = (mop->sav ? 0x1 : 0) | (rctd ? 0x2 : 0);
+            sg_put_unaligned_be16(mop->cdb_len, resp + n + 6);
+            n += 8;
+            if (rctd)
+                n += mock_ctd(resp + n, mop);
+        }
+        sg_put_unaligned_be32(n - 4, resp + 0);
+    } else if (rep_opts <= 3) {
+        for (k = 0, mop = mock_opcodes; k < num; ++k, ++mop) {
+            if ((mop->opcode == cdbp[3]) && ((! mop->sav) || (mop->sa == sa)))
+                break;
+        }
+        if ((k < num) && (((1 == rep_opts) && mop->sav) ||
+                          ((2 == rep_opts) && (! mop->sav)))) {
+            mk_sense_invalid_fld(ptp, true, 2, 2, vb);
+            return 0;
+        }
+        if (k >= num) {
+            resp[1] = 0x1;              /* not supported */
+            n = 4;
+        } else {
+            resp[1] = 0x3 | (rctd ? 0x80 : 0);
+            sg_put_unaligned_be16(mop->cdb_len, resp + 2);
+            memset(resp + 4, 0xff, mop->cdb_len);       /* usage data */
+            resp[4] = mop->opcode;
+            if (mop->sav)
+                resp[5] = (0x7f == mop->opcode) ? 0xff : mop->sa;
+            n = 4 + mop->cdb_len;
+            if (rctd)
+                n += mock_ctd(resp + n, mop);
+        }
+    } else {
+        mk_sense_invalid_fld(ptp, true, 2, 2, vb);
+        return 0;
+    }
+    mock_din(ptp, resp, n, sg_get_unaligned_be32(cdbp + 6));
+    return 0;
+}
+
+/* STREAM CONTROL: open assigns the lowest free stream id, close frees the
+ * stream id in the cdb */
+static int
+mock_stream_ctl(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    uint32_t k;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t resp[8];
+
+    switch ((cdbp[1] >> 5) & 0x3) {
+    case 0x1:           /* open */
+        for (k = 0; k < mdp->max_streams; ++k) {
+            if (! (mdp->str_open & (1U << k)))
+                break;
+        }
+        if (k >= mdp->max_streams) {
+            mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST,
+                              SYSTEM_RESOURCE_FAILURE_ASC, 0, vb);
+            return 0;
+        }
+        mdp->str_open |= (1U << k);
+        memset(resp, 0, sizeof(resp));
+        resp[0] = sizeof(resp) - 1;
+        sg_put_unaligned_be16(k + 1, resp + 4);
+        mock_din(ptp, resp, sizeof(resp), sg_get_unaligned_be32(cdbp + 10));
+        break;
+    case 0x2:           /* close */
+        k = sg_get_unaligned_be16(cdbp + 4);
+        if ((0 == k) || (k > MOCK_MAX_STREAMS) ||
+            (! (mdp->str_open & (1U << (k - 1))))) {
+            mk_sense_invalid_fld(ptp, true, 4, 7, vb);
+            return 0;
+        }
+        mdp->str_open &= ~(1U << (k - 1));
+        break;
+    default:
+        mk_sense_invalid_fld(ptp, true, 1, 6, vb);
+        break;
+    }
+    return 0;
+}
+
+/* GET STREAM STATUS: one descriptor per open stream id, starting at the
+ * stream id in the cdb */
+static int
+mock_get_str_stat(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp,
+                  int vb)
+{
+    int n = 8;
+    uint32_t k;
+    uint32_t start = sg_get_unaligned_be16(cdbp + 4);
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t resp[8 + (8 * MOCK_MAX_STREAMS)];
+
+    if (vb > 4)
+        pr2ws("%s: starting stream id=%u\n", __func__, start);
+    memset(resp, 0, sizeof(resp));
+    for (k = 1; k <= MOCK_MAX_STREAMS; ++k) {
+        if ((k >= start) && (mdp->str_open & (1U << (k - 1)))) {
+            sg_put_unaligned_be16(k, resp + n + 2);
+            n += 8;
+        }
+    }
+    sg_put_unaligned_be32(n - 4, resp + 0);
+    sg_put_unaligned_be16((n - 8) / 8, resp + 6);
+    mock_din(ptp, resp, n, sg_get_unaligned_be32(cdbp + 10));
+    return 0;
+}
+
+/* REPORT ZONES (ZBC IN service action 0x0) for a host aware device whose
+ * zones are all sequential write preferred */
+static int
+mock_rep_zones(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    bool partial = !! (0x80 & cdbp[14]);
+    int opt = 0x3f & cdbp[14];
+    int cond;
+    uint32_t z, alloc_len, num, list_len;
+    uint64_t lba, z_start, z_len;
+    const struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t * bp = (uint8_t *)(sg_uintptr_t)ptp->io_hdr.din_xferp;
+    uint8_t * dp;
+
+    if (0 == mdp->zone_lbs) {
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0, vb);
+        return 0;
+    }
+    lba = sg_get_unaligned_be64(cdbp + 2);
+    alloc_len = sg_get_unaligned_be32(cdbp + 10);
+    if (alloc_len > ptp->io_hdr.din_xfer_len)
+        alloc_len = ptp->io_hdr.din_xfer_len;
+    if (lba >= mdp->num_lbs) {
+        mk_sense_info(ptp, SPC_SK_ILLEGAL_REQUEST, LBA_OUT_OF_RANGE, 0, lba,
+                      vb);
+        return 0;
+    }
+    switch (opt) {
+    case 0x0:           /* all zones */
+    case 0x1:           /* empty */
+    case 0x2:           /* implicitly open */
+    case 0x5:           /* full */
+        break;
+    case 0x3:           /* explicitly open */
+    case 0x4:           /* closed */
+    case 0x6:           /* read only */
+    case 0x7:           /* offline */
+    case 0x10:          /* reset write pointer recommended */
+    case 0x11:          /* non-sequential write resources active */
+    case 0x3f:          /* not write pointer */
+        opt = -1;       /* matches no zones */
+        break;
+    default:
+        mk_sense_invalid_fld(ptp, true, 14, 5, vb);
+        return 0;
+    }
+    if ((NULL == bp) || (alloc_len < 64)) {
+        ptp->io_hdr.din_resid = ptp->io_hdr.din_xfer_len;
+        return 0;
+    }
+    memset(bp, 0, 64);
+    num = 0;
+    list_len = 0;
+    for (z = lba / mdp->zone_lbs; z < mdp->num_zones; ++z) {
+        z_start = z * mdp->zone_lbs;
+        z_len = mdp->zone_lbs;
+        if ((z_start + z_len) > mdp->num_lbs)
+            z_len = mdp->num_lbs - z_start;
+        if (mdp->wps[z] == z_start)
+            cond = 0x1;
+        else if (mdp->wps[z] >= (z_start + z_len))
+            cond = 0xe;
+        else
+            cond = 0x2;
+        if ((opt < 0) || ((0x1 == opt) && (0x1 != cond)) ||
+            ((0x2 == opt) && (0x2 != cond)) || ((0x5 == opt) && (0xe != cond)))
+            continue;
+        list_len += 64;
+        if (((num + 2) * 64) <= alloc_len) {
+            dp = bp + 64 + (num * 64);
+            memset(dp, 0, 64);
+            dp[0] = 0x3;        /* sequential write preferred */
+            dp[1] = cond << 4;
+            sg_put_unaligned_be64(z_len, dp + 8);
+            sg_put_unaligned_be64(z_start, dp + 16);
+            sg_put_unaligned_be64(mdp->wps[z], dp + 24);
+            ++num;
+        } else if (partial)
+            break;
+    }
+    sg_put_unaligned_be32(list_len, bp + 0);
+    bp[4] = 0x1;                /* SAME: all zones same type and length */
+    sg_put_unaligned_be64(mdp->num_lbs - 1, bp + 8);
+    ptp->io_hdr.din_resid = ptp->io_hdr.din_xfer_len - (64 + (num * 64));
+    return 0;
+}
+
+/* Appends a log parameter with an 8 byte counter, returns new offset */
+static int
+mock_log_counter(uint8_t * bp, int off, int pc, uint64_t val)
+{
+    sg_put_unaligned_be16(pc, bp + off);
+    bp[off + 2] = 0x2;          /* binary format list */
+    bp[off + 3] = 8;
+    sg_put_unaligned_be64(val, bp + off + 4);
+    return off + 12;
+}
+
+static int
+mock_log_sense(struct sg_pt_linux_scsi * ptp, const uint8_t * cdbp, int vb)
+{
+    int n;
+    int pg = 0x3f & cdbp[2];
+    const struct sg_mock_dev * mdp = ptp->mock_devp;
+    uint8_t resp[64];
+
+    if (cdbp[3]) {              /* no subpages */
+        mk_sense_invalid_fld(ptp, true, 3, -1, vb);
+        return 0;
+    }
+    memset(resp, 0, sizeof(resp));
+    resp[0] = pg;
+    switch (pg) {
+    case 0x0:           /* supported log pages */
+        resp[4] = 0x0;
+        resp[5] = 0x2;
+        resp[6] = 0x3;
+        resp[7] = 0xd;
+        n = 8;
+        break;
+    case 0x2:           /* write error counters */
+    case 0x3:           /* read error counters */
+        n = mock_log_counter(resp, 4, 0x5, (0x2 == pg) ? mdp->wr_bytes :
+                             mdp->rd_bytes);    /* total bytes processed */
+        n = mock_log_counter(resp, n, 0x6, (0x2 == pg) ? mdp->wr_errs :
+                             mdp->rd_errs);     /* total uncorrected errs */
+        break;
+    case 0xd:           /* temperature */
+        resp[5] = 0x0;          /* temperature */
+        resp[6] = 0x3;
+        resp[7] = 0x2;
+        resp[9] = 35;
+        resp[11] = 0x1;         /* reference temperature */
+        resp[12] = 0x3;
+        resp[13] = 0x2;
+        resp[15] = 65;
+        n = 16;
+        break;
+    default:
+        mk_sense_invalid_fld(ptp, true, 2, 5, vb);
+        return 0;
+    }
+    sg_put_unaligned_be16(n - 4, resp + 2);
+    mock_din(ptp, resp, n, sg_get_unaligned_be16(cdbp + 7));
+    return 0;
+}
+
+int
+sg_do_mock_pt(struct sg_pt_linux_scsi * ptp, int time_secs, int vb)
+{
+    int n, res;
+    struct sg_mock_dev * mdp = ptp->mock_devp;
+    const uint8_t * cdbp = (const uint8_t *)(sg_uintptr_t)
+                           ptp->io_hdr.request;
+    uint8_t resp[32];
+    struct timespec start_ts, end_ts;
+
+    if ((NULL == cdbp) || (ptp->io_hdr.request_len < 6)) {
+        if (vb)
+            pr2ws("No SCSI command (cdb) given [mock]\n");
+        return SCSI_PT_DO_BAD_PARAMS;
+    }
+    if (vb > 3)
+        pr2ws("%s: opcode=0x%x, time_secs=%d\n", __func__, cdbp[0],
+              time_secs);
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    ptp->io_hdr.device_status = 0;
+    ptp->io_hdr.driver_status = 0;
+    ptp->io_hdr.transport_status = 0;
+    ptp->io_hdr.response_len = 0;
+    ptp->io_hdr.din_resid = 0;
+    ptp->io_hdr.dout_resid = 0;
+    res = 0;
+    switch (cdbp[0]) {
+    case 0x08: case 0x0a: case 0x28: case 0x2a: case 0xa8: case 0xaa:
+    case 0x88: case 0x8a: case 0x2f: case 0x8f: case 0x42: case 0x89:
+    case 0x41: case 0x93: case 0x9f: case 0x9a:
+        mock_delay(mdp);
+        break;
+    default:
+        break;
+    }
+    mock_lock(mdp);
+    if (mdp->ua_pending && (0x12 != cdbp[0]) && (0xa0 != cdbp[0]) &&
+        (0x3 != cdbp[0])) {
+        mdp->ua_pending = false;
+        mk_sense_asc_ascq(ptp, SPC_SK_UNIT_ATTENTION, UA_RESET_ASC,
+                          POWER_ON_RESET_ASCQ, vb);
+        goto fini;
+    }
+    switch (cdbp[0]) {
+    case 0x00:          /* TEST UNIT READY */
+        break;
+    case 0x03:          /* REQUEST SENSE: nothing pending */
+        memset(resp, 0, sizeof(resp));
+        if (mdp->dsense) {
+            resp[0] = 0x72;
+            n = 8;
+        } else {
+            resp[0] = 0x70;
+            resp[7] = 0xa;
+            n = 18;
+        }
+        mock_din(ptp, resp, n, cdbp[4]);
+        break;
+    case 0x12:
+        res = mock_inq(ptp, cdbp, vb);
+        break;
+    case 0x25:
+        res = mock_readcap(ptp, cdbp);
+        break;
+    case 0x9e:
+        if (0x10 == (0x1f & cdbp[1]))
+            res = mock_readcap(ptp, cdbp);
+        else if (0x14 == (0x1f & cdbp[1]))
+            res = mock_stream_ctl(ptp, cdbp, vb);
+        else if (0x16 == (0x1f & cdbp[1]))
+            res = mock_get_str_stat(ptp, cdbp, vb);
+        else
+            mk_sense_invalid_fld(ptp, true, 1, 4, vb);
+        break;
+    case 0x08: case 0x0a: case 0x28: case 0x2a: case 0xa8: case 0xaa:
+    case 0x88: case 0x8a: case 0x2f: case 0x8f: case 0x9a:
+        res = mock_rw(ptp, cdbp, vb);
+        break;
+    case 0x35:          /* SYNCHRONIZE CACHE(10) */
+    case 0x91:          /* SYNCHRONIZE CACHE(16) */
+        if ((mdp->fd >= 0) && (fdatasync(mdp->fd) < 0))
+            res = -errno;
+        break;
+    case 0x42:
+        res = mock_unmap(ptp, cdbp, vb);
+        break;
+    case 0x89:
+        res = mock_caw(ptp, cdbp, vb);
+        break;
+    case 0x41:          /* WRITE SAME(10) */
+    case 0x93:          /* WRITE SAME(16) */
+        res = mock_ws(ptp, cdbp, vb);
+        break;
+    case 0x4d:
+        res = mock_log_sense(ptp, cdbp, vb);
+        break;
+    case 0x9f:          /* SERVICE ACTION OUT(16) */
+        if (0x12 == (0x1f & cdbp[1]))   /* WRITE SCATTERED(16) */
+            res = mock_wscat(ptp, cdbp, vb);
+        else
+            mk_sense_invalid_fld(ptp, true, 1, 4, vb);
+        break;
+    case 0x95:          /* ZBC IN */
+        if (0x0 == (0x1f & cdbp[1]))
+            res = mock_rep_zones(ptp, cdbp, vb);
+        else
+            mk_sense_invalid_fld(ptp, true, 1, 4, vb);
+        break;
+    case 0xa3:          /* MAINTENANCE IN */
+        if (0xc == (0x1f & cdbp[1]))
+            res = mock_rsoc(ptp, cdbp, vb);
+        else
+            mk_sense_invalid_fld(ptp, true, 1, 4, vb);
+        break;
+    case 0xa0:          /* REPORT LUNS: LUNs 0 to luns=N less 1 */
+        {
+            uint32_t k;
+            uint8_t rl[8 + (8 * MOCK_MAX_LUNS)];
+
+            memset(rl, 0, sizeof(rl));
+            sg_put_unaligned_be32(8 * mdp->num_luns, rl + 0);
+            for (k = 0; k < mdp->num_luns; ++k)
+                rl[8 + (8 * k) + 1] = (uint8_t)k;  /* peripheral method */
+            mock_din(ptp, rl, 8 + (8 * mdp->num_luns),
+                     sg_get_unaligned_be32(cdbp + 6));
+        }
+        break;
+    default:
+        if (vb > 2) {
+            char b[64];
+
+            sg_get_command_name(cdbp, -1, sizeof(b), b);
+            pr2ws("%s: SCSI %s command not emulated\n", __func__, b);
+        }
+        mk_sense_asc_ascq(ptp, SPC_SK_ILLEGAL_REQUEST, INVALID_OPCODE, 0, vb);
+        break;
+    }
+fini:
+    mock_unlock(mdp);
+    clock_gettime(CLOCK_MONOTONIC, &end_ts);
+    ptp->io_hdr.duration = (uint32_t)
+                ((end_ts.tv_sec - start_ts.tv_sec) * 1000 +
+                 (end_ts.tv_nsec - start_ts.tv_nsec) / 1000000);
+    if (res < 0) {
+        ptp->os_err = -res;
+        if (vb > 1)
+            pr2ws("%s: medium access failed: %s\n", __func__,
+                  safe_strerror(-res));
+    }
+    return res;
+}
@@ -28,6 +28,11 @@
  * This command performs a SCSI COMPARE AND WRITE. See SBC-3 at
  * http://www.t10.org
  *
+ * It also has a contention mode in which several threads, possibly on
+ * different paths to the same LU, repeatedly COMPARE AND WRITE one or more
+ * lock blocks in the way that cluster file systems use ATS (Atomic Test
+ * and Set) for heartbeats and locks.
+ *
  */
 
 #ifndef __sun
@@ -46,17 +51,20 @@
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <getopt.h>
+#include <time.h>
+#include <pthread.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_pt.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.26 20190113";
+static const char * version_str = "1.27 20261018";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_NUM_BLOCKS (1)
@@ -65,13 +73,25 @@ static const char * version_str = "1.26 20190113";
 
 #define COMPARE_AND_WRITE_OPCODE (0x89)
 #define COMPARE_AND_WRITE_CDB_SIZE (16)
+#define READ16_OPCODE (0x88)
+#define READ16_CDB_SIZE (16)
+
+#define MAX_DEVICES 16
+#define MAX_THREADS 1024
+#define MAX_LOCKS 4096
+#define DEF_CONTEND_COUNT 1000
+#define MAX_UA_RETRIES 16
+#define LOCK_REC_MAGIC "sg3_caw1"    /* 8 bytes, start of lock record */
+#define LOCK_REC_LEN 32
 
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 
 #define ME "sg_compare_and_write: "
 
 static struct option long_options[] = {
+        {"count", required_argument, 0, 'c'},
         {"dpo", no_argument, 0, 'd'},
+        {"duration", required_argument, 0, 's'},
         {"fua", no_argument, 0, 'f'},
         {"fua_nv", no_argument, 0, 'F'},
         {"fua-nv", no_argument, 0, 'F'},
@@ -82,8 +102,10 @@ static struct option long_options[] = {
         {"inc", required_argument, 0, 'C'},
         {"inw", required_argument, 0, 'D'},
         {"lba", required_argument, 0, 'l'},
+        {"locks", required_argument, 0, 'L'},
         {"num", required_argument, 0, 'n'},
         {"quiet", no_argument, 0, 'q'},
+        {"threads", required_argument, 0, 'T'},
         {"timeout", required_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -101,10 +123,16 @@ struct caw_flags {
 };
 
 struct opts_t {
+        bool contend;           /* contention mode */
         bool quiet;
         bool verbose_given;
         bool version_given;
         bool wfn_given;
+        int count;              /* COMPARE AND WRITEs per thread */
+        int duration;           /* seconds */
+        int num_devs;
+        int num_locks;
+        int num_threads;
         int numblocks;
         int verbose;
         int timeout;
@@ -112,10 +140,42 @@ struct opts_t {
         uint64_t lba;
         const char * ifn;
         const char * wfn;
-        const char * device_name;
+        const char * device_name;       /* same as dev_names[0] */
+        const char * dev_names[MAX_DEVICES];
         struct caw_flags flags;
 };
 
+struct caw_lat_arr {            /* grows as needed, in nanoseconds */
+        int num;
+        int max;
+        uint64_t * arr;
+};
+
+struct caw_shared {
+        bool stop;
+        int running;            /* number of worker threads not finished */
+        int half_len;           /* bytes compared, and written, per CAW */
+        pthread_mutex_t mutex;
+        const struct opts_t * op;
+};
+
+struct caw_thr {
+        int id;
+        int dev_ind;
+        int fd;
+        int res;                /* first error other than a miscompare */
+        unsigned int seed;
+        uint64_t successes;
+        uint64_t miscompares;
+        uint64_t reads;         /* of lock blocks after a miscompare */
+        uint64_t uas;
+        struct caw_lat_arr ok_lat;
+        struct caw_lat_arr mis_lat;
+        uint8_t * expect;       /* last known contents of each lock */
+        pthread_t tid;
+        struct caw_shared * shp;
+};
+
 
 static void
 usage()
@@ -129,9 +189,21 @@ usage()
                 "[--verbose] [--version]\n"
                 "                            [--wrprotect=WP] [--xferlen=LEN] "
                 "DEVICE\n"
+                "       sg_compare_and_write [--count=CNT] [--duration=SECS] "
+                "--lba=LBA\n"
+                "                            [--locks=NL] [--num=NUM] "
+                "[--threads=NT] [OPTS]\n"
+                "                            DEVICE [DEVICE...]\n"
                 "  where:\n"
+                "    --count=CNT|-c CNT    contention mode: COMPARE AND "
+                "WRITEs per\n"
+                "                          thread (def: %d unless "
+                "--duration= given)\n"
                 "    --dpo|-d            set the dpo bit in cdb (def: "
                 "clear)\n"
+                "    --duration=SECS|-s SECS    contention mode: stop "
+                "after SECS\n"
+                "                               seconds\n"
                 "    --fua|-f            set the fua bit in cdb (def: "
                 "clear)\n"
                 "    --fua_nv|-F         set the fua_nv bit in cdb (def: "
@@ -149,11 +221,19 @@ usage()
                 "buffer\n"
                 "    --lba=LBA|-l LBA    LBA of the first block to compare "
                 "and write\n"
+                "    --locks=NL|-L NL    contention mode: NL lock LBAs, NUM "
+                "blocks apart\n"
+                "                        starting at LBA (def: 1)\n"
                 "    --num=NUM|-n NUM    number of blocks to "
                 "compare/write (def: 1)\n"
                 "    --quiet|-q          suppress MISCOMPARE report to "
                 "stderr,\n"
                 "                        still sets exit status of 14\n"
+                "    --threads=NT|-T NT    contention mode: NT threads, "
+                "each with its\n"
+                "                          own file descriptor, spread "
+                "over DEVICEs\n"
+                "                          (def: 1)\n"
                 "    --timeout=TO|-t TO    timeout for the command "
                 "(def: 60 secs)\n"
                 "    --verbose|-v        increase verbosity (use '-vv' for "
@@ -170,7 +250,12 @@ usage()
                 "size\nbuffer, the first half is used to compare what is at "
                 "LBA for NUM\nblocks. If and only if the comparison is "
                 "equal, then the second\nhalf of the buffer is written to "
-                "LBA for NUM blocks.\n");
+                "LBA for NUM blocks. The contention mode\n(selected by any "
+                "of --count=, --duration=, --locks=, --threads= or\nmore "
+                "than one DEVICE) overwrites the lock blocks with lock "
+                "records and\nreports successes, miscompares and latency "
+                "percentiles.\n",
+                DEF_CONTEND_COUNT);
 }
 
 static int
@@ -189,12 +274,20 @@ parse_args(int argc, char* argv[], struct opts_t * op)
         while (1) {
                 int option_index = 0;
 
-                c = getopt_long(argc, argv, "C:dD:fFg:hi:l:n:qt:vVw:x:",
-                                long_options, &option_index);
+                c = getopt_long(argc, argv, "c:C:dD:fFg:hi:l:L:n:qs:t:T:vVw:"
+                                "x:", long_options, &option_index);
                 if (c == -1)
                         break;
 
                 switch (c) {
+                case 'c':
+                        op->count = sg_get_num(optarg);
+                        if (op->count < 1) {
+                                pr2serr("bad argument to '--count', expect "
+                                        "1 or more\n");
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 'C':
                 case 'i':
                         op->ifn = optarg;
@@ -235,6 +328,15 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                         op->lba = (uint64_t)ll;
                         lba_given = true;
                         break;
+                case 'L':
+                        op->num_locks = sg_get_num(optarg);
+                        if ((op->num_locks < 1) ||
+                            (op->num_locks > MAX_LOCKS)) {
+                                pr2serr("bad argument to '--locks', expect "
+                                        "1 to %d\n", MAX_LOCKS);
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 'n':
                         op->numblocks = sg_get_num(optarg);
                         if ((op->numblocks < 0) || (op->numblocks > 255))  {
@@ -246,6 +348,14 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                 case 'q':
                         op->quiet = true;
                         break;
+                case 's':
+                        op->duration = sg_get_num(optarg);
+                        if (op->duration < 1) {
+                                pr2serr("bad argument to '--duration', "
+                                        "expect 1 or more seconds\n");
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 't':
                         op->timeout = sg_get_num(optarg);
                         if (op->timeout < 0)  {
@@ -253,6 +363,15 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                                 goto out_err_no_usage;
                         }
                         break;
+                case 'T':
+                        op->num_threads = sg_get_num(optarg);
+                        if ((op->num_threads < 1) ||
+                            (op->num_threads > MAX_THREADS)) {
+                                pr2serr("bad argument to '--threads', expect "
+                                        "1 to %d\n", MAX_THREADS);
+                                goto out_err_no_usage;
+                        }
+                        break;
                 case 'v':
                         op->verbose_given = true;
                         ++op->verbose;
@@ -280,22 +399,48 @@ parse_args(int argc, char* argv[], struct opts_t * op)
                         goto out_err;
                 }
         }
-        if (optind < argc) {
-                if (NULL == op->device_name) {
-                        op->device_name = argv[optind];
-                        ++optind;
-                }
-                if (optind < argc) {
-                        for (; optind < argc; ++optind)
-                                pr2serr("Unexpected extra argument: %s\n",
-                                        argv[optind]);
+        for ( ; optind < argc; ++optind) {
+                if (op->num_devs >= MAX_DEVICES) {
+                        pr2serr("Unexpected extra argument: %s\n",
+                                argv[optind]);
                         goto out_err;
                 }
+                op->dev_names[op->num_devs++] = argv[optind];
         }
-        if (NULL == op->device_name) {
+        if (0 == op->num_devs) {
                 pr2serr("missing device name!\n");
                 goto out_err;
         }
+        op->device_name = op->dev_names[0];
+        if ((op->count > 0) || (op->duration > 0) || (op->num_locks > 0) ||
+            (op->num_threads > 0) || (op->num_devs > 1))
+                op->contend = true;
+        if (op->contend) {
+                if (if_given || op->wfn_given) {
+                        pr2serr("contention mode builds its own compare and "
+                                "write buffers,\nso --in= and --inw= are "
+                                "not permitted\n");
+                        goto out_err_no_usage;
+                }
+                if (! lba_given) {
+                        pr2serr("missing lba\n");
+                        goto out_err;
+                }
+                if (0 == op->numblocks) {
+                        pr2serr("contention mode needs --num= of 1 or "
+                                "more\n");
+                        goto out_err_no_usage;
+                }
+                if ((0 == op->count) && (0 == op->duration))
+                        op->count = DEF_CONTEND_COUNT;
+                if (0 == op->num_locks)
+                        op->num_locks = 1;
+                if (0 == op->num_threads)
+                        op->num_threads = 1;
+                if (0 == op->xfer_len)
+                        op->xfer_len = 2 * op->numblocks * DEF_BLOCK_SIZE;
+                return 0;
+        }
         if (! if_given) {
                 pr2serr("missing input file\n");
                 goto out_err;
@@ -458,11 +603,459 @@ open_dev(const char * outf, int verbose)
         return sg_fd;
 }
 
+/* Reads the current contents of a lock into 'buff', retrying after a
+ * unit attention. Returns 0 for success, else SG_LIB_CAT_* or other
+ * sg3_utils error code. */
+static int
+caw_read_lock(int sg_fd, uint8_t * buff, int blocks, uint64_t lba, int len,
+              int verbose)
+{
+        int k, res, ret, sense_cat;
+        struct sg_pt_base * ptvp;
+        uint8_t rdCmd[READ16_CDB_SIZE];
+        uint8_t sense_b[SENSE_BUFF_LEN];
+
+        memset(rdCmd, 0, sizeof(rdCmd));
+        rdCmd[0] = READ16_OPCODE;
+        sg_put_unaligned_be64(lba, rdCmd + 2);
+        sg_put_unaligned_be32((uint32_t)blocks, rdCmd + 10);
+        ptvp = construct_scsi_pt_obj();
+        if (NULL == ptvp) {
+                pr2serr("Could not construct scsit_pt_obj, out of memory\n");
+                return sg_convert_errno(ENOMEM);
+        }
+        for (k = 0; k < MAX_UA_RETRIES; ++k) {
+                if (k > 0)
+                        clear_scsi_pt_obj(ptvp);
+                set_scsi_pt_cdb(ptvp, rdCmd, sizeof(rdCmd));
+                set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+                set_scsi_pt_data_in(ptvp, buff, len);
+                res = do_scsi_pt(ptvp, sg_fd, DEF_TIMEOUT_SECS, verbose);
+                ret = sg_cmds_process_resp(ptvp, "READ(16)", res, false,
+                                           verbose, &sense_cat);
+                if (-1 == ret)
+                        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+                else if (-2 == ret) {
+                        if ((SG_LIB_CAT_RECOVERED == sense_cat) ||
+                            (SG_LIB_CAT_NO_SENSE == sense_cat))
+                                ret = 0;
+                        else
+                                ret = sense_cat;
+                } else
+                        ret = 0;
+                if (SG_LIB_CAT_UNIT_ATTENTION != ret)
+                        break;
+        }
+        destruct_scsi_pt_obj(ptvp);
+        return ret;
+}
+
+/* Builds the data to write: a lock record (magic, owner, generation and
+ * time stamp) followed by the rest of the previous contents unchanged. The
+ * generation is one more than that of the previous record, if any. */
+static void
+caw_mk_lock_rec(uint8_t * out, const uint8_t * prev, int len, int owner)
+{
+        uint64_t gen = 1;
+
+        if (len < LOCK_REC_LEN) {
+                memcpy(out, prev, len);
+                if (len > 0)
+                        ++out[len - 1];         /* must differ */
+                return;
+        }
+        if (0 == memcmp(prev, LOCK_REC_MAGIC, 8))
+                gen = sg_get_unaligned_be64(prev + 16) + 1;
+        memcpy(out, LOCK_REC_MAGIC, 8);
+        sg_put_unaligned_be32((uint32_t)owner, out + 8);
+        sg_put_unaligned_be32(0, out + 12);
+        sg_put_unaligned_be64(gen, out + 16);
+        sg_put_unaligned_be64(sg_get_monotonic_ns(), out + 24);
+        if (len > LOCK_REC_LEN)
+                memcpy(out + LOCK_REC_LEN, prev + LOCK_REC_LEN,
+                       len - LOCK_REC_LEN);
+}
+
+static void
+caw_lat_add(struct caw_lat_arr * lap, uint64_t ns)
+{
+        uint64_t * p;
+
+        if (lap->num >= lap->max) {
+                if (lap->max >= (INT32_MAX / 2))
+                        return;         /* enough samples */
+                lap->max = lap->max ? (2 * lap->max) : 4096;
+                p = (uint64_t *)realloc(lap->arr,
+                                        lap->max * sizeof(uint64_t));
+                if (NULL == p) {
+                        lap->max = lap->num;
+                        return;
+                }
+                lap->arr = p;
+        }
+        lap->arr[lap->num++] = ns;
+}
+
+static bool
+caw_stopped(struct caw_shared * shp)
+{
+        bool stop;
+
+        pthread_mutex_lock(&shp->mutex);
+        stop = shp->stop;
+        pthread_mutex_unlock(&shp->mutex);
+        return stop;
+}
+
+static void *
+caw_worker(void * v_tp)
+{
+        int j, k, res, half, uas;
+        uint64_t lba, t;
+        struct caw_thr * tp = (struct caw_thr *)v_tp;
+        struct caw_shared * shp = tp->shp;
+        const struct opts_t * op = shp->op;
+        uint8_t * buff;
+        uint8_t * free_buff = NULL;
+        uint8_t * ep;
+
+        half = shp->half_len;
+        res = 0;
+        buff = (uint8_t *)sg_memalign(2 * half, 0, &free_buff, false);
+        if (NULL == buff) {
+                res = sg_convert_errno(ENOMEM);
+                goto fini;
+        }
+        /* learn what is currently in each lock block */
+        for (j = 0; j < op->num_locks; ++j) {
+                lba = op->lba + ((uint64_t)j * op->numblocks);
+                res = caw_read_lock(tp->fd, tp->expect + (j * half),
+                                    op->numblocks, lba, half, op->verbose);
+                if (res)
+                        goto fini;
+                ++tp->reads;
+        }
+        for (k = 0, uas = 0; (0 == op->count) || (k < op->count); ) {
+                if (caw_stopped(shp))
+                        break;
+                j = (op->num_locks > 1) ?
+                    (int)(rand_r(&tp->seed) % op->num_locks) : 0;
+                lba = op->lba + ((uint64_t)j * op->numblocks);
+                ep = tp->expect + (j * half);
+                memcpy(buff, ep, half);
+                caw_mk_lock_rec(buff + half, ep, half, tp->id + 1);
+                t = sg_get_monotonic_ns();
+                res = sg_ll_compare_and_write(tp->fd, buff, op->numblocks,
+                                              lba, 2 * half, op->flags,
+                                              false, op->verbose);
+                t = sg_get_monotonic_ns() - t;
+                if (0 == res) {
+                        ++tp->successes;
+                        caw_lat_add(&tp->ok_lat, t);
+                        memcpy(ep, buff + half, half);
+                } else if (SG_LIB_CAT_MISCOMPARE == res) {
+                        /* another thread (or host) got there first */
+                        ++tp->miscompares;
+                        caw_lat_add(&tp->mis_lat, t);
+                        res = caw_read_lock(tp->fd, ep, op->numblocks, lba,
+                                            half, op->verbose);
+                        if (res)
+                                break;
+                        ++tp->reads;
+                } else if ((SG_LIB_CAT_UNIT_ATTENTION == res) &&
+                           (++uas < MAX_UA_RETRIES)) {
+                        ++tp->uas;
+                        continue;       /* does not count */
+                } else
+                        break;
+                res = 0;
+                uas = 0;
+                ++k;
+        }
+fini:
+        tp->res = res;
+        if (res && (! op->quiet)) {
+                char b[80];
+
+                sg_get_category_sense_str(res, sizeof(b), b, op->verbose);
+                pr2serr("thread %d on %s stopped: %s\n", tp->id,
+                        op->dev_names[tp->dev_ind], b);
+        }
+        if (free_buff)
+                free(free_buff);
+        pthread_mutex_lock(&shp->mutex);
+        --shp->running;
+        pthread_mutex_unlock(&shp->mutex);
+        return NULL;
+}
+
+static int
+cmp_u64(const void * a, const void * b)
+{
+        uint64_t x = *(const uint64_t *)a;
+        uint64_t y = *(const uint64_t *)b;
+
+        return (x < y) ? -1 : (x > y);
+}
+
+/* Nearest rank percentile, 'arr' must be sorted */
+static double
+caw_pctl_us(const uint64_t * arr, int num, double pct)
+{
+        int k = (int)((pct * num) / 100.0 + 0.5);
+
+        if (k > 0)
+                --k;
+        if (k >= num)
+                k = num - 1;
+        return arr[k] / 1000.0;
+}
+
+/* Sorts 'arr' then outputs a line of latency percentiles (in usecs) */
+static void
+caw_pr_lat(const char * name, uint64_t * arr, int num)
+{
+        if (num < 1) {
+                printf("    %-11s n=0\n", name);
+                return;
+        }
+        qsort(arr, num, sizeof(uint64_t), cmp_u64);
+        printf("    %-11s n=%d min=%.1f p50=%.1f p90=%.1f p99=%.1f "
+               "p99.9=%.1f max=%.1f\n", name, num, arr[0] / 1000.0,
+               caw_pctl_us(arr, num, 50.0), caw_pctl_us(arr, num, 90.0),
+               caw_pctl_us(arr, num, 99.0), caw_pctl_us(arr, num, 99.9),
+               arr[num - 1] / 1000.0);
+}
+
+/* Gathers latencies of threads on device 'dev_ind' (or all threads when
+ * dev_ind < 0) into the heap array placed in *arr_pp. Returns number of
+ * elements or -1 if out of memory. */
+static int
+caw_gather(const struct caw_thr * thr_arr, int num_thr, int dev_ind,
+           bool ok, bool mis, uint64_t ** arr_pp)
+{
+        int k, n;
+        uint64_t * arr;
+        const struct caw_thr * tp;
+
+        for (k = 0, n = 0, tp = thr_arr; k < num_thr; ++k, ++tp) {
+                if ((dev_ind >= 0) && (dev_ind != tp->dev_ind))
+                        continue;
+                n += (ok ? tp->ok_lat.num : 0) + (mis ? tp->mis_lat.num : 0);
+        }
+        arr = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+        if (NULL == arr)
+                return -1;
+        for (k = 0, n = 0, tp = thr_arr; k < num_thr; ++k, ++tp) {
+                if ((dev_ind >= 0) && (dev_ind != tp->dev_ind))
+                        continue;
+                if (ok && (tp->ok_lat.num > 0)) {
+                        memcpy(arr + n, tp->ok_lat.arr,
+                               tp->ok_lat.num * sizeof(uint64_t));
+                        n += tp->ok_lat.num;
+                }
+                if (mis && (tp->mis_lat.num > 0)) {
+                        memcpy(arr + n, tp->mis_lat.arr,
+                               tp->mis_lat.num * sizeof(uint64_t));
+                        n += tp->mis_lat.num;
+                }
+        }
+        *arr_pp = arr;
+        return n;
+}
+
+static void
+caw_report(const struct opts_t * op, const struct caw_thr * thr_arr,
+           double secs)
+{
+        int k, j, n;
+        uint64_t ok = 0;
+        uint64_t mis = 0;
+        uint64_t reads = 0;
+        uint64_t uas = 0;
+        uint64_t tot, d_ok, d_mis;
+        uint64_t * arr;
+        const struct caw_thr * tp;
+
+        for (k = 0, tp = thr_arr; k < op->num_threads; ++k, ++tp) {
+                ok += tp->successes;
+                mis += tp->miscompares;
+                reads += tp->reads;
+                uas += tp->uas;
+        }
+        tot = ok + mis;
+        printf("COMPARE AND WRITE contention: %d thread%s, %d path%s, %d "
+               "lock%s from LBA 0x%" PRIx64 ", %d block%s each\n",
+               op->num_threads, (op->num_threads > 1) ? "s" : "",
+               op->num_devs, (op->num_devs > 1) ? "s" : "", op->num_locks,
+               (op->num_locks > 1) ? "s" : "", op->lba, op->numblocks,
+               (op->numblocks > 1) ? "s" : "");
+        printf("  elapsed %.2f secs, %" PRIu64 " COMPARE AND WRITEs, %.1f "
+               "per sec\n", secs, tot, (secs > 0.0) ? (tot / secs) : 0.0);
+        printf("  successes: %" PRIu64 " (%.1f%%), miscompares: %" PRIu64
+               " (%.1f%%)\n", ok, tot ? (100.0 * ok / tot) : 0.0, mis,
+               tot ? (100.0 * mis / tot) : 0.0);
+        printf("  lock re-reads: %" PRIu64 ", unit attentions: %" PRIu64
+               "\n", reads, uas);
+        printf("  latency (microseconds):\n");
+        n = caw_gather(thr_arr, op->num_threads, -1, true, true, &arr);
+        if (n >= 0) {
+                caw_pr_lat("all", arr, n);
+                free(arr);
+        }
+        n = caw_gather(thr_arr, op->num_threads, -1, true, false, &arr);
+        if (n >= 0) {
+                caw_pr_lat("success", arr, n);
+                free(arr);
+        }
+        n = caw_gather(thr_arr, op->num_threads, -1, false, true, &arr);
+        if (n >= 0) {
+                caw_pr_lat("miscompare", arr, n);
+                free(arr);
+        }
+        if (op->num_devs < 2)
+                return;
+        printf("  per path:\n");
+        for (j = 0; j < op->num_devs; ++j) {
+                d_ok = 0;
+                d_mis = 0;
+                for (k = 0, tp = thr_arr; k < op->num_threads; ++k, ++tp) {
+                        if (j != tp->dev_ind)
+                                continue;
+                        d_ok += tp->successes;
+                        d_mis += tp->miscompares;
+                }
+                printf("    %s: successes: %" PRIu64 ", miscompares: %"
+                       PRIu64 "\n", op->dev_names[j], d_ok, d_mis);
+                n = caw_gather(thr_arr, op->num_threads, j, true, true,
+                               &arr);
+                if (n >= 0) {
+                        caw_pr_lat("all", arr, n);
+                        free(arr);
+                }
+        }
+}
+
+/* Contention mode: op->num_threads threads, each with its own file
+ * descriptor (opened round robin over the given DEVICEs), repeatedly
+ * COMPARE AND WRITE lock blocks. Each thread keeps what it last saw in
+ * each lock as its compare buffer; on a miscompare it re-reads that lock,
+ * as a cluster lock manager would. Returns 0 or first error. */
+static int
+do_contend(const struct opts_t * op)
+{
+        bool mutex_ok = false;
+        int k, res, ret;
+        int started = 0;
+        int half = op->xfer_len / 2;
+        uint64_t t_start, t_end;
+        struct caw_thr * thr_arr = NULL;
+        struct caw_thr * tp;
+        struct caw_shared shared;
+        struct caw_shared * shp = &shared;
+        struct timespec ts;
+
+        memset(shp, 0, sizeof(shared));
+        shp->op = op;
+        shp->half_len = half;
+        if ((half < 1) || (op->xfer_len & 1)) {
+                pr2serr("--xferlen= must be even and positive\n");
+                return SG_LIB_SYNTAX_ERROR;
+        }
+        thr_arr = (struct caw_thr *)calloc(op->num_threads,
+                                           sizeof(struct caw_thr));
+        if (NULL == thr_arr) {
+                pr2serr("Not enough user memory\n");
+                return sg_convert_errno(ENOMEM);
+        }
+        ret = 0;
+        for (k = 0, tp = thr_arr; k < op->num_threads; ++k, ++tp)
+                tp->fd = -1;
+        for (k = 0, tp = thr_arr; k < op->num_threads; ++k, ++tp) {
+                tp->id = k;
+                tp->dev_ind = k % op->num_devs;
+                tp->seed = (unsigned int)(k + 1) * 2654435761U;
+                tp->shp = shp;
+                tp->fd = open_dev(op->dev_names[tp->dev_ind], op->verbose);
+                if (tp->fd < 0) {
+                        ret = sg_convert_errno(-tp->fd);
+                        goto fini;
+                }
+                tp->expect = (uint8_t *)calloc(op->num_locks, half);
+                if (NULL == tp->expect) {
+                        pr2serr("Not enough user memory\n");
+                        ret = sg_convert_errno(ENOMEM);
+                        goto fini;
+                }
+        }
+        if (pthread_mutex_init(&shp->mutex, NULL)) {
+                ret = sg_convert_errno(EINVAL);
+                goto fini;
+        }
+        mutex_ok = true;
+        t_start = sg_get_monotonic_ns();
+        for (k = 0, tp = thr_arr; k < op->num_threads; ++k, ++tp) {
+                pthread_mutex_lock(&shp->mutex);
+                ++shp->running;
+                pthread_mutex_unlock(&shp->mutex);
+                res = pthread_create(&tp->tid, NULL, caw_worker, tp);
+                if (res) {
+                        pr2serr("pthread_create: %s\n", safe_strerror(res));
+                        pthread_mutex_lock(&shp->mutex);
+                        --shp->running;
+                        shp->stop = true;
+                        pthread_mutex_unlock(&shp->mutex);
+                        ret = sg_convert_errno(res);
+                        break;
+                }
+                ++started;
+        }
+        if (op->duration > 0) {
+                ts.tv_sec = 0;
+                ts.tv_nsec = 50 * 1000 * 1000;
+                while (1) {
+                        pthread_mutex_lock(&shp->mutex);
+                        if (0 == shp->running)
+                                k = 0;
+                        else if ((sg_get_monotonic_ns() - t_start) >=
+                                 ((uint64_t)op->duration * 1000000000)) {
+                                shp->stop = true;
+                                k = 0;
+                        } else
+                                k = 1;
+                        pthread_mutex_unlock(&shp->mutex);
+                        if (0 == k)
+                                break;
+                        nanosleep(&ts, NULL);
+                }
+        }
+        for (k = 0, tp = thr_arr; k < started; ++k, ++tp) {
+                pthread_join(tp->tid, NULL);
+                if (tp->res && (0 == ret))
+                        ret = tp->res;
+        }
+        t_end = sg_get_monotonic_ns();
+        if (started > 0)
+                caw_report(op, thr_arr, (t_end - t_start) / 1000000000.0);
+fini:
+        if (mutex_ok)
+                pthread_mutex_destroy(&shp->mutex);
+        for (k = 0, tp = thr_arr; k < op->num_threads; ++k, ++tp) {
+                if (tp->fd >= 0)
+                        sg_cmds_close_device(tp->fd);
+                free(tp->expect);
+                free(tp->ok_lat.arr);
+                free(tp->mis_lat.arr);
+        }
+        free(thr_arr);
+        return ret;
+}
+
 
 int
 main(int argc, char * argv[])
 {
-        bool ifn_stdin;
+        bool ifn_stdin = false;
         int res, half_xlen, vb;
         int infd = -1;
         int wfd = -1;
@@ -503,6 +1096,10 @@ main(int argc, char * argv[])
                 return 0;
         }
         vb = op->verbose;
+        if (op->contend) {
+                res = do_contend(op);
+                goto out;
+        }
 
         if (vb) {
                 pr2serr("Running COMPARE AND WRITE command with the "
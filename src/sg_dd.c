@@ -1,7 +1,7 @@
 /* A utility program for copying files. Specialised for "files" that
  * represent devices that understand the SCSI command set.
  *
- * Copyright (C) 1999 - 2019 D. Gilbert and P. Allworth
+ * Copyright (C) 1999 - 2026 D. Gilbert and P. Allworth
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2, or (at your option)
@@ -43,6 +43,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -66,7 +67,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "6.07 20190618";
+static const char * version_str = "6.11 20261018";
 
 
 #define ME "sg_dd: "
@@ -112,6 +113,12 @@ static const char * version_str = "6.07 20190618";
 #define FT_BLOCK 32             /* filetype is block device */
 #define FT_FIFO 64              /* filetype is a fifo (name pipe) */
 #define FT_ERROR 128            /* couldn't "stat" file */
+#define FT_PATTERN 256          /* if=pattern:..., generated blocks */
+#define FT_VERIFY 512           /* of=verify:..., blocks checked */
+
+#define PAT_PREFIX "pattern:"
+#define VFY_PREFIX "verify:"
+#define VFY_MAX_REPORTS 10
 
 #define DEV_NULL_MINOR_NUM 3
 
@@ -166,18 +173,53 @@ struct flags_t {
     bool excl;
     bool flock;
     bool fua;
+    bool iovec;                 /* pass buffer to sg driver as an iovec */
     bool sgio;
     bool sparse;
     int cdbsz;
     int coe;
     int nocache;
     int pdt;
+    int protect;                /* RDPROTECT or WRPROTECT field value */
     int retries;
 };
 
 static struct flags_t iflag;
 static struct flags_t oflag;
 
+/* With iflag=iovec or oflag=iovec the work buffer (and the verify spare)
+ * are handed to the sg driver as iovecs. They are also allocated this way
+ * when SG3_UTILS_HUGEPAGES asks for hugepages */
+static struct sg_iov_buf iov_bufs[2];
+static sg_iovec_t * iov_arr;
+static int iov_arr_sz;
+
+struct pat_t {
+    bool rand;                  /* false -> 'seq' */
+    uint64_t seed;
+};
+
+struct vfy_t {
+    bool busy;                  /* thread owns 'bp' */
+    bool quit;
+    int blocks;
+    int bs;
+    int reports;
+    int64_t lba;
+    int64_t bad_blks;
+    int64_t first_bad;
+    uint8_t * bp;
+    uint8_t * spare;
+    uint8_t * free_spare;
+    struct pat_t pat;
+    pthread_t tid;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+};
+
+static struct pat_t in_pat;
+static struct vfy_t vfy;
+
 static void calc_duration_throughput(bool contin);
 
 
@@ -247,6 +289,187 @@ siginfo_handler(int sig)
     print_stats("  ");
 }
 
+/* Pattern source (if=pattern:...) and verify sink (of=verify:...). Each
+ * block starts with its LBA then the seed (both big endian), the rest is
+ * 8 byte words. For 'seq' word k holds the byte offset (LBA * BS + 8 * k)
+ * in big endian which is easy to read in a hex dump. For 'rand' word k is
+ * a hash of a per block key plus k; since no word depends on the previous
+ * one the fill and check loops can be vectorized by the compiler. The LBA
+ * used is the block's position in IFILE (pattern) or OFILE (verify), so
+ * a copy with the same skip and seek can be checked on read back. */
+static int
+parse_pattern(const char * arg, struct pat_t * pp)
+{
+    const char * cp = arg;
+    int64_t ll;
+
+    pp->rand = true;
+    pp->seed = 0;
+    if (0 == strncmp(arg, "seq", 3)) {
+        pp->rand = false;
+        cp += 3;
+    } else if (0 == strncmp(arg, "rand", 4))
+        cp += 4;
+    if ('\0' == *cp)
+        return 0;
+    if (':' != *cp)
+        return 1;
+    ll = sg_get_llnum(cp + 1);
+    if (ll < 0)
+        return 1;
+    pp->seed = (uint64_t)ll;
+    return 0;
+}
+
+/* splitmix64 finalizer, a good 64 bit mixing function */
+static inline uint64_t
+pat_mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t
+pat_key(const struct pat_t * pp, uint64_t lba)
+{
+    return pat_mix64(pp->seed ^ (lba * 0x9e3779b97f4a7c15ULL));
+}
+
+static void
+pat_fill(const struct pat_t * pp, uint8_t * bp, int blocks, int64_t lba,
+         int bs)
+{
+    int j, k;
+    int n = bs / 8;
+    uint64_t key, off;
+
+    for (j = 0; j < blocks; ++j, ++lba, bp += bs) {
+        sg_put_unaligned_be64((uint64_t)lba, bp + 0);
+        sg_put_unaligned_be64(pp->seed, bp + 8);
+        if (pp->rand) {
+            key = pat_key(pp, lba);
+            for (k = 2; k < n; ++k)
+                sg_put_unaligned_le64(pat_mix64(key + k), bp + (8 * k));
+        } else {
+            off = (uint64_t)lba * bs;
+            for (k = 2; k < n; ++k)
+                sg_put_unaligned_be64(off + (8 * k), bp + (8 * k));
+        }
+    }
+}
+
+/* Returns -1 if the block at 'bp' is as expected for 'lba', otherwise the
+ * byte offset of the first 8 byte word that differs */
+static int
+pat_check(const struct pat_t * pp, const uint8_t * bp, int64_t lba, int bs)
+{
+    int k;
+    int n = bs / 8;
+    uint64_t key, off;
+
+    if ((sg_get_unaligned_be64(bp + 0) != (uint64_t)lba))
+        return 0;
+    if (sg_get_unaligned_be64(bp + 8) != pp->seed)
+        return 8;
+    if (pp->rand) {
+        key = pat_key(pp, lba);
+        for (k = 2; k < n; ++k) {
+            if (sg_get_unaligned_le64(bp + (8 * k)) != pat_mix64(key + k))
+                return 8 * k;
+        }
+    } else {
+        off = (uint64_t)lba * bs;
+        for (k = 2; k < n; ++k) {
+            if (sg_get_unaligned_be64(bp + (8 * k)) != (off + (8 * k)))
+                return 8 * k;
+        }
+    }
+    return -1;
+}
+
+static void
+vfy_blocks(struct vfy_t * vp)
+{
+    int j, off;
+    int64_t lba = vp->lba;
+    uint64_t stamp;
+    const uint8_t * bp = vp->bp;
+
+    for (j = 0; j < vp->blocks; ++j, ++lba, bp += vp->bs) {
+        off = pat_check(&vp->pat, bp, lba, vp->bs);
+        if (off < 0)
+            continue;
+        if (0 == vp->bad_blks++)
+            vp->first_bad = lba;
+        if ((vp->reports >= VFY_MAX_REPORTS) && (verbose < 2))
+            continue;
+        pr2serr("verify: miscompare at LBA %" PRId64 " [0x%" PRIx64 "], "
+                "byte offset %d", lba, (uint64_t)lba, off);
+        stamp = sg_get_unaligned_be64(bp);
+        if (stamp != (uint64_t)lba)
+            pr2serr(", block is stamped with LBA 0x%" PRIx64, stamp);
+        pr2serr("\n");
+        if ((++vp->reports == VFY_MAX_REPORTS) && (verbose < 2))
+            pr2serr("verify: further miscompares not reported\n");
+    }
+}
+
+/* Second pipeline stage: checks each buffer handed over by vfy_submit()
+ * while the main loop reads the next one */
+static void *
+vfy_thread(void * v_vp)
+{
+    struct vfy_t * vp = (struct vfy_t *)v_vp;
+
+    pthread_mutex_lock(&vp->mtx);
+    while (1) {
+        while ((! vp->busy) && (! vp->quit))
+            pthread_cond_wait(&vp->cv, &vp->mtx);
+        if (! vp->busy)
+            break;
+        pthread_mutex_unlock(&vp->mtx);
+        vfy_blocks(vp);
+        pthread_mutex_lock(&vp->mtx);
+        vp->busy = false;
+        pthread_cond_broadcast(&vp->cv);
+    }
+    pthread_mutex_unlock(&vp->mtx);
+    return NULL;
+}
+
+/* Hands 'bp' to the verify thread once it has finished the previous
+ * buffer. Returns the buffer the caller should use next. */
+static uint8_t *
+vfy_submit(struct vfy_t * vp, uint8_t * bp, int blocks, int64_t lba)
+{
+    uint8_t * next_bp;
+
+    pthread_mutex_lock(&vp->mtx);
+    while (vp->busy)
+        pthread_cond_wait(&vp->cv, &vp->mtx);
+    next_bp = vp->bp ? vp->bp : vp->spare;
+    vp->bp = bp;
+    vp->blocks = blocks;
+    vp->lba = lba;
+    vp->busy = true;
+    pthread_cond_broadcast(&vp->cv);
+    pthread_mutex_unlock(&vp->mtx);
+    return next_bp;
+}
+
+static void
+vfy_finish(struct vfy_t * vp)
+{
+    pthread_mutex_lock(&vp->mtx);
+    while (vp->busy)
+        pthread_cond_wait(&vp->cv, &vp->mtx);
+    vp->quit = true;
+    pthread_cond_broadcast(&vp->cv);
+    pthread_mutex_unlock(&vp->mtx);
+    pthread_join(vp->tid, NULL);
+}
+
 static bool bsg_major_checked = false;
 static int bsg_major = 0;
 
@@ -343,6 +566,10 @@ dd_filetype_str(int ft, char * buff)
         off += sg_scnpr(buff + off, 32, "raw device ");
     if (FT_OTHER & ft)
         off += sg_scnpr(buff + off, 32, "other (perhaps ordinary file) ");
+    if (FT_PATTERN & ft)
+        off += sg_scnpr(buff + off, 32, "generated pattern ");
+    if (FT_VERIFY & ft)
+        off += sg_scnpr(buff + off, 32, "pattern verifier ");
     if (FT_ERROR & ft)
         sg_scnpr(buff + off, 32, "unable to 'stat' file ");
     return buff;
@@ -360,8 +587,10 @@ usage()
             "              [blk_sgio=0|1] [bpt=BPT] [cdbsz=6|10|12|16] "
             "[coe=0|1|2|3]\n"
             "              [coe_limit=CL] [dio=0|1] [odir=0|1] "
-            "[of2=OFILE2] [retries=RETR]\n"
-            "              [sync=0|1] [time=0|1] [verbose=VERB]\n"
+            "[of2=OFILE2] [rdprotect=RDP]\n"
+            "              [retries=RETR] [sync=0|1] [time=0|1] "
+            "[verbose=VERB]\n"
+            "              [wrprotect=WRP]\n"
             "  where:\n"
             "    blk_sgio    0->block device use normal I/O(def), 1->use "
             "SG_IO\n"
@@ -383,24 +612,32 @@ usage()
             "(def)\n"
             "    ibs         input logical block size (if given must be same "
             "as 'bs=')\n"
-            "    if          file or device to read from (def: stdin)\n"
+            "    if          file or device to read from (def: stdin), "
+            "IFILE of\n"
+            "                'pattern:rand|seq[:SEED]' generates LBA "
+            "stamped blocks\n"
             "    iflag       comma separated list from: [coe,dio,direct,"
             "dpo,dsync,excl,\n"
-            "                flock,fua,nocache,null,sgio]\n"
+            "                flock,fua,iovec,nocache,null,sgio]\n"
             "    obs         output logical block size (if given must be "
             "same as 'bs=')\n"
             "    odir        1->use O_DIRECT when opening block dev, "
             "0->don't(def)\n"
             "    of          file or device to write to (def: stdout), "
             "OFILE of '.'\n");
-    pr2serr("                treated as /dev/null\n"
+    pr2serr("                treated as /dev/null, "
+            "'verify:rand|seq[:SEED]' checks blocks\n"
+            "                against that pattern\n"
             "    of2         additional output file (def: /dev/null), "
             "OFILE2 should be\n"
             "                normal file or pipe\n"
             "    oflag       comma separated list from: [append,coe,dio,"
             "direct,dpo,\n"
-            "                dsync,excl,flock,fua,nocache,null,sgio,"
-            "sparse]\n"
+            "                dsync,excl,flock,fua,iovec,nocache,null,"
+            "sgio,sparse]\n"
+            "    rdprotect   RDPROTECT field (0 to 7) for READs, non-zero "
+            "-> read and\n"
+            "                check protection information (def: 0)\n"
             "    retries     retry sgio errors RETR times (def: 0)\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
@@ -410,6 +647,9 @@ usage()
             "throughput\n"
             "    verbose     0->quiet(def), 1->some noise, 2->more noise, "
             "etc\n"
+            "    wrprotect   WRPROTECT field (0 to 7) for WRITEs, non-zero "
+            "-> write\n"
+            "                protection information (def: 0)\n"
             "    --dry-run    do preparation but bypass copy (or read)\n"
             "    --help      print out this usage message then exit\n"
             "    --verbose   same as 'verbose=1', can be used multiple "
@@ -457,6 +697,101 @@ scsi_read_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
     return 0;
 }
 
+/* Returns protection type (1, 2 or 3) from READ CAPACITY(16) response or
+ * 0 if protection is not enabled. Negative values are SG_LIB_CAT_* errors
+ * negated. */
+static int
+scsi_read_pi_type(int sg_fd)
+{
+    int res;
+    uint8_t rcBuff[RCAP16_REPLY_LEN];
+
+    res = sg_ll_readcap_16(sg_fd, false, 0, rcBuff, RCAP16_REPLY_LEN, true,
+                           (verbose ? verbose - 1: 0));
+    if (res)
+        return (res > 0) ? -res : -1;
+    if (0 == (0x1 & rcBuff[12]))        /* PROT_EN */
+        return 0;
+    return ((rcBuff[12] >> 1) & 0x7) + 1;       /* P_TYPE + 1 */
+}
+
+/* Called when 'rdprotect=' or 'wrprotect=' (named by 'opt') is non-zero.
+ * Returns the protection type of 'fname' (1 or 3) or a negated
+ * SG_LIB_* exit status. */
+static int
+pi_setup(int fd, int ftype, const char * fname, const char * opt)
+{
+    int res;
+
+    if (! (FT_SG & ftype)) {
+        pr2serr("%s= needs %s to be a sg device (or blk_sgio=1)\n", opt,
+                fname);
+        return -SG_LIB_SYNTAX_ERROR;
+    }
+    res = scsi_read_pi_type(fd);
+    if (SG_LIB_CAT_UNIT_ATTENTION == -res)
+        res = scsi_read_pi_type(fd);
+    if (res < 0) {
+        pr2serr("%s: READ CAPACITY(16) failed on %s\n", opt, fname);
+        return (-1 == res) ? -SG_LIB_CAT_OTHER : res;
+    } else if (0 == res) {
+        pr2serr("%s: protection not enabled on %s\n", opt, fname);
+        return -SG_LIB_CAT_ILLEGAL_REQ;
+    } else if (2 == res) {
+        pr2serr("%s: %s has type 2 protection which needs 32 byte cdbs, "
+                "not supported\n", opt, fname);
+        return -SG_LIB_CAT_ILLEGAL_REQ;
+    }
+    if (verbose)
+        pr2serr("%s: %s has type %d protection\n", opt, fname, res);
+    return res;
+}
+
+/* Checks the protection information of 'blocks' blocks (each blk_sz plus
+ * 8 bytes) read from 'lba'. Reports each bad block up to a limit and
+ * returns the number of bad blocks. */
+static int
+pi_check(const uint8_t * bp, int blocks, int64_t lba, int pi_type)
+{
+    int k, idx, off;
+    int bad = 0;
+    int xbs = blk_sz + 8;
+
+    for (k = 0; k < blocks; k += idx + 1) {
+        idx = sg_pi_verify(bp + (k * xbs), blk_sz, blocks - k, lba + k,
+                           pi_type, &off);
+        if (idx < 0)
+            break;
+        if ((++bad <= VFY_MAX_REPORTS) || (verbose > 1))
+            pr2serr("PI %s tag mismatch at lba=%" PRId64 " [0x%" PRIx64
+                    "]\n", (off ? "reference" : "guard"), lba + k + idx,
+                    lba + k + idx);
+    }
+    return bad;
+}
+
+/* Removes the 8 bytes of protection information after each block */
+static void
+pi_strip(uint8_t * bp, int blocks)
+{
+    int k;
+
+    for (k = 1; k < blocks; ++k)
+        memmove(bp + (k * blk_sz), bp + (k * (blk_sz + 8)), blk_sz);
+}
+
+/* Spreads 'blocks' packed blocks out, leaving 8 bytes after each for
+ * protection information. Works from the end so nothing is overwritten
+ * before it is moved. */
+static void
+pi_expand(uint8_t * bp, int blocks)
+{
+    int k;
+
+    for (k = blocks - 1; k > 0; --k)
+        memmove(bp + (k * (blk_sz + 8)), bp + (k * blk_sz), blk_sz);
+}
+
 
 /* Return of 0 -> success, -1 -> failure. BLKGETSIZE64, BLKGETSIZE and */
 /* BLKSSZGET macros problematic (from <linux/fs.h> or <sys/mount.h>). */
@@ -508,7 +843,8 @@ read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
 
 static int
 sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
-                  int64_t start_block, bool write_true, bool fua, bool dpo)
+                  int64_t start_block, bool write_true, bool fua, bool dpo,
+                  int protect)
 {
     int sz_ind;
     int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
@@ -541,6 +877,11 @@ sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
                     "supported\n");
             return 1;
         }
+        if (protect) {
+            pr2serr(ME "for 6 byte commands, %s field not supported\n",
+                    (write_true ? "WRPROTECT" : "RDPROTECT"));
+            return 1;
+        }
         break;
     case 10:
         sz_ind = 1;
@@ -573,10 +914,32 @@ sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
                 cdb_sz);
         return 1;
     }
+    if (protect)
+        cdbp[1] |= (protect & 0x7) << 5;
     return 0;
 }
 
 
+/* Points hp at an iovec describing the blen bytes at buff, split at the
+ * chunk boundaries of whichever iov_bufs[] holds buff. If buff is in
+ * neither, hp is left pointing at buff which is contiguous anyway. */
+static void
+set_iovec(struct sg_io_hdr * hp, uint8_t * buff, int blen)
+{
+    int k, n;
+
+    for (k = 0; k < 2; ++k) {
+        n = sg_iov_buf_segs(iov_bufs + k, buff, blen, iov_arr, iov_arr_sz);
+        if (n > 0) {
+            hp->iovec_count = n;
+            hp->dxferp = iov_arr;
+            if (verbose > 3)
+                pr2serr("    iovec_count=%d for %d bytes\n", n, blen);
+            return;
+        }
+    }
+}
+
 /* 0 -> successful, SG_LIB_SYNTAX_ERROR -> unable to build cdb,
    SG_LIB_CAT_UNIT_ATTENTION -> try again,
    SG_LIB_CAT_MEDIUM_HARD_WITH_INFO -> 'io_addrp' written to,
@@ -597,7 +960,7 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
     struct sg_io_hdr io_hdr;
 
     if (sg_build_scsi_cdb(rdCmd, ifp->cdbsz, blocks, from_block, false,
-                          ifp->fua, ifp->dpo)) {
+                          ifp->fua, ifp->dpo, ifp->protect)) {
         pr2serr(ME "bad rd cdb build, from_block=%" PRId64 ", blocks=%d\n",
                 from_block, blocks);
         return SG_LIB_SYNTAX_ERROR;
@@ -616,6 +979,8 @@ sg_read_low(int sg_fd, uint8_t * buff, int blocks, int64_t from_block,
     io_hdr.pack_id = (int)++glob_pack_id;
     if (diop && *diop)
         io_hdr.flags |= SG_FLAG_DIRECT_IO;
+    if (ifp->iovec)
+        set_iovec(&io_hdr, buff, bs * blocks);
 
     if (verbose > 2) {
         pr2serr("    read cdb: ");
@@ -1002,7 +1367,7 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
     struct sg_io_hdr io_hdr;
 
     if (sg_build_scsi_cdb(wrCmd, ofp->cdbsz, blocks, to_block, true, ofp->fua,
-                          ofp->dpo)) {
+                          ofp->dpo, ofp->protect)) {
         pr2serr(ME "bad wr cdb build, to_block=%" PRId64 ", blocks=%d\n",
                 to_block, blocks);
         return SG_LIB_SYNTAX_ERROR;
@@ -1021,6 +1386,8 @@ sg_write(int sg_fd, uint8_t * buff, int blocks, int64_t to_block,
     io_hdr.pack_id = (int)++glob_pack_id;
     if (diop && *diop)
         io_hdr.flags |= SG_FLAG_DIRECT_IO;
+    if (ofp->iovec)
+        set_iovec(&io_hdr, buff, bs * blocks);
 
     if (verbose > 2) {
         pr2serr("    write cdb: ");
@@ -1152,6 +1519,8 @@ process_flags(const char * arg, struct flags_t * fp)
             fp->flock = true;
         else if (0 == strcmp(cp, "fua"))
             fp->fua = true;
+        else if (0 == strcmp(cp, "iovec"))
+            fp->iovec = true;
         else if (0 == strcmp(cp, "nocache"))
             ++fp->nocache;
         else if (0 == strcmp(cp, "null"))
@@ -1504,15 +1873,18 @@ main(int argc, char * argv[])
     bool sparse_skip = false;
     bool verbose_given = false;
     bool version_given = false;
+    bool vfy_started = false;
     int res, k, n, t, buf_sz, blocks_per, infd, outfd, out2fd, keylen;
     int retries_tmp, blks_read, bytes_read, bytes_of2, bytes_of;
-    int in_sect_sz, out_sect_sz;
+    int in_sect_sz, out_sect_sz, in_xbs, out_xbs, xbs;
     int blocks = 0;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
     int dio_incomplete_count = 0;
     int ibs = 0;
+    int in_pi_type = 0;
     int in_type = FT_OTHER;
     int obs = 0;
+    int out_pi_type = 0;
     int out_type = FT_OTHER;
     int out2_type = FT_OTHER;
     int penult_blocks = 0;
@@ -1522,6 +1894,7 @@ main(int argc, char * argv[])
     int64_t out2_off = 0;
     int64_t in_num_sect = -1;
     int64_t out_num_sect = -1;
+    int64_t pi_bad_blks = 0;
     char * key;
     char * buf;
     uint8_t * wrkBuff;
@@ -1645,6 +2018,12 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'oflag='\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key, "rdprotect")) {
+            iflag.protect = sg_get_num(buf);
+            if ((iflag.protect < 0) || (iflag.protect > 7)) {
+                pr2serr(ME "bad argument to 'rdprotect=', expect 0 to 7\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "retries")) {
             iflag.retries = sg_get_num(buf);
             oflag.retries = iflag.retries;
@@ -1670,7 +2049,13 @@ main(int argc, char * argv[])
             do_time = !! sg_get_num(buf);
         else if (0 == strncmp(key, "verb", 4))
             verbose = sg_get_num(buf);
-        else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
+        else if (0 == strcmp(key, "wrprotect")) {
+            oflag.protect = sg_get_num(buf);
+            if ((oflag.protect < 0) || (oflag.protect > 7)) {
+                pr2serr(ME "bad argument to 'wrprotect=', expect 0 to 7\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
             res = 0;
             n = num_chs_in_str(key + 1, keylen - 1, 'd');
             dry_run += n;
@@ -1755,6 +2140,11 @@ main(int argc, char * argv[])
         pr2serr("Can't use both append and seek switches\n");
         return SG_LIB_CONTRADICT;
     }
+    if ((iflag.iovec && iflag.dio) || (oflag.iovec && oflag.dio)) {
+        pr2serr("Can't use both iovec and dio, the sg driver does not do "
+                "direct IO on iovecs\n");
+        return SG_LIB_CONTRADICT;
+    }
     if (bpt < 1) {
         pr2serr("bpt must be greater than 0\n");
         return SG_LIB_SYNTAX_ERROR;
@@ -1780,17 +2170,38 @@ main(int argc, char * argv[])
     outfd = STDOUT_FILENO;
     iflag.pdt = -1;
     oflag.pdt = -1;
-    if (inf[0] && ('-' != inf[0])) {
+    if (0 == strncmp(inf, PAT_PREFIX, sizeof(PAT_PREFIX) - 1)) {
+        if (parse_pattern(inf + sizeof(PAT_PREFIX) - 1, &in_pat)) {
+            pr2serr(ME "bad argument to 'if=%s', expect "
+                    "rand|seq[:SEED]\n", PAT_PREFIX);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        in_type = FT_PATTERN;
+        infd = -1;
+    } else if (inf[0] && ('-' != inf[0])) {
         infd = open_if(inf, skip, bpt, &iflag, &in_type, verbose);
         if (infd < 0)
             return -infd;
     }
 
-    if (outf[0] && ('-' != outf[0])) {
+    if (0 == strncmp(outf, VFY_PREFIX, sizeof(VFY_PREFIX) - 1)) {
+        if (parse_pattern(outf + sizeof(VFY_PREFIX) - 1, &vfy.pat)) {
+            pr2serr(ME "bad argument to 'of=%s', expect "
+                    "rand|seq[:SEED]\n", VFY_PREFIX);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        out_type = FT_VERIFY;
+        outfd = -1;
+    } else if (outf[0] && ('-' != outf[0])) {
         outfd = open_of(outf, seek, bpt, &oflag, &out_type, verbose);
         if (outfd < -1)
             return -outfd;
     }
+    if (((FT_PATTERN & in_type) || (FT_VERIFY & out_type)) &&
+        (blk_sz % 8)) {
+        pr2serr("pattern and verify need 'bs' to be a multiple of 8\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
 
     if (out2f[0]) {
         out2_type = dd_filetype(out2f);
@@ -1810,7 +2221,7 @@ main(int argc, char * argv[])
         return SG_LIB_CONTRADICT;
     }
     if (oflag.sparse) {
-        if (STDOUT_FILENO == outfd) {
+        if ((STDOUT_FILENO == outfd) || (FT_VERIFY & out_type)) {
             pr2serr("oflag=sparse needs seekable output file\n");
             return SG_LIB_CONTRADICT;
         }
@@ -1922,17 +2333,48 @@ main(int argc, char * argv[])
             oflag.cdbsz = MAX_SCSI_CDBSZ;
         }
     }
-
-    if (iflag.dio || iflag.direct || oflag.direct || (FT_RAW & in_type) ||
-        (FT_RAW & out_type)) {  /* want heap buffer aligned to page_size */
-
-        wrkPos = sg_memalign(blk_sz * bpt, 0, &wrkBuff, false);
+    in_xbs = blk_sz;
+    out_xbs = blk_sz;
+    if (iflag.protect) {
+        in_pi_type = pi_setup(infd, in_type, inf, "rdprotect");
+        if (in_pi_type < 0)
+            return -in_pi_type;
+        in_xbs = blk_sz + 8;
+    }
+    if (oflag.protect) {
+        if (oflag.sparse) {
+            pr2serr("oflag=sparse and wrprotect= contradict\n");
+            return SG_LIB_CONTRADICT;
+        }
+        out_pi_type = pi_setup(outfd, out_type, outf, "wrprotect");
+        if (out_pi_type < 0)
+            return -out_pi_type;
+        out_xbs = blk_sz + 8;
+    }
+    /* room for protection information if either side has it */
+    xbs = (in_xbs > out_xbs) ? in_xbs : out_xbs;
+
+    if (iflag.iovec || oflag.iovec ||
+        (SG_LIB_HP_NONE != sg_get_hugepage_mode())) {
+        /* chunked buffer, also page aligned and contiguous */
+        wrkBuff = NULL;
+        wrkPos = sg_iov_buf_alloc(iov_bufs + 0, xbs * bpt, 0, verbose > 0);
+        iov_arr_sz = iov_bufs[0].num_chunks + 1;
+        iov_arr = (sg_iovec_t *)calloc(iov_arr_sz, sizeof(sg_iovec_t));
+        if ((NULL == wrkPos) || (NULL == iov_arr)) {
+            pr2serr("iovec buffer: error, out of memory?\n");
+            return sg_convert_errno(ENOMEM);
+        }
+    } else if (iflag.dio || iflag.direct || oflag.direct ||
+               (FT_RAW & in_type) || (FT_RAW & out_type)) {
+        /* want heap buffer aligned to page_size */
+        wrkPos = sg_memalign(xbs * bpt, 0, &wrkBuff, false);
         if (NULL == wrkPos) {
             pr2serr("sg_memalign: error, out of memory?\n");
             return sg_convert_errno(ENOMEM);
         }
     } else {
-        wrkPos = sg_memalign(blk_sz * bpt, 0, &wrkBuff, false);
+        wrkPos = sg_memalign(xbs * bpt, 0, &wrkBuff, false);
         if (0 == wrkPos) {
             pr2serr("Not enough user memory\n");
             return sg_convert_errno(ENOMEM);
@@ -1956,6 +2398,29 @@ main(int argc, char * argv[])
         pr2serr("Since --dry-run option given, bypassing copy\n");
         goto bypass_copy;
     }
+    if (FT_VERIFY & out_type) {
+        /* verify thread checks one buffer while the next is read */
+        vfy.bs = blk_sz;
+        vfy.first_bad = -1;
+        if (iov_arr)
+            vfy.spare = sg_iov_buf_alloc(iov_bufs + 1, xbs * bpt, 0, false);
+        else
+            vfy.spare = sg_memalign(xbs * bpt, 0, &vfy.free_spare, false);
+        if (NULL == vfy.spare) {
+            pr2serr("Not enough user memory\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto bypass_copy;
+        }
+        pthread_mutex_init(&vfy.mtx, NULL);
+        pthread_cond_init(&vfy.cv, NULL);
+        res = pthread_create(&vfy.tid, NULL, vfy_thread, &vfy);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            ret = sg_convert_errno(res);
+            goto bypass_copy;
+        }
+        vfy_started = true;
+    }
 
     /* <<< main loop that does the copy >>> */
     while (dd_count > 0) {
@@ -1968,7 +2433,7 @@ main(int argc, char * argv[])
         blocks = (dd_count > blocks_per) ? blocks_per : dd_count;
         if (FT_SG & in_type) {
             dio_tmp = iflag.dio;
-            res = sg_read(infd, wrkPos, blocks, skip, blk_sz, &iflag,
+            res = sg_read(infd, wrkPos, blocks, skip, in_xbs, &iflag,
                           &dio_tmp, &blks_read);
             if (-2 == res) {     /* ENOMEM, find what's available+try that */
                 if (ioctl(infd, SG_GET_RESERVED_SIZE, &buf_sz) < 0) {
@@ -1978,12 +2443,12 @@ main(int argc, char * argv[])
                 }
                 if (buf_sz < MIN_RESERVED_SIZE)
                     buf_sz = MIN_RESERVED_SIZE;
-                blocks_per = (buf_sz + blk_sz - 1) / blk_sz;
+                blocks_per = (buf_sz + in_xbs - 1) / in_xbs;
                 if (blocks_per < blocks) {
                     blocks = blocks_per;
                     pr2serr("Reducing read to %d blocks per loop\n",
                             blocks_per);
-                    res = sg_read(infd, wrkPos, blocks, skip, blk_sz,
+                    res = sg_read(infd, wrkPos, blocks, skip, in_xbs,
                                   &iflag, &dio_tmp, &blks_read);
                 }
             }
@@ -2002,6 +2467,9 @@ main(int argc, char * argv[])
                 if (iflag.dio && (! dio_tmp))
                     dio_incomplete_count++;
             }
+        } else if (FT_PATTERN & in_type) {
+            pat_fill(&in_pat, wrkPos, blocks, skip, blk_sz);
+            in_full += blocks;
         } else {
             while (((res = read(infd, wrkPos, blocks * blk_sz)) < 0) &&
                    ((EINTR == errno) || (EAGAIN == errno)))
@@ -2030,13 +2498,31 @@ main(int argc, char * argv[])
         if (0 == blocks)
             break;      /* nothing read so leave loop */
 
+        if (in_pi_type) {
+            n = pi_check(wrkPos, blocks, skip, in_pi_type);
+            pi_bad_blks += n;
+            if ((n > 0) && (! iflag.coe)) {
+                ret = SG_LIB_CAT_PROTECTION;
+                break;
+            }
+            if (out_pi_type) {  /* keep guard and app tags, new ref tags */
+                for (k = 0; k < blocks; ++k)
+                    sg_put_unaligned_be32((uint32_t)(seek + k),
+                                          wrkPos + (k * xbs) + blk_sz + 4);
+            } else
+                pi_strip(wrkPos, blocks);
+        } else if (out_pi_type) {
+            pi_expand(wrkPos, blocks);
+            sg_pi_generate(wrkPos, blk_sz, blocks, seek, 0, out_pi_type);
+        }
+
         if (out2f[0]) {
-            while (((res = write(out2fd, wrkPos, blocks * blk_sz)) < 0) &&
+            while (((res = write(out2fd, wrkPos, blocks * out_xbs)) < 0) &&
                    ((EINTR == errno) || (EAGAIN == errno)))
                 ;
             if (verbose > 2)
-                pr2serr("write to of2: count=%d, res=%d\n", blocks * blk_sz,
-                        res);
+                pr2serr("write to of2: count=%d, res=%d\n",
+                        blocks * out_xbs, res);
             if (res < 0) {
                 snprintf(ebuff, EBUFF_SZ, ME "writing to of2, seek=%" PRId64
                          " ", seek);
@@ -2096,7 +2582,7 @@ main(int argc, char * argv[])
             retries_tmp = oflag.retries;
             first = true;
             while (1) {
-                ret = sg_write(outfd, wrkPos, blocks, seek, blk_sz,
+                ret = sg_write(outfd, wrkPos, blocks, seek, out_xbs,
                                &oflag, &dio_tmp);
                 if (0 == ret)
                     break;
@@ -2111,7 +2597,7 @@ main(int argc, char * argv[])
                     }
                     if (buf_sz < MIN_RESERVED_SIZE)
                         buf_sz = MIN_RESERVED_SIZE;
-                    blocks_per = (buf_sz + blk_sz - 1) / blk_sz;
+                    blocks_per = (buf_sz + out_xbs - 1) / out_xbs;
                     if (blocks_per < blocks) {
                         blocks = blocks_per;
                         pr2serr("Reducing write to %d blocks per loop\n",
@@ -2154,6 +2640,9 @@ main(int argc, char * argv[])
                 if (oflag.dio && (! dio_tmp))
                     dio_incomplete_count++;
             }
+        } else if (FT_VERIFY & out_type) {
+            wrkPos = vfy_submit(&vfy, wrkPos, blocks, seek);
+            out_full += blocks;
         } else if (FT_DEV_NULL & out_type)
             out_full += blocks; /* act as if written out without error */
         else {
@@ -2254,13 +2743,20 @@ main(int argc, char * argv[])
     }
 
 bypass_copy:
+    if (vfy_started)
+        vfy_finish(&vfy);
     if (do_time)
         calc_duration_throughput(false);
 
     free(wrkBuff);
+    if (vfy.free_spare)
+        free(vfy.free_spare);
+    sg_iov_buf_free(iov_bufs + 0);
+    sg_iov_buf_free(iov_bufs + 1);
+    free(iov_arr);
     if (free_zeros_buff)
         free(free_zeros_buff);
-    if (STDIN_FILENO != infd)
+    if ((STDIN_FILENO != infd) && (infd >= 0))
         close(infd);
     if (! ((STDOUT_FILENO == outfd) || (FT_DEV_NULL & out_type)))
         close(outfd);
@@ -2273,6 +2769,23 @@ bypass_copy:
             ret = SG_LIB_CAT_OTHER;
     }
     print_stats("");
+    if (vfy_started) {
+        pr2serr("verify: %" PRId64 " blocks checked, %" PRId64 " "
+                "miscompared", out_full, vfy.bad_blks);
+        if (vfy.bad_blks > 0) {
+            pr2serr(", first at LBA %" PRId64 " [0x%" PRIx64 "]",
+                    vfy.first_bad, (uint64_t)vfy.first_bad);
+            if (0 == ret)
+                ret = SG_LIB_CAT_MISCOMPARE;
+        }
+        pr2serr("\n");
+    }
+    if (pi_bad_blks > 0) {
+        pr2serr(">> %" PRId64 " blocks failed protection information "
+                "checks\n", pi_bad_blks);
+        if (0 == ret)
+            ret = SG_LIB_CAT_PROTECTION;
+    }
     if (dio_incomplete_count) {
         int fd;
         char c;
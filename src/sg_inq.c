@@ -1,5 +1,5 @@
 /* A utility program originally written for the Linux OS SCSI subsystem.
- * Copyright (C) 2000-2019 D. Gilbert
+ * Copyright (C) 2000-2026 D. Gilbert
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2, or (at your option)
@@ -51,7 +51,7 @@
 #include "sg_pt_nvme.h"
 #endif
 
-static const char * version_str = "2.02 20190815";    /* SPC-5 rev 22 */
+static const char * version_str = "2.03 20261018";    /* SPC-5 rev 22 */
 
 /* INQUIRY notes:
  * It is recommended that the initial allocation length given to a
@@ -115,6 +115,8 @@ static const char * version_str = "2.02 20190815";    /* SPC-5 rev 22 */
 
 #define VPD_NOPE_WANT_STD_INQ -2        /* request for standard inquiry */
 
+#define MX_EXPORT_ITEMS 8       /* --export: max --inhex= or --page= list */
+
 /* Vendor specific VPD pages (typically >= 0xc0) */
 #define VPD_UPR_EMC 0xc0
 #define VPD_RDAC_VERS 0xc2
@@ -278,7 +280,11 @@ struct opts_t {
     int num_pages;
     const char * page_arg;
     const char * device_name;
-    const char * inhex_fn;
+    const char * inhex_fn;      /* first (or only) --inhex= argument */
+    int num_inhex;
+    int num_export_pns;
+    const char * inhex_arr[MX_EXPORT_ITEMS];
+    int export_pns[MX_EXPORT_ITEMS];
 #ifdef SG_SCSI_STRINGS
     bool opt_new;
 #endif
@@ -324,7 +330,10 @@ usage()
             "format.\n"
             "                    Defaults to device id page (0x83) if --page "
             "not given,\n"
-            "                    only supported for VPD pages 0x80 and 0x83\n"
+            "                    only supported for VPD pages 0x80 and 0x83; "
+            "accepts\n"
+            "                    a --page= list and repeated --inhex= "
+            "options\n"
             "    --extended|-E|-x    decode extended INQUIRY data VPD page "
             "(0x86)\n"
             "    --force|-f      skip VPD page 0 check; directly fetch "
@@ -336,7 +345,8 @@ usage()
             "    --inhex=FN|-I FN    read ASCII hex from file FN instead of "
             "DEVICE;\n"
             "                        if used with --raw then read binary "
-            "from FN\n"
+            "from FN;\n"
+            "                        may be repeated when --export given\n"
             "    --len=LEN|-l LEN    requested response length (def: 0 "
             "-> fetch 36\n"
             "                        bytes first, then fetch again as "
@@ -351,7 +361,9 @@ usage()
             "    --page=PG|-p PG     Vital Product Data (VPD) page number "
             "or\n"
             "                        abbreviation (opcode number if "
-            "'--cmddt' given)\n"
+            "'--cmddt' given);\n"
+            "                        with --export PG may be a comma "
+            "separated list\n"
             "    --raw|-r        output response in binary (to stdout)\n"
             "    --vendor|-s     show vendor specific fields in std "
             "inquiry\n"
@@ -536,7 +548,13 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
             op->page_given = true;
             break;
         case 'I':
-            op->inhex_fn = optarg;
+            if (op->num_inhex >= MX_EXPORT_ITEMS) {
+                pr2serr("too many '--inhex=' options, max is %d\n",
+                        MX_EXPORT_ITEMS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->inhex_arr[op->num_inhex++] = optarg;
+            op->inhex_fn = op->inhex_arr[0];
             break;
         case 'l':
         case 'm':
@@ -747,8 +765,11 @@ old_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
                     return SG_LIB_SYNTAX_ERROR;
                 }
                 op->do_block = n;
-            } else if (0 == strncmp("I=", cp, 2))
-                op->inhex_fn = cp + 2;
+            } else if (0 == strncmp("I=", cp, 2)) {
+                op->inhex_arr[0] = cp + 2;
+                op->inhex_fn = op->inhex_arr[0];
+                op->num_inhex = 1;
+            }
             else if (0 == strncmp("l=", cp, 2)) {
                 num = sscanf(cp + 2, "%d", &n);
                 if ((1 != num) || (n < 1)) {
@@ -4050,6 +4071,223 @@ err_out:
 }
 #endif          /* (HAVE_NVME && (! IGNORE_NVME)) */
 
+/* Examines the response held in rsp_buff (read via --inhex=) and, if the
+ * page has not been given, guesses whether it is a standard INQUIRY
+ * response or a VPD page. */
+static void
+inhex_guess_page(struct opts_t * op)
+{
+    if (-1 == op->page_num) {       /* may be able to deduce VPD page */
+        if (op->page_pdt < 0)
+            op->page_pdt = 0x1f & rsp_buff[0];
+        if ((0x2 == (0xf & rsp_buff[3])) && (rsp_buff[2] > 2)) {
+            if (op->verbose)
+                pr2serr("Guessing from --inhex= this is a standard "
+                        "INQUIRY\n");
+        } else if (rsp_buff[2] <= 2) {
+            /*
+             * Removable devices have the RMB bit set, which would
+             * present itself as vpd page 0x80 output if we're not
+             * careful
+             *
+             * Serial number must be right-aligned ASCII data in
+             * bytes 5-7; standard INQUIRY will have flags here.
+             */
+            if (rsp_buff[1] == 0x80 &&
+                (rsp_buff[5] < 0x20 || rsp_buff[5] > 0x80 ||
+                 rsp_buff[6] < 0x20 || rsp_buff[6] > 0x80 ||
+                 rsp_buff[7] < 0x20 || rsp_buff[7] > 0x80)) {
+                if (op->verbose)
+                    pr2serr("Guessing from --inhex= this is a "
+                            "standard INQUIRY\n");
+            } else {
+                if (op->verbose)
+                    pr2serr("Guessing from --inhex= this is VPD "
+                            "page 0x%x\n", rsp_buff[1]);
+                op->page_num = rsp_buff[1];
+                op->do_vpd = true;
+                if ((1 != op->do_hex) && (0 == op->do_raw))
+                    op->do_decode = true;
+            }
+        } else {
+            if (op->verbose)
+                pr2serr("page number unclear from --inhex, hope it's a "
+                        "standard INQUIRY\n");
+        }
+    }
+
+}
+
+/* Parses a comma separated list given to --page= (only used with
+ * --export). List elements may be 'sinq' (standard INQUIRY), 'sn' (0x80)
+ * or 'di' (0x83), or their numeric equivalents. Returns 0 if okay. */
+static int
+parse_export_pages(struct opts_t * op)
+{
+    int n;
+    const char * cp;
+    const char * ncp;
+    const struct svpd_values_name_t * vnp;
+    char b[32];
+
+    for (cp = op->page_arg; cp && *cp; cp = ncp ? (ncp + 1) : NULL) {
+        ncp = strchr(cp, ',');
+        n = ncp ? (ncp - cp) : (int)strlen(cp);
+        if ((n < 1) || (n >= (int)sizeof(b))) {
+            pr2serr("bad element in list given to '--page='\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        memcpy(b, cp, n);
+        b[n] = '\0';
+        if (op->num_export_pns >= MX_EXPORT_ITEMS) {
+            pr2serr("too many pages in list given to '--page=', max is "
+                    "%d\n", MX_EXPORT_ITEMS);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if (isalpha(b[0])) {
+            vnp = sdp_find_vpd_by_acron(b);
+            if (NULL == vnp) {
+                pr2serr("abbreviation %s given to '--page=' not "
+                        "recognized\n", b);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            n = vnp->value;
+        } else {
+            n = sg_get_num(b);
+            if ((n < 0) || (n > 255)) {
+                pr2serr("Bad element '%s' given to '--page=', expecting 0 "
+                        "to 255 inclusive\n", b);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        }
+        if ((VPD_NOPE_WANT_STD_INQ != n) && (VPD_DEVICE_ID != n) &&
+            (VPD_UNIT_SERIAL_NUM != n)) {
+            pr2serr("Option '--export' only supported for the standard "
+                    "INQUIRY and\nVPD pages 0x80 and 0x83\n");
+            return SG_LIB_CONTRADICT;
+        }
+        op->export_pns[op->num_export_pns++] = n;
+    }
+    return 0;
+}
+
+/* Decodes several --inhex= files in --export format; intended for udev
+ * which has the kernel's sysfs copies of the standard INQUIRY response
+ * and VPD pages 0x80 and 0x83. The first file dictates the exit status,
+ * later files that are absent (e.g. page not supported) or fail to decode
+ * are skipped. */
+static int
+export_inhex_multi(const struct opts_t * op)
+{
+    int k, err, inhex_len;
+    int ret = 0;
+    const char * fn;
+    struct opts_t a_opts;
+    struct opts_t * aop = &a_opts;
+
+    for (k = 0; k < op->num_inhex; ++k) {
+        fn = op->inhex_arr[k];
+        if ((k > 0) && access(fn, R_OK)) {
+            if (op->verbose)
+                pr2serr("skipping --inhex=%s: %s\n", fn,
+                        safe_strerror(errno));
+            continue;
+        }
+        *aop = *op;
+        aop->inhex_fn = fn;
+        aop->page_num = -1;
+        inhex_len = 0;
+        err = sg_f2hex_arr(fn, !!op->do_raw, false, rsp_buff, &inhex_len,
+                           rsp_buff_sz);
+        if (err) {
+            if (err < 0)
+                err = sg_convert_errno(-err);
+            if (0 == k)
+                return err;
+            continue;
+        }
+        aop->do_raw = 0;
+        inhex_guess_page(aop);
+        if (-1 == aop->page_num)
+            err = std_inq_process(-1, aop, inhex_len);
+        else if ((VPD_DEVICE_ID == aop->page_num) ||
+                 (VPD_UNIT_SERIAL_NUM == aop->page_num)) {
+            aop->do_decode = true;
+            err = vpd_decode(-1, aop, inhex_len);
+        } else {
+            pr2serr("--inhex=%s: VPD page 0x%x not supported by "
+                    "'--export'\n", fn, aop->page_num);
+            err = SG_LIB_CONTRADICT;
+        }
+        if (0 == k)
+            ret = err;
+        else if (err && op->verbose)
+            pr2serr("--inhex=%s: decode failed, skipped\n", fn);
+    }
+    return ret;
+}
+
+/* Handles --export with a list given to --page= using the one open file
+ * descriptor. The supported VPD pages page is fetched (at most) once
+ * rather than once per VPD page. The first page in the list dictates the
+ * exit status; later pages that are not supported or fail are skipped
+ * so udev still imports what was found. */
+static int
+export_dev_multi(int sg_fd, const struct opts_t * op)
+{
+    bool have_supp = false;
+    int k, pn, res, supp_len;
+    int ret = 0;
+    int vb = op->verbose;
+    struct opts_t a_opts;
+    struct opts_t * aop = &a_opts;
+    uint8_t supp[512];
+
+    for (k = 0; k < op->num_export_pns; ++k) {
+        pn = op->export_pns[k];
+        *aop = *op;
+        memset(rsp_buff, 0, rsp_buff_sz);
+        if (VPD_NOPE_WANT_STD_INQ == pn) {
+            aop->page_num = -1;
+            aop->do_vpd = false;
+            res = std_inq_process(sg_fd, aop, -1);
+        } else {
+            if ((! op->do_force) && (! have_supp)) {
+                res = vpd_fetch_page_from_dev(sg_fd, rsp_buff,
+                                              VPD_SUPPORTED_VPDS,
+                                              op->resp_len, vb, &supp_len);
+                if (res) {
+                    if (vb)
+                        pr2serr("unable to fetch supported VPD pages, "
+                                "skip other VPD pages\n");
+                    return (0 == k) ? res : ret;
+                }
+                if (supp_len > (int)sizeof(supp))
+                    supp_len = sizeof(supp);
+                memcpy(supp, rsp_buff, supp_len);
+                have_supp = true;
+            }
+            if (have_supp && vpd_page_not_supported(supp, supp_len, pn,
+                                                    vb)) {
+                if (vb)
+                    pr2serr("VPD page 0x%x not supported, skipped\n", pn);
+                res = sg_convert_errno(EDOM);
+            } else {
+                aop->page_num = pn;
+                aop->do_vpd = true;
+                aop->do_decode = true;
+                aop->do_force = true;   /* page 0 check done above */
+                res = vpd_decode(sg_fd, aop, -1);
+            }
+        }
+        if (0 == k)
+            ret = res;
+        else if (res && vb)
+            pr2serr("page 0x%x failed, skipped\n", 0xff & pn);
+    }
+    return ret;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -4099,6 +4337,32 @@ main(int argc, char * argv[])
         pr2serr("Version string: %s\n", version_str);
         return 0;
     }
+    if (op->num_inhex > 1) {
+        if (! op->do_export) {
+            pr2serr("Repeated '--inhex=' options need '--export'\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->page_arg) {
+            pr2serr("Don't support '--page=' with repeated '--inhex=' "
+                    "options\n");
+            return SG_LIB_CONTRADICT;
+        }
+    }
+    if (op->page_arg && strchr(op->page_arg, ',')) {
+        if (! op->do_export) {
+            pr2serr("A list given to '--page=' needs '--export'\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->inhex_fn || (op->page_num >= 0)) {
+            pr2serr("A list given to '--page=' needs a DEVICE and no "
+                    "other page option\n");
+            return SG_LIB_CONTRADICT;
+        }
+        res = parse_export_pages(op);
+        if (res)
+            return res;
+        op->page_arg = NULL;
+    }
     if (op->page_arg) {
         if (op->page_num >= 0) {
             pr2serr("Given '-p' option and another option that "
@@ -4185,6 +4449,10 @@ main(int argc, char * argv[])
             ret = SG_LIB_CONTRADICT;
             goto err_out;
         }
+        if (op->num_inhex > 1) {
+            ret = export_inhex_multi(op);
+            goto err_out;
+        }
         err = sg_f2hex_arr(op->inhex_fn, !!op->do_raw, false, rsp_buff,
                            &inhex_len, rsp_buff_sz);
         if (err) {
@@ -4194,44 +4462,7 @@ main(int argc, char * argv[])
             goto err_out;
         }
         op->do_raw = 0;         /* don't want raw on output with --inhex= */
-        if (-1 == op->page_num) {       /* may be able to deduce VPD page */
-            if (op->page_pdt < 0)
-                op->page_pdt = 0x1f & rsp_buff[0];
-            if ((0x2 == (0xf & rsp_buff[3])) && (rsp_buff[2] > 2)) {
-                if (op->verbose)
-                    pr2serr("Guessing from --inhex= this is a standard "
-                            "INQUIRY\n");
-            } else if (rsp_buff[2] <= 2) {
-                /*
-                 * Removable devices have the RMB bit set, which would
-                 * present itself as vpd page 0x80 output if we're not
-                 * careful
-                 *
-                 * Serial number must be right-aligned ASCII data in
-                 * bytes 5-7; standard INQUIRY will have flags here.
-                 */
-                if (rsp_buff[1] == 0x80 &&
-                    (rsp_buff[5] < 0x20 || rsp_buff[5] > 0x80 ||
-                     rsp_buff[6] < 0x20 || rsp_buff[6] > 0x80 ||
-                     rsp_buff[7] < 0x20 || rsp_buff[7] > 0x80)) {
-                    if (op->verbose)
-                        pr2serr("Guessing from --inhex= this is a "
-                                "standard INQUIRY\n");
-                } else {
-                    if (op->verbose)
-                        pr2serr("Guessing from --inhex= this is VPD "
-                                "page 0x%x\n", rsp_buff[1]);
-                    op->page_num = rsp_buff[1];
-                    op->do_vpd = true;
-                    if ((1 != op->do_hex) && (0 == op->do_raw))
-                        op->do_decode = true;
-                }
-            } else {
-                if (op->verbose)
-                    pr2serr("page number unclear from --inhex, hope it's a "
-                            "standard INQUIRY\n");
-            }
-        }
+        inhex_guess_page(op);
     } else if (0 == op->device_name) {
         pr2serr("No DEVICE argument given\n\n");
         usage_for(op);
@@ -4400,6 +4631,10 @@ main(int argc, char * argv[])
     }
 #endif
 
+    if (op->num_export_pns > 0) {
+        ret = export_dev_multi(sg_fd, op);
+        goto err_out;
+    }
     if ((! op->do_cmddt) && (! op->do_vpd)) {
         /* So it's a standard INQUIRY, try ATA IDENTIFY if that fails */
         ret = std_inq_process(sg_fd, op, -1);
@@ -28,6 +28,24 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+#include <time.h>
+#elif defined(HAVE_GETTIMEOFDAY)
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#if defined(MSC_VER) || defined(__MINGW32__)
+#define HAVE_MS_SLEEP
+#endif
+
+#ifdef HAVE_MS_SLEEP
+#include <windows.h>
+#define sleep_for(seconds)    Sleep( (seconds) * 1000)
+#else
+#define sleep_for(seconds)    sleep(seconds)
+#endif
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #ifdef SG_LIB_WIN32
@@ -36,7 +54,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.77 20190822";    /* spc5r22 + sbc4r17 */
+static const char * version_str = "1.79 20261018";    /* spc5r22 + sbc4r17 */
 
 #define MX_ALLOC_LEN (0xfffc)
 #define SHORT_RESP_LEN 128
@@ -108,6 +126,7 @@ static const char * version_str = "1.77 20190822";    /* spc5r22 + sbc4r17 */
 
 #define LOG_SENSE_PROBE_ALLOC_LEN 4
 #define LOG_SENSE_DEF_TIMEOUT 64        /* seconds */
+#define MX_LP_CTRS 2048                 /* max counters in --interval mode */
 
 static uint8_t * rsp_buff;
 static uint8_t * free_rsp_buff;
@@ -119,12 +138,14 @@ static struct option long_options[] = {
         {"all", no_argument, 0, 'a'},
         {"brief", no_argument, 0, 'b'},
         {"control", required_argument, 0, 'c'},
+        {"count", required_argument, 0, 'C'},
         {"enumerate", no_argument, 0, 'e'},
         {"filter", required_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
         {"in", required_argument, 0, 'i'},
         {"inhex", required_argument, 0, 'i'},
+        {"interval", required_argument, 0, 'I'},
         {"list", no_argument, 0, 'l'},
         {"maxlen", required_argument, 0, 'm'},
         {"name", no_argument, 0, 'n'},
@@ -171,6 +192,8 @@ struct opts_t {
     int do_help;
     int do_hex;
     int do_list;
+    int interval;       /* seconds between samples; 0 -> single fetch */
+    int count;          /* number of samples with --interval; 0 -> forever */
     int vend_prod_num;  /* one of the VP_* constants or -1 (def) */
     int deduced_vpn;    /* deduced vendor_prod_num; from INQUIRY, etc */
     int verbose;
@@ -491,9 +514,10 @@ usage(int hval)
     if (1 == hval) {
         pr2serr(
            "Usage: sg_logs [-All] [--all] [--brief] [--control=PC] "
-           "[--enumerate]\n"
-           "               [--filter=FL] [--help] [--hex] [--in=FN] "
-           "[--list]\n"
+           "[--count=CNT]\n"
+           "               [--enumerate] [--filter=FL] [--help] [--hex] "
+           "[--in=FN]\n"
+           "               [--interval=SECS] [--list]\n"
            "               [--no_inq] [--maxlen=LEN] [--name] [--page=PG]\n"
            "               [--paramp=PP] [--pcb] [--ppc] [--pdt=DT] "
            "[--raw]\n"
@@ -510,6 +534,9 @@ usage(int hval)
            "                    twice to fetch and decode all log pages "
            "and subpages\n"
            "    --brief|-b      shorten the output of some log pages\n"
+           "    --count=CNT|-C CNT    number of intervals to sample with "
+           "--interval\n"
+           "                          (def: 0 -> until interrupted)\n"
            "    --enumerate|-e    enumerate known pages, ignore DEVICE. "
            "Sort order,\n"
            "                      '-e': all by acronym; '-ee': non-vendor "
@@ -528,6 +555,10 @@ usage(int hval)
            "    --in=FN|-i FN    FN is a filename containing a log page "
            "in ASCII hex\n"
            "                     or binary if --raw also given.\n"
+           "    --interval=SECS|-I SECS    re-read counter log pages every "
+           "SECS\n"
+           "                               seconds and show deltas and "
+           "rates\n"
            "    --page=PG|-p PG    PG is either log page acronym, PGN or "
            "PGN,SPGN\n"
            "                       where (S)PGN is a (sub) page number\n");
@@ -561,7 +592,10 @@ usage(int hval)
            "subpage names\n"
            "    --maxlen=LEN|-m LEN    max response length (def: 0 "
            "-> everything)\n"
-           "                           when > 1 will request LEN bytes\n"
+           "                           when > 1 will request LEN bytes "
+           "in a single\n"
+           "                           fetch (no fallback to length "
+           "probe)\n"
            "    --name|-n       decode some pages into multiple name=value "
            "lines\n"
            "    --no_inq|-x     no initial INQUIRY output (twice: and no "
@@ -904,7 +938,7 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "aAbc:D:ef:hHi:lLm:M:nNOp:P:qQrRsStTvV"
+        c = getopt_long(argc, argv, "aAbc:C:D:ef:hHi:I:lLm:M:nNOp:P:qQrRsStTvV"
                         "xX", long_options, &option_index);
         if (c == -1)
             break;
@@ -928,6 +962,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
             }
             op->page_control = n;
             break;
+        case 'C':
+            n = sg_get_num(optarg);
+            if (n < 0) {
+                pr2serr("bad argument to '--count='\n");
+                usage(1);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->count = n;
+            break;
         case 'D':
             n = sg_get_num(optarg);
             if ((n < 0) || (n > 31)) {
@@ -968,6 +1011,16 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'i':
             op->in_fn = optarg;
             break;
+        case 'I':
+            n = sg_get_num(optarg);
+            if (n < 1) {
+                pr2serr("bad argument to '--interval=', expect 1 or more "
+                        "seconds\n");
+                usage(1);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->interval = n;
+            break;
         case 'l':
             ++op->do_list;
             break;
@@ -1357,11 +1410,55 @@ num_or_unknown(const uint8_t * xp, int num_bytes /* max is 8 */, bool in_hex,
     return b;
 }
 
-/* Call LOG SENSE twice: the first time ask for 4 byte response to determine
-   actual length of response; then a second time requesting the
-   min(actual_len, mx_resp_len) bytes. If the calculated length for the
-   second fetch is odd then it is incremented (perhaps should be made modulo
-   4 in the future for SAS). Returns 0 if ok, SG_LIB_CAT_INVALID_OP for
+/* Lengths (including 4 byte header) of log pages already fetched from this
+ * DEVICE in this invocation, indexed by [pg_code][subpg_code]. A value of 0
+ * means not yet known. Used to size later fetches of the same page without
+ * a probe. */
+static uint16_t lpg_len_cache[64][256];
+
+/* Set when this DEVICE has rejected a LOG SENSE with a large allocation
+ * length but accepted the 4 byte probe. Thereafter every fetch does the
+ * probe first (as this utility did before version 1.78). */
+static bool big_alloc_rejected = false;
+
+/* Sanity check the page length in the 4 byte header at 'resp' and return
+ * the (even) number of bytes to request for the whole page. */
+static int
+calc_lpg_req_len(const uint8_t * resp, int mx_resp_len,
+                 const struct opts_t * op)
+{
+    int calc_len = sg_get_unaligned_be16(resp + 2) + 4;
+
+    if (op->pg_code != (0x3f & resp[0])) {
+        if (op->verbose)
+            pr2serr("Page code does not appear in first byte of "
+                    "response so it's suspect\n");
+        if (calc_len > 0x40) {
+            calc_len = 0x40;
+            if (op->verbose)
+                pr2serr("Trim response length to 64 bytes due to "
+                        "suspect response format\n");
+        }
+    }
+    /* Some HBAs don't like odd transfer lengths */
+    if (calc_len % 2)
+        calc_len += 1;
+    if (calc_len > mx_resp_len)
+        calc_len = mx_resp_len;
+    return calc_len;
+}
+
+/* Call LOG SENSE once asking for mx_resp_len bytes (or the length cached
+   from an earlier fetch of the same page) and use the resid and the page
+   length in the response to trim it. If the device rejects that (e.g. some
+   older devices object to large allocation lengths) then fall back to
+   calling LOG SENSE twice: the first time ask for 4 byte response to
+   determine actual length of response; then a second time requesting the
+   min(actual_len, mx_resp_len) bytes. Once the fallback has worked, it is
+   used for all subsequent pages. If the calculated length for the second
+   fetch is odd then it is incremented (perhaps should be made modulo 4 in
+   the future for SAS). If --maxlen=LEN is given (LEN > 1) then a single
+   fetch of LEN bytes is done. Returns 0 if ok, SG_LIB_CAT_INVALID_OP for
    log_sense not supported, SG_LIB_CAT_ILLEGAL_REQ for bad field in log sense
    command, SG_LIB_CAT_NOT_READY, SG_LIB_CAT_UNIT_ATTENTION,
    SG_LIB_CAT_ABORTED_COMMAND and -1 for other errors. */
@@ -1369,7 +1466,10 @@ static int
 do_logs(int sg_fd, uint8_t * resp, int mx_resp_len,
         const struct opts_t * op)
 {
+    bool fallback_ok;
+    bool refetched = false;     /* at most one refetch per call */
     int calc_len, request_len, res, resid, vb;
+    uint16_t * cachep;
 
 #ifdef SG_LIB_WIN32
 #ifdef SG_LIB_WIN32_DIRECT
@@ -1390,51 +1490,34 @@ do_logs(int sg_fd, uint8_t * resp, int mx_resp_len,
 #endif
     memset(resp, 0, mx_resp_len);
     vb = op->verbose;
+    cachep = &lpg_len_cache[op->pg_code & 0x3f][op->subpg_code & 0xff];
+    fallback_ok = false;
     if (op->maxlen > 1)
         request_len = mx_resp_len;
+    else if (*cachep > 0)
+        request_len = (*cachep < mx_resp_len) ? *cachep : mx_resp_len;
+    else if (big_alloc_rejected)
+        goto probe;
     else {
-        request_len = LOG_SENSE_PROBE_ALLOC_LEN;
-        if ((res = sg_ll_log_sense_v2(sg_fd, op->do_ppc, op->do_sp,
-                                      op->page_control, op->pg_code,
-                                      op->subpg_code, op->paramp,
-                                      resp, request_len, LOG_SENSE_DEF_TIMEOUT,
-                                      &resid, true /* noisy */, vb)))
-            return res;
-        if (resid > 0) {
-            res = SG_LIB_WILD_RESID;
-            goto resid_err;
-        }
-        calc_len = sg_get_unaligned_be16(resp + 2) + 4;
-        if ((! op->do_raw) && (vb > 1)) {
-            pr2serr("  Log sense (find length) response:\n");
-            hex2stderr(resp, LOG_SENSE_PROBE_ALLOC_LEN, 1);
-            pr2serr("  hence calculated response length=%d\n", calc_len);
-        }
-        if (op->pg_code != (0x3f & resp[0])) {
-            if (vb)
-                pr2serr("Page code does not appear in first byte of "
-                        "response so it's suspect\n");
-            if (calc_len > 0x40) {
-                calc_len = 0x40;
-                if (vb)
-                    pr2serr("Trim response length to 64 bytes due to "
-                            "suspect response format\n");
-            }
-        }
-        /* Some HBAs don't like odd transfer lengths */
-        if (calc_len % 2)
-            calc_len += 1;
-        if (calc_len > mx_resp_len)
-            calc_len = mx_resp_len;
-        request_len = calc_len;
+        request_len = mx_resp_len;
+        fallback_ok = (mx_resp_len > LOG_SENSE_PROBE_ALLOC_LEN);
     }
-    if ((res = sg_ll_log_sense_v2(sg_fd, op->do_ppc, op->do_sp,
-                                  op->page_control, op->pg_code,
-                                  op->subpg_code, op->paramp,
-                                  resp, request_len,
-                                  LOG_SENSE_DEF_TIMEOUT, &resid,
-                                  true /* noisy */, vb)))
+fetch:
+    res = sg_ll_log_sense_v2(sg_fd, op->do_ppc, op->do_sp, op->page_control,
+                             op->pg_code, op->subpg_code, op->paramp, resp,
+                             request_len, LOG_SENSE_DEF_TIMEOUT, &resid,
+                             ! fallback_ok /* noisy */, vb);
+    if (res) {
+        if (fallback_ok && ((SG_LIB_CAT_ILLEGAL_REQ == res) ||
+                            (SG_LIB_CAT_OTHER == res) || (res < 0))) {
+            if (vb > 1)
+                pr2serr("  Log sense with allocation length %d failed, "
+                        "probe length\n", request_len);
+            fallback_ok = false;
+            goto probe;
+        }
         return res;
+    }
     if (resid > 0) {
         request_len -= resid;
         if (request_len < 4) {
@@ -1443,11 +1526,61 @@ do_logs(int sg_fd, uint8_t * resp, int mx_resp_len,
             goto resid_err;
         }
     }
+    if (0 == op->maxlen) {
+        calc_len = calc_lpg_req_len(resp, mx_resp_len, op);
+        if (calc_len > request_len) {
+            /* cached length stale or page grown; fetch again at new size */
+            if ((! refetched) && (*cachep > 0) &&
+                (request_len < mx_resp_len)) {
+                if (vb > 1)
+                    pr2serr("  Log sense page length grew to %d bytes, "
+                            "refetch\n", calc_len);
+                *cachep = calc_len;
+                request_len = calc_len;
+                refetched = true;
+                goto fetch;
+            }
+            /* otherwise accept the shorter response */
+        } else
+            request_len = calc_len;
+        *cachep = request_len;
+    }
     if ((! op->do_raw) && (vb > 1)) {
         pr2serr("  Log sense response:\n");
         hex2stderr(resp, request_len, 1);
     }
     return 0;
+
+probe:
+    request_len = LOG_SENSE_PROBE_ALLOC_LEN;
+    if ((res = sg_ll_log_sense_v2(sg_fd, op->do_ppc, op->do_sp,
+                                  op->page_control, op->pg_code,
+                                  op->subpg_code, op->paramp,
+                                  resp, request_len, LOG_SENSE_DEF_TIMEOUT,
+                                  &resid, true /* noisy */, vb)))
+        return res;
+    if (resid > 0) {
+        res = SG_LIB_WILD_RESID;
+        goto resid_err;
+    }
+    calc_len = calc_lpg_req_len(resp, mx_resp_len, op);
+    if ((! op->do_raw) && (vb > 1)) {
+        pr2serr("  Log sense (find length) response:\n");
+        hex2stderr(resp, LOG_SENSE_PROBE_ALLOC_LEN, 1);
+        pr2serr("  hence calculated response length=%d\n", calc_len);
+    }
+    if (! big_alloc_rejected) {
+        /* the probe worked where the large allocation length did not */
+        big_alloc_rejected = true;
+        if (vb)
+            pr2serr("Device rejects large LOG SENSE allocation lengths, "
+                    "will probe page lengths\n");
+    }
+    *cachep = calc_len;
+    request_len = calc_len;
+    refetched = true;
+    goto fetch;
+
 resid_err:
     pr2serr("%s: request_len=%d, resid=%d, problems\n", __func__, request_len,
             resid);
@@ -1683,6 +1816,25 @@ skip:
     return true;
 }
 
+/* Returns name of parameter code 'pc' in the error counter log pages or
+ * NULL if reserved or vendor specific. */
+static const char *
+error_counter_pc_str(int pc)
+{
+    switch (pc) {
+    case 0: return "Errors corrected without substantial delay";
+    case 1: return "Errors corrected with possible delays";
+    case 2: return "Total rewrites or rereads";
+    case 3: return "Total errors corrected";
+    case 4: return "Total times correction algorithm processed";
+    case 5: return "Total bytes processed";
+    case 6: return "Total uncorrected errors";
+    case 0x8009: return "Track following errors [Hitachi]";
+    case 0x8015: return "Positioning errors [Hitachi]";
+    default: return NULL;
+    }
+}
+
 /* WRITE_ERR_LPAGE; READ_ERR_LPAGE; READ_REV_ERR_LPAGE; VERIFY_ERR_LPAGE */
 /* [0x2, 0x3, 0x4, 0x5]  introduced: SPC-3 */
 static bool
@@ -1692,6 +1844,7 @@ show_error_counter_page(const uint8_t * resp, int len,
     int num, pl, pc, pg_code;
     uint64_t val;
     const uint8_t * bp;
+    const char * cp;
     char str[PCB_STR_LEN];
 
     pg_code = resp[0] & 0x3f;
@@ -1732,18 +1885,11 @@ show_error_counter_page(const uint8_t * resp, int len,
                 break;
             }
         }
-        switch (pc) {
-        case 0: printf("  Errors corrected without substantial delay"); break;
-        case 1: printf("  Errors corrected with possible delays"); break;
-        case 2: printf("  Total rewrites or rereads"); break;
-        case 3: printf("  Total errors corrected"); break;
-        case 4: printf("  Total times correction algorithm processed"); break;
-        case 5: printf("  Total bytes processed"); break;
-        case 6: printf("  Total uncorrected errors"); break;
-        case 0x8009: printf("  Track following errors [Hitachi]"); break;
-        case 0x8015: printf("  Positioning errors [Hitachi]"); break;
-        default: printf("  Reserved or vendor specific [0x%x]", pc); break;
-        }
+        cp = error_counter_pc_str(pc);
+        if (cp)
+            printf("  %s", cp);
+        else
+            printf("  Reserved or vendor specific [0x%x]", pc);
         val = sg_get_unaligned_be(pl - 4, bp + 4);
         printf(" = %" PRIu64 "", val);
         if (val > ((uint64_t)1 << 40))
@@ -6653,6 +6799,332 @@ fetchTemperature(int sg_fd, uint8_t * resp, int max_len, struct opts_t * op)
     return (res >= 0) ? res : SG_LIB_CAT_OTHER;
 }
 
+/* One counter sampled in --interval=SECS mode. A counter is identified by
+ * its log page, parameter code, an index below that (e.g. the phy
+ * identifier in the SAS protocol specific port page, else 0) and a field
+ * number within the parameter. */
+struct lp_ctr_t {
+    uint8_t pg_code;
+    uint8_t width;      /* in bytes, 1 to 8; used to detect wrap around */
+    uint16_t pc;
+    uint16_t sub;
+    uint16_t fld;
+    bool seen;          /* in the current sample */
+    uint64_t prev;
+    uint64_t curr;
+    char name[72];
+};
+
+struct lp_ctr_tbl_t {
+    int num;
+    int hint;           /* index expected to match the next counter */
+    struct lp_ctr_t arr[MX_LP_CTRS];
+};
+
+/* Log pages sampled with --interval=SECS when --page=PG is not given; only
+ * those the device reports as supported are fetched. */
+static const int interval_def_pgs[] = {WRITE_ERR_LPAGE, READ_ERR_LPAGE,
+    READ_REV_ERR_LPAGE, VERIFY_ERR_LPAGE, NON_MEDIUM_LPAGE,
+    BACKGROUND_SCAN_LPAGE, PROTO_SPECIFIC_LPAGE};
+
+static bool
+interval_pg_ok(int pg_code)
+{
+    int k;
+
+    for (k = 0; k < (int)SG_ARRAY_SIZE(interval_def_pgs); ++k) {
+        if (pg_code == interval_def_pgs[k])
+            return true;
+    }
+    return false;
+}
+
+/* Records value 'val' (which is 'width' bytes wide in the log page) of the
+ * counter identified by pg_code, pc, sub and fld. The table is built on the
+ * first sample; since each later sample walks the same pages in the same
+ * order, the entry after the previous match is checked before searching. */
+static void
+lp_ctr_set(struct lp_ctr_tbl_t * tp, int pg_code, int pc, int sub, int fld,
+           int width, uint64_t val, const char * name)
+{
+    int k;
+    struct lp_ctr_t * cp;
+
+    for (k = 0; k < tp->num; ++k) {
+        cp = tp->arr + ((tp->hint + k) % tp->num);
+        if ((pg_code == cp->pg_code) && (pc == cp->pc) &&
+            (sub == cp->sub) && (fld == cp->fld))
+            goto found;
+    }
+    if (tp->num >= MX_LP_CTRS)
+        return;         /* table full, ignore */
+    cp = tp->arr + tp->num++;
+    cp->pg_code = pg_code;
+    cp->pc = pc;
+    cp->sub = sub;
+    cp->fld = fld;
+    cp->width = (width > 8) ? 8 : width;
+    cp->prev = val;
+    snprintf(cp->name, sizeof(cp->name), "%s", name);
+found:
+    tp->hint = (cp - tp->arr) + 1;
+    cp->seen = true;
+    cp->curr = val;
+}
+
+/* Places the counters found in log page 'resp' of length 'len' into the
+ * table. Only pages accepted by interval_pg_ok() are understood. */
+static void
+lp_ctrs_extract(const uint8_t * resp, int len, struct lp_ctr_tbl_t * tp)
+{
+    int k, num, pl, pc, pg_code, phy, spld_len, m, num_ped, pes, w;
+    uint64_t val;
+    const uint8_t * bp;
+    const uint8_t * vcp;
+    const uint8_t * xcp;
+    const char * ccp;
+    char b[72];
+
+    pg_code = resp[0] & 0x3f;
+    num = len - 4;
+    for (k = 0, bp = resp + 4; k < num; k += pl, bp += pl) {
+        if ((num - k) < 4)
+            break;
+        pc = sg_get_unaligned_be16(bp + 0);
+        pl = bp[3] + 4;
+        if ((k + pl) > num)
+            break;
+        switch (pg_code) {
+        case WRITE_ERR_LPAGE:
+        case READ_ERR_LPAGE:
+        case READ_REV_ERR_LPAGE:
+        case VERIFY_ERR_LPAGE:
+        case NON_MEDIUM_LPAGE:
+            w = pl - 4;
+            if ((w < 1) || (w > 8))
+                break;
+            val = sg_get_unaligned_be(w, bp + 4);
+            if (NON_MEDIUM_LPAGE == pg_code)
+                ccp = (0 == pc) ? "Non-medium error count" : NULL;
+            else
+                ccp = error_counter_pc_str(pc);
+            if (ccp)
+                snprintf(b, sizeof(b), "%s", ccp);
+            else
+                snprintf(b, sizeof(b), "Reserved or vendor specific [0x%x]",
+                         pc);
+            lp_ctr_set(tp, pg_code, pc, 0, 0, w, val, b);
+            break;
+        case BACKGROUND_SCAN_LPAGE:
+            /* only the status parameter holds counters */
+            if ((0 != pc) || (pl < 16))
+                break;
+            lp_ctr_set(tp, pg_code, pc, 0, 0, 4,
+                       sg_get_unaligned_be32(bp + 4),
+                       "Accumulated power on minutes");
+            lp_ctr_set(tp, pg_code, pc, 0, 1, 2,
+                       sg_get_unaligned_be16(bp + 10),
+                       "Number of background scans performed");
+            lp_ctr_set(tp, pg_code, pc, 0, 2, 2,
+                       sg_get_unaligned_be16(bp + 14),
+                       "Number of background medium scans performed");
+            break;
+        case PROTO_SPECIFIC_LPAGE:
+            if (6 != (0xf & bp[4]))
+                break;          /* only SAS is decoded */
+            for (m = 8, vcp = bp + 8; m < pl; m += spld_len,
+                 vcp += spld_len) {
+                spld_len = vcp[3];
+                if (spld_len < 44)
+                    spld_len = 48;  /* in SAS-1 and SAS-1.1 vcp[3]==0 */
+                else
+                    spld_len += 4;
+                if ((m + 48) > pl)
+                    break;
+                phy = vcp[1];
+                snprintf(b, sizeof(b), "port %d, phy %d: Invalid DWORD "
+                         "count", pc, phy);
+                lp_ctr_set(tp, pg_code, pc, phy, 0, 4,
+                           sg_get_unaligned_be32(vcp + 32), b);
+                snprintf(b, sizeof(b), "port %d, phy %d: Running disparity "
+                         "error count", pc, phy);
+                lp_ctr_set(tp, pg_code, pc, phy, 1, 4,
+                           sg_get_unaligned_be32(vcp + 36), b);
+                snprintf(b, sizeof(b), "port %d, phy %d: Loss of DWORD "
+                         "synchronization count", pc, phy);
+                lp_ctr_set(tp, pg_code, pc, phy, 2, 4,
+                           sg_get_unaligned_be32(vcp + 40), b);
+                snprintf(b, sizeof(b), "port %d, phy %d: Phy reset problem "
+                         "count", pc, phy);
+                lp_ctr_set(tp, pg_code, pc, phy, 3, 4,
+                           sg_get_unaligned_be32(vcp + 44), b);
+                if ((spld_len < 52) || ((m + 52) > pl))
+                    continue;
+                num_ped = vcp[51];
+                for (xcp = vcp + 52; num_ped > 0; --num_ped, xcp += 12) {
+                    if ((xcp + 12) > (bp + pl))
+                        break;
+                    pes = xcp[3];
+                    /* skip no event and peak value detectors */
+                    if ((0 == pes) || ((pes >= 0x2b) && (pes <= 0x2e)))
+                        continue;
+                    snprintf(b, sizeof(b), "port %d, phy %d: phy event "
+                             "source 0x%x count", pc, phy, pes);
+                    lp_ctr_set(tp, pg_code, pc, phy, 0x100 + pes, 4,
+                               sg_get_unaligned_be32(xcp + 4), b);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Returns elapsed time in seconds since first call (monotonic if
+ * available). */
+static double
+interval_now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+    return (double)time(NULL);
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (tv.tv_usec / 1000000.0);
+#else
+    return (double)time(NULL);
+#endif
+}
+
+/* Implements --interval=SECS [--count=CNT]. The device stays open and
+ * only the requested (or default counter) log pages are re-read each
+ * interval. After the first (baseline) sample, the change of each counter
+ * and its per second rate are output. Returns 0 if ok, else error. */
+static int
+do_interval_sampling(int sg_fd, uint8_t * resp, int max_len,
+                     struct opts_t * op)
+{
+    bool first_pg;
+    int k, j, n, res, pg_len, num_pgs, sample;
+    int pgs[SG_ARRAY_SIZE(interval_def_pgs)];
+    uint64_t delta, mask;
+    double t_prev, t_now, elapsed;
+    const struct log_elem * lep;
+    struct lp_ctr_t * cp;
+    struct lp_ctr_tbl_t * tp;
+
+    num_pgs = 0;
+    if (op->pg_arg || op->do_transport) {
+        if ((! interval_pg_ok(op->pg_code)) || (op->subpg_code > 0)) {
+            pr2serr("--interval only samples error counter, non-medium "
+                    "error,\nbackground scan and protocol specific port "
+                    "pages\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        pgs[num_pgs++] = op->pg_code;
+    } else {
+        op->pg_code = SUPP_PAGES_LPAGE;
+        op->subpg_code = NOT_SPG_SUBPG;
+        res = do_logs(sg_fd, resp, max_len, op);
+        if (res) {
+            pr2serr("log_sense: unable to fetch supported pages\n");
+            return res;
+        }
+        pg_len = sg_get_unaligned_be16(resp + 2);
+        if ((pg_len + 4) > max_len)
+            pg_len = max_len - 4;
+        for (k = 0; k < (int)SG_ARRAY_SIZE(interval_def_pgs); ++k) {
+            for (j = 0; j < pg_len; ++j) {
+                if (interval_def_pgs[k] == (resp[4 + j] & 0x3f)) {
+                    pgs[num_pgs++] = interval_def_pgs[k];
+                    break;
+                }
+            }
+        }
+        if (0 == num_pgs) {
+            pr2serr("device supports none of the counter log pages that "
+                    "--interval samples\n");
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    tp = (struct lp_ctr_tbl_t *)calloc(1, sizeof(*tp));
+    if (NULL == tp) {
+        pr2serr("Unable to allocate counter table\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    t_prev = 0.0;
+    res = 0;
+    for (sample = 0; (0 == op->count) || (sample <= op->count); ++sample) {
+        if (sample > 0)
+            sleep_for(op->interval);
+        t_now = interval_now();
+        for (k = 0; k < tp->num; ++k)
+            tp->arr[k].seen = false;
+        for (k = 0; k < num_pgs; ++k) {
+            op->pg_code = pgs[k];
+            op->subpg_code = NOT_SPG_SUBPG;
+            res = do_logs(sg_fd, resp, max_len, op);
+            if (res) {
+                pr2serr("log_sense: page=0x%x failed\n", pgs[k]);
+                goto fini;
+            }
+            pg_len = sg_get_unaligned_be16(resp + 2) + 4;
+            lp_ctrs_extract(resp, (pg_len > max_len) ? max_len : pg_len, tp);
+        }
+        if (0 == sample) {
+            if (0 == op->do_brief)
+                printf("Sampling %d counters every %d second%s\n", tp->num,
+                       op->interval, ((1 == op->interval) ? "" : "s"));
+            t_prev = t_now;
+            continue;
+        }
+        elapsed = t_now - t_prev;
+        if (elapsed <= 0.0)
+            elapsed = (double)op->interval;
+        printf("\nSample %d, over %.3f seconds:\n", sample, elapsed);
+        for (k = 0, first_pg = true, n = -1; k < tp->num; ++k) {
+            cp = tp->arr + k;
+            if (! cp->seen)
+                continue;
+            if (cp->curr >= cp->prev)
+                delta = cp->curr - cp->prev;
+            else {      /* counter wrapped (or was reset) */
+                mask = (cp->width < 8) ?
+                       ((uint64_t)1 << (8 * cp->width)) - 1 : ~(uint64_t)0;
+                delta = (mask - cp->prev) + cp->curr + 1;
+            }
+            cp->prev = cp->curr;
+            if ((0 == delta) && op->do_brief)
+                continue;
+            if (first_pg || (n != cp->pg_code)) {
+                n = cp->pg_code;
+                first_pg = false;
+                lep = pg_subpg_pdt_search(n, 0, op->dev_pdt,
+                                          op->vend_prod_num);
+                printf("  %s  [0x%x]\n", (lep ? lep->name : "log page"), n);
+            }
+            if (op->do_name)
+                printf("    pg=0x%x,pc=0x%x,sub=%d,fld=%d delta=%" PRIu64
+                       " rate=%.2f\n", cp->pg_code, cp->pc, cp->sub, cp->fld,
+                       delta, delta / elapsed);
+            else
+                printf("    %s: %" PRIu64 " [%.2f/s], total=%" PRIu64 "\n",
+                       cp->name, delta, delta / elapsed, cp->curr);
+        }
+        fflush(stdout);
+        t_prev = t_now;
+    }
+fini:
+    free(tp);
+    return res;
+}
+
 /* Returns 0 if successful else SG_LIB_SYNTAX_ERROR. */
 static int
 decode_pg_arg(struct opts_t * op)
@@ -6890,6 +7362,19 @@ main(int argc, char * argv[])
             goto err_out;
         }
     }
+    if (op->interval > 0) {
+        if (op->do_select || op->do_all || op->do_list ||
+            op->do_temperature || op->do_raw || op->do_hex || op->in_fn) {
+            pr2serr("--interval conflicts with --all, --hex, --in, --list, "
+                    "--raw,\n--select and --temperature\n");
+            ret = SG_LIB_CONTRADICT;
+            goto err_out;
+        }
+    } else if (op->count > 0) {
+        pr2serr("--count=CNT only makes sense with --interval=SECS\n");
+        ret = SG_LIB_CONTRADICT;
+        goto err_out;
+    }
     if (op->in_fn) {
         if (! op->do_select) {
             pr2serr("--in=FN can only be used with --select when DEVICE "
@@ -6973,6 +7458,11 @@ main(int argc, char * argv[])
         ret = fetchTemperature(sg_fd, rsp_buff, SHORT_RESP_LEN, op);
         goto err_out;
     }
+    if (op->interval > 0) {
+        resp_len = (op->maxlen > 0) ? op->maxlen : MX_ALLOC_LEN;
+        ret = do_interval_sampling(sg_fd, rsp_buff, resp_len, op);
+        goto err_out;
+    }
     if (op->do_select) {
         k = sg_ll_log_select(sg_fd, op->do_pcreset, op->do_sp,
                              op->page_control, op->pg_code, op->subpg_code,
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2004-2018 Douglas Gilbert.
+ * Copyright (c) 2004-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -22,6 +22,17 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#define SLUNS_HAVE_PTHREAD 1
+#endif
+#ifdef SG_LIB_LINUX
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_unaligned.h"
@@ -31,17 +42,38 @@
  *
  *
  * This program issues the SCSI REPORT LUNS command to the given SCSI device
- * and decodes the response.
+ * and decodes the response. Given several DEVICEs (or --all in Linux) it
+ * sends REPORT LUNS to all of them concurrently and outputs one compact
+ * line per target.
  */
 
-static const char * version_str = "1.42 20180626";
+static const char * version_str = "1.43 20261018";
 
 #define MAX_RLUNS_BUFF_LEN (1024 * 1024)
 #define DEF_RLUNS_BUFF_LEN (1024 * 8)
+#define DEF_MULTI_THREADS 64
+#define MAX_MULTI_THREADS 1024
+#define MAX_TGT_CANDS 8         /* LUs of a target tried by --all */
+#define NAME_LEN_MAX 256
+#define D_NAME_LEN_MAX 520
+/* REPORT LUNS well known logical unit (T10: c1 01 00 ..) as a Linux lun */
+#define RLUNS_WLUN_LINUX 0xc101
+
+#ifdef SG_LIB_LINUX
+static const char * def_sysfs_root = "/sys";
+static const char * def_dev_dir = "/dev";
+#endif
 
 
 static struct option long_options[] = {
+#ifdef SG_LIB_LINUX
+        {"all", no_argument, 0, 'a'},
+#endif
         {"decode", no_argument, 0, 'd'},
+#ifdef SG_LIB_LINUX
+        {"dev_dir", required_argument, 0, 'D'},
+        {"dev-dir", required_argument, 0, 'D'},
+#endif
         {"help", no_argument, 0, 'h'},
         {"hex", no_argument, 0, 'H'},
 #ifdef SG_LIB_LINUX
@@ -54,7 +86,11 @@ static struct option long_options[] = {
         {"raw", no_argument, 0, 'r'},
         {"readonly", no_argument, 0, 'R'},
         {"select", required_argument, 0, 's'},
+#ifdef SG_LIB_LINUX
+        {"sysfs", required_argument, 0, 'S'},
+#endif
         {"test", required_argument, 0, 't'},
+        {"threads", required_argument, 0, 'T'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
         {0, 0, 0, 0},
@@ -70,20 +106,41 @@ usage()
             "                  [--maxlen=LEN] [--quiet] [--raw] "
             "[--readonly]\n"
             "                  [--select=SR] [--verbose] [--version] "
-            "DEVICE\n");
+            "DEVICE\n"
+            "     or\n"
+            "       sg_luns    [--all] [--dev_dir=DIR] [--hex] [--linux] "
+            "[--maxlen=LEN]\n"
+            "                  [--readonly] [--select=SR] [--sysfs=DIR] "
+            "[--threads=TN]\n"
+            "                  [--verbose] [DEVICE...]\n");
 #else
     pr2serr("Usage: sg_luns    [--decode] [--help] [--hex] [--lu_cong] "
             "[--maxlen=LEN]\n"
             "                  [--quiet] [--raw] [--readonly] "
             "[--select=SR]\n"
-            "                  [--verbose] [--version] DEVICE\n");
+            "                  [--verbose] [--version] DEVICE\n"
+            "     or\n"
+            "       sg_luns    [--hex] [--maxlen=LEN] [--readonly] "
+            "[--select=SR]\n"
+            "                  [--threads=TN] [--verbose] DEVICE "
+            "DEVICE...\n");
 #endif
     pr2serr("     or\n"
             "       sg_luns    --test=ALUN [--decode] [--hex] [--lu_cong] "
             "[--verbose]\n"
-            "  where:\n"
-            "    --decode|-d        decode all luns into component parts\n"
-            "    --help|-h          print out usage message\n"
+            "  where:\n");
+#ifdef SG_LIB_LINUX
+    pr2serr("    --all|-a           REPORT LUNS to each target in sysfs, "
+            "via its\n"
+            "                       well known lu or lun 0 when present\n");
+#endif
+    pr2serr("    --decode|-d        decode all luns into component parts\n");
+#ifdef SG_LIB_LINUX
+    pr2serr("    --dev_dir=DIR|-D DIR    where sg and bsg nodes are, for "
+            "--all\n"
+            "                            (def: /dev)\n");
+#endif
+    pr2serr("    --help|-h          print out usage message\n"
             "    --hex|-H           output response in hexadecimal; used "
             "twice\n"
             "                       shows decoded values in hex\n");
@@ -110,10 +167,17 @@ usage()
             "                          0x11 -> admin luns + "
             "non-conglomerate luns\n"
             "                          0x12 -> admin lun + its "
-            "subsidiary luns\n"
-            "    --test=ALUN|-t ALUN    decode ALUN and ignore most other "
+            "subsidiary luns\n", DEF_RLUNS_BUFF_LEN);
+#ifdef SG_LIB_LINUX
+    pr2serr("    --sysfs=DIR|-S DIR    where sysfs is mounted, for --all "
+            "(def: /sys)\n");
+#endif
+    pr2serr("    --test=ALUN|-t ALUN    decode ALUN and ignore most other "
             "options\n"
             "                           and DEVICE (apart from '-H')\n"
+            "    --threads=TN|-T TN    maximum REPORT LUNS commands "
+            "outstanding when\n"
+            "                          more than one DEVICE (def: %d)\n"
             "    --verbose|-v       increase verbosity\n"
             "    --version|-V       print version string and exit\n\n"
             "Performs a SCSI REPORT LUNS command or decodes the given ALUN. "
@@ -121,7 +185,9 @@ usage()
             "well known logical unit;\nwhen SR is 0x12 DEVICE must be an "
             "administrative logical unit. When the\n--test=ALUN option is "
             "given, decodes ALUN rather than sending a REPORT\nLUNS "
-            "command.\n", DEF_RLUNS_BUFF_LEN );
+            "command. Given more than one DEVICE (or --all) the commands "
+            "are sent\nconcurrently and one line is output per DEVICE (or "
+            "target).\n", DEF_MULTI_THREADS);
 }
 
 /* Decoded according to SAM-5 rev 10. Note that one draft: BCC rev 0,
@@ -355,10 +421,421 @@ dStrRaw(const char * str, int len)
         printf("%c", str[k]);
 }
 
+/* In multi-device mode: one DEVICE from the command line or, with --all,
+ * one target found in sysfs. cands[] holds names of device nodes that can
+ * reach it, in order of preference; the first that answers is used. */
+struct sluns_tgt_t {
+    bool trunc;                 /* LUN list didn't fit in maxlen */
+    int hct[3];                 /* host, channel, target (--all only) */
+    int num_cands;
+    int used;                   /* index of cands[] that answered */
+    int len;                    /* LUN list length in rp, bytes */
+    int ret;
+    char * cands[MAX_TGT_CANDS];
+    uint8_t * rp;               /* REPORT LUNS response */
+    uint8_t * free_rp;
+};
+
+/* State shared by the worker threads in multi-device mode */
+struct sluns_multi_t {
+    bool do_all;
+    bool do_linux;
+    bool o_readonly;
+    int do_hex;
+    int select_rep;
+    int maxlen;                 /* 0 -> start small then grow */
+    int num_threads;
+    int verbose;
+    const char * dev_dir;
+    const char * sysfs_root;
+    int num_tgts;
+    int next_tgt;               /* next target to be claimed by a worker */
+    struct sluns_tgt_t * tgts;
+#ifdef SLUNS_HAVE_PTHREAD
+    pthread_mutex_t mutex;
+#endif
+};
+
+/* Sends REPORT LUNS via dev_name. Unless --maxlen is given the allocation
+ * length is increased until the whole LUN list fits. On success the
+ * response is placed in tp and 0 is returned. */
+static int
+sluns_fetch(const struct sluns_multi_t * mp, const char * dev_name,
+            struct sluns_tgt_t * tp)
+{
+    int sg_fd, res, mx;
+    int len = 0;
+    int vb = mp->verbose;
+    uint8_t * rp = NULL;
+    uint8_t * free_rp = NULL;
+    char eb[64];
+
+    sg_fd = sg_cmds_open_device(dev_name, mp->o_readonly, vb);
+    if (sg_fd < 0) {
+        if (vb)
+            pr2serr("open error: %s: %s\n", dev_name,
+                    safe_strerror_r(-sg_fd, eb, sizeof(eb)));
+        return sg_convert_errno(-sg_fd);
+    }
+    tp->trunc = false;
+    mx = mp->maxlen ? mp->maxlen : DEF_RLUNS_BUFF_LEN;
+    while (true) {
+        free(free_rp);
+        rp = (uint8_t *)sg_memalign(mx, 0, &free_rp, false);
+        if (NULL == rp) {
+            res = sg_convert_errno(ENOMEM);
+            break;
+        }
+        res = sg_ll_report_luns(sg_fd, mp->select_rep, rp, mx, vb > 0, vb);
+        if (res)
+            break;
+        len = (int)(sg_get_unaligned_be32(rp + 0) & 0x7ffffff8);
+        if ((len + 8) <= mx)
+            break;
+        if (mp->maxlen || (mx >= MAX_RLUNS_BUFF_LEN)) {
+            tp->trunc = true;
+            len = ((mx - 8) / 8) * 8;
+            break;
+        }
+        mx = ((len + 8) > MAX_RLUNS_BUFF_LEN) ? MAX_RLUNS_BUFF_LEN :
+                                                (len + 8);
+    }
+    sg_cmds_close_device(sg_fd);
+    if (res) {
+        free(free_rp);
+        if (vb) {
+            char b[80];
+
+            sg_get_category_sense_str(res, sizeof(b), b, vb);
+            pr2serr("Report Luns via %s: %s\n", dev_name, b);
+        }
+        return res;
+    }
+    tp->rp = rp;
+    tp->free_rp = free_rp;
+    tp->len = len;
+    return 0;
+}
+
+/* Worker: claims targets from the shared index until none are left. */
+static void *
+sluns_worker(void * v_mp)
+{
+    int k, j, res;
+    struct sluns_multi_t * mp = (struct sluns_multi_t *)v_mp;
+    struct sluns_tgt_t * tp;
+
+    while (true) {
+#ifdef SLUNS_HAVE_PTHREAD
+        pthread_mutex_lock(&mp->mutex);
+#endif
+        k = mp->next_tgt++;
+#ifdef SLUNS_HAVE_PTHREAD
+        pthread_mutex_unlock(&mp->mutex);
+#endif
+        if (k >= mp->num_tgts)
+            break;
+        tp = mp->tgts + k;
+        for (j = 0; j < tp->num_cands; ++j) {
+            res = sluns_fetch(mp, tp->cands[j], tp);
+            tp->ret = res;
+            if (0 == res) {
+                tp->used = j;
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+#ifdef SG_LIB_LINUX
+/* A logical unit found in /sys/class/scsi_device */
+struct sluns_lu_t {
+    int hct[3];
+    uint64_t lun;
+};
+
+/* Sorts by H:C:T then, within a target, the REPORT LUNS well known LU
+ * first, lun 0 next, then ascending lun. */
+static int
+sluns_lu_cmp(const void * a, const void * b)
+{
+    int k;
+    const struct sluns_lu_t * lap = (const struct sluns_lu_t *)a;
+    const struct sluns_lu_t * lbp = (const struct sluns_lu_t *)b;
+
+    for (k = 0; k < 3; ++k) {
+        if (lap->hct[k] != lbp->hct[k])
+            return (lap->hct[k] < lbp->hct[k]) ? -1 : 1;
+    }
+    if (lap->lun == lbp->lun)
+        return 0;
+    if (RLUNS_WLUN_LINUX == lap->lun)
+        return -1;
+    if (RLUNS_WLUN_LINUX == lbp->lun)
+        return 1;
+    return (lap->lun < lbp->lun) ? -1 : 1;
+}
+
+/* Builds the name of a device node that can send commands to the given
+ * logical unit: its sg node if it has one, else its bsg node. Returns
+ * true if one is found. */
+static bool
+sluns_lu_node(const struct sluns_lu_t * lup, const struct sluns_multi_t * mp,
+              char * b, int blen)
+{
+    bool found = false;
+    DIR * dp;
+    struct dirent * dep;
+    struct stat st;
+    char dname[NAME_LEN_MAX];
+
+    snprintf(dname, sizeof(dname), "%s/class/scsi_device/%d:%d:%d:%"
+             PRIu64 "/device/scsi_generic", mp->sysfs_root, lup->hct[0],
+             lup->hct[1], lup->hct[2], lup->lun);
+    dp = opendir(dname);
+    if (dp) {
+        while ((dep = readdir(dp))) {
+            if (0 == strncmp(dep->d_name, "sg", 2)) {
+                snprintf(b, blen, "%s/%.*s", mp->dev_dir, NAME_LEN_MAX,
+                         dep->d_name);
+                found = true;
+                break;
+            }
+        }
+        closedir(dp);
+        if (found)
+            return true;
+    }
+    snprintf(b, blen, "%s/bsg/%d:%d:%d:%" PRIu64, mp->dev_dir, lup->hct[0],
+             lup->hct[1], lup->hct[2], lup->lun);
+    return (0 == stat(b, &st));
+}
+
+/* Implements --all: one entry in mp->tgts for each target that has at
+ * least one logical unit in sysfs. SR 0x10 and 0x11 must be sent to lun 0
+ * or to the REPORT LUNS well known LU so other LUs are not tried. Returns
+ * 0 if ok, else error. */
+static int
+sluns_find_targets(struct sluns_multi_t * mp)
+{
+    bool wlun_only;
+    int k, n, num, h, c, t;
+    int mx = 256;
+    uint64_t lun;
+    DIR * dp;
+    struct dirent * dep;
+    struct sluns_lu_t * lus;
+    struct sluns_lu_t * nlus;
+    struct sluns_lu_t * lup;
+    struct sluns_tgt_t * tp;
+    char b[NAME_LEN_MAX];
+    char dev[D_NAME_LEN_MAX];
+
+    snprintf(b, sizeof(b), "%s/class/scsi_device", mp->sysfs_root);
+    dp = opendir(b);
+    if (NULL == dp) {
+        pr2serr("opendir(%s): %s\n", b, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    lus = (struct sluns_lu_t *)calloc(mx, sizeof(struct sluns_lu_t));
+    num = 0;
+    while (lus && (dep = readdir(dp))) {
+        if (4 != sscanf(dep->d_name, "%d:%d:%d:%" SCNu64, &h, &c, &t,
+                        &lun))
+            continue;
+        if (num >= mx) {
+            mx *= 2;
+            nlus = (struct sluns_lu_t *)realloc(lus, mx * sizeof(*lus));
+            if (NULL == nlus) {
+                free(lus);
+                lus = NULL;
+                break;
+            }
+            lus = nlus;
+        }
+        lus[num].hct[0] = h;
+        lus[num].hct[1] = c;
+        lus[num].hct[2] = t;
+        lus[num].lun = lun;
+        ++num;
+    }
+    closedir(dp);
+    if (NULL == lus)
+        return sg_convert_errno(ENOMEM);
+    qsort(lus, num, sizeof(struct sluns_lu_t), sluns_lu_cmp);
+    /* num is an upper bound on the number of targets */
+    mp->tgts = (struct sluns_tgt_t *)calloc(num + 1,
+                                            sizeof(struct sluns_tgt_t));
+    if (NULL == mp->tgts) {
+        free(lus);
+        return sg_convert_errno(ENOMEM);
+    }
+    wlun_only = ((0x10 == mp->select_rep) || (0x11 == mp->select_rep));
+    for (k = 0, n = -1, tp = NULL; k < num; ++k) {
+        lup = lus + k;
+        if ((NULL == tp) || memcmp(tp->hct, lup->hct, sizeof(tp->hct))) {
+            tp = mp->tgts + ++n;
+            mp->num_tgts = n + 1;
+            memcpy(tp->hct, lup->hct, sizeof(tp->hct));
+            tp->ret = SG_LIB_FILE_ERROR;        /* until a node is found */
+        }
+        if (tp->num_cands >= MAX_TGT_CANDS)
+            continue;
+        if (wlun_only && (0 != lup->lun) && (RLUNS_WLUN_LINUX != lup->lun))
+            continue;
+        if (! sluns_lu_node(lup, mp, dev, sizeof(dev))) {
+            if (mp->verbose > 1)
+                pr2serr("no sg or bsg node for %d:%d:%d:%" PRIu64 "\n",
+                        lup->hct[0], lup->hct[1], lup->hct[2], lup->lun);
+            continue;
+        }
+        if (NULL == (tp->cands[tp->num_cands] = strdup(dev))) {
+            free(lus);
+            return sg_convert_errno(ENOMEM);
+        }
+        ++tp->num_cands;
+        tp->ret = 0;
+    }
+    free(lus);
+    return 0;
+}
+#endif  /* SG_LIB_LINUX */
+
+/* Outputs one line per target: its H:C:T (--all only), the device node
+ * used, then either the number of luns and a comma separated list of them
+ * or the error. Returns 0 if all targets answered, else the last error. */
+static int
+sluns_multi_out(const struct sluns_multi_t * mp)
+{
+    int k, m, off;
+    int ret = 0;
+    int tot = 0;
+    int bad = 0;
+    const uint8_t * bp;
+    const struct sluns_tgt_t * tp;
+    char b[80];
+
+    for (k = 0; k < mp->num_tgts; ++k) {
+        tp = mp->tgts + k;
+        if (mp->do_all)
+            printf("%d:%d:%d ", tp->hct[0], tp->hct[1], tp->hct[2]);
+        if (tp->ret) {
+            ret = tp->ret;
+            ++bad;
+            if (0 == tp->num_cands) {
+                printf("- error=no sg or bsg node\n");
+                continue;
+            }
+            sg_get_category_sense_str(tp->ret, sizeof(b), b, 0);
+            printf("%s error=%s\n", tp->cands[tp->num_cands - 1], b);
+            continue;
+        }
+        printf("%s n=%d luns=", tp->cands[tp->used], tp->len / 8);
+        for (m = 0, off = 8; m < (tp->len / 8); ++m, off += 8) {
+            bp = tp->rp + off;
+            if (m)
+                printf(",");
+#ifdef SG_LIB_LINUX
+            if (mp->do_linux) {
+                if (mp->do_hex)
+                    printf("0x%" PRIx64, t10_2linux_lun(bp));
+                else
+                    printf("%" PRIu64, t10_2linux_lun(bp));
+                continue;
+            }
+#endif
+            printf("%016" PRIx64, sg_get_unaligned_be64(bp));
+        }
+        printf("%s\n", (tp->trunc ? " truncated" : ""));
+        tot += tp->len / 8;
+    }
+    if (mp->verbose)
+        pr2serr("%d target%s, %d failed, %d lun%s reported\n", mp->num_tgts,
+                ((1 == mp->num_tgts) ? "" : "s"), bad, tot,
+                ((1 == tot) ? "" : "s"));
+    return ret;
+}
+
+/* Implements multi-device mode: REPORT LUNS is sent to all DEVICEs (or,
+ * with --all, to all targets in sysfs) concurrently using up to
+ * mp->num_threads threads. Output follows once all have answered so
+ * elapsed time is close to that of the slowest target. */
+static int
+sluns_multi(struct sluns_multi_t * mp, char ** dev_names, int num_devs)
+{
+    int k, n, ret;
+#ifdef SLUNS_HAVE_PTHREAD
+    pthread_t * tids;
+#endif
+
+    if (mp->do_all) {
+#ifdef SG_LIB_LINUX
+        ret = sluns_find_targets(mp);
+        if (ret)
+            goto fini;
+#endif
+    } else {
+        mp->tgts = (struct sluns_tgt_t *)calloc(num_devs + 1,
+                                                sizeof(struct sluns_tgt_t));
+        if (NULL == mp->tgts)
+            return sg_convert_errno(ENOMEM);
+        for (k = 0; k < num_devs; ++k) {
+            mp->tgts[k].cands[0] = dev_names[k];
+            mp->tgts[k].num_cands = 1;
+        }
+        mp->num_tgts = num_devs;
+    }
+    if (0 == mp->num_tgts) {
+        if (mp->verbose)
+            pr2serr("no targets found\n");
+        ret = 0;
+        goto fini;
+    }
+    n = (mp->num_threads > mp->num_tgts) ? mp->num_tgts : mp->num_threads;
+#ifdef SLUNS_HAVE_PTHREAD
+    pthread_mutex_init(&mp->mutex, NULL);
+    tids = (pthread_t *)calloc(n + 1, sizeof(pthread_t));
+    if (NULL == tids) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < n; ++k) {
+        if (pthread_create(tids + k, NULL, sluns_worker, mp)) {
+            pr2serr("pthread_create failed, continue with %d threads\n", k);
+            break;
+        }
+    }
+    n = k;
+    if (0 == n)
+        sluns_worker(mp);
+    for (k = 0; k < n; ++k)
+        pthread_join(tids[k], NULL);
+    free(tids);
+    pthread_mutex_destroy(&mp->mutex);
+#else
+    if (mp->verbose && (n > 1))
+        pr2serr("threads not available, one DEVICE at a time\n");
+    sluns_worker(mp);
+#endif
+    ret = sluns_multi_out(mp);
+fini:
+    for (k = 0; mp->tgts && (k < mp->num_tgts); ++k) {
+        free(mp->tgts[k].free_rp);
+        if (mp->do_all) {
+            for (n = 0; n < mp->tgts[k].num_cands; ++n)
+                free(mp->tgts[k].cands[n]);
+        }
+    }
+    free(mp->tgts);
+    return ret;
+}
+
 int
 main(int argc, char * argv[])
 {
 #ifdef SG_LIB_LINUX
+    bool do_all = false;
     bool do_linux = false;
 #endif
     bool do_quiet = false;
@@ -377,6 +854,8 @@ main(int argc, char * argv[])
     int do_hex = 0;
     int lu_cong_arg = 0;
     int maxlen = 0;
+    int num_devs = 0;
+    int num_threads = DEF_MULTI_THREADS;
     int ret = 0;
     int select_rep = 0;
     int verbose = 0;
@@ -384,6 +863,11 @@ main(int argc, char * argv[])
     const char * test_arg = NULL;
     const char * device_name = NULL;
     const char * cp;
+#ifdef SG_LIB_LINUX
+    const char * dev_dir = def_dev_dir;
+    const char * sysfs_root = def_sysfs_root;
+#endif
+    char ** dev_names = NULL;
     uint8_t * reportLunsBuff = NULL;
     uint8_t * free_reportLunsBuff = NULL;
     uint8_t lun_arr[8];
@@ -393,16 +877,24 @@ main(int argc, char * argv[])
         int option_index = 0;
 
 #ifdef SG_LIB_LINUX
-        c = getopt_long(argc, argv, "dhHlLm:qrRs:t:vV", long_options,
-                        &option_index);
+        c = getopt_long(argc, argv, "aD:dhHlLm:qrRs:S:t:T:vV",
+                        long_options, &option_index);
 #else
-        c = getopt_long(argc, argv, "dhHLm:qrRs:t:vV", long_options,
+        c = getopt_long(argc, argv, "dhHLm:qrRs:t:T:vV", long_options,
                         &option_index);
 #endif
         if (c == -1)
             break;
 
         switch (c) {
+#ifdef SG_LIB_LINUX
+        case 'a':
+            do_all = true;
+            break;
+        case 'D':
+            dev_dir = optarg;
+            break;
+#endif
         case 'd':
             ++decode_arg;
             break;
@@ -415,7 +907,7 @@ main(int argc, char * argv[])
             break;
 #ifdef SG_LIB_LINUX
         case 'l':
-            do_linux = false;
+            do_linux = true;
             break;
 #endif
         case 'L':
@@ -446,9 +938,22 @@ main(int argc, char * argv[])
                 return SG_LIB_SYNTAX_ERROR;
             }
             break;
+#ifdef SG_LIB_LINUX
+        case 'S':
+            sysfs_root = optarg;
+            break;
+#endif
         case 't':
             test_arg = optarg;
             break;
+        case 'T':
+            num_threads = sg_get_num(optarg);
+            if ((num_threads < 1) || (num_threads > MAX_MULTI_THREADS)) {
+                pr2serr("argument to '--threads' should be 1 to %d\n",
+                        MAX_MULTI_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'v':
             verbose_given = true;
             ++verbose;
@@ -463,16 +968,9 @@ main(int argc, char * argv[])
         }
     }
     if (optind < argc) {
-        if (NULL == device_name) {
-            device_name = argv[optind];
-            ++optind;
-        }
-        if (optind < argc) {
-            for (; optind < argc; ++optind)
-                pr2serr("Unexpected extra argument: %s\n", argv[optind]);
-            usage();
-            return SG_LIB_SYNTAX_ERROR;
-        }
+        device_name = argv[optind];
+        dev_names = argv + optind;
+        num_devs = argc - optind;
     }
 #ifdef DEBUG
     pr2serr("In DEBUG mode, ");
@@ -584,6 +1082,42 @@ main(int argc, char * argv[])
         decode_lun("  ", lun_arr, (lu_cong_arg % 2), do_hex, verbose);
         return 0;
     }
+#ifdef SG_LIB_LINUX
+    if (do_all || (num_devs > 1)) {
+#else
+    if (num_devs > 1) {
+#endif
+        struct sluns_multi_t multi;
+
+        if (do_raw || decode_arg) {
+            pr2serr("--raw and --decode need a single DEVICE\n");
+            return SG_LIB_CONTRADICT;
+        }
+        memset(&multi, 0, sizeof(multi));
+#ifdef SG_LIB_LINUX
+        if (do_all && num_devs) {
+            pr2serr("--all and DEVICE contradict\n");
+            return SG_LIB_CONTRADICT;
+        }
+        multi.do_all = do_all;
+        multi.do_linux = do_linux;
+        multi.dev_dir = dev_dir;
+        multi.sysfs_root = sysfs_root;
+#endif
+        multi.o_readonly = o_readonly;
+        multi.do_hex = do_hex;
+        multi.select_rep = select_rep;
+        multi.maxlen = maxlen;
+        multi.num_threads = num_threads;
+        multi.verbose = verbose;
+        ret = sluns_multi(&multi, dev_names, num_devs);
+        if ((0 == verbose) && ret) {
+            if (! sg_if_can2stderr("sg_luns failed: ", ret))
+                pr2serr("Some error occurred, try again with '-v' or '-vv' "
+                        "for more information\n");
+        }
+        return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+    }
     if (NULL == device_name) {
         pr2serr("missing device name!\n");
         usage();
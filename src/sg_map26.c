@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2005-2018 Douglas Gilbert.
+ * Copyright (c) 2005-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -13,6 +13,9 @@
  * This program maps a primary SCSI device node name to the corresponding
  * SCSI generic device node name (or vice versa). Targets linux
  * kernel 2.6, 3 and 4 series. Sysfs device names can also be mapped.
+ * With --batch many devices are mapped, and with --all every SCSI device
+ * is listed, from an index built by a single walk of sysfs and the
+ * device directory.
  */
 
 /* #define _XOPEN_SOURCE 500 */
@@ -32,6 +35,8 @@
 #include <errno.h>
 #include <limits.h>
 #include <getopt.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
 #include <dirent.h>
 #include <libgen.h>
 #include <sys/ioctl.h>
@@ -47,7 +52,7 @@
 #endif
 #include "sg_lib.h"
 
-static const char * version_str = "1.16 20180724";
+static const char * version_str = "1.17 20261018";
 
 #define ME "sg_map26: "
 
@@ -105,14 +110,18 @@ static const char * sys_st_dir = "/sys/class/scsi_tape/";
 static const char * sys_sch_dir = "/sys/class/scsi_changer/";
 static const char * sys_osst_dir = "/sys/class/onstream_tape/";
 static const char * def_dev_dir = "/dev";
+static const char * def_sysfs_root = "/sys";
 
 
 static struct option long_options[] = {
+        {"all", no_argument, 0, 'a'},
+        {"batch", no_argument, 0, 'b'},
         {"dev_dir", required_argument, 0, 'd'},
         {"given_is", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"result", required_argument, 0, 'r'},
         {"symlink", no_argument, 0, 's'},
+        {"sysfs", required_argument, 0, 'S'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
         {0, 0, 0, 0},
@@ -154,11 +163,19 @@ pr2serr(const char * fmt, ...)
 static void
 usage()
 {
-        pr2serr("Usage: sg_map26 [--dev_dir=DIR] [--given_is=0...1] [--help] "
-                "[--result=0...3]\n"
-                "                [--symlink] [--verbose] [--version] "
-                "DEVICE\n"
+        pr2serr("Usage: sg_map26 [--all] [--batch] [--dev_dir=DIR] "
+                "[--given_is=0...1]\n"
+                "                [--help] [--result=0...3] [--symlink] "
+                "[--sysfs=DIR]\n"
+                "                [--verbose] [--version] [DEVICE...]\n"
                 "  where:\n"
+                "    --all | -a        list all SCSI devices with their sg, "
+                "primary and\n"
+                "                      bsg device nodes\n"
+                "    --batch | -b      map each DEVICE (or each line from "
+                "stdin if\n"
+                "                      no DEVICE or DEVICE is '-') using an "
+                "index\n"
                 "    --dev_dir=DIR | -d DIR    search in DIR for "
                 "resulting special\n"
                 "                            (def: directory of DEVICE "
@@ -181,6 +198,9 @@ usage()
                 "path\n"
                 "    --symlink | -s    symlinks to special included in "
                 "result\n"
+                "    --sysfs=DIR | -S DIR    sysfs mount point for --all "
+                "and --batch\n"
+                "                            (def: /sys)\n"
                 "    --verbose | -v    increase verbosity of output\n"
                 "    --version | -V    print version string and exit\n\n"
                 "Maps SCSI device node to corresponding generic node (and "
@@ -1039,6 +1059,652 @@ map_sg(const char * device_name, const char * device_dir, int ma, int mi,
 }
 
 
+/*
+ * The --batch and --all modes build an index of the SCSI devices known to
+ * sysfs, and of the special files in the device directory, once. Then each
+ * query is answered from those indexes so mapping N devices costs one walk
+ * rather than N walks of sysfs and the device directory.
+ */
+
+#define IDX_SG 0
+#define IDX_PRIM 1      /* sd, sr, st, osst or sch */
+#define IDX_BSG 2
+#define IDX_NUM 3
+
+#define IDX_MEM_NAME_LEN 64
+#define IDX_MEM_REL_LEN 128
+
+struct idx_mem_t {              /* member of a class (e.g. sg3 or sda) */
+        bool valid;
+        int nt;                 /* NT_* value (NT_NO_MATCH for bsg) */
+        dev_t dev;
+        char name[IDX_MEM_NAME_LEN];
+        char rel[IDX_MEM_REL_LEN];      /* relative to sysfs device dir */
+};
+
+struct idx_dev_t {              /* a SCSI device (logical unit) */
+        int h, c, t;
+        uint64_t l;
+        char hctl[IDX_MEM_NAME_LEN];
+        struct idx_mem_t mem[IDX_NUM];
+};
+
+struct idx_dnode_t {            /* a special file in the device directory */
+        bool is_blk;
+        dev_t rdev;
+        char path[D_NAME_LEN_MAX];
+};
+
+struct idx_mkey_t {             /* a member found by its dev_t */
+        bool is_tape;
+        dev_t key;              /* tape minors normalised by TAPE_NR() */
+        int dev_i;              /* index into devs[] */
+        int which;              /* IDX_* */
+};
+
+struct sg_index_t {
+        int num_devs;
+        int num_dnodes;
+        int num_mkeys;
+        const char * sysfs_root;
+        struct idx_dev_t * devs;
+        struct idx_dnode_t * dnodes;    /* sorted by (is_blk, rdev) */
+        struct idx_mkey_t * mkeys;      /* sorted by (key, dev_i, which) */
+};
+
+static const struct idx_cls_t {
+        const char * cls;       /* name below sysfs device directory */
+        const char * prefix;    /* member name prefix, then only digits */
+        int nt;
+        int which;              /* IDX_* */
+} idx_cls_arr[] = {
+        {"scsi_generic", "sg", NT_SG, IDX_SG},
+        {"block", NULL, NT_SD, IDX_PRIM},       /* sd or sr from major */
+        {"scsi_tape", "st", NT_ST, IDX_PRIM},
+        {"onstream_tape", "os", NT_OSST, IDX_PRIM},
+        {"scsi_changer", "sch", NT_CH, IDX_PRIM},
+        {"bsg", NULL, NT_NO_MATCH, IDX_BSG},
+        {NULL, NULL, 0, 0},
+};
+
+static bool
+idx_member_ok(const struct idx_cls_t * clp, const char * name)
+{
+        int len;
+        const char * cp;
+
+        if ('.' == name[0])
+                return false;
+        if (NULL == clp->prefix)
+                return true;
+        len = strlen(clp->prefix);
+        if (strncmp(name, clp->prefix, len) || ('\0' == name[len]))
+                return false;
+        for (cp = name + len; *cp; ++cp) {
+                if (! isdigit((unsigned char)*cp))
+                        return false;
+        }
+        return true;
+}
+
+static bool
+idx_dev_from_str(const char * value, dev_t * devp)
+{
+        unsigned int ma, mi;
+
+        if (2 != sscanf(value, "%u:%u", &ma, &mi))
+                return false;
+        *devp = makedev(ma, mi);
+        return true;
+}
+
+/* Fills the members of dvp from the sysfs device directory, handles both
+ * the "block/sda" (directory) and older "block:sda" (symlink) layouts. */
+static void
+idx_scan_device(struct idx_dev_t * dvp, const char * base, int verbose)
+{
+        int len;
+        DIR * dp;
+        DIR * sdp;
+        struct dirent * dep;
+        struct dirent * sdep;
+        const struct idx_cls_t * clp;
+        struct idx_mem_t * mp;
+        const char * mname;
+        char b[D_NAME_LEN_MAX];
+        char rel[IDX_MEM_REL_LEN];
+        char value[NAME_LEN_MAX];
+
+        dp = opendir(base);
+        if (NULL == dp) {
+                if (verbose)
+                        pr2serr("opendir: %s %s\n", base,
+                                ssafe_strerror(errno));
+                return;
+        }
+        while ((dep = readdir(dp))) {
+                for (clp = idx_cls_arr; clp->cls; ++clp) {
+                        len = strlen(clp->cls);
+                        if (strncmp(dep->d_name, clp->cls, len))
+                                continue;
+                        if (dvp->mem[clp->which].valid)
+                                break;
+                        mname = NULL;
+                        if ('\0' == dep->d_name[len]) {
+                                snprintf(b, sizeof(b), "%.*s/%s",
+                                         NAME_LEN_MAX, base, clp->cls);
+                                sdp = opendir(b);
+                                if (NULL == sdp)
+                                        break;
+                                while ((sdep = readdir(sdp))) {
+                                        if (idx_member_ok(clp,
+                                                          sdep->d_name)) {
+                                                snprintf(rel, sizeof(rel),
+                                                         "%s/%.*s", clp->cls,
+                                                         IDX_MEM_NAME_LEN,
+                                                         sdep->d_name);
+                                                mname = rel + len + 1;
+                                                break;
+                                        }
+                                }
+                                closedir(sdp);
+                        } else if ((':' == dep->d_name[len]) &&
+                                   idx_member_ok(clp,
+                                                 dep->d_name + len + 1)) {
+                                snprintf(rel, sizeof(rel), "%.*s",
+                                         IDX_MEM_REL_LEN - 1, dep->d_name);
+                                mname = rel + len + 1;
+                        }
+                        if (NULL == mname)
+                                break;
+                        mp = dvp->mem + clp->which;
+                        snprintf(b, sizeof(b), "%.*s/%s", NAME_LEN_MAX, base,
+                                 rel);
+                        if ((! get_value(b, "dev", value, sizeof(value))) ||
+                            (! idx_dev_from_str(value, &mp->dev))) {
+                                if (verbose > 1)
+                                        pr2serr("no dev in %s\n", b);
+                                break;
+                        }
+                        mp->valid = true;
+                        mp->nt = (NT_SD == clp->nt) ?
+                                 nt_typ_from_major(major(mp->dev)) : clp->nt;
+                        snprintf(mp->name, sizeof(mp->name), "%s", mname);
+                        snprintf(mp->rel, sizeof(mp->rel), "%s", rel);
+                        break;
+                }
+        }
+        closedir(dp);
+}
+
+static int
+idx_dev_cmp(const void * a, const void * b)
+{
+        const struct idx_dev_t * lp = (const struct idx_dev_t *)a;
+        const struct idx_dev_t * rp = (const struct idx_dev_t *)b;
+
+        if (lp->h != rp->h)
+                return (lp->h < rp->h) ? -1 : 1;
+        if (lp->c != rp->c)
+                return (lp->c < rp->c) ? -1 : 1;
+        if (lp->t != rp->t)
+                return (lp->t < rp->t) ? -1 : 1;
+        if (lp->l != rp->l)
+                return (lp->l < rp->l) ? -1 : 1;
+        return strcmp(lp->hctl, rp->hctl);
+}
+
+/* One walk of <sysfs>/class/scsi_device . Returns 0 if okay. */
+static int
+idx_build_devs(struct sg_index_t * ip, int verbose)
+{
+        int mx = 0;
+        DIR * dp;
+        struct dirent * dep;
+        struct idx_dev_t * dvp;
+        char dir[D_NAME_LEN_MAX];
+        char base[D_NAME_LEN_MAX];
+
+        snprintf(dir, sizeof(dir), "%s/class/scsi_device", ip->sysfs_root);
+        dp = opendir(dir);
+        if (NULL == dp) {
+                if (ENOENT == errno)
+                        return 0;       /* no SCSI devices */
+                pr2serr("opendir: %s %s\n", dir, ssafe_strerror(errno));
+                return SG_LIB_FILE_ERROR;
+        }
+        while ((dep = readdir(dp))) {
+                if ('.' == dep->d_name[0])
+                        continue;
+                if (ip->num_devs >= mx) {
+                        mx = mx ? (2 * mx) : 256;
+                        dvp = (struct idx_dev_t *)realloc(ip->devs,
+                                        mx * sizeof(struct idx_dev_t));
+                        if (NULL == dvp) {
+                                closedir(dp);
+                                pr2serr("out of memory\n");
+                                return SG_LIB_CAT_OTHER;
+                        }
+                        ip->devs = dvp;
+                }
+                dvp = ip->devs + ip->num_devs++;
+                memset(dvp, 0, sizeof(*dvp));
+                if (4 != sscanf(dep->d_name, "%d:%d:%d:%" SCNu64, &dvp->h,
+                                &dvp->c, &dvp->t, &dvp->l))
+                        dvp->h = -1;
+                snprintf(dvp->hctl, sizeof(dvp->hctl), "%.*s",
+                         IDX_MEM_NAME_LEN - 1, dep->d_name);
+                snprintf(base, sizeof(base), "%.*s/%s/device", NAME_LEN_MAX,
+                         dir, dvp->hctl);
+                idx_scan_device(dvp, base, verbose);
+        }
+        closedir(dp);
+        if (ip->num_devs > 1)
+                qsort(ip->devs, ip->num_devs, sizeof(struct idx_dev_t),
+                      idx_dev_cmp);
+        return 0;
+}
+
+static int
+idx_dnode_cmp(const void * a, const void * b)
+{
+        const struct idx_dnode_t * lp = (const struct idx_dnode_t *)a;
+        const struct idx_dnode_t * rp = (const struct idx_dnode_t *)b;
+
+        if (lp->is_blk != rp->is_blk)
+                return lp->is_blk ? 1 : -1;
+        if (lp->rdev != rp->rdev)
+                return (lp->rdev < rp->rdev) ? -1 : 1;
+        return strcmp(lp->path, rp->path);
+}
+
+/* Adds the block and char special files in dir_name (not recursive) to
+ * the index. Symlinks are only followed when follow_symlink is true. */
+static int
+idx_add_dnodes(struct sg_index_t * ip, const char * dir_name,
+               bool follow_symlink, int * mxp)
+{
+        DIR * dp;
+        struct dirent * dep;
+        struct idx_dnode_t * dnp;
+        struct stat st;
+        char name[D_NAME_LEN_MAX];
+
+        dp = opendir(dir_name);
+        if (NULL == dp)
+                return -errno;
+        while ((dep = readdir(dp))) {
+                switch (dep->d_type) {
+                case DT_BLK:
+                case DT_CHR:
+                case DT_UNKNOWN:
+                        break;
+                case DT_LNK:
+                        if (follow_symlink)
+                                break;
+                        continue;
+                default:
+                        continue;
+                }
+                snprintf(name, sizeof(name), "%.*s/%.*s", NAME_LEN_MAX,
+                         dir_name, NAME_LEN_MAX, dep->d_name);
+                if (((DT_LNK == dep->d_type) ? stat(name, &st) :
+                                               lstat(name, &st)) < 0)
+                        continue;
+                if (! (S_ISBLK(st.st_mode) || S_ISCHR(st.st_mode)))
+                        continue;
+                if (ip->num_dnodes >= *mxp) {
+                        *mxp = *mxp ? (2 * *mxp) : 1024;
+                        dnp = (struct idx_dnode_t *)realloc(ip->dnodes,
+                                        *mxp * sizeof(struct idx_dnode_t));
+                        if (NULL == dnp) {
+                                closedir(dp);
+                                return -ENOMEM;
+                        }
+                        ip->dnodes = dnp;
+                }
+                dnp = ip->dnodes + ip->num_dnodes++;
+                dnp->is_blk = S_ISBLK(st.st_mode);
+                dnp->rdev = st.st_rdev;
+                snprintf(dnp->path, sizeof(dnp->path), "%s", name);
+        }
+        closedir(dp);
+        return 0;
+}
+
+static int
+idx_build_dnodes(struct sg_index_t * ip, const char * dev_dir,
+                 bool follow_symlink, int verbose)
+{
+        int res;
+        int mx = 0;
+        char b[D_NAME_LEN_MAX];
+
+        res = idx_add_dnodes(ip, dev_dir, follow_symlink, &mx);
+        if (res) {
+                pr2serr("scan of %s failed: %s\n", dev_dir,
+                        ssafe_strerror(-res));
+                return SG_LIB_FILE_ERROR;
+        }
+        /* bsg nodes live in a sub-directory */
+        snprintf(b, sizeof(b), "%s/bsg", dev_dir);
+        res = idx_add_dnodes(ip, b, follow_symlink, &mx);
+        if (res && (-ENOENT != res) && verbose)
+                pr2serr("scan of %s failed: %s\n", b, ssafe_strerror(-res));
+        if (ip->num_dnodes > 1)
+                qsort(ip->dnodes, ip->num_dnodes, sizeof(struct idx_dnode_t),
+                      idx_dnode_cmp);
+        return 0;
+}
+
+/* Returns index of first dnode with (is_blk, rdev) or -1 if none */
+static int
+idx_find_dnode(const struct sg_index_t * ip, bool is_blk, dev_t rdev)
+{
+        int lo = 0;
+        int hi = ip->num_dnodes;
+        int mid;
+        const struct idx_dnode_t * dnp;
+
+        while (lo < hi) {
+                mid = (lo + hi) / 2;
+                dnp = ip->dnodes + mid;
+                if ((dnp->is_blk < is_blk) ||
+                    ((dnp->is_blk == is_blk) && (dnp->rdev < rdev)))
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        if ((lo < ip->num_dnodes) && (ip->dnodes[lo].is_blk == is_blk) &&
+            (ip->dnodes[lo].rdev == rdev))
+                return lo;
+        return -1;
+}
+
+/* Outputs (with a leading space) each special file matching (is_blk,
+ * rdev). Returns the number output. */
+static int
+idx_pr_dnodes(const struct sg_index_t * ip, bool is_blk, dev_t rdev,
+              bool first_only)
+{
+        int k, n;
+
+        k = idx_find_dnode(ip, is_blk, rdev);
+        if (k < 0)
+                return 0;
+        for (n = 0; k < ip->num_dnodes; ++k, ++n) {
+                if ((ip->dnodes[k].is_blk != is_blk) ||
+                    (ip->dnodes[k].rdev != rdev))
+                        break;
+                if (first_only && (n > 0))
+                        break;
+                printf(" %s", ip->dnodes[k].path);
+        }
+        return n;
+}
+
+static bool
+idx_mem_is_blk(const struct idx_mem_t * mp)
+{
+        return (NT_SD == mp->nt) || (NT_SR == mp->nt) || (NT_HD == mp->nt);
+}
+
+static void
+idx_pr_sysfs(const struct sg_index_t * ip, const struct idx_dev_t * dvp,
+             const struct idx_mem_t * mp)
+{
+        char b[D_NAME_LEN_MAX];
+        char rp[PATH_MAX];
+
+        snprintf(b, sizeof(b), "%s/class/scsi_device/%s/device/%s",
+                 ip->sysfs_root, dvp->hctl, mp->rel);
+        printf(" %s", realpath(b, rp) ? rp : b);
+}
+
+/* Tape devices have several minors (e.g. st0, nst0, st0a) per member so
+ * their keys hold the tape number in place of the minor. */
+static dev_t
+idx_tape_key(dev_t rdev)
+{
+        return makedev(major(rdev), TAPE_NR(minor(rdev)));
+}
+
+static int
+idx_mkey_cmp(const void * a, const void * b)
+{
+        const struct idx_mkey_t * lp = (const struct idx_mkey_t *)a;
+        const struct idx_mkey_t * rp = (const struct idx_mkey_t *)b;
+
+        if (lp->key != rp->key)
+                return (lp->key < rp->key) ? -1 : 1;
+        if (lp->dev_i != rp->dev_i)
+                return (lp->dev_i < rp->dev_i) ? -1 : 1;
+        return lp->which - rp->which;
+}
+
+/* Builds the members' index sorted by dev_t, call after idx_build_devs().
+ * Returns 0 if okay. */
+static int
+idx_build_mkeys(struct sg_index_t * ip)
+{
+        int k, w;
+        const struct idx_mem_t * mp;
+        struct idx_mkey_t * mkp;
+
+        if (0 == ip->num_devs)
+                return 0;
+        ip->mkeys = (struct idx_mkey_t *)calloc(ip->num_devs * IDX_NUM,
+                                                sizeof(struct idx_mkey_t));
+        if (NULL == ip->mkeys) {
+                pr2serr("out of memory\n");
+                return SG_LIB_CAT_OTHER;
+        }
+        for (k = 0; k < ip->num_devs; ++k) {
+                for (w = 0; w < IDX_NUM; ++w) {
+                        mp = ip->devs[k].mem + w;
+                        if (! mp->valid)
+                                continue;
+                        mkp = ip->mkeys + ip->num_mkeys++;
+                        mkp->is_tape = (NT_ST == mp->nt) ||
+                                       (NT_OSST == mp->nt);
+                        mkp->key = mkp->is_tape ? idx_tape_key(mp->dev) :
+                                                  mp->dev;
+                        mkp->dev_i = k;
+                        mkp->which = w;
+                }
+        }
+        if (ip->num_mkeys > 1)
+                qsort(ip->mkeys, ip->num_mkeys, sizeof(struct idx_mkey_t),
+                      idx_mkey_cmp);
+        return 0;
+}
+
+/* Binary search for the first member with 'key' whose is_tape matches and,
+ * if blk_known, whose is_blk matches. Returns its mkeys[] index or -1. */
+static int
+idx_find_mkey(const struct sg_index_t * ip, dev_t key, bool is_tape,
+              bool blk_known, bool is_blk)
+{
+        int lo = 0;
+        int hi = ip->num_mkeys;
+        int mid;
+        const struct idx_mkey_t * mkp;
+
+        while (lo < hi) {
+                mid = (lo + hi) / 2;
+                if (ip->mkeys[mid].key < key)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        for ( ; lo < ip->num_mkeys; ++lo) {
+                mkp = ip->mkeys + lo;
+                if (mkp->key != key)
+                        break;
+                if ((mkp->is_tape == is_tape) &&
+                    ((! blk_known) ||
+                     (is_blk == idx_mem_is_blk(ip->devs[mkp->dev_i].mem +
+                                               mkp->which))))
+                        return lo;
+        }
+        return -1;
+}
+
+/* Maps one given name using the index. Outputs a line starting with the
+ * given name followed by the result(s) or '-'. Returns 0 if found. */
+static int
+idx_query(const struct sg_index_t * ip, const char * given, int result,
+          int verbose)
+{
+        bool is_blk = false;
+        bool blk_known = false;
+        int k, w, m, n;
+        dev_t rdev;
+        struct stat st;
+        const struct idx_dev_t * dvp = NULL;
+        const struct idx_mem_t * mp;
+        char value[D_NAME_LEN_MAX];
+
+        n = 0;
+        if (stat(given, &st) < 0) {
+                if (verbose)
+                        pr2serr("stat failed on %s: %s\n", given,
+                                ssafe_strerror(errno));
+                goto fini;
+        }
+        if (S_ISBLK(st.st_mode) || S_ISCHR(st.st_mode)) {
+                rdev = st.st_rdev;
+                is_blk = S_ISBLK(st.st_mode);
+                blk_known = true;
+        } else if (! ((S_ISDIR(st.st_mode) ?
+                       get_value(given, "dev", value, sizeof(value)) :
+                       get_value(NULL, given, value, sizeof(value))) &&
+                      idx_dev_from_str(value, &rdev))) {
+                if (verbose)
+                        pr2serr("Couldn't decode dev from %s\n", given);
+                goto fini;
+        }
+        k = idx_find_mkey(ip, rdev, false, blk_known, is_blk);
+        if (k < 0)
+                k = idx_find_mkey(ip, idx_tape_key(rdev), true, blk_known,
+                                  is_blk);
+        if (k < 0)
+                goto fini;
+        dvp = ip->devs + ip->mkeys[k].dev_i;
+        w = ip->mkeys[k].which;
+        if (verbose)
+                pr2serr(" %s: %s [%s]\n", given, dvp->mem[w].name,
+                        dvp->hctl);
+        /* sg maps to primary; others (including bsg) map to sg */
+        m = (IDX_SG == w) ? IDX_PRIM : IDX_SG;
+        mp = (result < 2) ? (dvp->mem + m) : (dvp->mem + w);
+        if (! mp->valid)
+                goto fini;
+        printf("%s", given);
+        if (result & 1) {
+                idx_pr_sysfs(ip, dvp, mp);
+                n = 1;
+        } else
+                n = idx_pr_dnodes(ip, idx_mem_is_blk(mp),
+                                  (2 == result) ? rdev : mp->dev, false);
+        printf("%s\n", (n > 0) ? "" : " -");
+        return (n > 0) ? 0 : 1;
+fini:
+        printf("%s -\n", given);
+        return 1;
+}
+
+/* Outputs one line per SCSI device: [H:C:T:L] then sg, primary and bsg
+ * special files ('-' when absent). */
+static void
+idx_dump(const struct sg_index_t * ip, int result)
+{
+        int k, w;
+        const struct idx_dev_t * dvp;
+        const struct idx_mem_t * mp;
+        static const int order[IDX_NUM] = {IDX_SG, IDX_PRIM, IDX_BSG};
+
+        for (k = 0; k < ip->num_devs; ++k) {
+                dvp = ip->devs + k;
+                printf("[%s]", dvp->hctl);
+                for (w = 0; w < IDX_NUM; ++w) {
+                        mp = dvp->mem + order[w];
+                        if (! mp->valid)
+                                printf(" -");
+                        else if (result & 1)
+                                idx_pr_sysfs(ip, dvp, mp);
+                        else if (0 == idx_pr_dnodes(ip, idx_mem_is_blk(mp),
+                                                    mp->dev, true))
+                                printf(" -");
+                }
+                printf("\n");
+        }
+}
+
+/* Handles --all and --batch. Returns exit status. */
+static int
+do_index_mode(bool do_all, int argc, char * argv[], int first_dev,
+              const char * dev_dir, const char * sysfs_root, int result,
+              bool follow_symlink, int verbose)
+{
+        bool from_stdin;
+        int k, len, res;
+        int ret = 0;
+        char * cp;
+        struct sg_index_t idx;
+        char line[D_NAME_LEN_MAX];
+
+        memset(&idx, 0, sizeof(idx));
+        idx.sysfs_root = sysfs_root;
+        res = idx_build_devs(&idx, verbose);
+        if (0 == res)
+                res = idx_build_dnodes(&idx, dev_dir, follow_symlink,
+                                       verbose);
+        if (res) {
+                ret = res;
+                goto fini;
+        }
+        if (verbose)
+                pr2serr("index: %d SCSI devices, %d special files in %s\n",
+                        idx.num_devs, idx.num_dnodes, dev_dir);
+        if (do_all) {
+                idx_dump(&idx, result);
+                goto fini;
+        }
+        res = idx_build_mkeys(&idx);
+        if (res) {
+                ret = res;
+                goto fini;
+        }
+        from_stdin = (first_dev >= argc);
+        for (k = first_dev; k < argc; ++k) {
+                if (0 == strcmp("-", argv[k]))
+                        from_stdin = true;
+                else if (idx_query(&idx, argv[k], result, verbose))
+                        ret = 1;
+        }
+        if (from_stdin) {
+                while (fgets(line, sizeof(line), stdin)) {
+                        for (cp = line; isspace((unsigned char)*cp); ++cp)
+                                ;
+                        len = strlen(cp);
+                        while ((len > 0) &&
+                               isspace((unsigned char)cp[len - 1]))
+                                cp[--len] = '\0';
+                        if ((0 == len) || ('#' == cp[0]))
+                                continue;
+                        if (idx_query(&idx, cp, result, verbose))
+                                ret = 1;
+                }
+        }
+fini:
+        free(idx.devs);
+        free(idx.dnodes);
+        free(idx.mkeys);
+        return ret;
+}
+
+
 int
 main(int argc, char * argv[])
 {
@@ -1049,8 +1715,11 @@ main(int argc, char * argv[])
         int verbose = 0;
         int ret = 1;
         int ma, mi;
+        bool do_all = false;
+        bool do_batch = false;
         bool do_dev_dir = false;
         bool follow_symlink = false;
+        const char * sysfs_root = def_sysfs_root;
         char device_name[D_NAME_LEN_MAX];
         char device_dir[D_NAME_LEN_MAX];
         char value[D_NAME_LEN_MAX];
@@ -1060,12 +1729,18 @@ main(int argc, char * argv[])
         while (1) {
                 int option_index = 0;
 
-                c = getopt_long(argc, argv, "d:hg:r:svV", long_options,
+                c = getopt_long(argc, argv, "abd:hg:r:sS:vV", long_options,
                                 &option_index);
                 if (c == -1)
                         break;
 
                 switch (c) {
+                case 'a':
+                        do_all = true;
+                        break;
+                case 'b':
+                        do_batch = true;
+                        break;
                 case 'd':
                         strncpy(device_dir, optarg, sizeof(device_dir) - 1);
                         do_dev_dir = true;
@@ -1097,6 +1772,9 @@ main(int argc, char * argv[])
                 case 's':
                         follow_symlink = true;
                         break;
+                case 'S':
+                        sysfs_root = optarg;
+                        break;
                 case 'v':
                         ++verbose;
                         break;
@@ -1109,6 +1787,19 @@ main(int argc, char * argv[])
                         return SG_LIB_SYNTAX_ERROR;
                 }
         }
+        if (do_all || do_batch) {
+                if (do_all && (optind < argc)) {
+                        pr2serr("--all does not take a DEVICE\n");
+                        return SG_LIB_SYNTAX_ERROR;
+                }
+                if (given_is >= 0)
+                        pr2serr("--given_is= ignored with --all and "
+                                "--batch\n");
+                return do_index_mode(do_all, argc, argv, optind,
+                                     do_dev_dir ? device_dir : def_dev_dir,
+                                     sysfs_root, result, follow_symlink,
+                                     verbose);
+        }
         if (optind < argc) {
                 if ('\0' == device_name[0]) {
                         strncpy(device_name, argv[optind],
@@ -9,7 +9,9 @@
  *
  * This program uses the SCSI command READ BUFFER on the given
  * device, first to find out how big it is and then to read that
- * buffer (data mode, buffer id 0).
+ * buffer (data mode, buffer id 0). Optionally several threads, each with
+ * a queue of commands, can be used to saturate the transport and the
+ * echo buffer can be written then read back (and checked).
  */
 
 
@@ -34,6 +36,8 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -51,27 +55,37 @@
 #define RB_DEF_SIZE (200*1024*1024)
 #define RB_OPCODE 0x3C
 #define RB_CMD_LEN 10
+#define WB_OPCODE 0x3B
+#define RB_MAX_QD 256
+#define RB_MAX_THREADS 256
+#define RB_MAX_RETRIES 3
+#define RB_SENSE_LEN 32
 
 #ifndef SG_FLAG_MMAP_IO
 #define SG_FLAG_MMAP_IO 4
 #endif
 
 
-static const char * version_str = "5.05 20180627";
+static const char * version_str = "5.06 20261018";
 
 static struct option long_options[] = {
         {"buffer", required_argument, 0, 'b'},
         {"dio", no_argument, 0, 'd'},
+        {"duration", required_argument, 0, 'D'},
         {"echo", no_argument, 0, 'e'},
         {"help", no_argument, 0, 'h'},
+        {"interval", required_argument, 0, 'i'},
         {"mmap", no_argument, 0, 'm'},
         {"new", no_argument, 0, 'N'},
         {"old", no_argument, 0, 'O'},
+        {"qd", required_argument, 0, 'Q'},
         {"quick", no_argument, 0, 'q'},
         {"size", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 'T'},
         {"time", no_argument, 0, 't'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
+        {"write", no_argument, 0, 'w'},
         {0, 0, 0, 0},
 };
 
@@ -81,11 +95,16 @@ struct opts_t {
     bool do_mmap;
     bool do_quick;
     bool do_time;
+    bool do_write;      /* write echo buffer then read it back */
     bool verbose_given;
     bool version_given;
     bool opt_new;
     int do_buffer;
     int do_help;
+    int duration;       /* run for this many seconds (ignore --size) */
+    int interval;       /* report MB/sec every this many seconds */
+    int num_threads;
+    int qd;             /* commands outstanding per thread */
     int verbose;
     int64_t do_size;
     const char * device_name;
@@ -95,24 +114,41 @@ struct opts_t {
 static void
 usage()
 {
-    pr2serr("Usage: sg_rbuf [--buffer=EACH] [--dio] [--echo] "
-            "[--help] [--mmap]\n"
-            "               [--quick] [--size=OVERALL] [--time] [--verbose] "
-            "[--version]\n"
+    pr2serr("Usage: sg_rbuf [--buffer=EACH] [--dio] [--duration=SECS] "
+            "[--echo] [--help]\n"
+            "               [--interval=SECS] [--mmap] [--qd=QD] [--quick] "
+            "[--size=OVERALL]\n"
+            "               [--threads=NT] [--time] [--verbose] [--version] "
+            "[--write]\n"
             "               SG_DEVICE\n");
     pr2serr("  where:\n"
             "    --buffer=EACH|-b EACH    buffer size to use (in bytes)\n"
             "    --dio|-d        requests dio ('-q' overrides it)\n"
+            "    --duration=SECS|-D SECS    run for SECS seconds rather "
+            "than\n"
+            "                               reading OVERALL bytes\n"
             "    --echo|-e       use echo buffer (def: use data mode)\n"
             "    --help|-h       print usage message then exit\n"
+            "    --interval=SECS|-i SECS    report MB/sec and IOPS every "
+            "SECS\n"
+            "                               seconds\n"
             "    --mmap|-m       requests mmap-ed IO (overrides -q, -d)\n"
-            "    --quick|-q      quick, don't xfer to user space\n");
+            "    --qd=QD|-Q QD    commands queued per thread (def: 1, "
+            "max: %d)\n"
+            "    --quick|-q      quick, don't xfer to user space\n",
+            RB_MAX_QD);
     pr2serr("    --size=OVERALL|-s OVERALL    total size to read (in bytes)\n"
             "                    default: 200 MiB\n"
+            "    --threads=NT|-T NT    number of threads, each with its own "
+            "file\n"
+            "                          descriptor (def: 1)\n"
             "    --time|-t       time the data transfer\n"
             "    --verbose|-v    increase verbosity (more debug)\n"
             "    --old|-O        use old interface (use as first option)\n"
-            "    --version|-V    print version string then exit\n\n"
+            "    --version|-V    print version string then exit\n"
+            "    --write|-w      write echo buffer then read it back and "
+            "check\n"
+            "                    (implies '--echo')\n\n"
             "Use SCSI READ BUFFER command (data or echo buffer mode, buffer "
             "id 0)\nrepeatedly. This utility only works with Linux sg "
             "devices.\n");
@@ -131,7 +167,6 @@ usage_old()
     printf("    -q       quick, don't xfer to user space\n");
     printf("    -s=OVERALL_MIB    num is total size to read (in MiB) "
            "(default: 200 MiB)\n");
-    printf("             maximum total size is 4000 MiB\n");
     printf("    -t       time the data transfer\n");
     printf("    -v       increase verbosity (more debug)\n");
     printf("    -N|--new use new interface\n");
@@ -159,7 +194,7 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:dehmNOqs:tvV", long_options,
+        c = getopt_long(argc, argv, "b:dD:ehi:mNOqQ:s:tT:vVw", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -177,6 +212,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'd':
             op->do_dio = true;
             break;
+        case 'D':
+            n = sg_get_num(optarg);
+            if (n < 1) {
+                pr2serr("bad argument to '--duration', expect 1 or more "
+                        "seconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->duration = n;
+            break;
         case 'e':
             op->do_echo = true;
             break;
@@ -184,6 +228,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case '?':
             ++op->do_help;
             break;
+        case 'i':
+            n = sg_get_num(optarg);
+            if (n < 1) {
+                pr2serr("bad argument to '--interval', expect 1 or more "
+                        "seconds\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->interval = n;
+            break;
         case 'm':
             op->do_mmap = true;
             break;
@@ -195,6 +248,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'q':
             op->do_quick = true;
             break;
+        case 'Q':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > RB_MAX_QD)) {
+                pr2serr("bad argument to '--qd', expect 1 to %d\n",
+                        RB_MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->qd = n;
+            break;
         case 's':
            nn = sg_get_llnum(optarg);
            if (nn < 0) {
@@ -207,6 +269,15 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 't':
             op->do_time = true;
             break;
+        case 'T':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > RB_MAX_THREADS)) {
+                pr2serr("bad argument to '--threads', expect 1 to %d\n",
+                        RB_MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_threads = n;
+            break;
         case 'v':
             op->verbose_given = true;
             ++op->verbose;
@@ -214,6 +285,10 @@ new_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
         case 'V':
             op->version_given = true;
             break;
+        case 'w':
+            op->do_write = true;
+            op->do_echo = true;
+            break;
         default:
             pr2serr("unrecognised option code %c [0x%x]\n", c, c);
             if (op->do_help)
@@ -303,7 +378,7 @@ old_parse_cmd_line(struct opts_t * op, int argc, char * argv[])
                 op->do_buffer *= 1024;
             }
             else if (0 == strncmp("s=", cp, 2)) {
-                nn = sg_get_llnum(optarg);
+                nn = sg_get_llnum(cp + 2);
                 if (nn < 0) {
                     printf("Couldn't decode number after 's=' option\n");
                     usage_for(op);
@@ -352,6 +427,489 @@ parse_cmd_line(struct opts_t * op, int argc, char * argv[])
 }
 
 
+/* One queued command; with --write each slot alternates between WRITE
+ * BUFFER and READ BUFFER (echo mode). */
+struct rb_slot {
+    bool busy;
+    bool writing;
+    int retries;
+    uint8_t * buffp;
+    uint8_t * free_buffp;
+    uint8_t cdb[RB_CMD_LEN];
+    uint8_t sense[RB_SENSE_LEN];
+    struct sg_io_hdr io_hdr;
+};
+
+/* Shared by all worker threads, counters protected by 'mutex' */
+struct rb_shared {
+    const struct opts_t * op;
+    int buf_size;
+    const uint8_t * pattern;    /* data written to echo buffer */
+    int64_t num_cmds;           /* 0 -> until stop (--duration) */
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;          /* signalled when last worker exits */
+    bool stop;
+    bool dio_incomplete;
+    int running;
+    int exit_status;
+    int64_t started;
+    int64_t cmds;
+    int64_t bytes;
+    int64_t miscompares;
+};
+
+static double
+ts_diff_secs(const struct timespec * a, const struct timespec * b)
+{
+    return (double)(b->tv_sec - a->tv_sec) +
+           ((b->tv_nsec - a->tv_nsec) / 1000000000.0);
+}
+
+/* Returns true if another READ BUFFER (or WRITE+READ pair) may be started */
+static bool
+rb_claim(struct rb_shared * shp)
+{
+    bool ok;
+
+    pthread_mutex_lock(&shp->mutex);
+    ok = ! shp->stop;
+    if (ok && (shp->num_cmds > 0)) {
+        if (shp->started < shp->num_cmds)
+            ++shp->started;
+        else
+            ok = false;
+    }
+    pthread_mutex_unlock(&shp->mutex);
+    return ok;
+}
+
+static void
+rb_unclaim(struct rb_shared * shp)
+{
+    pthread_mutex_lock(&shp->mutex);
+    if (shp->num_cmds > 0)
+        --shp->started;
+    pthread_mutex_unlock(&shp->mutex);
+}
+
+/* First error wins, it also tells all threads to stop */
+static void
+rb_set_status(struct rb_shared * shp, int status)
+{
+    pthread_mutex_lock(&shp->mutex);
+    if (0 == shp->exit_status)
+        shp->exit_status = status;
+    shp->stop = true;
+    pthread_mutex_unlock(&shp->mutex);
+}
+
+/* Submits one command with the sg v3 asynchronous interface. Returns 0 if
+ * ok, 1 if the sg driver's queue is full, else -1 . */
+static int
+rb_submit(int sg_fd, struct rb_slot * sp, const struct rb_shared * shp)
+{
+    int k, res;
+    const struct opts_t * op = shp->op;
+    struct sg_io_hdr * hp = &sp->io_hdr;
+
+    memset(sp->cdb, 0, RB_CMD_LEN);
+    sp->cdb[0] = sp->writing ? WB_OPCODE : RB_OPCODE;
+    sp->cdb[1] = op->do_echo ? RB_MODE_ECHO_DATA : RB_MODE_DATA;
+    sg_put_unaligned_be24((uint32_t)shp->buf_size, sp->cdb + 6);
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = RB_CMD_LEN;
+    hp->mx_sb_len = RB_SENSE_LEN;
+    hp->dxfer_len = shp->buf_size;
+    if (sp->writing) {
+        hp->dxfer_direction = SG_DXFER_TO_DEV;
+        /* sg driver only reads from this buffer so casting away const ok */
+        hp->dxferp = (void *)shp->pattern;
+    } else {
+        hp->dxfer_direction = SG_DXFER_FROM_DEV;
+        if (! op->do_mmap)
+            hp->dxferp = sp->buffp;
+    }
+    hp->cmdp = sp->cdb;
+    hp->sbp = sp->sense;
+    hp->timeout = 20000;     /* 20000 millisecs == 20 seconds */
+    hp->usr_ptr = sp;
+    if (op->do_mmap)
+        hp->flags |= SG_FLAG_MMAP_IO;
+    else if (op->do_dio)
+        hp->flags |= SG_FLAG_DIRECT_IO;
+    else if (op->do_quick)
+        hp->flags |= SG_FLAG_NO_DXFER;
+    if (op->verbose > 1) {
+        pr2serr("    %s buffer (%sdata) cdb: ",
+                (sp->writing ? "Write" : "Read"),
+                (op->do_echo ? "echo " : ""));
+        for (k = 0; k < RB_CMD_LEN; ++k)
+            pr2serr("%02x ", sp->cdb[k]);
+        pr2serr("\n");
+    }
+    while (((res = write(sg_fd, hp, sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res >= 0)
+        return 0;
+    if ((EDOM == errno) || (EAGAIN == errno) || (EBUSY == errno))
+        return 1;
+    if (ENOMEM == errno)
+        pr2serr("write(sg_io_hdr): out of memory, try a smaller buffer "
+                "size than %d bytes\n", shp->buf_size);
+    else
+        perror("write(sg_io_hdr) on sg device, error");
+    return -1;
+}
+
+/* Each worker thread opens its own file descriptor to the sg device and
+ * keeps up to QD commands outstanding on it until told to stop or the
+ * overall number of commands has been started. */
+static void *
+rb_worker(void * v_shp)
+{
+    bool dio_incomplete = false;
+    int sg_fd, k, res, cat;
+    int outstanding = 0;
+    int64_t cmds = 0;
+    int64_t bytes = 0;
+    int64_t miscompares = 0;
+    struct rb_shared * shp = (struct rb_shared *)v_shp;
+    const struct opts_t * op = shp->op;
+    int qd = (op->qd > 0) ? op->qd : 1;
+    int cur_qd = qd;
+    uint8_t * mmap_bp = NULL;
+    struct rb_slot * slots = NULL;
+    struct rb_slot * sp;
+    struct sg_io_hdr io_hdr;
+
+    sg_fd = open(op->device_name, op->do_write ? O_RDWR : O_RDONLY);
+    if (sg_fd < 0) {
+        res = errno;
+        perror("worker thread device open error");
+        rb_set_status(shp, sg_convert_errno(res));
+        goto fini;
+    }
+    if (! op->do_dio) {
+        k = shp->buf_size;
+        if (op->do_mmap) {
+            size_t psz = sysconf(_SC_PAGESIZE);
+
+            k = ((k + psz - 1) / psz) * psz;    /* round up to page size */
+        }
+        if (ioctl(sg_fd, SG_SET_RESERVED_SIZE, &k) < 0)
+            perror("SG_SET_RESERVED_SIZE error");
+    }
+    k = 1;
+    if ((qd > 1) && (ioctl(sg_fd, SG_SET_COMMAND_Q, &k) < 0))
+        perror("SG_SET_COMMAND_Q error");
+    slots = (struct rb_slot *)calloc(qd, sizeof(struct rb_slot));
+    if (NULL == slots) {
+        pr2serr("out of memory (slots)\n");
+        rb_set_status(shp, SG_LIB_CAT_OTHER);
+        goto fini;
+    }
+    if (op->do_mmap) {
+        mmap_bp = (uint8_t *)mmap(NULL, shp->buf_size, PROT_READ, MAP_SHARED,
+                                  sg_fd, 0);
+        if (MAP_FAILED == mmap_bp) {
+            mmap_bp = NULL;
+            perror("error using mmap()");
+            rb_set_status(shp, SG_LIB_CAT_OTHER);
+            goto fini;
+        }
+        slots[0].buffp = mmap_bp;
+    } else {
+        for (k = 0; k < qd; ++k) {
+            sp = slots + k;
+            sp->buffp = sg_memalign(shp->buf_size, 0, &sp->free_buffp,
+                                    op->verbose > 3);
+            if (NULL == sp->buffp) {
+                pr2serr("out of memory (data)\n");
+                rb_set_status(shp, SG_LIB_CAT_OTHER);
+                goto fini;
+            }
+        }
+    }
+
+    while (1) {
+        for (k = 0; (outstanding < cur_qd) && (k < qd); ++k) {
+            sp = slots + k;
+            if (sp->busy)
+                continue;
+            if (! rb_claim(shp))
+                break;
+            sp->writing = op->do_write;
+            sp->retries = 0;
+            res = rb_submit(sg_fd, sp, shp);
+            if (1 == res) {
+                rb_unclaim(shp);
+                if (0 == outstanding) {
+                    pr2serr("sg driver will not queue any commands\n");
+                    rb_set_status(shp, SG_LIB_CAT_OTHER);
+                } else {
+                    if (op->verbose)
+                        pr2serr("sg driver queue full, reducing queue depth "
+                                "to %d\n", outstanding);
+                    cur_qd = outstanding;
+                }
+                break;
+            } else if (res < 0) {
+                rb_unclaim(shp);
+                rb_set_status(shp, SG_LIB_CAT_OTHER);
+                break;
+            }
+            sp->busy = true;
+            ++outstanding;
+        }
+        if (0 == outstanding)
+            break;
+        memset(&io_hdr, 0, sizeof(io_hdr));
+        io_hdr.interface_id = 'S';
+        io_hdr.pack_id = -1;    /* any completed command */
+        while (((res = read(sg_fd, &io_hdr, sizeof(io_hdr))) < 0) &&
+               (EINTR == errno))
+            ;
+        if (res < 0) {
+            res = errno;
+            perror("read(sg_io_hdr) on sg device, error");
+            rb_set_status(shp, sg_convert_errno(res));
+            break;
+        }
+        sp = (struct rb_slot *)io_hdr.usr_ptr;
+        if ((sp < slots) || (sp >= (slots + qd)) || (! sp->busy)) {
+            pr2serr("unexpected usr_ptr from sg driver\n");
+            rb_set_status(shp, SG_LIB_CAT_OTHER);
+            break;
+        }
+        if (op->verbose > 2)
+            pr2serr("      duration=%u ms\n", io_hdr.duration);
+        cat = sg_err_category3(&io_hdr);
+        switch (cat) {
+        case SG_LIB_CAT_CLEAN:
+            break;
+        case SG_LIB_CAT_RECOVERED:
+            if (op->verbose > 1)
+                sg_chk_n_print3("READ BUFFER data, continuing", &io_hdr,
+                                true);
+            cat = SG_LIB_CAT_CLEAN;
+            break;
+        case SG_LIB_CAT_UNIT_ATTENTION:
+        case SG_LIB_CAT_ABORTED_COMMAND:
+            /* includes ECHO BUFFER OVERWRITTEN, so restart the pair */
+            if (op->verbose)
+                sg_chk_n_print3(sp->writing ? "WRITE BUFFER" : "READ BUFFER",
+                                &io_hdr, op->verbose > 1);
+            if (sp->retries < RB_MAX_RETRIES) {
+                ++sp->retries;
+                sp->writing = op->do_write;
+                if (0 == rb_submit(sg_fd, sp, shp))
+                    continue;   /* resubmitted, sp still busy */
+            }
+            break;
+        default:
+            sg_chk_n_print3(sp->writing ? "WRITE BUFFER data error" :
+                            "READ BUFFER data error", &io_hdr,
+                            op->verbose > 1);
+            break;
+        }
+        if (SG_LIB_CAT_CLEAN != cat) {
+            rb_set_status(shp, (cat >= 0) ? cat : SG_LIB_CAT_OTHER);
+            sp->busy = false;
+            --outstanding;
+            continue;           /* reap what is still outstanding */
+        }
+        if (op->do_dio &&
+            ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+            dio_incomplete = true;
+        ++cmds;
+        bytes += shp->buf_size - io_hdr.resid;
+        if (sp->writing) {      /* now read back what was written */
+            sp->writing = false;
+            if (0 == rb_submit(sg_fd, sp, shp))
+                continue;
+            rb_set_status(shp, SG_LIB_CAT_OTHER);
+        } else if (op->do_write &&
+                   memcmp(sp->buffp, shp->pattern, shp->buf_size)) {
+            ++miscompares;
+            if (op->verbose)
+                pr2serr("echo buffer read back differs from data "
+                        "written\n");
+        }
+        sp->busy = false;
+        --outstanding;
+        pthread_mutex_lock(&shp->mutex);
+        shp->cmds += cmds;
+        shp->bytes += bytes;
+        shp->miscompares += miscompares;
+        pthread_mutex_unlock(&shp->mutex);
+        cmds = 0;
+        bytes = 0;
+        miscompares = 0;
+    }
+fini:
+    if (slots) {
+        for (k = 0; k < qd; ++k) {
+            if (slots[k].free_buffp)
+                free(slots[k].free_buffp);
+        }
+        free(slots);
+    }
+    if (mmap_bp)
+        munmap(mmap_bp, shp->buf_size);
+    if (sg_fd >= 0)
+        close(sg_fd);
+    pthread_mutex_lock(&shp->mutex);
+    shp->cmds += cmds;
+    shp->bytes += bytes;
+    shp->miscompares += miscompares;
+    if (dio_incomplete)
+        shp->dio_incomplete = true;
+    if (--shp->running <= 0)
+        pthread_cond_signal(&shp->cv);
+    pthread_mutex_unlock(&shp->mutex);
+    return NULL;
+}
+
+/* Runs NT threads each with QD commands outstanding. The main thread waits
+ * for them, printing MB/sec every --interval and setting the stop flag
+ * when --duration expires. Returns 0 if ok, else an SG_LIB_* error code. */
+static int
+rb_multi(const struct opts_t * op, int buf_size, int64_t total_size)
+{
+    bool stopped = false;
+    int k, res;
+    int nt = (op->num_threads > 0) ? op->num_threads : 1;
+    int qd = (op->qd > 0) ? op->qd : 1;
+    int64_t cmds, bytes;
+    int64_t prev_cmds = 0;
+    int64_t prev_bytes = 0;
+    double secs;
+    uint8_t * pat_free_bp = NULL;
+    uint8_t * pat_bp = NULL;
+    pthread_t * tids;
+    pthread_condattr_t cattr;
+    struct timespec start_ts, now_ts, ival_ts, wait_ts, end_ts;
+    struct rb_shared sh;
+
+    tids = (pthread_t *)calloc(nt, sizeof(pthread_t));
+    if (NULL == tids) {
+        pr2serr("out of memory (threads)\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    memset(&sh, 0, sizeof(sh));
+    sh.op = op;
+    sh.buf_size = buf_size;
+    sh.num_cmds = (op->duration > 0) ? 0 : (total_size / buf_size);
+    if ((op->duration <= 0) && (sh.num_cmds < 1)) {
+        pr2serr("OVERALL size smaller than buffer size, nothing to do\n");
+        free(tids);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->do_write) {
+        uint32_t seed = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+
+        pat_bp = sg_memalign(buf_size, 0, &pat_free_bp, op->verbose > 3);
+        if (NULL == pat_bp) {
+            pr2serr("out of memory (pattern)\n");
+            free(tids);
+            return SG_LIB_CAT_OTHER;
+        }
+        /* differs from run to run so stale echo buffer contents show up */
+        for (k = 0; k < buf_size; ++k) {
+            seed = (seed * 1103515245) + 12345;
+            pat_bp[k] = (uint8_t)(seed >> 16);
+        }
+        sh.pattern = pat_bp;
+    }
+    pthread_mutex_init(&sh.mutex, NULL);
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sh.cv, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    ival_ts = start_ts;
+    end_ts = start_ts;
+    end_ts.tv_sec += op->duration;
+    pthread_mutex_lock(&sh.mutex);
+    for (k = 0; k < nt; ++k) {
+        res = pthread_create(tids + k, NULL, rb_worker, &sh);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            sh.stop = true;
+            sh.exit_status = SG_LIB_CAT_OTHER;
+            break;
+        }
+        ++sh.running;
+    }
+    nt = k;
+    while (sh.running > 0) {
+        if (op->interval > 0) {
+            wait_ts = ival_ts;
+            wait_ts.tv_sec += op->interval;
+        } else
+            wait_ts = end_ts;
+        if ((! stopped) && (op->duration > 0) &&
+            (ts_diff_secs(&end_ts, &wait_ts) > 0.0))
+            wait_ts = end_ts;
+        if ((op->interval > 0) || ((op->duration > 0) && (! stopped)))
+            res = pthread_cond_timedwait(&sh.cv, &sh.mutex, &wait_ts);
+        else
+            res = pthread_cond_wait(&sh.cv, &sh.mutex);
+        if (ETIMEDOUT != res)
+            continue;
+        clock_gettime(CLOCK_MONOTONIC, &now_ts);
+        if ((! stopped) && (op->duration > 0) &&
+            (ts_diff_secs(&end_ts, &now_ts) >= 0.0)) {
+            sh.stop = true;
+            stopped = true;
+        }
+        if ((op->interval > 0) &&
+            (ts_diff_secs(&ival_ts, &now_ts) >= (double)op->interval)) {
+            cmds = sh.cmds;
+            bytes = sh.bytes;
+            pthread_mutex_unlock(&sh.mutex);
+            secs = ts_diff_secs(&ival_ts, &now_ts);
+            printf("%7.1f secs: %10.2f MB/sec %10.2f IOPS\n",
+                   ts_diff_secs(&start_ts, &now_ts),
+                   (bytes - prev_bytes) / (secs * 1000000.0),
+                   (cmds - prev_cmds) / secs);
+            fflush(stdout);
+            prev_cmds = cmds;
+            prev_bytes = bytes;
+            ival_ts = now_ts;
+            pthread_mutex_lock(&sh.mutex);
+        }
+    }
+    pthread_mutex_unlock(&sh.mutex);
+    for (k = 0; k < nt; ++k)
+        pthread_join(tids[k], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+
+    secs = ts_diff_secs(&start_ts, &now_ts);
+    printf("%s %" PRId64 " bytes with %" PRId64 " commands in %.3f secs "
+           "[%d thread%s, qd=%d]\n", (op->do_write ? "Wrote and read back" :
+           "Read"), sh.bytes, sh.cmds, secs, nt, ((1 == nt) ? "" : "s"), qd);
+    if (secs > 0.00001)
+        printf("  %.2f MB/sec, %.2f IOPS, buffer size=%d bytes\n",
+               sh.bytes / (secs * 1000000.0), sh.cmds / secs, buf_size);
+    if (op->do_write)
+        printf("  echo buffer miscompares: %" PRId64 "\n", sh.miscompares);
+    if (sh.dio_incomplete)
+        printf(">> direct IO requested but not done\n");
+    if ((0 == sh.exit_status) && (sh.miscompares > 0))
+        sh.exit_status = SG_LIB_CAT_MISCOMPARE;
+    pthread_cond_destroy(&sh.cv);
+    pthread_mutex_destroy(&sh.mutex);
+    if (pat_free_bp)
+        free(pat_free_bp);
+    free(tids);
+    return sh.exit_status;
+}
+
+
 int
 main(int argc, char * argv[])
 {
@@ -359,11 +917,13 @@ main(int argc, char * argv[])
     bool clear = true;
 #endif
     bool dio_incomplete = false;
+    bool multi = false;
     int sg_fd, res, j, err;
     int buf_capacity = 0;
     int buf_size = 0;
     size_t psz;
-    unsigned int k, num;
+    unsigned int k;
+    int64_t n, num;
     int64_t total_size = RB_DEF_SIZE;
     struct opts_t * op;
     uint8_t * rbBuff = NULL;
@@ -415,6 +975,18 @@ main(int argc, char * argv[])
         return SG_LIB_SYNTAX_ERROR;
     }
 
+    if (op->do_mmap && (op->qd > 1)) {
+        pr2serr("mmap-ed IO uses the reserved buffer so '--qd' must be 1\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if (op->do_write && (op->do_mmap || op->do_quick)) {
+        pr2serr("'--write' needs the data in user space so cannot be used "
+                "with '--mmap'\nor '--quick'\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if ((op->num_threads > 1) || (op->qd > 1) || (op->duration > 0) ||
+        (op->interval > 0) || op->do_write)
+        multi = true;
     if (op->do_buffer > 0)
         buf_size = op->do_buffer;
     if (op->do_size > 0)
@@ -511,7 +1083,17 @@ main(int argc, char * argv[])
         free(rawp);
         rawp = NULL;
     }
+    if (buf_size < 1) {
+        pr2serr("buffer size is zero, nothing to do\n");
+        close(sg_fd);
+        return SG_LIB_CAT_MALFORMED;
+    }
 
+    if (multi) {
+        /* each worker thread opens the device itself */
+        close(sg_fd);
+        return rb_multi(op, buf_size, total_size);
+    }
     if (! op->do_dio) {
         k = buf_size;
         if (op->do_mmap && (0 != (k % psz)))
@@ -559,7 +1141,7 @@ main(int argc, char * argv[])
         gettimeofday(&start_tm, NULL);
     }
     /* main data reading loop */
-    for (k = 0; k < num; ++k) {
+    for (n = 0; n < num; ++n) {
         memset(rb_cdb, 0, RB_CMD_LEN);
         rb_cdb[0] = RB_OPCODE;
         rb_cdb[1] = op->do_echo ? RB_MODE_ECHO_DATA : RB_MODE_DATA;
@@ -579,7 +1161,7 @@ main(int argc, char * argv[])
         io_hdr.cmdp = rb_cdb;
         io_hdr.sbp = sense_buffer;
         io_hdr.timeout = 20000;     /* 20000 millisecs == 20 seconds */
-        io_hdr.pack_id = k;
+        io_hdr.pack_id = (int)n;
         if (op->do_mmap)
             io_hdr.flags |= SG_FLAG_MMAP_IO;
         else if (op->do_dio)
@@ -660,7 +1242,7 @@ main(int argc, char * argv[])
         if (a > 0.00001) {
             if (b > 511)
                 printf(", %.2f MB/sec", b / (a * 1000000.0));
-            printf(", %.2f IOPS", num / a);
+            printf(", %.2f IOPS", (double)num / a);
         }
         printf("\n");
     }
@@ -668,7 +1250,7 @@ main(int argc, char * argv[])
         printf(">> direct IO requested but not done\n");
     printf("Read %" PRId64 " MiB (actual: %" PRId64 " bytes), buffer "
            "size=%d KiB (%d bytes)\n", (total_size / (1024 * 1024)),
-           (int64_t)num * buf_size, buf_size / 1024, buf_size);
+           num * buf_size, buf_size / 1024, buf_size);
 
     if (rawp) free(rawp);
     res = close(sg_fd);
@@ -19,6 +19,11 @@
    This version should compile with Linux sg drivers with version numbers
    >= 30000 . For mmap-ed IO the sg version number >= 30122 .
 
+   It can also be used as a quick IOPS probe: 'dist=' chooses uniform or
+   zipfian random starting LBAs within a range and 'qd=' keeps multiple
+   SCSI READs outstanding on a sg device using its asynchronous (write()
+   then read()) interface.
+
 */
 
 #define _XOPEN_SOURCE 600
@@ -46,19 +51,23 @@
 #endif
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
+#include <math.h>
 #include <linux/major.h>
+#include <linux/fs.h>           /* for BLKGETSIZE64 */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
 #include "sg_lib.h"
+#include "sg_cmds_basic.h"
 #include "sg_io_linux.h"
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.35 20190501";
+static const char * version_str = "1.36 20261018";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -173,13 +182,15 @@ usage()
 {
     pr2serr("Usage: sg_read  [blk_sgio=0|1] [bpt=BPT] [bs=BS] "
             "[cdbsz=6|10|12|16]\n"
-            "                count=COUNT [dio=0|1] [dpo=0|1] [fua=0|1] "
-            "if=IFILE\n"
-            "                [mmap=0|1] [no_dfxer=0|1] [odir=0|1] "
+            "                count=COUNT [dio=0|1] [dist=DIST] [dpo=0|1] "
+            "[fua=0|1]\n"
+            "                if=IFILE [interval=SECS] [mmap=0|1] "
+            "[no_dfxer=0|1]\n"
+            "                [odir=0|1] [qd=QD] [range=RNG] [seed=SEED] "
             "[skip=SKIP]\n"
             "                [time=TI] [verbose=VERB] [--help] "
             "[--verbose]\n"
-            "                [--version] "
+            "                [--version]\n"
             "  where:\n"
             "    blk_sgio 0->normal IO for block devices, 1->SCSI commands "
             "via SG_IO\n"
@@ -195,16 +206,33 @@ usage()
             "error)\n"
             "             (if negative, do |COUNT| zero block SCSI READs)\n"
             "    dio      1-> attempt direct IO on sg device, 0->indirect IO "
-            "(def)\n");
+            "(def)\n"
+            "    dist     starting LBA of each read: 'seq' (def: always "
+            "SKIP),\n"
+            "             'uniform' or 'zipf[,THETA]' (def THETA: 0.99); "
+            "random\n"
+            "             LBAs are BPT aligned within RNG blocks from "
+            "SKIP\n");
     pr2serr("    dpo      1-> set disable page out (DPO) in SCSI READs\n"
             "    fua      1-> set force unit access (FUA) in SCSI READs\n"
             "    if       an sg, block or raw device, or a seekable file (not "
             "stdin)\n"
+            "    interval output IOPS, MB/sec and latency every SECS "
+            "seconds\n"
+            "             (def: 0 -> only summary at end)\n"
             "    mmap     1->perform mmaped IO on sg device, 0->indirect IO "
             "(def)\n"
             "    no_dxfer 1->DMA to kernel buffers only, not user space, "
             "0->normal(def)\n"
             "    odir     1->open block device O_DIRECT, 0->don't (def)\n"
+            "    qd       queue depth: number of SCSI READs kept outstanding "
+            "(def: 1)\n"
+            "             QD > 1 needs a sg device and uses async "
+            "write()/read()\n"
+            "    range    number of blocks random LBAs are chosen from "
+            "(def: from\n"
+            "             SKIP to end of IFILE)\n"
+            "    seed     seed for random LBAs (def: from time of day)\n"
             "    skip     each transfer starts at this logical address "
             "(def=0)\n"
             "    time     0->do nothing(def), 1->time from 1st cmd, 2->time "
@@ -214,7 +242,7 @@ usage()
             "    --verbose|-v   increase level of verbosity (def: 0)\n"
             "    --version|-V   print version number then exit\n\n"
             "Issue SCSI READ commands, each starting from the same logical "
-            "block address\n");
+            "block address\n(or from random LBAs when 'dist=' is given)\n");
 }
 
 static int
@@ -394,6 +422,480 @@ num_chs_in_str(const char * s, int slen, int ch)
     return res;
 }
 
+#define DIST_SEQ 0      /* each read starts at SKIP (original behaviour) */
+#define DIST_UNIFORM 1
+#define DIST_ZIPF 2
+
+#define DEF_ZIPF_THETA 0.99
+#define ZETA_EXACT_TERMS 1000000
+#define MAX_QUEUE_DEPTH 256
+#define MAX_ASYNC_RETRIES 2
+
+/* Yields the starting LBA of each read. For the random distributions the
+ * range is split into 'n_units' transfers each of 'unit' blocks and the
+ * yielded LBAs are aligned to 'unit' blocks from 'base'. */
+struct lba_gen {
+    int dist;
+    int unit;
+    int64_t base;
+    int64_t n_units;
+    uint64_t rstate;            /* xorshift64* state */
+    double theta;               /* following only used by DIST_ZIPF */
+    double alpha;
+    double zetan;
+    double eta;
+    double half_pow_theta;
+};
+
+struct lat_stats {
+    int64_t num;
+    double sum_us;
+    double min_us;
+    double max_us;
+};
+
+/* Collects IOPS and latency, optionally output every 'interval' seconds */
+struct iops_mon {
+    int interval;
+    int64_t ival_blocks;
+    struct timespec start_ts;
+    struct timespec next_ts;
+    struct timespec ival_ts;
+    struct lat_stats ival_lat;
+    struct lat_stats tot_lat;
+};
+
+struct async_slot {
+    bool busy;
+    int blocks;
+    int retries;
+    int64_t lba;
+    uint8_t * bufp;
+    struct timespec start_ts;
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+};
+
+static uint64_t
+xorshift64star(uint64_t * statep)
+{
+    uint64_t x = *statep;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *statep = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+/* Returns uniformly distributed double in the range [0.0, 1.0) */
+static double
+rand_unit(uint64_t * statep)
+{
+    return (xorshift64star(statep) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Generalized harmonic number: sum of 1/(k**theta) for k=1..n . Beyond
+ * ZETA_EXACT_TERMS terms the tail is approximated by an integral, which
+ * is accurate enough and keeps start up quick for very large ranges. */
+static double
+zeta(int64_t n, double theta)
+{
+    int64_t k;
+    int64_t m = (n > ZETA_EXACT_TERMS) ? ZETA_EXACT_TERMS : n;
+    double sum = 0.0;
+
+    for (k = 1; k <= m; ++k)
+        sum += pow((double)k, -theta);
+    if (n > m)
+        sum += (pow(n + 0.5, 1.0 - theta) - pow(m + 0.5, 1.0 - theta)) /
+               (1.0 - theta);
+    return sum;
+}
+
+static void
+lba_gen_init(struct lba_gen * lgp, int dist, double theta, int64_t base,
+             int64_t range, int unit, uint64_t seed)
+{
+    memset(lgp, 0, sizeof(*lgp));
+    lgp->dist = dist;
+    lgp->base = base;
+    lgp->unit = (unit > 0) ? unit : 1;
+    lgp->n_units = range / lgp->unit;
+    if (lgp->n_units < 1)
+        lgp->n_units = 1;
+    lgp->rstate = seed ? seed : 0x9e3779b97f4a7c15ULL;
+    if ((DIST_ZIPF == dist) && (lgp->n_units > 1)) {
+        /* Gray et al, "Quickly generating billion-record synthetic
+         * databases", SIGMOD 1994 */
+        lgp->theta = theta;
+        lgp->alpha = 1.0 / (1.0 - theta);
+        lgp->zetan = zeta(lgp->n_units, theta);
+        lgp->half_pow_theta = pow(0.5, theta);
+        lgp->eta = (1.0 - pow(2.0 / lgp->n_units, 1.0 - theta)) /
+                   (1.0 - ((1.0 + lgp->half_pow_theta) / lgp->zetan));
+    }
+}
+
+static int64_t
+next_lba(struct lba_gen * lgp)
+{
+    int64_t idx;
+    uint64_t h;
+    double u, uz;
+
+    switch (lgp->dist) {
+    case DIST_UNIFORM:
+        idx = xorshift64star(&lgp->rstate) % lgp->n_units;
+        break;
+    case DIST_ZIPF:
+        if (lgp->n_units < 2) {
+            idx = 0;
+            break;
+        }
+        u = rand_unit(&lgp->rstate);
+        uz = u * lgp->zetan;
+        if (uz < 1.0)
+            idx = 0;
+        else if (uz < (1.0 + lgp->half_pow_theta))
+            idx = 1;
+        else
+            idx = (int64_t)(lgp->n_units *
+                            pow((lgp->eta * u) - lgp->eta + 1.0,
+                                lgp->alpha));
+        if (idx >= lgp->n_units)
+            idx = lgp->n_units - 1;
+        /* scatter the hot ranks across the range rather than having
+         * them clustered at its start */
+        h = (uint64_t)idx * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+        idx = h % lgp->n_units;
+        break;
+    case DIST_SEQ:
+    default:
+        return lgp->base;
+    }
+    return lgp->base + (idx * lgp->unit);
+}
+
+static double
+ts_diff_us(const struct timespec * a, const struct timespec * b)
+{
+    return ((b->tv_sec - a->tv_sec) * 1000000.0) +
+           ((b->tv_nsec - a->tv_nsec) / 1000.0);
+}
+
+static void
+lat_reset(struct lat_stats * lsp)
+{
+    memset(lsp, 0, sizeof(*lsp));
+}
+
+static void
+lat_add(struct lat_stats * lsp, double us)
+{
+    if ((0 == lsp->num) || (us < lsp->min_us))
+        lsp->min_us = us;
+    if (us > lsp->max_us)
+        lsp->max_us = us;
+    lsp->sum_us += us;
+    ++lsp->num;
+}
+
+static void
+mon_init(struct iops_mon * mp, int interval)
+{
+    memset(mp, 0, sizeof(*mp));
+    mp->interval = interval;
+    clock_gettime(CLOCK_MONOTONIC, &mp->start_ts);
+    mp->ival_ts = mp->start_ts;
+    mp->next_ts = mp->start_ts;
+    mp->next_ts.tv_sec += interval;
+}
+
+/* Called after each command completes, 'tsp' being the completion time */
+static void
+mon_done(struct iops_mon * mp, const struct timespec * tsp, double lat_us,
+         int blocks, int bs)
+{
+    double secs;
+    const struct lat_stats * lsp = &mp->ival_lat;
+
+    lat_add(&mp->tot_lat, lat_us);
+    lat_add(&mp->ival_lat, lat_us);
+    mp->ival_blocks += blocks;
+    if ((mp->interval <= 0) || (tsp->tv_sec < mp->next_ts.tv_sec) ||
+        ((tsp->tv_sec == mp->next_ts.tv_sec) &&
+         (tsp->tv_nsec < mp->next_ts.tv_nsec)))
+        return;
+    secs = ts_diff_us(&mp->ival_ts, tsp) / 1000000.0;
+    pr2serr("%7.1f secs: %9.0f IOPS %9.2f MB/sec, latency (usecs) "
+            "avg=%.1f min=%.1f max=%.1f\n",
+            ts_diff_us(&mp->start_ts, tsp) / 1000000.0, lsp->num / secs,
+            ((double)mp->ival_blocks * bs) / (secs * 1000000.0),
+            lsp->sum_us / lsp->num, lsp->min_us, lsp->max_us);
+    lat_reset(&mp->ival_lat);
+    mp->ival_blocks = 0;
+    mp->ival_ts = *tsp;
+    while ((mp->next_ts.tv_sec < tsp->tv_sec) ||
+           ((mp->next_ts.tv_sec == tsp->tv_sec) &&
+            (mp->next_ts.tv_nsec <= tsp->tv_nsec)))
+        mp->next_ts.tv_sec += mp->interval;
+}
+
+static void
+mon_summary(const struct iops_mon * mp, const char * read_str)
+{
+    double secs;
+    struct timespec end_ts;
+    const struct lat_stats * lsp = &mp->tot_lat;
+
+    if (lsp->num < 1)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &end_ts);
+    secs = ts_diff_us(&mp->start_ts, &end_ts) / 1000000.0;
+    pr2serr("%s latency (usecs): avg=%.1f min=%.1f max=%.1f over %" PRId64
+            " commands\n", read_str, lsp->sum_us / lsp->num, lsp->min_us,
+            lsp->max_us, lsp->num);
+    if (secs > 0.00001)
+        pr2serr("IOPS: %.0f\n", lsp->num / secs);
+}
+
+/* Returns number of bs sized blocks in the IFILE, or -1 if unknown */
+static int64_t
+get_num_blocks(int fd, int in_type, int bs)
+{
+    uint8_t rc_buff[32];
+    struct stat st;
+
+    if (FT_SG & in_type) {
+        if (0 == sg_ll_readcap_16(fd, false, 0, rc_buff, sizeof(rc_buff),
+                                  (verbose > 0), verbose))
+            return (int64_t)sg_get_unaligned_be64(rc_buff) + 1;
+        if (0 == sg_ll_readcap_10(fd, false, 0, rc_buff, 8, (verbose > 0),
+                                  verbose))
+            return (int64_t)sg_get_unaligned_be32(rc_buff) + 1;
+        return -1;
+    }
+#ifdef BLKGETSIZE64
+    if (FT_BLOCK & in_type) {
+        uint64_t ull;
+
+        if (ioctl(fd, BLKGETSIZE64, &ull) < 0)
+            return -1;
+        return (int64_t)(ull / bs);
+    }
+#endif
+    if ((0 == fstat(fd, &st)) && S_ISREG(st.st_mode))
+        return st.st_size / bs;
+    return -1;
+}
+
+/* Submits a SCSI READ using the sg v3 asynchronous interface. Returns 0 if
+ * ok, 1 if the sg driver's queue is full, else -1 . */
+static int
+async_submit(int sg_fd, struct async_slot * sp, int bs, int cdbsz, bool fua,
+             bool dpo, bool do_dio, bool no_dxfer)
+{
+    int k, res;
+    struct sg_io_hdr * hp = &sp->io_hdr;
+
+    if (sg_build_scsi_cdb(sp->cdb, cdbsz, sp->blocks, sp->lba, false, fua,
+                          dpo)) {
+        pr2serr(ME "bad cdb build, from_block=%" PRId64 ", blocks=%d\n",
+                sp->lba, sp->blocks);
+        return -1;
+    }
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = cdbsz;
+    hp->cmdp = sp->cdb;
+    if (sp->blocks > 0) {
+        hp->dxfer_direction = SG_DXFER_FROM_DEV;
+        hp->dxfer_len = bs * sp->blocks;
+        hp->dxferp = sp->bufp;
+        if (do_dio)
+            hp->flags |= SG_FLAG_DIRECT_IO;
+        else if (no_dxfer)
+            hp->flags |= SG_FLAG_NO_DXFER;
+    } else
+        hp->dxfer_direction = SG_DXFER_NONE;
+    hp->mx_sb_len = SENSE_BUFF_LEN;
+    hp->sbp = sp->sense;
+    hp->timeout = DEF_TIMEOUT;
+    hp->pack_id = pack_id_count++;
+    hp->usr_ptr = sp;
+    if (verbose > 1) {
+        pr2serr("    read cdb: ");
+        for (k = 0; k < cdbsz; ++k)
+            pr2serr("%02x ", sp->cdb[k]);
+        pr2serr("\n");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sp->start_ts);
+    while (((res = write(sg_fd, hp, sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res >= 0)
+        return 0;
+    if ((EDOM == errno) || (EAGAIN == errno) || (EBUSY == errno))
+        return 1;
+    perror(ME "write(sg_io_hdr) on sg device, error");
+    return -1;
+}
+
+/* Keeps up to 'qd' SCSI READs outstanding on the sg device, each with up
+ * to 'bpt' blocks, until COUNT is exhausted. Uses the same globals as the
+ * synchronous main loop. Returns 0 if ok, else an SG_LIB_* error code. */
+static int
+async_reads(int sg_fd, int qd, int bs, int bpt, int cdbsz, bool fua,
+            bool dpo, bool do_dio, bool no_dxfer, struct lba_gen * lgp,
+            struct iops_mon * mp, int * itersp, int * dio_incompletep)
+{
+    bool stop = false;
+    int k, res, cat;
+    int ret = 0;
+    int outstanding = 0;
+    int cur_qd = qd;
+    int64_t to_issue = dd_count;    /* blocks or -(zero block READs) */
+    uint8_t * free_bp = NULL;
+    uint8_t * bp;
+    struct async_slot * slots;
+    struct async_slot * sp;
+    struct sg_io_hdr io_hdr;
+    struct timespec now_ts;
+
+    slots = (struct async_slot *)calloc(qd, sizeof(struct async_slot));
+    if (NULL == slots) {
+        pr2serr(ME "out of memory\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    /* one buffer per slot unless no data reaches user space */
+    k = ((dd_count > 0) && (! no_dxfer)) ? qd : 1;
+    bp = sg_memalign((uint32_t)bs * (bpt > 0 ? bpt : 1) * k, 0, &free_bp,
+                     verbose > 3);
+    if (NULL == bp) {
+        pr2serr(ME "out of memory for %d read buffers\n", k);
+        free(slots);
+        return SG_LIB_CAT_OTHER;
+    }
+    for (k = 0; k < qd; ++k)
+        slots[k].bufp = (dd_count > 0) && (! no_dxfer) ?
+                        (bp + ((size_t)k * bs * bpt)) : bp;
+    k = 1;
+    ioctl(sg_fd, SG_SET_COMMAND_Q, &k);
+
+    while ((outstanding > 0) || ((0 != to_issue) && (! stop))) {
+        for (k = 0; (! stop) && (0 != to_issue) && (outstanding < cur_qd);
+             ++k) {
+            sp = slots + (k % qd);
+            if (sp->busy)
+                continue;
+            sp->blocks = (to_issue > 0) ?
+                         ((to_issue > bpt) ? bpt : (int)to_issue) : 0;
+            sp->lba = next_lba(lgp);
+            sp->retries = 0;
+            res = async_submit(sg_fd, sp, bs, cdbsz, fua, dpo, do_dio,
+                               no_dxfer);
+            if (1 == res) {
+                if (0 == outstanding) {
+                    pr2serr(ME "sg driver will not queue any commands\n");
+                    ret = SG_LIB_CAT_OTHER;
+                    stop = true;
+                } else {
+                    if (verbose)
+                        pr2serr("sg driver queue full, reducing queue "
+                                "depth to %d\n", outstanding);
+                    cur_qd = outstanding;
+                }
+                break;
+            } else if (res < 0) {
+                ret = SG_LIB_CAT_OTHER;
+                stop = true;
+                break;
+            }
+            sp->busy = true;
+            ++outstanding;
+            if (to_issue > 0)
+                to_issue -= sp->blocks;
+            else
+                ++to_issue;
+        }
+        if (0 == outstanding)
+            break;
+        memset(&io_hdr, 0, sizeof(io_hdr));
+        io_hdr.interface_id = 'S';
+        io_hdr.pack_id = -1;    /* any completed command */
+        while (((res = read(sg_fd, &io_hdr, sizeof(io_hdr))) < 0) &&
+               (EINTR == errno))
+            ;
+        if (res < 0) {
+            res = errno;
+            perror(ME "read(sg_io_hdr) on sg device, error");
+            ret = sg_convert_errno(res);
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now_ts);
+        sp = (struct async_slot *)io_hdr.usr_ptr;
+        if ((sp < slots) || (sp >= (slots + qd)) || (! sp->busy)) {
+            pr2serr(ME "unexpected usr_ptr from sg driver\n");
+            ret = SG_LIB_CAT_OTHER;
+            break;
+        }
+        if (verbose > 2)
+            pr2serr("      duration=%u ms\n", io_hdr.duration);
+        cat = sg_err_category3(&io_hdr);
+        switch (cat) {
+        case SG_LIB_CAT_CLEAN:
+            break;
+        case SG_LIB_CAT_RECOVERED:
+            if (verbose > 1)
+                sg_chk_n_print3("reading, continue", &io_hdr, true);
+            break;
+        case SG_LIB_CAT_UNIT_ATTENTION:
+        case SG_LIB_CAT_ABORTED_COMMAND:
+            if (verbose)
+                sg_chk_n_print3("reading", &io_hdr, (verbose > 1));
+            if ((! stop) && (sp->retries < MAX_ASYNC_RETRIES)) {
+                ++sp->retries;
+                if (0 == async_submit(sg_fd, sp, bs, cdbsz, fua, dpo,
+                                      do_dio, no_dxfer))
+                    continue;   /* resubmitted, sp still busy */
+            }
+            ret = cat;
+            break;
+        default:
+            sg_chk_n_print3("reading", &io_hdr, (verbose > 1));
+            ret = (SG_LIB_CAT_NOT_READY == cat) ||
+                  (SG_LIB_CAT_MEDIUM_HARD == cat) ? cat : SG_LIB_CAT_OTHER;
+            break;
+        }
+        sp->busy = false;
+        --outstanding;
+        if ((SG_LIB_CAT_CLEAN != cat) && (SG_LIB_CAT_RECOVERED != cat)) {
+            stop = true;
+            continue;           /* reap what is still outstanding */
+        }
+        ++*itersp;
+        in_full += sp->blocks;
+        if (dd_count > 0)
+            dd_count -= sp->blocks;
+        else
+            ++dd_count;
+        if (sp->blocks > 0) {
+            if (do_dio && ((io_hdr.info & SG_INFO_DIRECT_IO_MASK) !=
+                           SG_INFO_DIRECT_IO))
+                ++*dio_incompletep;
+            sum_of_resids += io_hdr.resid;
+        }
+        mon_done(mp, &now_ts, ts_diff_us(&sp->start_ts, &now_ts), sp->blocks,
+                 bs);
+    }
+    free(free_bp);
+    free(slots);
+    return ret;
+}
+
 #define STR_SZ 1024
 #define INF_SZ 512
 #define EBUFF_SZ 768
@@ -408,6 +910,7 @@ main(int argc, char * argv[])
     bool do_dio = false;
     bool do_mmap = false;
     bool do_odir = false;
+    bool iops_mode;
     bool dpo = false;
     bool fua = false;
     bool no_dxfer = false;
@@ -416,7 +919,10 @@ main(int argc, char * argv[])
     int bs = 0;
     int bpt = DEF_BLOCKS_PER_TRANSFER;
     int dio_incomplete = 0;
+    int dist = DIST_SEQ;
     int do_time = 0;
+    int interval = 0;
+    int qd = 1;
     int in_type = FT_OTHER;
     int ret = 0;
     int scsi_cdbsz = DEF_SCSI_CDBSZ;
@@ -424,6 +930,10 @@ main(int argc, char * argv[])
     int n, keylen;
     size_t psz;
     int64_t skip = 0;
+    int64_t range = 0;
+    int64_t lba, num_blks;
+    uint64_t seed = 0;
+    double theta = DEF_ZIPF_THETA;
     char * key;
     char * buf;
     uint8_t * wrkBuff = NULL;
@@ -433,7 +943,11 @@ main(int argc, char * argv[])
     char str[STR_SZ];
     char ebuff[EBUFF_SZ];
     const char * read_str;
+    const char * cp;
     struct timeval start_tm, end_tm;
+    struct timespec cmd_ts, done_ts;
+    struct lba_gen lg;
+    struct iops_mon mon;
 
 #if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
     psz = sysconf(_SC_PAGESIZE); /* POSIX.1 (was getpagesize()) */
@@ -487,6 +1001,29 @@ main(int argc, char * argv[])
             }
         } else if (0 == strcmp(key,"dio"))
             do_dio = !! sg_get_num(buf);
+        else if (0 == strcmp(key,"dist")) {
+            if (0 == strncmp(buf, "seq", 3))
+                dist = DIST_SEQ;
+            else if ((0 == strncmp(buf, "uni", 3)) ||
+                     (0 == strncmp(buf, "rand", 4)))
+                dist = DIST_UNIFORM;
+            else if (0 == strncmp(buf, "zipf", 4)) {
+                dist = DIST_ZIPF;
+                cp = strpbrk(buf, ",:");
+                if (cp) {
+                    theta = atof(cp + 1);
+                    if ((theta <= 0.0) || (theta >= 1.0)) {
+                        pr2serr(ME "zipf THETA must be greater than 0 and "
+                                "less than 1\n");
+                        return SG_LIB_SYNTAX_ERROR;
+                    }
+                }
+            } else {
+                pr2serr(ME "'dist' expects 'seq', 'uniform' or "
+                        "'zipf[,THETA]'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        }
         else if (0 == strcmp(key,"dpo"))
             dpo = !! sg_get_num(buf);
         else if (0 == strcmp(key,"fua"))
@@ -494,6 +1031,12 @@ main(int argc, char * argv[])
         else if (strcmp(key,"if") == 0) {
             memcpy(inf, buf, INF_SZ - 1);
             inf[INF_SZ - 1] = '\0';
+        } else if (0 == strcmp(key,"interval")) {
+            interval = sg_get_num(buf);
+            if (interval < 0) {
+                pr2serr( ME "bad argument to 'interval'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"mmap"))
             do_mmap = !! sg_get_num(buf);
         else if (0 == strcmp(key,"no_dxfer"))
@@ -503,6 +1046,24 @@ main(int argc, char * argv[])
         else if (strcmp(key,"of") == 0) {
             memcpy(outf, buf, INF_SZ - 1);
             outf[INF_SZ - 1] = '\0';
+        } else if (0 == strcmp(key,"qd")) {
+            qd = sg_get_num(buf);
+            if ((qd < 1) || (qd > MAX_QUEUE_DEPTH)) {
+                pr2serr( ME "'qd' expects 1 to %d\n", MAX_QUEUE_DEPTH);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"range")) {
+            range = sg_get_llnum(buf);
+            if (range < 1) {
+                pr2serr( ME "bad argument to 'range'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"seed")) {
+            seed = (uint64_t)sg_get_llnum(buf);
+            if ((uint64_t)-1 == seed) {
+                pr2serr( ME "bad argument to 'seed'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"skip")) {
             skip = sg_get_llnum(buf);
             if (-1 == skip) {
@@ -602,6 +1163,12 @@ main(int argc, char * argv[])
         pr2serr("cannot select no_dxfer with dio or mmap\n");
         return SG_LIB_CONTRADICT;
     }
+    if ((qd > 1) && do_mmap) {
+        pr2serr("mmap-ed IO is limited to one command at a time, so "
+                "qd=1 needed\n");
+        return SG_LIB_CONTRADICT;
+    }
+    iops_mode = (qd > 1) || (DIST_SEQ != dist) || (interval > 0);
 
     install_handler (SIGINT, interrupt_handler);
     install_handler (SIGQUIT, interrupt_handler);
@@ -677,6 +1244,10 @@ main(int argc, char * argv[])
             pr2serr(ME "negative 'count' only supported with SCSI READs\n");
             return SG_LIB_CAT_OTHER;
         }
+        if (qd > 1) {
+            pr2serr(ME "qd > 1 only supported on sg devices\n");
+            return SG_LIB_CAT_OTHER;
+        }
         flags = O_RDONLY;
         if (do_odir)
             flags |= O_DIRECT;
@@ -707,6 +1278,29 @@ main(int argc, char * argv[])
         return 0;
     orig_count = dd_count;
 
+    if (DIST_SEQ != dist) {
+        if (0 == range) {
+            num_blks = get_num_blocks(infd, in_type, bs);
+            if (num_blks <= skip) {
+                pr2serr(ME "unable to find size of %s, give 'range=RNG'\n",
+                        inf);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            range = num_blks - skip;
+        }
+        if (0 == seed) {
+            struct timeval tv;
+
+            gettimeofday(&tv, NULL);
+            seed = ((uint64_t)tv.tv_sec << 20) ^ tv.tv_usec ^ getpid();
+        }
+        if (verbose)
+            pr2serr("%s LBAs from %" PRId64 " for %" PRId64 " blocks, "
+                    "seed=%" PRIu64 "\n", (DIST_ZIPF == dist) ? "Zipfian" :
+                    "Uniform", skip, range, seed);
+    }
+    lba_gen_init(&lg, dist, theta, skip, range, (bpt > 0) ? bpt : 1, seed);
+
     if (dd_count > 0) {
         if (do_dio || do_odir || (FT_RAW & in_type)) {
             wrkBuff = (uint8_t *)malloc(bs * bpt + psz);
@@ -742,17 +1336,31 @@ main(int argc, char * argv[])
         pr2serr("About to issue %" PRId64 " zero block SCSI READs\n",
                 0 - dd_count);
 
-    /* main loop */
-    for (iters = 0; dd_count != 0; ++iters) {
+    mon_init(&mon, interval);
+    iters = 0;
+    if (qd > 1) {
+        if (do_time > 0)
+            gettimeofday(&start_tm, NULL);
+        ret = async_reads(infd, qd, bs, bpt, scsi_cdbsz, fua, dpo, do_dio,
+                          no_dxfer, &lg, &mon, &iters, &dio_incomplete);
+        if (do_time > 1)
+            do_time = 1;        /* all commands timed */
+    }
+
+    /* main loop (synchronous, one command at a time) */
+    for ( ; (qd < 2) && (dd_count != 0); ++iters) {
         if ((do_time > 0) && (iters == (do_time - 1)))
             gettimeofday(&start_tm, NULL);
         if (dd_count < 0)
             blocks = 0;
         else
             blocks = (dd_count > blocks_per) ? blocks_per : dd_count;
+        lba = next_lba(&lg);
+        if (iops_mode)
+            clock_gettime(CLOCK_MONOTONIC, &cmd_ts);
         if (FT_SG & in_type) {
             dio_tmp = do_dio;
-            res = sg_bread(infd, wrkPos, blocks, skip, bs, scsi_cdbsz,
+            res = sg_bread(infd, wrkPos, blocks, lba, bs, scsi_cdbsz,
                            fua, dpo, &dio_tmp, do_mmap, no_dxfer);
             if (1 == res) {     /* ENOMEM, find what's available+try that */
                 if (ioctl(infd, SG_GET_RESERVED_SIZE, &buf_sz) < 0) {
@@ -764,11 +1372,11 @@ main(int argc, char * argv[])
                 blocks_per = (buf_sz + bs - 1) / bs;
                 blocks = blocks_per;
                 pr2serr("Reducing read to %d blocks per loop\n", blocks_per);
-                res = sg_bread(infd, wrkPos, blocks, skip, bs, scsi_cdbsz,
+                res = sg_bread(infd, wrkPos, blocks, lba, bs, scsi_cdbsz,
                                fua, dpo, &dio_tmp, do_mmap, no_dxfer);
             } else if (2 == res) {
                 pr2serr("Unit attention, try again (r)\n");
-                res = sg_bread(infd, wrkPos, blocks, skip, bs, scsi_cdbsz,
+                res = sg_bread(infd, wrkPos, blocks, lba, bs, scsi_cdbsz,
                                fua, dpo, &dio_tmp, do_mmap, no_dxfer);
             }
             if (0 != res) {
@@ -801,8 +1409,9 @@ main(int argc, char * argv[])
                     dio_incomplete++;
             }
         } else {
-            if (iters > 0) { /* subsequent iteration reset skip position */
-                off64_t offset = skip;
+            if ((iters > 0) || (lba != skip)) {
+                /* subsequent iteration reset skip position */
+                off64_t offset = lba;
 
                 offset *= bs;       /* could exceed 32 bits here! */
                 if (lseek64(infd, offset, SEEK_SET) < 0) {
@@ -815,7 +1424,7 @@ main(int argc, char * argv[])
                 ;
             if (res < 0) {
                 snprintf(ebuff, EBUFF_SZ, ME "reading, skip=%" PRId64 " ",
-                         skip);
+                         lba);
                 perror(ebuff);
                 break;
             } else if (res < blocks * bs) {
@@ -832,12 +1441,19 @@ main(int argc, char * argv[])
             }
             in_full += blocks;
         }
+        if (iops_mode) {
+            clock_gettime(CLOCK_MONOTONIC, &done_ts);
+            mon_done(&mon, &done_ts, ts_diff_us(&cmd_ts, &done_ts), blocks,
+                     bs);
+        }
         if (dd_count > 0)
             dd_count -= blocks;
         else if (dd_count < 0)
             ++dd_count;
     }
     read_str = (FT_SG & in_type) ? "SCSI READ" : "read";
+    if (iops_mode)
+        mon_summary(&mon, read_str);
     if (do_time > 0) {
         gettimeofday(&end_tm, NULL);
         if (start_tm.tv_sec || start_tm.tv_usec) {
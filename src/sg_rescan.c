@@ -0,0 +1,764 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* A utility program for the Linux OS SCSI subsystem.
+ *
+ *
+ * This program rescans SCSI hosts (HBAs). For each target that already has
+ * logical units in sysfs it sends REPORT LUNS and compares the answer with
+ * what sysfs holds. New logical units are added by writing "C T L" to the
+ * host's 'scan' attribute and (optionally) logical units that are no longer
+ * reported are deleted. Hosts are scanned in parallel, one thread each.
+ * This is a faster alternative to the rescan-scsi-bus.sh script which
+ * spends most of its time forking sg_inq and sg_luns per device.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_cmds_basic.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+static const char * version_str = "1.00 20261018";
+
+#define ME "sg_rescan: "
+
+#define DEF_RLUNS_BUFF_LEN (1024 * 8)
+#define MAX_RLUNS_BUFF_LEN (1024 * 1024)
+#define MAX_THREADS 256
+#define MAX_HOSTS 4096
+#define NAME_LEN_MAX 256
+#define D_NAME_LEN_MAX 520
+#define DEF_PT_TIMEOUT 60
+#define INQ_RESP_LEN 36
+
+static const char * def_sysfs_root = "/sys";
+static const char * def_dev_dir = "/dev";
+
+/* One logical unit (or "device" in Linux terms) found in sysfs */
+struct lu_t {
+    int host;
+    int channel;
+    int target;
+    uint64_t lun;
+    bool reported;      /* set when REPORT LUNS on its target lists it */
+};
+
+struct host_t {
+    int host_no;
+    int num_lus;
+    struct lu_t * lus;  /* points into the sorted array of all lus */
+    int num_targets;
+    int added;
+    int removed;
+    int stale;          /* no longer reported but --remove not given */
+    int resized;
+    int target_scans;   /* REPORT LUNS failed so kernel scans target */
+    int errs;
+    double secs;
+};
+
+struct opts_t {
+    bool dry_run;
+    bool do_remove;
+    bool do_resize;
+    bool do_wildcard;
+    int num_threads;
+    int verbose;
+    const char * sysfs_root;
+    const char * dev_dir;
+};
+
+struct work_t {
+    const struct opts_t * op;
+    struct host_t * hosts;
+    int num_hosts;
+    int next_host;
+    pthread_mutex_t mutex;
+};
+
+
+static struct option long_options[] = {
+        {"dev_dir", required_argument, 0, 'D'},
+        {"dev-dir", required_argument, 0, 'D'},
+        {"dry-run", no_argument, 0, 'd'},
+        {"dry_run", no_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {"hosts", required_argument, 0, 'H'},
+        {"remove", no_argument, 0, 'r'},
+        {"resize", no_argument, 0, 'R'},
+        {"sysfs", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 't'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {"wildcard", no_argument, 0, 'w'},
+        {0, 0, 0, 0},
+};
+
+
+static void
+usage()
+{
+    pr2serr("Usage: sg_rescan [--dev_dir=DIR] [--dry-run] [--help] "
+            "[--hosts=HL]\n"
+            "                 [--remove] [--resize] [--sysfs=DIR] "
+            "[--threads=NT]\n"
+            "                 [--verbose] [--version] [--wildcard]\n"
+            "  where:\n"
+            "    --dev_dir=DIR|-D DIR    directory holding sg and bsg "
+            "device nodes\n"
+            "                            (def: /dev)\n"
+            "    --dry-run|-d    report what would change, don't write to "
+            "sysfs\n"
+            "    --help|-h       print out usage message\n"
+            "    --hosts=HL|-H HL    comma separated list of host numbers "
+            "to rescan\n"
+            "                        (def: all SCSI hosts)\n"
+            "    --remove|-r     delete logical units that are no longer "
+            "reported\n"
+            "    --resize|-R     have the kernel re-read capacity of "
+            "existing logical\n"
+            "                    units\n"
+            "    --sysfs=DIR|-s DIR    where sysfs is mounted (def: "
+            "/sys)\n"
+            "    --threads=NT|-t NT    maximum hosts scanned at once (def: "
+            "number\n"
+            "                          of hosts; maximum: %d)\n"
+            "    --verbose|-v    increase verbosity\n"
+            "    --version|-V    print version string and exit\n"
+            "    --wildcard|-w    also have the kernel scan each host for new "
+            "targets\n\n"
+            "Rescans SCSI hosts in parallel. For each target with logical "
+            "units in\nsysfs, sends REPORT LUNS and adds logical units that "
+            "are new. Logical\nunits no longer reported are listed and, if "
+            "--remove is given, deleted.\n", MAX_THREADS);
+}
+
+/* Same mapping as the kernel's scsilun_to_int() */
+static uint64_t
+t10_2linux_lun(const uint8_t t10_lun[])
+{
+    int k;
+    const uint8_t * cp;
+    uint64_t res;
+
+    res = sg_get_unaligned_be16(t10_lun + 6);
+    for (cp = t10_lun + 4, k = 0; k < 3; ++k, cp -= 2)
+        res = (res << 16) + sg_get_unaligned_be16(cp);
+    return res;
+}
+
+static int
+lu_cmp(const void * a, const void * b)
+{
+    const struct lu_t * lap = (const struct lu_t *)a;
+    const struct lu_t * lbp = (const struct lu_t *)b;
+
+    if (lap->host != lbp->host)
+        return (lap->host < lbp->host) ? -1 : 1;
+    if (lap->channel != lbp->channel)
+        return (lap->channel < lbp->channel) ? -1 : 1;
+    if (lap->target != lbp->target)
+        return (lap->target < lbp->target) ? -1 : 1;
+    if (lap->lun != lbp->lun)
+        return (lap->lun < lbp->lun) ? -1 : 1;
+    return 0;
+}
+
+static int
+host_cmp(const void * a, const void * b)
+{
+    const struct host_t * hap = (const struct host_t *)a;
+    const struct host_t * hbp = (const struct host_t *)b;
+
+    return (hap->host_no < hbp->host_no) ? -1 :
+           ((hap->host_no > hbp->host_no) ? 1 : 0);
+}
+
+/* Writes the string val to the sysfs attribute at path. With --dry-run
+ * only reports what would be written. Returns 0 on success else errno. */
+static int
+sysfs_write(const char * path, const char * val, const struct opts_t * op)
+{
+    int fd, n, err;
+    int len = strlen(val);
+    char eb[64];
+
+    if (op->dry_run) {
+        printf("  would write '%s' to %s\n", val, path);
+        return 0;
+    }
+    if (op->verbose > 1)
+        pr2serr("    writing '%s' to %s\n", val, path);
+    fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        err = errno;
+        pr2serr(ME "open(%s): %s\n", path,
+                safe_strerror_r(err, eb, sizeof(eb)));
+        return err;
+    }
+    n = write(fd, val, len);
+    err = (n < 0) ? errno : 0;
+    close(fd);
+    if (err) {
+        pr2serr(ME "write '%s' to %s: %s\n", val, path,
+                safe_strerror_r(err, eb, sizeof(eb)));
+        return err;
+    }
+    return (n < len) ? EIO : 0;
+}
+
+/* Builds the name of a device node that can be used to send commands to
+ * the given logical unit: its sg node if there is one, else its bsg node.
+ * Returns true if one is found. */
+static bool
+lu_dev_node(const struct lu_t * lup, const struct opts_t * op, char * b,
+            int blen)
+{
+    DIR * dp;
+    struct dirent * dep;
+    struct stat st;
+    bool found = false;
+    char dname[NAME_LEN_MAX];
+
+    snprintf(dname, sizeof(dname),
+             "%s/class/scsi_device/%d:%d:%d:%" PRIu64
+             "/device/scsi_generic", op->sysfs_root, lup->host,
+             lup->channel, lup->target, lup->lun);
+    dp = opendir(dname);
+    if (dp) {
+        while ((dep = readdir(dp))) {
+            if (0 == strncmp(dep->d_name, "sg", 2)) {
+                snprintf(b, blen, "%s/%s", op->dev_dir, dep->d_name);
+                found = true;
+                break;
+            }
+        }
+        closedir(dp);
+        if (found)
+            return true;
+    }
+    snprintf(b, blen, "%s/bsg/%d:%d:%d:%" PRIu64, op->dev_dir, lup->host,
+             lup->channel, lup->target, lup->lun);
+    return (0 == stat(b, &st));
+}
+
+/* Sends REPORT LUNS via any logical unit of the target that will answer.
+ * On success returns the response (caller frees) with *lenp set to the
+ * length of its LUN list, else returns NULL. */
+static uint8_t *
+target_report_luns(struct lu_t * lus, int num, const struct opts_t * op,
+                   int * lenp)
+{
+    int k, fd, res, mx;
+    int len = 0;
+    int vb = (op->verbose > 2) ? (op->verbose - 2) : 0;
+    uint8_t * rp;
+    char dev[D_NAME_LEN_MAX];
+    char eb[64];
+
+    for (k = 0; k < num; ++k) {
+        if (! lu_dev_node(lus + k, op, dev, sizeof(dev)))
+            continue;
+        fd = sg_cmds_open_device(dev, true /* ro */, vb);
+        if (fd < 0) {
+            if (op->verbose)
+                pr2serr("  open %s: %s\n", dev,
+                        safe_strerror_r(-fd, eb, sizeof(eb)));
+            continue;
+        }
+        mx = DEF_RLUNS_BUFF_LEN;
+        rp = NULL;
+        while (true) {
+            free(rp);
+            rp = (uint8_t *)calloc(1, mx);
+            if (NULL == rp)
+                break;
+            res = sg_ll_report_luns(fd, 0, rp, mx, false, vb);
+            if (res) {
+                if (op->verbose)
+                    pr2serr("  REPORT LUNS via %s failed, res=%d\n", dev,
+                            res);
+                free(rp);
+                rp = NULL;
+                break;
+            }
+            len = sg_get_unaligned_be32(rp + 0);
+            if (len + 8 <= mx)
+                break;
+            if (mx >= MAX_RLUNS_BUFF_LEN) {
+                len = mx - 8;   /* truncate, should not happen */
+                break;
+            }
+            mx = ((len + 8) > MAX_RLUNS_BUFF_LEN) ? MAX_RLUNS_BUFF_LEN :
+                                                    (len + 8);
+        }
+        sg_cmds_close_device(fd);
+        if (rp) {
+            *lenp = len;
+            return rp;
+        }
+    }
+    return NULL;
+}
+
+/* A logical unit that REPORT LUNS no longer lists is checked with a
+ * standard INQUIRY before it is deleted; if it still claims to be
+ * connected (peripheral qualifier 0) it is kept. */
+static bool
+lu_still_there(const struct lu_t * lup, const struct opts_t * op)
+{
+    int fd, res, resid;
+    int vb = (op->verbose > 2) ? (op->verbose - 2) : 0;
+    uint8_t b[INQ_RESP_LEN];
+    char dev[D_NAME_LEN_MAX];
+
+    if (! lu_dev_node(lup, op, dev, sizeof(dev)))
+        return false;
+    fd = sg_cmds_open_device(dev, true /* ro */, vb);
+    if (fd < 0)
+        return false;
+    memset(b, 0, sizeof(b));
+    res = sg_ll_inquiry_v2(fd, false, 0, b, sizeof(b), DEF_PT_TIMEOUT,
+                           &resid, false, vb);
+    sg_cmds_close_device(fd);
+    return ((0 == res) && (0 == (0xe0 & b[0])));
+}
+
+/* Rescans the targets of one host that sysfs knows about. Returns 0 if
+ * all sysfs writes succeed. */
+static int
+rescan_host(struct host_t * hp, const struct opts_t * op)
+{
+    bool found;
+    int k, j, m, n, len;
+    uint64_t lun;
+    uint64_t t0 = sg_get_monotonic_ns();
+    struct lu_t * lus;
+    uint8_t * rp;
+    char scan_path[NAME_LEN_MAX];
+    char b[NAME_LEN_MAX];
+    char v[64];
+
+    snprintf(scan_path, sizeof(scan_path), "%s/class/scsi_host/host%d/scan",
+             op->sysfs_root, hp->host_no);
+    for (k = 0; k < hp->num_lus; k = j) {
+        lus = hp->lus + k;
+        for (j = k + 1; j < hp->num_lus; ++j) {
+            if ((hp->lus[j].channel != lus->channel) ||
+                (hp->lus[j].target != lus->target))
+                break;
+        }
+        n = j - k;              /* number of lus of this target in sysfs */
+        ++hp->num_targets;
+        rp = target_report_luns(lus, n, op, &len);
+        if (NULL == rp) {
+            /* old device or none answer: let the kernel scan target */
+            snprintf(v, sizeof(v), "%d %d -", lus->channel, lus->target);
+            if (sysfs_write(scan_path, v, op))
+                ++hp->errs;
+            ++hp->target_scans;
+            continue;
+        }
+        for (m = 0; m < len; m += 8) {
+            lun = t10_2linux_lun(rp + 8 + m);
+            for (found = false, n = 0; n < (j - k); ++n) {
+                if (lus[n].lun == lun) {
+                    lus[n].reported = true;
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+                continue;
+            printf("  %d:%d:%d:%" PRIu64 " new\n", hp->host_no,
+                   lus->channel, lus->target, lun);
+            snprintf(v, sizeof(v), "%d %d %" PRIu64, lus->channel,
+                     lus->target, lun);
+            if (sysfs_write(scan_path, v, op))
+                ++hp->errs;
+            else
+                ++hp->added;
+        }
+        free(rp);
+        for (n = 0; n < (j - k); ++n) {
+            const struct lu_t * lup = lus + n;
+
+            snprintf(b, sizeof(b), "%s/class/scsi_device/%d:%d:%d:%" PRIu64
+                     "/device/", op->sysfs_root, lup->host, lup->channel,
+                     lup->target, lup->lun);
+            len = strlen(b);
+            if (lup->reported) {
+                if (op->do_resize) {
+                    snprintf(b + len, sizeof(b) - len, "rescan");
+                    if (sysfs_write(b, "1", op))
+                        ++hp->errs;
+                    else
+                        ++hp->resized;
+                }
+                continue;
+            }
+            if ((! op->do_remove) || lu_still_there(lup, op)) {
+                printf("  %d:%d:%d:%" PRIu64 " no longer reported%s\n",
+                       lup->host, lup->channel, lup->target, lup->lun,
+                       op->do_remove ? " but answers INQUIRY, kept" : "");
+                ++hp->stale;
+                continue;
+            }
+            printf("  %d:%d:%d:%" PRIu64 " removed\n", lup->host,
+                   lup->channel, lup->target, lup->lun);
+            snprintf(b + len, sizeof(b) - len, "delete");
+            if (sysfs_write(b, "1", op))
+                ++hp->errs;
+            else
+                ++hp->removed;
+        }
+    }
+    /* last so the kernel's scan of known targets finds nothing new */
+    if (op->do_wildcard) {
+        if (sysfs_write(scan_path, "- - -", op))
+            ++hp->errs;
+    }
+    hp->secs = (sg_get_monotonic_ns() - t0) / 1000000000.0;
+    return hp->errs ? SG_LIB_FILE_ERROR : 0;
+}
+
+static void *
+worker_thread(void * v_wp)
+{
+    int k;
+    struct work_t * wp = (struct work_t *)v_wp;
+
+    while (true) {
+        pthread_mutex_lock(&wp->mutex);
+        k = wp->next_host++;
+        pthread_mutex_unlock(&wp->mutex);
+        if (k >= wp->num_hosts)
+            break;
+        rescan_host(wp->hosts + k, wp->op);
+    }
+    return NULL;
+}
+
+/* Fills the array of hosts, either from the --hosts= list or from
+ * /sys/class/scsi_host . Returns number of hosts or -1 on error. */
+static int
+find_hosts(const char * host_list, struct host_t * hosts,
+           const struct opts_t * op)
+{
+    int n, num;
+    const char * cp;
+    DIR * dp;
+    struct dirent * dep;
+    struct stat st;
+    char b[NAME_LEN_MAX];
+
+    num = 0;
+    if (host_list) {
+        for (cp = host_list; cp; cp = strchr(cp, ',')) {
+            if (',' == *cp)
+                ++cp;
+            if (0 == strncmp(cp, "host", 4))
+                cp += 4;
+            if ((1 != sscanf(cp, "%d", &n)) || (n < 0)) {
+                pr2serr("bad host number in --hosts=%s\n", host_list);
+                return -1;
+            }
+            if (num >= MAX_HOSTS) {
+                pr2serr("too many hosts, max is %d\n", MAX_HOSTS);
+                return -1;
+            }
+            snprintf(b, sizeof(b), "%s/class/scsi_host/host%d",
+                     op->sysfs_root, n);
+            if (stat(b, &st) < 0) {
+                pr2serr("host%d not found in %s\n", n, b);
+                return -1;
+            }
+            hosts[num++].host_no = n;
+        }
+    } else {
+        snprintf(b, sizeof(b), "%s/class/scsi_host", op->sysfs_root);
+        dp = opendir(b);
+        if (NULL == dp) {
+            pr2serr(ME "opendir(%s): %s\n", b, safe_strerror(errno));
+            return -1;
+        }
+        while ((dep = readdir(dp))) {
+            if ((1 != sscanf(dep->d_name, "host%d", &n)) || (n < 0))
+                continue;
+            if (num >= MAX_HOSTS)
+                break;
+            hosts[num++].host_no = n;
+        }
+        closedir(dp);
+    }
+    qsort(hosts, num, sizeof(struct host_t), host_cmp);
+    return num;
+}
+
+/* Reads /sys/class/scsi_device into an array (caller frees) sorted by
+ * H:C:T:L . Returns number of entries or -1 on error. */
+static int
+find_lus(struct lu_t ** lupp, const struct opts_t * op)
+{
+    int num, h, c, t;
+    int mx = 256;
+    uint64_t lun;
+    DIR * dp;
+    struct dirent * dep;
+    struct lu_t * lus;
+    struct lu_t * nlus;
+    char b[NAME_LEN_MAX];
+
+    snprintf(b, sizeof(b), "%s/class/scsi_device", op->sysfs_root);
+    dp = opendir(b);
+    if (NULL == dp) {
+        pr2serr(ME "opendir(%s): %s\n", b, safe_strerror(errno));
+        return -1;
+    }
+    lus = (struct lu_t *)calloc(mx, sizeof(struct lu_t));
+    num = 0;
+    while (lus && (dep = readdir(dp))) {
+        if (4 != sscanf(dep->d_name, "%d:%d:%d:%" SCNu64, &h, &c, &t,
+                        &lun))
+            continue;
+        if (num >= mx) {
+            mx *= 2;
+            nlus = (struct lu_t *)realloc(lus, mx * sizeof(struct lu_t));
+            if (NULL == nlus) {
+                free(lus);
+                lus = NULL;
+                break;
+            }
+            lus = nlus;
+        }
+        memset(lus + num, 0, sizeof(struct lu_t));
+        lus[num].host = h;
+        lus[num].channel = c;
+        lus[num].target = t;
+        lus[num].lun = lun;
+        ++num;
+    }
+    closedir(dp);
+    if (NULL == lus) {
+        pr2serr(ME "out of memory\n");
+        return -1;
+    }
+    qsort(lus, num, sizeof(struct lu_t), lu_cmp);
+    *lupp = lus;
+    return num;
+}
+
+
+int
+main(int argc, char * argv[])
+{
+    int c, k, j, n, num_hosts, num_lus;
+    int err = 0;
+    int ret = 0;
+    uint64_t t0;
+    double secs;
+    const char * host_list = NULL;
+    struct lu_t * lus = NULL;
+    struct host_t * hosts = NULL;
+    struct host_t * hp;
+    pthread_t * tids = NULL;
+    struct opts_t opts;
+    struct opts_t * op = &opts;
+    struct work_t work;
+    struct host_t tot;
+    char eb[64];
+
+    memset(op, 0, sizeof(opts));
+    op->sysfs_root = def_sysfs_root;
+    op->dev_dir = def_dev_dir;
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "dD:hH:rRs:t:vVw", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'd':
+            op->dry_run = true;
+            break;
+        case 'D':
+            op->dev_dir = optarg;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'H':
+            host_list = optarg;
+            break;
+        case 'r':
+            op->do_remove = true;
+            break;
+        case 'R':
+            op->do_resize = true;
+            break;
+        case 's':
+            op->sysfs_root = optarg;
+            break;
+        case 't':
+            n = sg_get_num(optarg);
+            if ((n < 1) || (n > MAX_THREADS)) {
+                pr2serr("--threads= expects 1 to %d\n", MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_threads = n;
+            break;
+        case 'v':
+            ++op->verbose;
+            break;
+        case 'V':
+            pr2serr(ME "version: %s\n", version_str);
+            return 0;
+        case 'w':
+            op->do_wildcard = true;
+            break;
+        default:
+            pr2serr("unrecognised option code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+
+    t0 = sg_get_monotonic_ns();
+    hosts = (struct host_t *)calloc(MAX_HOSTS, sizeof(struct host_t));
+    if (NULL == hosts) {
+        pr2serr(ME "out of memory\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    num_hosts = find_hosts(host_list, hosts, op);
+    if (num_hosts < 0) {
+        ret = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    if (0 == num_hosts) {
+        if (op->verbose)
+            pr2serr("no SCSI hosts found\n");
+        goto fini;
+    }
+    num_lus = find_lus(&lus, op);
+    if (num_lus < 0) {
+        ret = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    /* point each host at its (contiguous) run of the sorted lus */
+    for (k = 0, j = 0; k < num_hosts; ++k) {
+        hp = hosts + k;
+        while ((j < num_lus) && (lus[j].host < hp->host_no))
+            ++j;
+        hp->lus = lus + j;
+        while ((j < num_lus) && (lus[j].host == hp->host_no)) {
+            ++hp->num_lus;
+            ++j;
+        }
+    }
+    if ((0 == op->num_threads) || (op->num_threads > num_hosts))
+        op->num_threads = (num_hosts > MAX_THREADS) ? MAX_THREADS :
+                                                      num_hosts;
+    if (op->verbose)
+        pr2serr("%d hosts, %d logical units in sysfs, %d threads\n",
+                num_hosts, num_lus, op->num_threads);
+
+    memset(&work, 0, sizeof(work));
+    work.op = op;
+    work.hosts = hosts;
+    work.num_hosts = num_hosts;
+    pthread_mutex_init(&work.mutex, NULL);
+    tids = (pthread_t *)calloc(op->num_threads, sizeof(pthread_t));
+    if (NULL == tids) {
+        pr2serr(ME "out of memory\n");
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < op->num_threads; ++k) {
+        err = pthread_create(tids + k, NULL, worker_thread, &work);
+        if (err) {
+            /* workers already started may be reporting errors */
+            pr2serr(ME "pthread_create: %s\n",
+                    safe_strerror_r(err, eb, sizeof(eb)));
+            break;
+        }
+    }
+    if (0 == k) {
+        ret = sg_convert_errno(err);
+        goto fini;
+    }
+    for (j = 0; j < k; ++j)
+        pthread_join(tids[j], NULL);
+    pthread_mutex_destroy(&work.mutex);
+    secs = (sg_get_monotonic_ns() - t0) / 1000000000.0;
+
+    memset(&tot, 0, sizeof(tot));
+    for (k = 0; k < num_hosts; ++k) {
+        hp = hosts + k;
+        printf("host%d: %d targets, %d LUs: %d added, %d removed, %d "
+               "stale", hp->host_no, hp->num_targets, hp->num_lus,
+               hp->added, hp->removed, hp->stale);
+        if (op->do_resize)
+            printf(", %d resized", hp->resized);
+        if (hp->target_scans)
+            printf(", %d target scans", hp->target_scans);
+        printf(" [%.3f secs]\n", hp->secs);
+        tot.num_targets += hp->num_targets;
+        tot.num_lus += hp->num_lus;
+        tot.added += hp->added;
+        tot.removed += hp->removed;
+        tot.stale += hp->stale;
+        tot.errs += hp->errs;
+    }
+    printf("Rescanned %d hosts (%d targets) in %.3f secs: %d added, %d "
+           "removed, %d stale\n", num_hosts, tot.num_targets, secs,
+           tot.added, tot.removed, tot.stale);
+    if (tot.errs) {
+        pr2serr("%d sysfs write(s) failed\n", tot.errs);
+        ret = SG_LIB_FILE_ERROR;
+    }
+fini:
+    free(tids);
+    free(lus);
+    free(hosts);
+    return ret;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2018-2019 Douglas Gilbert.
+ * Copyright (c) 2018-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -16,6 +16,10 @@
 #include <ctype.h>
 #include <getopt.h>
 #include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -23,6 +27,7 @@
 #include "config.h"
 #endif
 
+
 #include "sg_lib.h"
 #include "sg_lib_data.h"
 #include "sg_pt.h"
@@ -33,9 +38,11 @@
 /*
  * This program issues the SCSI STREAM CONTROL or GET STREAM STATUS command
  * to the given SCSI device. Based on sbc4r15.pdf .
+ * With --write=K it opens K streams and writes them concurrently with
+ * WRITE STREAM(16) commands, then reports per stream throughput.
  */
 
-static const char * version_str = "1.07 20190113";
+static const char * version_str = "1.08 20261018";
 
 #define STREAM_CONTROL_SA 0x14
 #define GET_STREAM_STATUS_SA 0x16
@@ -43,22 +50,74 @@ static const char * version_str = "1.07 20190113";
 #define STREAM_CONTROL_OPEN 0x1
 #define STREAM_CONTROL_CLOSE 0x2
 
+#define WRITE_STREAM16_OP 0x9a
+
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_PT_TIMEOUT  60      /* 60 seconds */
+#define DEF_BPT 128             /* blocks per WRITE STREAM command */
+#define MAX_WR_STREAMS 64
+#define MAX_QD 64
+
+struct sw_ctl {                 /* shared by all --write=K workers */
+    bool stop;                  /* error or --duration= expired */
+    int num_str;                /* K from --write=K */
+    int bs;                     /* logical block size */
+    int verbose;
+    uint32_t bpt;
+    uint32_t duration;          /* seconds, 0 -> until ranges written */
+    uint64_t lba;               /* start of first stream's range */
+    uint64_t num;               /* blocks per stream, 0 -> split capacity */
+    uint64_t deadline_ns;
+    const char * device_name;
+    pthread_mutex_t mutex;      /* protects stop */
+};
+
+struct sw_stream {
+    bool in_reg;                /* infd is a regular file: use pread() */
+    int infd;                   /* -1 -> synthetic pattern */
+    int qd;
+    int ret;                    /* first error from a worker */
+    uint16_t str_id;            /* assigned by STREAM CONTROL (open) */
+    uint64_t start_lba;
+    uint64_t next_lba;
+    uint64_t end_lba;           /* one past last */
+    uint64_t blks;
+    uint64_t cmds;
+    uint64_t lat_ns;
+    uint64_t max_lat_ns;
+    uint64_t end_ns;            /* when last command completed */
+    const char * if_name;
+    pthread_mutex_t mutex;      /* protects the above from next_lba */
+};
+
+struct sw_worker {
+    struct sw_stream * ssp;
+    struct sw_ctl * scp;
+    pthread_t tid;
+};
+
+static volatile sig_atomic_t sw_interrupted = 0;
 
 
 static struct option long_options[] = {
+        {"bpt", required_argument, 0, 'B'},
         {"brief", no_argument, 0, 'b'},
         {"close", no_argument, 0, 'c'},
         {"ctl", required_argument, 0, 'C'},
+        {"duration", required_argument, 0, 'd'},
         {"get", no_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"id", required_argument, 0, 'i'},
+        {"in", required_argument, 0, 'I'},
+        {"lba", required_argument, 0, 'l'},
         {"maxlen", required_argument, 0, 'm'},
+        {"num", required_argument, 0, 'n'},
         {"open", no_argument, 0, 'o'},
+        {"qd", required_argument, 0, 'q'},
         {"readonly", no_argument, 0, 'r'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
+        {"write", required_argument, 0, 'w'},
         {0, 0, 0, 0},
 };
 
@@ -87,22 +146,44 @@ usage()
             "    --id=SID|-i SID     for close, SID is stream_id to close; "
             "for get,\n"
             "                        list from and include this stream id\n"
+            "    --in=IF[,IF...]|-I IF[,IF...]    data source of each stream "
+            "for\n"
+            "                        --write=K; a missing IF (or none) "
+            "selects a\n"
+            "                        synthetic pattern stamped with LBA and "
+            "stream id\n"
+            "    --lba=LBA|-l LBA    first LBA written by --write=K (def: "
+            "0)\n"
             "    --maxlen=LEN|-m LEN    length in bytes of buffer to "
             "receive data-in\n"
             "                           (def: 8 (for open and close); 252 "
             "(for get,\n"
             "                           but increase if needed)\n"
+            "    --num=NUM|-n NUM    blocks written to each stream (def: "
+            "capacity\n"
+            "                        from LBA split equally between K "
+            "streams)\n"
             "    --open|-o           open a new stream, return assigned "
             "stream id\n"
+            "    --qd=QD[,QD...]|-q QD[,QD...]    commands outstanding on "
+            "each\n"
+            "                        stream (def: 1); one QD applies to all "
+            "streams\n"
             "    --readonly|-r       open DEVICE read-only (if supported)\n"
             "    --verbose|-v        increase verbosity\n"
-            "    --version|-V        print version string and exit\n\n"
+            "    --version|-V        print version string and exit\n"
+            "    --write=K|-w K      open K streams, write them concurrently "
+            "then\n"
+            "                        close them; reports per stream "
+            "throughput\n\n"
             "Performs a SCSI STREAM CONTROL or GET STREAM STATUS command. "
             "If --open,\n--close or --ctl=CTL given (only one) then "
             "performs STREAM CONTROL\ncommand. If --get or no other "
             "selecting option given then performs a\nGET STREAM STATUS "
             "command. A successful --open will output the assigned\nstream "
-            "id to stdout (and ignore --id=SID , if given).\n"
+            "id to stdout (and ignore --id=SID , if given). With "
+            "--write=K each\nstream writes its own NUM block range, "
+            "starting at LBA, with WRITE\nSTREAM(16) commands.\n"
            );
 }
 
@@ -233,6 +314,498 @@ sg_ll_stream_control(int sg_fd, uint32_t str_ctl, uint16_t str_id,
     return ret;
 }
 
+/* Invokes a SCSI WRITE STREAM(16) command (SBC-4).  Return of 0 -> success,
+ * various SG_LIB_CAT_* positive values or -1 -> other errors */
+static int
+sg_ll_write_stream16(int sg_fd, uint16_t str_id, uint64_t lba, uint32_t num,
+                     uint8_t * dop, int dlen, bool noisy, int verbose)
+{
+    int k, ret, res, sense_cat;
+    uint8_t wsCdb[16] = {WRITE_STREAM16_OP,
+           0, 0, 0,  0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t sense_b[SENSE_BUFF_LEN];
+    struct sg_pt_base * ptvp;
+    static const char * const cmd_name = "Write stream(16)";
+
+    sg_put_unaligned_be64(lba, wsCdb + 2);
+    sg_put_unaligned_be16(str_id, wsCdb + 10);
+    sg_put_unaligned_be16((uint16_t)num, wsCdb + 12);
+    if (verbose > 1) {
+        pr2serr("    %s cdb: ", cmd_name);
+        for (k = 0; k < (int)sizeof(wsCdb); ++k)
+            pr2serr("%02x ", wsCdb[k]);
+        pr2serr("\n");
+    }
+
+    ptvp = construct_scsi_pt_obj_with_fd(sg_fd, verbose);
+    if (NULL == ptvp) {
+        pr2serr("%s: out of memory\n", cmd_name);
+        return -1;
+    }
+    set_scsi_pt_cdb(ptvp, wsCdb, sizeof(wsCdb));
+    set_scsi_pt_data_out(ptvp, dop, dlen);
+    set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
+    res = do_scsi_pt(ptvp, -1, DEF_PT_TIMEOUT, verbose);
+    ret = sg_cmds_process_resp(ptvp, cmd_name, res, noisy, verbose,
+                               &sense_cat);
+    if (-1 == ret)
+        ret = sg_convert_errno(get_scsi_pt_os_err(ptvp));
+    else if (-2 == ret) {
+        switch (sense_cat) {
+        case SG_LIB_CAT_RECOVERED:
+        case SG_LIB_CAT_NO_SENSE:
+            ret = 0;
+            break;
+        default:
+            ret = sense_cat;
+            break;
+        }
+    } else
+        ret = 0;
+    destruct_scsi_pt_obj(ptvp);
+    return ret;
+}
+
+/* First SIGINT or SIGTERM asks the workers to stop so the open streams
+ * can be closed; a second one takes the default action. */
+static void
+sw_interrupt_handler(int sig)
+{
+    struct sigaction sigact;
+
+    sigact.sa_handler = SIG_DFL;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigaction(sig, &sigact, NULL);
+    sw_interrupted = 1;
+}
+
+static void
+sw_install_handler(int sig_num)
+{
+    struct sigaction sigact;
+
+    sigaction(sig_num, NULL, &sigact);
+    if (sigact.sa_handler != SIG_IGN) {
+        sigact.sa_handler = sw_interrupt_handler;
+        sigemptyset(&sigact.sa_mask);
+        sigact.sa_flags = 0;
+        sigaction(sig_num, &sigact, NULL);
+    }
+}
+
+static bool
+sw_should_stop(struct sw_ctl * scp)
+{
+    bool stop;
+
+    if (sw_interrupted)
+        return true;
+    pthread_mutex_lock(&scp->mutex);
+    if ((! scp->stop) && (scp->deadline_ns > 0) &&
+        (sg_get_monotonic_ns() >= scp->deadline_ns))
+        scp->stop = true;
+    stop = scp->stop;
+    pthread_mutex_unlock(&scp->mutex);
+    return stop;
+}
+
+/* Each block of synthetic data starts with its LBA (8 bytes, big endian)
+ * and the stream id (2 bytes), the remainder of the block is filled with
+ * a byte derived from the stream id. */
+static void
+sw_stamp(uint8_t * bp, uint64_t lba, uint32_t num, int bs, uint16_t str_id)
+{
+    uint32_t k;
+
+    for (k = 0; k < num; ++k, bp += bs, ++lba) {
+        sg_put_unaligned_be64(lba, bp + 0);
+        sg_put_unaligned_be16(str_id, bp + 8);
+    }
+}
+
+/* One thread per outstanding command of a stream. Each claims the next
+ * chunk of its stream's LBA range, fetches its data and sends it with a
+ * WRITE STREAM(16) command on its own file descriptor. */
+static void *
+sw_worker(void * v_wp)
+{
+    int sg_fd, res, n;
+    uint32_t num;
+    uint64_t lba, t_start, lat;
+    struct sw_worker * wp = (struct sw_worker *)v_wp;
+    struct sw_stream * ssp = wp->ssp;
+    struct sw_ctl * scp = wp->scp;
+    uint8_t * bp;
+    uint8_t * free_bp = NULL;
+
+    sg_fd = sg_cmds_open_device(scp->device_name, false, scp->verbose);
+    if (sg_fd < 0) {
+        pr2serr("Stream %u: open error: %s: %s\n", ssp->str_id,
+                scp->device_name, safe_strerror(-sg_fd));
+        res = sg_convert_errno(-sg_fd);
+        goto err_out;
+    }
+    bp = sg_memalign(scp->bpt * scp->bs, 0, &free_bp, false);
+    if (NULL == bp) {
+        pr2serr("Stream %u: unable to allocate buffer\n", ssp->str_id);
+        res = sg_convert_errno(ENOMEM);
+        goto err_out;
+    }
+    if (ssp->infd < 0)
+        memset(bp, 0x80 | (ssp->str_id & 0x7f), scp->bpt * scp->bs);
+    while (! sw_should_stop(scp)) {
+        pthread_mutex_lock(&ssp->mutex);
+        lba = ssp->next_lba;
+        num = ((ssp->end_lba - lba) < scp->bpt) ?
+              (uint32_t)(ssp->end_lba - lba) : scp->bpt;
+        if ((num > 0) && (ssp->infd >= 0) && (! ssp->in_reg)) {
+            /* pipe or character device: keep the data in order */
+            n = sg_full_read(ssp->infd, bp, num * scp->bs);
+            if (n < 0) {
+                pthread_mutex_unlock(&ssp->mutex);
+                pr2serr("Stream %u: error reading %s: %s\n", ssp->str_id,
+                        ssp->if_name, safe_strerror(-n));
+                res = sg_convert_errno(-n);
+                goto err_out;
+            }
+            if ((uint32_t)n < (num * scp->bs)) {
+                if (n % scp->bs)
+                    pr2serr("Stream %u: ignoring %d bytes of partial block "
+                            "at end of %s\n", ssp->str_id, n % scp->bs,
+                            ssp->if_name);
+                num = n / scp->bs;
+                ssp->end_lba = lba + num;       /* end of file */
+            }
+        }
+        ssp->next_lba += num;
+        pthread_mutex_unlock(&ssp->mutex);
+        if (0 == num)
+            break;
+        if (ssp->in_reg) {
+            n = pread(ssp->infd, bp, num * scp->bs,
+                      (off_t)((lba - ssp->start_lba) * scp->bs));
+            if (n < (int)(num * scp->bs)) {
+                pr2serr("Stream %u: short read on %s: %s\n", ssp->str_id,
+                        ssp->if_name, (n < 0) ? safe_strerror(errno) :
+                        "truncated?");
+                res = (n < 0) ? sg_convert_errno(errno) : SG_LIB_FILE_ERROR;
+                goto err_out;
+            }
+        } else if (ssp->infd < 0)
+            sw_stamp(bp, lba, num, scp->bs, ssp->str_id);
+        t_start = sg_get_monotonic_ns();
+        res = sg_ll_write_stream16(sg_fd, ssp->str_id, lba, num, bp,
+                                   num * scp->bs, true, scp->verbose);
+        lat = sg_get_monotonic_ns() - t_start;
+        if (res) {
+            char b[80];
+
+            sg_get_category_sense_str(res, sizeof(b), b, scp->verbose);
+            pr2serr("Stream %u: Write stream(16) at lba=0x%" PRIx64 ": %s\n",
+                    ssp->str_id, lba, b);
+            goto err_out;
+        }
+        pthread_mutex_lock(&ssp->mutex);
+        ssp->blks += num;
+        ++ssp->cmds;
+        ssp->lat_ns += lat;
+        if (lat > ssp->max_lat_ns)
+            ssp->max_lat_ns = lat;
+        ssp->end_ns = t_start + lat;
+        pthread_mutex_unlock(&ssp->mutex);
+    }
+    res = 0;
+    goto fini;
+err_out:
+    pthread_mutex_lock(&ssp->mutex);
+    if (0 == ssp->ret)
+        ssp->ret = res;
+    pthread_mutex_unlock(&ssp->mutex);
+    pthread_mutex_lock(&scp->mutex);
+    scp->stop = true;
+    pthread_mutex_unlock(&scp->mutex);
+fini:
+    if (free_bp)
+        free(free_bp);
+    if (sg_fd >= 0)
+        sg_cmds_close_device(sg_fd);
+    return NULL;
+}
+
+/* Fetches the logical block size and number of blocks with READ
+ * CAPACITY(16), falling back to READ CAPACITY(10). */
+static int
+sw_capacity(int sg_fd, int * bsp, uint64_t * num_lbsp, int verbose)
+{
+    int res;
+    uint8_t rc_buff[32];
+
+    res = sg_ll_readcap_16(sg_fd, false, 0, rc_buff, sizeof(rc_buff), true,
+                           verbose);
+    if (0 == res) {
+        *num_lbsp = sg_get_unaligned_be64(rc_buff + 0) + 1;
+        *bsp = (int)sg_get_unaligned_be32(rc_buff + 8);
+    } else {
+        res = sg_ll_readcap_10(sg_fd, false, 0, rc_buff, 8, true, verbose);
+        if (res)
+            return res;
+        *num_lbsp = (uint64_t)sg_get_unaligned_be32(rc_buff + 0) + 1;
+        *bsp = (int)sg_get_unaligned_be32(rc_buff + 4);
+    }
+    if ((*bsp <= 0) || (*bsp > (1024 * 1024))) {
+        pr2serr("Unexpected logical block size: %d\n", *bsp);
+        return SG_LIB_CAT_MALFORMED;
+    }
+    return 0;
+}
+
+static void
+sw_report(const char * leadin, uint64_t blks, uint64_t cmds, uint64_t lat_ns,
+          uint64_t max_lat_ns, uint64_t elapsed_ns, int bs)
+{
+    double secs = (double)elapsed_ns / 1000000000.0;
+    double mb = (double)blks * bs / 1000000.0;
+
+    printf("%s: %" PRIu64 " blocks (%.2f MB) in %" PRIu64 " commands",
+           leadin, blks, mb, cmds);
+    if (secs > 0.00001)
+        printf(", %.2f MB/sec, %.1f IOPS", mb / secs, (double)cmds / secs);
+    if (cmds > 0)
+        printf(", latency avg/max: %" PRIu64 "/%" PRIu64 " usec",
+               (lat_ns / cmds) / 1000, max_lat_ns / 1000);
+    printf("\n");
+}
+
+/* Opens scp->num_str streams with STREAM CONTROL, writes each stream's LBA
+ * range from its own source with its own queue depth, reports per stream
+ * throughput and closes every stream that was opened before returning. */
+static int
+do_stream_write(int sg_fd, struct sw_ctl * scp, struct sw_stream * ss_arr)
+{
+    int k, j, resid, num_wk;
+    int res = 0;
+    int ret = 0;
+    int opened = 0;
+    uint64_t num_lbs, per_str, t_start, t_last, blks, cmds, lat, max_lat;
+    struct sw_stream * ssp;
+    struct sw_worker * wk_arr = NULL;
+    struct stat a_stat;
+    uint8_t resp[8];
+    char b[80];
+
+    ret = sw_capacity(sg_fd, &scp->bs, &num_lbs, scp->verbose);
+    if (ret) {
+        sg_get_category_sense_str(ret, sizeof(b), b, scp->verbose);
+        pr2serr("Read capacity: %s\n", b);
+        return ret;
+    }
+    if (scp->lba >= num_lbs) {
+        pr2serr("--lba=0x%" PRIx64 " beyond end of %s (%" PRIu64
+                " blocks)\n", scp->lba, scp->device_name, num_lbs);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    per_str = scp->num ? scp->num : (num_lbs - scp->lba) / scp->num_str;
+    if ((0 == per_str) || ((per_str * scp->num_str) > (num_lbs - scp->lba))) {
+        pr2serr("%d streams of %" PRIu64 " blocks from lba=0x%" PRIx64
+                " do not fit in %s (%" PRIu64 " blocks)\n", scp->num_str,
+                per_str, scp->lba, scp->device_name, num_lbs);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    for (k = 0, num_wk = 0; k < scp->num_str; ++k) {
+        ssp = ss_arr + k;
+        ssp->start_lba = scp->lba + (k * per_str);
+        ssp->next_lba = ssp->start_lba;
+        ssp->end_lba = ssp->start_lba + per_str;
+        num_wk += ssp->qd;
+        if (ssp->infd < 0)
+            continue;
+        if ((0 == fstat(ssp->infd, &a_stat)) && S_ISREG(a_stat.st_mode)) {
+            ssp->in_reg = true;
+            if ((uint64_t)(a_stat.st_size / scp->bs) < per_str)
+                ssp->end_lba = ssp->start_lba + (a_stat.st_size / scp->bs);
+        }
+    }
+    wk_arr = (struct sw_worker *)calloc(num_wk, sizeof(struct sw_worker));
+    if (NULL == wk_arr) {
+        pr2serr("Unable to allocate %d workers\n", num_wk);
+        return sg_convert_errno(ENOMEM);
+    }
+
+    /* open the streams, the device assigns their ids */
+    for (k = 0; k < scp->num_str; ++k) {
+        ssp = ss_arr + k;
+        memset(resp, 0, sizeof(resp));
+        resid = 0;
+        ret = sg_ll_stream_control(sg_fd, STREAM_CONTROL_OPEN, 0, resp,
+                                   sizeof(resp), &resid, false,
+                                   scp->verbose);
+        if (ret) {
+            sg_get_category_sense_str(ret, sizeof(b), b, scp->verbose);
+            pr2serr("Stream control (open) of stream %d of %d: %s\n", k + 1,
+                    scp->num_str, b);
+            goto close_streams;
+        }
+        if ((resp[0] + 1 < 6) || ((int)sizeof(resp) - resid < 6)) {
+            pr2serr("Stream control (open) response too short\n");
+            ret = SG_LIB_CAT_MALFORMED;
+            goto close_streams;
+        }
+        ssp->str_id = sg_get_unaligned_be16(resp + 4);
+        ++opened;
+        if (scp->verbose)
+            pr2serr("Opened stream id %u for lba range 0x%" PRIx64
+                    "..0x%" PRIx64 ", qd=%d, source: %s\n", ssp->str_id,
+                    ssp->start_lba, ssp->end_lba - 1, ssp->qd,
+                    (ssp->infd < 0) ? "pattern" : ssp->if_name);
+    }
+
+    sw_install_handler(SIGINT);
+    sw_install_handler(SIGTERM);
+    t_start = sg_get_monotonic_ns();
+    if (scp->duration > 0)
+        scp->deadline_ns = t_start + (uint64_t)scp->duration * 1000000000;
+    for (k = 0, j = 0; k < scp->num_str; ++k) {
+        int q;
+
+        ssp = ss_arr + k;
+        ssp->end_ns = t_start;
+        for (q = 0; q < ssp->qd; ++q, ++j) {
+            wk_arr[j].ssp = ssp;
+            wk_arr[j].scp = scp;
+            res = pthread_create(&wk_arr[j].tid, NULL, sw_worker,
+                                 wk_arr + j);
+            if (res) {
+                pr2serr("pthread_create: %s\n", safe_strerror(res));
+                ret = sg_convert_errno(res);
+                pthread_mutex_lock(&scp->mutex);
+                scp->stop = true;
+                pthread_mutex_unlock(&scp->mutex);
+                break;
+            }
+        }
+        if (res)
+            break;
+    }
+    num_wk = j;
+    for (j = 0; j < num_wk; ++j)
+        pthread_join(wk_arr[j].tid, NULL);
+
+    if (sw_interrupted)
+        pr2serr("Interrupted by signal, closing streams\n");
+    t_last = t_start;
+    blks = 0;
+    cmds = 0;
+    lat = 0;
+    max_lat = 0;
+    for (k = 0; k < scp->num_str; ++k) {
+        ssp = ss_arr + k;
+        snprintf(b, sizeof(b), "Stream id %u", ssp->str_id);
+        sw_report(b, ssp->blks, ssp->cmds, ssp->lat_ns, ssp->max_lat_ns,
+                  ssp->end_ns - t_start, scp->bs);
+        blks += ssp->blks;
+        cmds += ssp->cmds;
+        lat += ssp->lat_ns;
+        if (ssp->max_lat_ns > max_lat)
+            max_lat = ssp->max_lat_ns;
+        if (ssp->end_ns > t_last)
+            t_last = ssp->end_ns;
+        if (ssp->ret && (0 == ret))
+            ret = ssp->ret;
+    }
+    if (scp->num_str > 1) {
+        snprintf(b, sizeof(b), "All %d streams", scp->num_str);
+        sw_report(b, blks, cmds, lat, max_lat, t_last - t_start, scp->bs);
+    }
+
+close_streams:
+    for (k = 0; k < opened; ++k) {
+        ssp = ss_arr + k;
+        res = sg_ll_stream_control(sg_fd, STREAM_CONTROL_CLOSE, ssp->str_id,
+                                   resp, sizeof(resp), NULL, false,
+                                   scp->verbose);
+        if (res) {
+            sg_get_category_sense_str(res, sizeof(b), b, scp->verbose);
+            pr2serr("Stream control (close) of stream id %u: %s\n",
+                    ssp->str_id, b);
+            if (0 == ret)
+                ret = res;
+        } else if (scp->verbose)
+            pr2serr("Closed stream id %u\n", ssp->str_id);
+    }
+    free(wk_arr);
+    if ((0 == ret) && sw_interrupted)
+        ret = SG_LIB_CAT_OTHER;
+    return ret;
+}
+
+/* Decodes --in=IF[,IF...] and --qd=QD[,QD...] into ss_arr and opens the
+ * input files. The IF names point into *in_sp which the caller should
+ * free. Returns 0 or an exit status. */
+static int
+sw_setup(struct sw_stream * ss_arr, int num_str, const char * in_arg,
+         const char * qd_arg, char ** in_sp)
+{
+    int k, n;
+    char * cp;
+    char * np;
+    char * in_s;
+    const char * qp;
+
+    for (k = 0; k < num_str; ++k) {
+        ss_arr[k].infd = -1;
+        ss_arr[k].qd = 1;
+        pthread_mutex_init(&ss_arr[k].mutex, NULL);
+    }
+    for (qp = qd_arg, k = 0; qp && *qp; ++k) {
+        if (k >= num_str) {
+            pr2serr("--qd= has more values than streams (%d)\n", num_str);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        n = sg_get_num(qp);
+        if ((n < 1) || (n > MAX_QD)) {
+            pr2serr("--qd= expects values from 1 to %d\n", MAX_QD);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        ss_arr[k].qd = n;
+        qp = strchr(qp, ',');
+        if (qp)
+            ++qp;
+    }
+    if (1 == k) {               /* one QD applies to all streams */
+        for (k = 1; k < num_str; ++k)
+            ss_arr[k].qd = ss_arr[0].qd;
+    }
+    if (NULL == in_arg)
+        return 0;
+    in_s = strdup(in_arg);
+    if (NULL == in_s)
+        return sg_convert_errno(ENOMEM);
+    *in_sp = in_s;
+    for (cp = in_s, k = 0; cp; cp = np, ++k) {
+        np = strchr(cp, ',');
+        if (np)
+            *np++ = '\0';
+        if (k >= num_str) {
+            pr2serr("--in= has more files than streams (%d)\n", num_str);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        if ('\0' == *cp)
+            continue;           /* synthetic pattern for this stream */
+        ss_arr[k].if_name = cp;
+        if (0 == strcmp(cp, "-"))
+            ss_arr[k].infd = STDIN_FILENO;
+        else
+            ss_arr[k].infd = open(cp, O_RDONLY);
+        if (ss_arr[k].infd < 0) {
+            n = errno;
+            pr2serr("Unable to open %s: %s\n", cp, safe_strerror(n));
+            return sg_convert_errno(n);
+        }
+    }
+    return 0;
+}
+
 
 int
 main(int argc, char * argv[])
@@ -246,7 +819,9 @@ main(int argc, char * argv[])
     bool read_only = false;
     bool verbose_given = false;
     bool version_given = false;
+    bool wr_opt_given = false;
     int c, k, res, resid;
+    int num_str = 0;
     int sg_fd = -1;
     int maxlen = 0;
     int ret = 0;
@@ -256,16 +831,25 @@ main(int argc, char * argv[])
     uint32_t ctl = 0;
     uint32_t pg_sz = sg_get_page_size();
     uint32_t param_dl;
+    int64_t ll;
     const char * device_name = NULL;
     const char * cmd_name = NULL;
+    const char * in_arg = NULL;
+    const char * qd_arg = NULL;
+    char * in_s = NULL;
     uint8_t * arr = NULL;
     uint8_t * free_arr = NULL;
+    struct sw_stream * ss_arr = NULL;
+    struct sw_ctl sw_ctl;
+
+    memset(&sw_ctl, 0, sizeof(sw_ctl));
+    sw_ctl.bpt = DEF_BPT;
 
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "bcC:ghi:m:orvV", long_options,
-                        &option_index);
+        c = getopt_long(argc, argv, "bB:cC:d:ghi:I:l:m:n:oq:rvVw:",
+                        long_options, &option_index);
         if (c == -1)
             break;
 
@@ -273,6 +857,15 @@ main(int argc, char * argv[])
         case 'b':
             do_brief = true;
             break;
+        case 'B':
+            k = sg_get_num(optarg);
+            if ((k < 1) || (k > UINT16_MAX)) {
+                pr2serr("--bpt= expects a number from 1 to 65535\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            sw_ctl.bpt = (uint32_t)k;
+            wr_opt_given = true;
+            break;
         case 'c':
             do_close = true;
             break;
@@ -283,6 +876,15 @@ main(int argc, char * argv[])
             }
             ctl_given = true;
             break;
+        case 'd':
+            k = sg_get_num(optarg);
+            if (k < 0) {
+                pr2serr("--duration= unable to decode argument\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            sw_ctl.duration = (uint32_t)k;
+            wr_opt_given = true;
+            break;
         case 'g':
             do_get = true;
             break;
@@ -298,6 +900,19 @@ main(int argc, char * argv[])
             }
             stream_id = (uint16_t)k;
             break;
+        case 'I':
+            in_arg = optarg;
+            wr_opt_given = true;
+            break;
+        case 'l':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("--lba= unable to decode argument\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            sw_ctl.lba = (uint64_t)ll;
+            wr_opt_given = true;
+            break;
         case 'm':
             k = sg_get_num(optarg);
             if (k < 0) {
@@ -308,9 +923,22 @@ main(int argc, char * argv[])
             if (k > 0)
                 maxlen = k;
             break;
+        case 'n':
+            ll = sg_get_llnum(optarg);
+            if (ll < 0) {
+                pr2serr("--num= unable to decode argument\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            sw_ctl.num = (uint64_t)ll;
+            wr_opt_given = true;
+            break;
         case 'o':
             do_open = true;
             break;
+        case 'q':
+            qd_arg = optarg;
+            wr_opt_given = true;
+            break;
         case 'r':
             read_only = true;
             break;
@@ -321,6 +949,14 @@ main(int argc, char * argv[])
         case 'V':
             version_given = true;
             break;
+        case 'w':
+            num_str = sg_get_num(optarg);
+            if ((num_str < 1) || (num_str > MAX_WR_STREAMS)) {
+                pr2serr("--write= expects a number from 1 to %d\n",
+                        MAX_WR_STREAMS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         default:
             pr2serr("unrecognised option code 0x%x ??\n", c);
             usage();
@@ -367,10 +1003,21 @@ main(int argc, char * argv[])
     }
 
     k = (int)do_close + (int)do_get + (int)do_open + (int)ctl_given;
+    if (num_str > 0) {
+        if ((k > 0) || read_only) {
+            pr2serr("--write=K cannot be given with --close, --ctl=, "
+                    "--get, --open\nor --readonly\n");
+            return SG_LIB_CONTRADICT;
+        }
+    } else if (wr_opt_given) {
+        pr2serr("--bpt=, --duration=, --in=, --lba=, --num= and --qd= "
+                "need --write=K\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
     if (k > 1) {
         pr2serr("Can only have one of: --close, --ctl==, --get, or --open\n");
         return SG_LIB_CONTRADICT;
-    } else if (0 == k)
+    } else if ((0 == k) && (0 == num_str))
         do_get = true;
     if (do_close)
         ctl = STREAM_CONTROL_CLOSE;
@@ -399,6 +1046,30 @@ main(int argc, char * argv[])
         goto fini;
     }
 
+    if (num_str > 0) {
+        ss_arr = (struct sw_stream *)calloc(num_str,
+                                            sizeof(struct sw_stream));
+        if (NULL == ss_arr) {
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        ret = sw_setup(ss_arr, num_str, in_arg, qd_arg, &in_s);
+        if (0 == ret) {
+            sw_ctl.num_str = num_str;
+            sw_ctl.verbose = verbose;
+            sw_ctl.device_name = device_name;
+            pthread_mutex_init(&sw_ctl.mutex, NULL);
+            ret = do_stream_write(sg_fd, &sw_ctl, ss_arr);
+            pthread_mutex_destroy(&sw_ctl.mutex);
+        }
+        for (k = 0; k < num_str; ++k) {
+            if ((ss_arr[k].infd >= 0) && (STDIN_FILENO != ss_arr[k].infd))
+                close(ss_arr[k].infd);
+            pthread_mutex_destroy(&ss_arr[k].mutex);
+        }
+        goto fini;
+    }
+
     if (maxlen > (int)pg_sz)
         arr = sg_memalign(maxlen, pg_sz, &free_arr, verbose > 3);
     else
@@ -490,6 +1161,10 @@ main(int argc, char * argv[])
     }
 
 fini:
+    if (ss_arr)
+        free(ss_arr);
+    if (in_s)
+        free(in_s);
     if (free_arr)
         free(free_arr);
     if (sg_fd >= 0) {
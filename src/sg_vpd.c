@@ -26,6 +26,11 @@
 #include "config.h"
 #endif
 
+#ifndef SG_LIB_WIN32
+#include <pthread.h>
+#define SVPD_HAVE_PTHREAD 1
+#endif
+
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_unaligned.h"
@@ -40,7 +45,7 @@
 
 */
 
-static const char * version_str = "1.54 20190516";  /* spc5r22 + sbc4r17 */
+static const char * version_str = "1.55 20261018";  /* spc5r22 + sbc4r17 */
 
 /* standard VPD pages, in ascending page number order */
 #define VPD_SUPPORTED_VPDS 0x0
@@ -101,6 +106,11 @@ static const char * version_str = "1.54 20190516";  /* spc5r22 + sbc4r17 */
 #define INQUIRY_CMDLEN  6
 #define DEF_PT_TIMEOUT  60       /* 60 seconds */
 
+#define DEF_BATCH_THREADS 16
+#define MAX_BATCH_THREADS 1024
+#define MAX_BATCH_PAGES 64
+#define DEF_BATCH_PAGES "sn,di,bl,bdc,lbpv"
+
 
 /* These structures are duplicates of those of the same name in
  * sg_vpd_vendor.c . Take care that both are the same. */
@@ -164,6 +174,7 @@ static uint8_t * free_rsp_buff;
 
 static struct option long_options[] = {
         {"all", no_argument, 0, 'a'},
+        {"batch", no_argument, 0, 'B'},
         {"enumerate", no_argument, 0, 'e'},
         {"examine", no_argument, 0, 'E'},
         {"force", no_argument, 0, 'f'},
@@ -176,6 +187,7 @@ static struct option long_options[] = {
         {"page", required_argument, 0, 'p'},
         {"quiet", no_argument, 0, 'q'},
         {"raw", no_argument, 0, 'r'},
+        {"threads", required_argument, 0, 'T'},
         {"vendor", required_argument, 0, 'M'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
@@ -255,10 +267,17 @@ usage()
             "               [--quiet] [--raw] [--vendor=VP] [--verbose] "
             "[--version]\n"
             "               DEVICE\n");
+    pr2serr("       sg_vpd  --batch [--all] [--maxlen=LEN] [--page=PG[,PG...]] "
+            "[--threads=TN]\n"
+            "               [--verbose] [DEVICE...]\n");
     pr2serr("  where:\n"
             "    --all|-a        output all pages listed in the supported "
             "pages VPD\n"
             "                    page\n"
+            "    --batch|-B      fetch pages from each DEVICE (or each line of "
+            "stdin\n"
+            "                    if no DEVICE given) and output one line per "
+            "DEVICE\n"
             "    --enumerate|-e    enumerate known VPD pages names (ignore "
             "DEVICE),\n"
             "                      can be used with --page=num to search\n"
@@ -290,6 +309,9 @@ usage()
             "also\n"
             "                    given, FN is in binary (else FN is in "
             "hex)\n"
+            "    --threads=TN|-T TN    number of DEVICEs processed "
+            "concurrently with\n"
+            "                          --batch (def: %d)\n"
             "    --vendor=VP|-M VP    vendor/product abbreviation [or "
             "number]\n"
             "    --verbose|-v    increase verbosity\n"
@@ -297,7 +319,7 @@ usage()
             "Fetch Vital Product Data (VPD) page using SCSI INQUIRY or "
             "decodes VPD\npage response held in file FN. To list available "
             "pages use '-e'. Also\n'-p -1' or '-p sinq' yields the standard "
-            "INQUIRY response.\n");
+            "INQUIRY response.\n", DEF_BATCH_THREADS);
 }
 
 /* mxlen is command line --maxlen=LEN option (def: 0) or -1 for a VPD page
@@ -3561,11 +3583,512 @@ svpd_examine_all(int sg_fd, struct opts_t * op)
     return any_err;
 }
 
+/* For --batch: state shared by the worker threads. Each DEVICE's record is
+ * built into its own buffer so output is in DEVICE order, one line each. */
+struct svpd_batch_t {
+    int num_devs;
+    int next_dev;               /* next DEVICE to be claimed by a worker */
+    int num_pgs;
+    int maxlen;
+    int verbose;
+    bool all_pgs;               /* --all: every page in supported VPD list */
+    int pgs[MAX_BATCH_PAGES];
+    char ** dev_names;
+    char ** recs;               /* one output line per DEVICE */
+    int * rets;
+#ifdef SVPD_HAVE_PTHREAD
+    pthread_mutex_t mutex;
+#endif
+};
+
+/* Growable buffer for one --batch output record */
+struct svpd_rec_t {
+    char * b;
+    int len;
+    int alloc;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+static void rec_printf(struct svpd_rec_t * rp, const char * fmt, ...)
+        __attribute__ ((format (printf, 2, 3)));
+#else
+static void rec_printf(struct svpd_rec_t * rp, const char * fmt, ...);
+#endif
+
+static void
+rec_printf(struct svpd_rec_t * rp, const char * fmt, ...)
+{
+    int n;
+    char * cp;
+    va_list args;
+
+    if (rp->alloc < 0)
+        return;         /* earlier allocation failure */
+    while (true) {
+        va_start(args, fmt);
+        n = vsnprintf(rp->b ? (rp->b + rp->len) : NULL,
+                      rp->b ? (size_t)(rp->alloc - rp->len) : 0, fmt, args);
+        va_end(args);
+        if (n < 0)
+            return;
+        if (rp->b && (n < (rp->alloc - rp->len))) {
+            rp->len += n;
+            return;
+        }
+        cp = (char *)realloc(rp->b, rp->alloc + n + 512);
+        if (NULL == cp) {
+            rp->alloc = -1;
+            return;
+        }
+        rp->b = cp;
+        rp->alloc += n + 512;
+    }
+}
+
+/* Appends ' key=' then the ASCII field at 'up' (length 'len') with leading
+ * and trailing spaces trimmed. Internal whitespace becomes '_' and any
+ * other character that is unsafe in a shell or udev value is output as
+ * \xNN (as 'sg_inq --export' does). */
+static void
+rec_ascii(struct svpd_rec_t * rp, const char * key, const uint8_t * up,
+          int len)
+{
+    int k;
+
+    while ((len > 0) && ((' ' == up[len - 1]) || (0 == up[len - 1])))
+        --len;
+    while ((len > 0) && (' ' == *up)) {
+        ++up;
+        --len;
+    }
+    rec_printf(rp, " %s=", key);
+    for (k = 0; k < len; ++k) {
+        if (isalnum(up[k]) || (up[k] && strchr("#+-.:@_/", up[k])))
+            rec_printf(rp, "%c", up[k]);
+        else if (isspace(up[k]))
+            rec_printf(rp, "_");
+        else
+            rec_printf(rp, "\\x%02x", up[k]);
+    }
+}
+
+static void
+rec_hex(struct svpd_rec_t * rp, const char * key, const uint8_t * up, int len)
+{
+    int k;
+
+    rec_printf(rp, " %s=", key);
+    for (k = 0; k < len; ++k)
+        rec_printf(rp, "%02x", up[k]);
+}
+
+/* Compact decode of device identification VPD page designators: only
+ * those designator types that identify something are output. */
+static void
+rec_dev_ids(struct svpd_rec_t * rp, const uint8_t * bp, int len)
+{
+    int off, assoc, desig_type, c_set, i_len;
+    const uint8_t * ip;
+    const char * a_str;
+    static const char * assoc_arr[] = {"lu", "port", "tgt", "rsv"};
+    char key[32];
+
+    for (off = -1; 0 == sg_vpd_dev_id_iter(bp + 4, len - 4, &off, -1, -1,
+                                           -1); ) {
+        ip = bp + 4 + off;
+        i_len = ip[3];
+        if ((off + i_len + 4) > (len - 4))
+            break;
+        c_set = ip[0] & 0xf;
+        assoc = (ip[1] >> 4) & 0x3;
+        desig_type = ip[1] & 0xf;
+        a_str = assoc_arr[assoc];
+        switch (desig_type) {
+        case 1:         /* T10 vendor identification */
+            snprintf(key, sizeof(key), "di_%s_t10", a_str);
+            rec_ascii(rp, key, ip + 4, i_len);
+            break;
+        case 2:         /* EUI-64 based */
+            snprintf(key, sizeof(key), "di_%s_eui", a_str);
+            rec_hex(rp, key, ip + 4, i_len);
+            break;
+        case 3:         /* NAA */
+            snprintf(key, sizeof(key), "di_%s_naa", a_str);
+            rec_hex(rp, key, ip + 4, i_len);
+            break;
+        case 4:         /* Relative target port */
+            if (i_len >= 4)
+                rec_printf(rp, " di_%s_rtpi=%u", a_str,
+                           sg_get_unaligned_be16(ip + 6));
+            break;
+        case 5:         /* Target port group */
+            if (i_len >= 4)
+                rec_printf(rp, " di_%s_tpg=%u", a_str,
+                           sg_get_unaligned_be16(ip + 6));
+            break;
+        case 8:         /* SCSI name string */
+            snprintf(key, sizeof(key), "di_%s_name", a_str);
+            if ((3 == c_set) || (2 == c_set))
+                rec_ascii(rp, key, ip + 4, i_len);
+            else
+                rec_hex(rp, key, ip + 4, i_len);
+            break;
+        case 0xa:       /* UUID */
+            snprintf(key, sizeof(key), "di_%s_uuid", a_str);
+            if (i_len > 2)
+                rec_hex(rp, key, ip + 6, i_len - 2);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Appends the compact form of VPD page 'pn' (in 'bp' of length 'len') to
+ * record. Pages without a compact form are output in hex. */
+static void
+rec_vpd_page(struct svpd_rec_t * rp, int pn, const uint8_t * bp, int len,
+             int pdt)
+{
+    bool sbc = ((PDT_DISK == pdt) || (PDT_WO == pdt) ||
+                (PDT_OPTICAL == pdt) || (PDT_ZBC == pdt));
+    char key[16];
+
+    switch (pn) {
+    case VPD_UNIT_SERIAL_NUM:
+        rec_ascii(rp, "sn", bp + 4, len - 4);
+        return;
+    case VPD_DEVICE_ID:
+        rec_dev_ids(rp, bp, len);
+        return;
+    case VPD_BLOCK_LIMITS:
+        if ((! sbc) || (len < 16))
+            break;
+        rec_printf(rp, " bl_max_xfer=%u bl_opt_xfer=%u bl_opt_xfer_gran=%u",
+                   sg_get_unaligned_be32(bp + 8),
+                   sg_get_unaligned_be32(bp + 12),
+                   sg_get_unaligned_be16(bp + 6));
+        if (len > 27)
+            rec_printf(rp, " bl_max_unmap_lba=%u bl_max_unmap_desc=%u",
+                       sg_get_unaligned_be32(bp + 20),
+                       sg_get_unaligned_be32(bp + 24));
+        if (len > 35)
+            rec_printf(rp, " bl_opt_unmap_gran=%u",
+                       sg_get_unaligned_be32(bp + 28));
+        if (len > 43)
+            rec_printf(rp, " bl_max_ws_len=%" PRIu64 "",
+                       sg_get_unaligned_be64(bp + 36));
+        return;
+    case VPD_BLOCK_DEV_CHARS:
+        if ((! sbc) || (len < 9))
+            break;
+        rec_printf(rp, " bdc_rpm=%u bdc_form_factor=%u bdc_zoned=%u",
+                   sg_get_unaligned_be16(bp + 4), bp[7] & 0xf,
+                   (bp[8] >> 4) & 0x3);
+        return;
+    case VPD_LB_PROVISIONING:
+        if ((! sbc) || (len < 8))
+            break;
+        rec_printf(rp, " lbpv_lbpu=%d lbpv_lbpws=%d lbpv_lbpws10=%d "
+                   "lbpv_lbprz=%d lbpv_anc_sup=%d lbpv_prov_type=%d",
+                   !!(0x80 & bp[5]), !!(0x40 & bp[5]), !!(0x20 & bp[5]),
+                   0x7 & (bp[5] >> 2), !!(0x2 & bp[5]), bp[6] & 0x7);
+        return;
+    default:
+        break;
+    }
+    snprintf(key, sizeof(key), "vpd_0x%02x", pn);
+    rec_hex(rp, key, bp, len);
+}
+
+/* Fetches the standard INQUIRY response, the supported VPD pages page then
+ * each requested page that is supported, for one DEVICE. Builds its output
+ * record in bap->recs[k]. Returns 0 if ok, else error. */
+static int
+svpd_batch_one(struct svpd_batch_t * bap, int k, uint8_t * rp)
+{
+    bool want;
+    int j, m, res, rlen, n, pn, pdt, sg_fd, vb;
+    int ret = 0;
+    const char * dev_name = bap->dev_names[k];
+    uint8_t sup[256];
+    struct svpd_rec_t rec;
+    char b[80];
+
+    vb = bap->verbose;
+    memset(&rec, 0, sizeof(rec));
+    rec_printf(&rec, "%s", dev_name);
+    sg_fd = sg_cmds_open_device(dev_name, true /* ro */, vb);
+    if (sg_fd < 0) {
+        rec_printf(&rec, " error=open:%s",
+                   safe_strerror_r(-sg_fd, b, sizeof(b)));
+        ret = sg_convert_errno(-sg_fd);
+        goto fini;
+    }
+    memset(rp, 0, 36);
+    res = sg_ll_inquiry_v2(sg_fd, false, 0, rp, 36, DEF_PT_TIMEOUT, &n,
+                           vb > 0, vb);
+    if (res || ((36 - n) < 8)) {
+        rec_printf(&rec, " error=inquiry");
+        ret = res ? res : SG_LIB_CAT_MALFORMED;
+        goto fini;
+    }
+    pdt = rp[0] & 0x1f;
+    rec_printf(&rec, " pqual=%d pdt=%d", (rp[0] >> 5) & 0x7, pdt);
+    rec_ascii(&rec, "vendor", rp + 8, 8);
+    rec_ascii(&rec, "product", rp + 16, 16);
+    rec_ascii(&rec, "rev", rp + 32, 4);
+    /* fetch the Supported VPD pages page once, then only supported pages */
+    res = vpd_fetch_page(sg_fd, rp, VPD_SUPPORTED_VPDS, bap->maxlen,
+                         vb < 1, vb, &rlen);
+    if (res) {
+        sg_get_category_sense_str(res, sizeof(b), b, vb);
+        rec_printf(&rec, " error=vpd_0x00");
+        if (vb)
+            pr2serr("%s: fetching VPD page 0 failed: %s\n", dev_name, b);
+        ret = res;
+        goto fini;
+    }
+    n = sg_get_unaligned_be16(rp + 2);
+    if (n > (rlen - 4))
+        n = rlen - 4;
+    if (n > (int)sizeof(sup))
+        n = sizeof(sup);
+    memcpy(sup, rp + 4, n);
+    rec_printf(&rec, " sup=");
+    for (j = 0; j < n; ++j)
+        rec_printf(&rec, "%s%02x", (j ? "," : ""), sup[j]);
+    for (j = 0; j < n; ++j) {
+        pn = sup[j];
+        if (VPD_SUPPORTED_VPDS == pn)
+            continue;
+        want = bap->all_pgs;
+        for (m = 0; (! want) && (m < bap->num_pgs); ++m)
+            want = (pn == bap->pgs[m]);
+        if (! want)
+            continue;
+        res = vpd_fetch_page(sg_fd, rp, pn, bap->maxlen, vb < 1, vb, &rlen);
+        if (res) {
+            rec_printf(&rec, " error=vpd_0x%02x", pn);
+            ret = res;
+            continue;
+        }
+        rec_vpd_page(&rec, pn, rp, rlen, pdt);
+    }
+fini:
+    if (sg_fd >= 0)
+        sg_cmds_close_device(sg_fd);
+    if (rec.alloc < 0) {
+        free(rec.b);
+        rec.b = NULL;
+        ret = sg_convert_errno(ENOMEM);
+    }
+    bap->recs[k] = rec.b;
+    bap->rets[k] = ret;
+    return ret;
+}
+
+/* Worker: claims DEVICEs from the shared index until none are left. */
+static void *
+svpd_batch_worker(void * v_bap)
+{
+    int k;
+    uint8_t * rp;
+    uint8_t * free_rp;
+    struct svpd_batch_t * bap = (struct svpd_batch_t *)v_bap;
+
+    rp = sg_memalign(rsp_buff_sz, 0, &free_rp, false);
+    if (NULL == rp)
+        return NULL;
+    while (true) {
+#ifdef SVPD_HAVE_PTHREAD
+        pthread_mutex_lock(&bap->mutex);
+#endif
+        k = bap->next_dev++;
+#ifdef SVPD_HAVE_PTHREAD
+        pthread_mutex_unlock(&bap->mutex);
+#endif
+        if (k >= bap->num_devs)
+            break;
+        svpd_batch_one(bap, k, rp);
+    }
+    free(free_rp);
+    return NULL;
+}
+
+/* Reads DEVICE names from stdin, one per line, into *namesp. Returns number
+ * of names or -1 on allocation failure. */
+static int
+svpd_batch_read_names(char *** namesp)
+{
+    int n = 0;
+    int alloc = 0;
+    char ** arr = NULL;
+    char ** cpp;
+    char * cp;
+    char line[512];
+
+    while (fgets(line, sizeof(line), stdin)) {
+        cp = line + strspn(line, " \t");
+        cp[strcspn(cp, " \t\r\n")] = '\0';
+        if (('\0' == *cp) || ('#' == *cp))
+            continue;
+        if (n >= alloc) {
+            alloc = alloc ? (2 * alloc) : 256;
+            cpp = (char **)realloc(arr, alloc * sizeof(char *));
+            if (NULL == cpp)
+                goto nomem;
+            arr = cpp;
+        }
+        if (NULL == (arr[n] = strdup(cp)))
+            goto nomem;
+        ++n;
+    }
+    *namesp = arr;
+    return n;
+nomem:
+    while (--n >= 0)
+        free(arr[n]);
+    free(arr);
+    return -1;
+}
+
+/* Implements --batch. Pages are given by 'pg_list' (comma separated list of
+ * acronyms or numbers); NULL means DEF_BATCH_PAGES. Returns 0 if all
+ * DEVICEs ok, else the last error. */
+static int
+svpd_batch(char ** dev_names, int num_devs, const char * pg_list,
+           int num_threads, const struct opts_t * op)
+{
+    bool from_stdin = false;
+    int k, n, ret;
+    const char * cp;
+    const char * ncp;
+    const struct svpd_values_name_t * vnp;
+    struct svpd_batch_t * bap;
+    char b[32];
+#ifdef SVPD_HAVE_PTHREAD
+    pthread_t * tids;
+#endif
+
+    bap = (struct svpd_batch_t *)calloc(1, sizeof(*bap));
+    if (NULL == bap)
+        return sg_convert_errno(ENOMEM);
+    bap->maxlen = op->maxlen;
+    bap->verbose = op->verbose;
+    bap->all_pgs = op->do_all;
+    if (NULL == pg_list)
+        pg_list = DEF_BATCH_PAGES;
+    for (cp = pg_list; (! bap->all_pgs) && cp && *cp; cp = ncp) {
+        ncp = strchr(cp, ',');
+        n = ncp ? (int)(ncp - cp) : (int)strlen(cp);
+        if (ncp)
+            ++ncp;
+        if ((n < 1) || (n >= (int)sizeof(b))) {
+            pr2serr("--batch: bad --page= list element\n");
+            ret = SG_LIB_SYNTAX_ERROR;
+            goto fini;
+        }
+        memcpy(b, cp, n);
+        b[n] = '\0';
+        if (bap->num_pgs >= MAX_BATCH_PAGES) {
+            pr2serr("--batch: too many pages, max is %d\n", MAX_BATCH_PAGES);
+            ret = SG_LIB_SYNTAX_ERROR;
+            goto fini;
+        }
+        if (isalpha(b[0])) {
+            vnp = sdp_find_vpd_by_acron(b);
+            if ((NULL == vnp) || (vnp->value < 0)) {
+                pr2serr("--batch: abbreviation '%s' doesn't match a standard "
+                        "VPD page\n", b);
+                ret = SG_LIB_SYNTAX_ERROR;
+                goto fini;
+            }
+            bap->pgs[bap->num_pgs++] = vnp->value;
+        } else {
+            n = sg_get_num_nomult(b);
+            if ((n < 0) || (n > 255)) {
+                pr2serr("--batch: bad page number '%s'\n", b);
+                ret = SG_LIB_SYNTAX_ERROR;
+                goto fini;
+            }
+            bap->pgs[bap->num_pgs++] = n;
+        }
+    }
+    if (0 == num_devs) {
+        num_devs = svpd_batch_read_names(&dev_names);
+        if (num_devs < 0) {
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        from_stdin = true;
+    }
+    bap->num_devs = num_devs;
+    bap->dev_names = dev_names;
+    bap->recs = (char **)calloc(num_devs + 1, sizeof(char *));
+    bap->rets = (int *)calloc(num_devs + 1, sizeof(int));
+    if ((NULL == bap->recs) || (NULL == bap->rets)) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    if (num_threads > num_devs)
+        num_threads = num_devs;
+#ifdef SVPD_HAVE_PTHREAD
+    pthread_mutex_init(&bap->mutex, NULL);
+    tids = (pthread_t *)calloc(num_threads + 1, sizeof(pthread_t));
+    if (NULL == tids) {
+        ret = sg_convert_errno(ENOMEM);
+        goto fini;
+    }
+    for (k = 0; k < num_threads; ++k) {
+        if (pthread_create(tids + k, NULL, svpd_batch_worker, bap)) {
+            pr2serr("--batch: pthread_create failed, continue with %d "
+                    "threads\n", k);
+            break;
+        }
+    }
+    n = k;
+    if (0 == n)
+        svpd_batch_worker(bap);
+    for (k = 0; k < n; ++k)
+        pthread_join(tids[k], NULL);
+    free(tids);
+    pthread_mutex_destroy(&bap->mutex);
+#else
+    if (op->verbose && (num_threads > 1))
+        pr2serr("--batch: threads not available, one DEVICE at a time\n");
+    svpd_batch_worker(bap);
+#endif
+    ret = 0;
+    for (k = 0; k < num_devs; ++k) {
+        if (bap->recs[k]) {
+            printf("%s\n", bap->recs[k]);
+            free(bap->recs[k]);
+        } else
+            printf("%s error=nomem\n", dev_names[k]);
+        if (bap->rets[k])
+            ret = bap->rets[k];
+    }
+fini:
+    if (from_stdin) {
+        for (k = 0; k < num_devs; ++k)
+            free(dev_names[k]);
+        free(dev_names);
+    }
+    free(bap->recs);
+    free(bap->rets);
+    free(bap);
+    return ret;
+}
+
+
 
 int
 main(int argc, char * argv[])
 {
+    bool do_batch = false;
     int c, res, matches;
+    int num_threads = DEF_BATCH_THREADS;
     int sg_fd = -1;
     int inhex_len = 0;
     int ret = 0;
@@ -3582,7 +4105,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "aeEfhHiI:lm:M:p:qrvV", long_options,
+        c = getopt_long(argc, argv, "aBeEfhHiI:lm:M:p:qrT:vV", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -3591,6 +4114,9 @@ main(int argc, char * argv[])
         case 'a':
             op->do_all = true;
             break;
+        case 'B':
+            do_batch = true;
+            break;
         case 'e':
             op->do_enum = true;
             break;
@@ -3651,6 +4177,14 @@ main(int argc, char * argv[])
         case 'r':
             ++op->do_raw;
             break;
+        case 'T':
+            num_threads = sg_get_num(optarg);
+            if ((num_threads < 1) || (num_threads > MAX_BATCH_THREADS)) {
+                pr2serr("argument to '--threads' should be from 1 to %d\n",
+                        MAX_BATCH_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'v':
             op->verbose_given = true;
             ++op->verbose;
@@ -3664,6 +4198,21 @@ main(int argc, char * argv[])
             return SG_LIB_SYNTAX_ERROR;
         }
     }
+    if (do_batch) {
+        if (op->do_enum || op->examine || op->do_ident || op->do_hex ||
+            op->do_raw || op->inhex_fn || op->vend_prod) {
+            pr2serr("--batch cannot be used with --enumerate, --examine, "
+                    "--hex,\n--ident, --inhex, --raw or --vendor\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->version_given) {
+            pr2serr("version: %s\n", version_str);
+            return 0;
+        }
+        ret = svpd_batch(argv + optind, argc - optind, op->page_str,
+                         num_threads, op);
+        return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
+    }
     if (optind < argc) {
         if (NULL == op->device_name) {
             op->device_name = argv[optind];
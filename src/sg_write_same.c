@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2019 Douglas Gilbert.
+ * Copyright (c) 2009-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -19,6 +19,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <getopt.h>
+#include <time.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
@@ -26,6 +28,7 @@
 #include "config.h"
 #endif
 
+
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_cmds_basic.h"
@@ -33,7 +36,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.28 20190124";
+static const char * version_str = "1.29 20261018";
 
 
 #define ME "sg_write_same: "
@@ -48,12 +51,18 @@ static const char * version_str = "1.28 20190124";
 #define WRITE_SAME32_LEN 32
 #define RCAP10_RESP_LEN 8
 #define RCAP16_RESP_LEN 32
+#define VPD_BLOCK_LIMITS 0xb0
+#define VPD_BLOCK_LIMITS_LEN 64
 #define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
 #define DEF_TIMEOUT_SECS 60
 #define DEF_WS_CDB_SIZE WRITE_SAME10_LEN
 #define DEF_WS_NUMBLOCKS 1
 #define MAX_XFER_LEN (64 * 1024)
 #define EBUFF_SZ 512
+#define MAX_QD 64
+#define DEF_WS10_MAX_BLKS 0xffff
+#define DEF_WS16_MAX_BLKS 0x7fffff     /* when Block Limits VPD gives 0 */
+#define PROGRESS_SECS 5
 
 #ifndef UINT32_MAX
 #define UINT32_MAX ((uint32_t)-1)
@@ -63,7 +72,9 @@ static struct option long_options[] = {
     {"10", no_argument, 0, 'R'},
     {"16", no_argument, 0, 'S'},
     {"32", no_argument, 0, 'T'},
+    {"all", no_argument, 0, 'A'},
     {"anchor", no_argument, 0, 'a'},
+    {"chunk", required_argument, 0, 'c'},
     {"grpnum", required_argument, 0, 'g'},
     {"help", no_argument, 0, 'h'},
     {"in", required_argument, 0, 'i'},
@@ -72,6 +83,8 @@ static struct option long_options[] = {
     {"ndob", no_argument, 0, 'N'},
     {"num", required_argument, 0, 'n'},
     {"pbdata", no_argument, 0, 'P'},
+    {"progress", no_argument, 0, 'p'},
+    {"qd", required_argument, 0, 'q'},
     {"timeout", required_argument, 0, 't'},
     {"unmap", no_argument, 0, 'U'},
     {"verbose", no_argument, 0, 'v'},
@@ -82,10 +95,12 @@ static struct option long_options[] = {
 };
 
 struct opts_t {
+    bool all;
     bool anchor;
     bool ndob;
     bool lbdata;
     bool pbdata;
+    bool progress;
     bool unmap;
     bool verbose_given;
     bool version_given;
@@ -97,23 +112,49 @@ struct opts_t {
     int wrprotect;
     int xfer_len;
     int pref_cdb_size;
+    int qd;
+    uint32_t chunk;             /* 0 -> from Block Limits VPD page */
     uint64_t lba;
+    uint64_t num_all;           /* --num= with --all, 0 -> to end */
     char ifilename[256];
 };
 
+/* State shared by the threads of whole range (--all) mode */
+struct ws_range_t {
+    pthread_mutex_t mutex;
+    bool stop;
+    int ret;
+    uint32_t chunk;
+    uint32_t gran;
+    uint32_t align;
+    uint64_t next_lba;
+    uint64_t end_lba;           /* one past last block to write */
+    uint64_t done_blks;
+    uint64_t num_cmds;
+    uint64_t err_lba;
+    const struct opts_t * op;
+    const uint8_t * wBuff;
+};
+
+struct ws_thr_t {
+    pthread_t tid;
+    int sg_fd;
+    struct ws_range_t * rp;
+};
+
 
 static void
 usage()
 {
-    pr2serr("Usage: sg_write_same [--10] [--16] [--32] [--anchor] "
-            "[--grpnum=GN] [--help]\n"
-            "                     [--in=IF] [--lba=LBA] [--lbdata] "
-            "[--ndob] [--num=NUM]\n"
-            "                     [--pbdata] [--timeout=TO] [--unmap] "
-            "[--verbose]\n"
-            "                     [--version] [--wrprotect=WRP] "
-            "[xferlen=LEN]\n"
-            "                     DEVICE\n"
+    pr2serr("Usage: sg_write_same [--10] [--16] [--32] [--all] [--anchor] "
+            "[--chunk=CH]\n"
+            "                     [--grpnum=GN] [--help] [--in=IF] "
+            "[--lba=LBA] [--lbdata]\n"
+            "                     [--ndob] [--num=NUM] [--pbdata] "
+            "[--progress] [--qd=QD]\n"
+            "                     [--timeout=TO] [--unmap] [--verbose] "
+            "[--version]\n"
+            "                     [--wrprotect=WRP] [xferlen=LEN] DEVICE\n"
             "  where:\n"
             "    --10|-R              send WRITE SAME(10) (even if '--unmap' "
             "is given)\n"
@@ -122,7 +163,16 @@ usage()
             "                         LBA+NUM > 32 bits, or NUM > 65535; "
             "then def 16)\n"
             "    --32|-T              send WRITE SAME(32) (def: 10 or 16)\n"
+            "    --all|-A             write from LBA to end of DEVICE (or "
+            "NUM blocks) split\n"
+            "                         into as many commands as the Block "
+            "Limits VPD page\n"
+            "                         requires\n"
             "    --anchor|-a          set ANCHOR field in cdb\n"
+            "    --chunk=CH|-c CH     with --all: CH is maximum blocks per "
+            "command (def:\n"
+            "                         MAXIMUM WRITE SAME LENGTH from Block "
+            "Limits VPD)\n"
             "    --grpnum=GN|-g GN    GN is group number field (def: 0)\n"
             "    --help|-h            print out usage message\n"
             "    --in=IF|-i IF        IF is file to fetch one block of data "
@@ -139,6 +189,11 @@ usage()
             "                         [Beware NUM==0 may mean: 'rest of "
             "device']\n"
             "    --pbdata|-P          set PBDATA bit (obsolete)\n"
+            "    --progress|-p        with --all: report progress every %d "
+            "seconds\n"
+            "    --qd=QD|-q QD        with --all: QD commands outstanding, "
+            "one per thread\n"
+            "                         (def: 1, maximum: %d)\n"
             "    --timeout=TO|-t TO    command timeout (unit: seconds) (def: "
             "60)\n"
             "    --unmap|-U           set UNMAP bit\n"
@@ -153,15 +208,17 @@ usage()
             "only\nsupported by the 16 and 32 byte variants. When set the "
             "specified blocks\nwill be filled with zeros or the "
             "'provisioning initialization pattern'\nas indicated by the "
-            "LBPRZ field. As a precaution one of the '--in=',\n'--lba=' or "
-            "'--num=' options is required.\nAnother implementation of WRITE "
-            "SAME is found in the sg_write_x utility.\n"
-            );
+            "LBPRZ field. As a precaution one of the '--all', '--in=',\n"
+            "'--lba=' or '--num=' options is required.\nAnother "
+            "implementation of WRITE SAME is found in the sg_write_x "
+            "utility.\n",
+            PROGRESS_SECS, MAX_QD);
 }
 
+/* Sends one WRITE SAME command for 'num' blocks starting at 'lba' */
 static int
-do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
-              int * act_cdb_lenp)
+do_write_same(int sg_fd, const struct opts_t * op, uint64_t lba, uint32_t num,
+              const void * dataoutp, int * act_cdb_lenp)
 {
     int k, ret, res, sense_cat, cdb_len;
     uint64_t llba;
@@ -171,15 +228,15 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
 
     cdb_len = op->pref_cdb_size;
     if (WRITE_SAME10_LEN == cdb_len) {
-        llba = op->lba + op->numblocks;
-        if ((op->numblocks > 0xffff) || (llba > UINT32_MAX) ||
+        llba = lba + num;
+        if ((num > 0xffff) || (llba > UINT32_MAX) ||
             op->ndob || (op->unmap && (! op->want_ws10))) {
             cdb_len = WRITE_SAME16_LEN;
             if (op->verbose) {
                 const char * cp = "use WRITE SAME(16) instead of 10 byte "
                                   "cdb";
 
-                if (op->numblocks > 0xffff)
+                if (num > 0xffff)
                     pr2serr("%s since blocks exceed 65535\n", cp);
                 else if (llba > UINT32_MAX)
                     pr2serr("%s since LBA may exceed 32 bits\n", cp);
@@ -205,9 +262,9 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
             ws_cdb[1] |= 0x4;
         if (op->lbdata)
             ws_cdb[1] |= 0x2;
-        sg_put_unaligned_be32((uint32_t)op->lba, ws_cdb + 2);
+        sg_put_unaligned_be32((uint32_t)lba, ws_cdb + 2);
         ws_cdb[6] = (op->grpnum & 0x1f);
-        sg_put_unaligned_be16((uint16_t)op->numblocks, ws_cdb + 7);
+        sg_put_unaligned_be16((uint16_t)num, ws_cdb + 7);
         break;
     case WRITE_SAME16_LEN:
         ws_cdb[0] = WRITE_SAME16_OP;
@@ -222,8 +279,8 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
             ws_cdb[1] |= 0x2;
         if (op->ndob)
             ws_cdb[1] |= 0x1;
-        sg_put_unaligned_be64(op->lba, ws_cdb + 2);
-        sg_put_unaligned_be32((uint32_t)op->numblocks, ws_cdb + 10);
+        sg_put_unaligned_be64(lba, ws_cdb + 2);
+        sg_put_unaligned_be32(num, ws_cdb + 10);
         ws_cdb[14] = (op->grpnum & 0x1f);
         break;
     case WRITE_SAME32_LEN:
@@ -242,8 +299,8 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
             ws_cdb[10] |= 0x2;
         if (op->ndob)
             ws_cdb[10] |= 0x1;
-        sg_put_unaligned_be64(op->lba, ws_cdb + 12);
-        sg_put_unaligned_be32((uint32_t)op->numblocks, ws_cdb + 28);
+        sg_put_unaligned_be64(lba, ws_cdb + 12);
+        sg_put_unaligned_be32(num, ws_cdb + 28);
         break;
     default:
         pr2serr("do_write_same: bad cdb length %d\n", cdb_len);
@@ -306,6 +363,316 @@ do_write_same(int sg_fd, const struct opts_t * op, const void * dataoutp,
 }
 
 
+/* Fetches the number of logical blocks and their size. Tries READ
+ * CAPACITY(16) first. Returns 0 or an SG_LIB_CAT_* value. */
+static int
+ws_get_capacity(int sg_fd, uint64_t * num_lbsp, uint32_t * lb_szp, int vb)
+{
+    int res;
+    int vb2 = vb ? (vb - 1) : 0;
+    uint8_t resp_buff[RCAP16_RESP_LEN];
+
+    res = sg_ll_readcap_16(sg_fd, false, 0, resp_buff, RCAP16_RESP_LEN,
+                           true, vb2);
+    if (SG_LIB_CAT_UNIT_ATTENTION == res) {
+        pr2serr("Read capacity(16) unit attention, try again\n");
+        res = sg_ll_readcap_16(sg_fd, false, 0, resp_buff, RCAP16_RESP_LEN,
+                               true, vb2);
+    }
+    if (0 == res) {
+        *num_lbsp = sg_get_unaligned_be64(resp_buff + 0) + 1;
+        *lb_szp = sg_get_unaligned_be32(resp_buff + 8);
+        return 0;
+    }
+    if ((SG_LIB_CAT_INVALID_OP != res) && (SG_LIB_CAT_ILLEGAL_REQ != res))
+        return res;
+    if (vb)
+        pr2serr("Read capacity(16) not supported, try Read capacity(10)\n");
+    res = sg_ll_readcap_10(sg_fd, false, 0, resp_buff, RCAP10_RESP_LEN, true,
+                           vb2);
+    if (0 == res) {
+        *num_lbsp = (uint64_t)sg_get_unaligned_be32(resp_buff + 0) + 1;
+        *lb_szp = sg_get_unaligned_be32(resp_buff + 4);
+    }
+    return res;
+}
+
+/* Decodes the MAXIMUM WRITE SAME LENGTH field of the Block Limits VPD page
+ * plus the granularity (and alignment) that chunks should respect. With
+ * --unmap that is the optimal unmap granularity, otherwise the optimal
+ * transfer length granularity. Outputs are left alone if the page is not
+ * available, in which case a SG_LIB_CAT_* value is returned. */
+static int
+ws_block_limits(int sg_fd, const struct opts_t * op, uint64_t * max_wsp,
+                uint32_t * granp, uint32_t * alignp)
+{
+    int res, len;
+    int vb = op->verbose;
+    uint8_t resp[VPD_BLOCK_LIMITS_LEN];
+
+    memset(resp, 0, sizeof(resp));
+    res = sg_ll_inquiry(sg_fd, false, true, VPD_BLOCK_LIMITS, resp,
+                        sizeof(resp), false, (vb ? (vb - 1) : 0));
+    if (res)
+        return res;
+    if (VPD_BLOCK_LIMITS != resp[1])
+        return SG_LIB_CAT_MALFORMED;
+    if (vb > 3)
+        hex2stderr(resp, sizeof(resp), 1);
+    len = sg_get_unaligned_be16(resp + 2) + 4;
+    if (len >= 44)
+        *max_wsp = sg_get_unaligned_be64(resp + 36);
+    if (op->unmap) {
+        if (len >= 36) {
+            *granp = sg_get_unaligned_be32(resp + 28);
+            if (0x80 & resp[32])        /* UGAVALID */
+                *alignp = sg_get_unaligned_be32(resp + 32) & 0x7fffffff;
+        }
+    } else if (len >= 8)
+        *granp = sg_get_unaligned_be16(resp + 6);
+    return 0;
+}
+
+/* Hands out the next chunk of the range. The first chunk is shortened,
+ * if need be, so that those that follow start on a granularity boundary.
+ * Returns false when there is nothing more to do. */
+static bool
+ws_claim(struct ws_range_t * rp, uint64_t * lbap, uint32_t * nump)
+{
+    bool ok = false;
+    uint32_t num;
+    uint64_t rem;
+
+    pthread_mutex_lock(&rp->mutex);
+    if ((! rp->stop) && (rp->next_lba < rp->end_lba)) {
+        num = rp->chunk;
+        if (rp->gran > 1)
+            num -= (rp->next_lba + rp->gran - rp->align) % rp->gran;
+        rem = rp->end_lba - rp->next_lba;
+        if (num > rem)
+            num = (uint32_t)rem;
+        *lbap = rp->next_lba;
+        *nump = num;
+        rp->next_lba += num;
+        ok = true;
+    }
+    pthread_mutex_unlock(&rp->mutex);
+    return ok;
+}
+
+static void *
+ws_worker(void * v_tp)
+{
+    int res;
+    uint32_t num;
+    uint64_t lba;
+    struct ws_thr_t * tp = (struct ws_thr_t *)v_tp;
+    struct ws_range_t * rp = tp->rp;
+
+    while (ws_claim(rp, &lba, &num)) {
+        res = do_write_same(tp->sg_fd, rp->op, lba, num, rp->wBuff, NULL);
+        pthread_mutex_lock(&rp->mutex);
+        ++rp->num_cmds;
+        if (res) {
+            /* chunks are claimed in ascending order so all blocks below
+             * the lowest failing chunk have been written */
+            if ((0 == rp->ret) || (lba < rp->err_lba)) {
+                rp->ret = res;
+                rp->err_lba = lba;
+            }
+            rp->stop = true;
+        } else
+            rp->done_blks += num;
+        pthread_mutex_unlock(&rp->mutex);
+        if (res)
+            break;
+    }
+    return NULL;
+}
+
+static void
+ws_progress(const struct ws_range_t * rp, uint64_t blks, uint32_t lb_sz,
+            double secs, bool final)
+{
+    uint64_t tot = rp->end_lba - rp->op->lba;
+    double rate = (secs > 0.0) ? (blks / secs) : 0.0;
+
+    if (final)
+        pr2serr("Wrote %" PRIu64 " blocks with %" PRIu64 " WRITE SAME(%d) "
+                "commands in %.2f seconds", blks, rp->num_cmds,
+                rp->op->pref_cdb_size, secs);
+    else
+        pr2serr("  %5.1f%% done, %" PRIu64 " of %" PRIu64 " blocks", 100.0 *
+                blks / tot, blks, tot);
+    if (rate > 0.0) {
+        pr2serr(", %.1f MB/s", (rate * lb_sz) / 1000000.0);
+        if (! final)
+            pr2serr(", %.0f seconds remaining", (tot - blks) / rate);
+    }
+    pr2serr("\n");
+}
+
+/* Writes the blocks from op->lba to op->lba+op->num_all (or to the end of
+ * the device) using as many WRITE SAME commands as the device's Block
+ * Limits allow, op->qd of them at a time. Each thread gets its own file
+ * descriptor, the first uses 'sg_fd'. */
+static int
+do_ws_range(const char * device_name, int sg_fd, struct opts_t * op,
+            const uint8_t * wBuff)
+{
+    bool mutex_ok = false;
+    int k, res, started, running;
+    int ret = 0;
+    int vb = op->verbose;
+    uint32_t lb_sz = 0;
+    uint32_t limit;
+    uint32_t gran = 0;
+    uint32_t align = 0;
+    uint64_t num_lbs = 0;
+    uint64_t max_ws = 0;
+    uint64_t blks, t_start, t_last, now;
+    struct ws_thr_t * thr_arr = NULL;
+    struct ws_thr_t * tp;
+    struct ws_range_t range;
+    struct ws_range_t * rp = &range;
+    struct timespec ts;
+    char b[80];
+
+    res = ws_get_capacity(sg_fd, &num_lbs, &lb_sz, vb);
+    if (res) {
+        sg_get_category_sense_str(res, sizeof(b), b, vb);
+        pr2serr("Read capacity: %s\n", b);
+        return res;
+    }
+    memset(rp, 0, sizeof(*rp));
+    rp->op = op;
+    rp->wBuff = wBuff;
+    rp->next_lba = op->lba;
+    rp->end_lba = op->num_all ? (op->lba + op->num_all) : num_lbs;
+    if ((op->lba >= num_lbs) || (rp->end_lba > num_lbs) ||
+        (rp->end_lba < op->lba)) {
+        pr2serr("range exceeds the %" PRIu64 " blocks of %s\n", num_lbs,
+                device_name);
+        return SG_LIB_LBA_OUT_OF_RANGE;
+    }
+    res = ws_block_limits(sg_fd, op, &max_ws, &gran, &align);
+    if (res && vb)
+        pr2serr("Block Limits VPD page not available, use defaults\n");
+
+    /* settle on one cdb size so do_write_same() never has to switch */
+    if (WRITE_SAME10_LEN == op->pref_cdb_size) {
+        if ((! op->want_ws10) || op->ndob ||
+            (rp->end_lba > ((uint64_t)UINT32_MAX + 1))) {
+            if (op->want_ws10)
+                pr2serr("use WRITE SAME(16) instead of 10 byte cdb since "
+                        "range needs it\n");
+            op->pref_cdb_size = WRITE_SAME16_LEN;
+        }
+    }
+    limit = (WRITE_SAME10_LEN == op->pref_cdb_size) ? 0xffff : UINT32_MAX;
+    if (op->chunk) {
+        rp->chunk = op->chunk;
+        if (max_ws && (op->chunk > max_ws))
+            pr2serr("Warning: --chunk=%u exceeds MAXIMUM WRITE SAME LENGTH "
+                    "(%" PRIu64 ")\n", op->chunk, max_ws);
+    } else if (max_ws)
+        rp->chunk = (max_ws > limit) ? limit : (uint32_t)max_ws;
+    else
+        rp->chunk = (WRITE_SAME10_LEN == op->pref_cdb_size) ?
+                    DEF_WS10_MAX_BLKS : DEF_WS16_MAX_BLKS;
+    if (rp->chunk > limit)
+        rp->chunk = limit;
+    if ((gran > 1) && (rp->chunk >= gran)) {
+        rp->chunk -= rp->chunk % gran;
+        rp->gran = gran;
+        rp->align = align % gran;
+    }
+    if (vb)
+        pr2serr("WRITE SAME(%d) LBA 0x%" PRIx64 " to 0x%" PRIx64 ": chunks "
+                "of %u blocks, granularity=%u, alignment=%u, qd=%d\n",
+                op->pref_cdb_size, op->lba, rp->end_lba - 1, rp->chunk,
+                rp->gran, rp->align, op->qd);
+
+    thr_arr = (struct ws_thr_t *)calloc(op->qd, sizeof(struct ws_thr_t));
+    if (NULL == thr_arr) {
+        pr2serr("unable to allocate thread array\n");
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0, tp = thr_arr; k < op->qd; ++k, ++tp) {
+        tp->rp = rp;
+        tp->sg_fd = -1;
+    }
+    thr_arr->sg_fd = sg_fd;
+    for (k = 1, tp = thr_arr + 1; k < op->qd; ++k, ++tp) {
+        tp->sg_fd = sg_cmds_open_device(device_name, false /* rw */, vb);
+        if (tp->sg_fd < 0) {
+            pr2serr(ME "open error: %s: %s\n", device_name,
+                    safe_strerror(-tp->sg_fd));
+            ret = sg_convert_errno(-tp->sg_fd);
+            goto fini;
+        }
+    }
+    if (pthread_mutex_init(&rp->mutex, NULL)) {
+        ret = sg_convert_errno(EINVAL);
+        goto fini;
+    }
+    mutex_ok = true;
+    t_start = sg_get_monotonic_ns();
+    t_last = t_start;
+    for (started = 0, tp = thr_arr; started < op->qd; ++started, ++tp) {
+        res = pthread_create(&tp->tid, NULL, ws_worker, tp);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            pthread_mutex_lock(&rp->mutex);
+            rp->stop = true;
+            pthread_mutex_unlock(&rp->mutex);
+            ret = sg_convert_errno(res);
+            break;
+        }
+    }
+    if (op->progress) {
+        ts.tv_sec = 0;
+        ts.tv_nsec = 100 * 1000 * 1000;
+        while (1) {
+            pthread_mutex_lock(&rp->mutex);
+            running = (! rp->stop) && (rp->next_lba < rp->end_lba);
+            blks = rp->done_blks;
+            pthread_mutex_unlock(&rp->mutex);
+            if (! running)
+                break;
+            now = sg_get_monotonic_ns();
+            if ((now - t_last) >= ((uint64_t)PROGRESS_SECS * 1000000000)) {
+                ws_progress(rp, blks, lb_sz, (now - t_start) / 1000000000.0,
+                            false);
+                t_last = now;
+            }
+            nanosleep(&ts, NULL);
+        }
+    }
+    for (k = 0, tp = thr_arr; k < started; ++k, ++tp)
+        pthread_join(tp->tid, NULL);
+    if (op->progress || vb)
+        ws_progress(rp, rp->done_blks, lb_sz,
+                    (sg_get_monotonic_ns() - t_start) / 1000000000.0, true);
+    if (rp->ret) {
+        ret = rp->ret;
+        sg_get_category_sense_str(ret, sizeof(b), b, vb);
+        pr2serr("Write same(%d): %s\n", op->pref_cdb_size, b);
+        pr2serr("Failed in chunk starting at LBA 0x%" PRIx64 ", blocks "
+                "before it were written\n", rp->err_lba);
+    }
+fini:
+    if (mutex_ok)
+        pthread_mutex_destroy(&rp->mutex);
+    for (k = 1, tp = thr_arr + 1; k < op->qd; ++k, ++tp) {
+        if (tp->sg_fd >= 0)
+            sg_cmds_close_device(tp->sg_fd);
+    }
+    free(thr_arr);
+    return ret;
+}
+
+
 int
 main(int argc, char * argv[])
 {
@@ -337,7 +704,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "ag:hi:l:Ln:NPRSt:TUvVw:x:",
+        c = getopt_long(argc, argv, "aAc:g:hi:l:Ln:NpPq:RSt:TUvVw:x:",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -346,6 +713,17 @@ main(int argc, char * argv[])
         case 'a':
             op->anchor = true;
             break;
+        case 'A':
+            op->all = true;
+            break;
+        case 'c':
+            ll = sg_get_llnum(optarg);
+            if ((ll < 1) || (ll > UINT32_MAX)) {
+                pr2serr("bad argument to '--chunk'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->chunk = (uint32_t)ll;
+            break;
         case 'g':
             op->grpnum = sg_get_num(optarg);
             if ((op->grpnum < 0) || (op->grpnum > 63))  {
@@ -375,19 +753,32 @@ main(int argc, char * argv[])
             op->lbdata = true;
             break;
         case 'n':
-            op->numblocks = sg_get_num(optarg);
-            if (op->numblocks < 0)  {
+            ll = sg_get_llnum(optarg);
+            if (ll < 0)  {
                 pr2serr("bad argument to '--num'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+            /* only --all accepts more than INT_MAX, checked below */
+            op->numblocks = (ll > INT_MAX) ? -1 : (int)ll;
+            op->num_all = (uint64_t)ll;
             num_given = true;
             break;
         case 'N':
             op->ndob = true;
             break;
+        case 'p':
+            op->progress = true;
+            break;
         case 'P':
             op->pbdata = true;
             break;
+        case 'q':
+            op->qd = sg_get_num(optarg);
+            if ((op->qd < 1) || (op->qd > MAX_QD))  {
+                pr2serr("bad argument to '--qd', expect 1 to %d\n", MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'R':
             op->want_ws10 = true;
             break;
@@ -487,11 +878,25 @@ main(int argc, char * argv[])
     }
     vb = op->verbose;
 
-    if ((! if_given) && (! lba_given) && (! num_given)) {
-        pr2serr("As a precaution, one of '--in=', '--lba=' or '--num=' is "
-                "required\n");
+    if ((! if_given) && (! lba_given) && (! num_given) && (! op->all)) {
+        pr2serr("As a precaution, one of '--all', '--in=', '--lba=' or "
+                "'--num=' is required\n");
         return SG_LIB_CONTRADICT;
     }
+    if (op->all) {
+        if (0 == op->qd)
+            op->qd = 1;
+    } else {
+        if (op->chunk || op->progress || op->qd) {
+            pr2serr("'--chunk=', '--progress' and '--qd=' need '--all'\n");
+            return SG_LIB_CONTRADICT;
+        }
+        if (op->numblocks < 0) {
+            pr2serr("bad argument to '--num', more than %d blocks needs "
+                    "'--all'\n", INT_MAX);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
 
     if (op->ndob) {
         if (if_given) {
@@ -637,8 +1042,11 @@ main(int argc, char * argv[])
         }
     }
 
-    ret = do_write_same(sg_fd, op, wBuff, &act_cdb_len);
-    if (ret) {
+    if (op->all)
+        ret = do_ws_range(device_name, sg_fd, op, wBuff);
+    else if ((ret = do_write_same(sg_fd, op, op->lba,
+                                  (uint32_t)op->numblocks, wBuff,
+                                  &act_cdb_len))) {
         sg_get_category_sense_str(ret, sizeof(b), b, vb);
         pr2serr("Write same(%d): %s\n", act_cdb_len, b);
     }
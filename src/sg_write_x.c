@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2019 Douglas Gilbert.
+ * Copyright (c) 2017-2026 Douglas Gilbert.
  * All rights reserved.
  * Use of this source code is governed by a BSD-style
  * license that can be found in the BSD_LICENSE file.
@@ -9,7 +9,9 @@
  * The utility can send six variants of the SCSI WRITE command: (normal)
  * WRITE(16 or 32), WRITE ATOMIC(16 or 32), ORWRITE(16 or 32),
  * WRITE SAME(16 or 32), WRITE SCATTERED (16 or 32) or WRITE
- * STREAM(16 or 32).
+ * STREAM(16 or 32). With --extents a stream of LBA range descriptors,
+ * each followed by its data, is packed into as few WRITE SCATTERED
+ * commands as the device's limits allow.
  */
 
 #include <unistd.h>
@@ -25,12 +27,14 @@
 #include <sys/types.h>  /* needed for lseek() */
 #include <sys/stat.h>
 #include <getopt.h>
+#include <pthread.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+
 #include "sg_lib.h"
 #include "sg_pt.h"
 #include "sg_cmds_basic.h"
@@ -38,7 +42,7 @@
 #include "sg_unaligned.h"
 #include "sg_pr2serr.h"
 
-static const char * version_str = "1.20 20190113";
+static const char * version_str = "1.21 20261018";
 
 /* Protection Information refers to 8 bytes of extra information usually
  * associated with each logical block and is often abbreviated to PI while
@@ -76,6 +80,13 @@ static const char * version_str = "1.20 20190113";
 #define DEF_AT 0xffff
 #define DEF_TM 0xffff
 #define EBUFF_SZ 256
+#define VPD_BLOCK_LIMITS 0xb0
+#define VPD_BLOCK_LIMITS_EXT 0xb7
+#define DEF_QD 1
+#define MAX_QD 64
+#define DEF_SCAT_MAX_RDS 128    /* when the device doesn't report limits */
+#define DEF_SCAT_MAX_BLKS 2048
+#define MAX_SCAT_BUFF (32 * 1024 * 1024)    /* per command, --extents */
 
 #define MAX_NUM_ADDR 128
 
@@ -99,6 +110,7 @@ static struct option long_options[] = {
     {"dpo", no_argument, 0, 'd'},
     {"dry-run", no_argument, 0, 'x'},
     {"dry_run", no_argument, 0, 'x'},
+    {"extents", no_argument, 0, 'e'},
     {"fua", no_argument, 0, 'f'},
     {"grpnum", required_argument, 0, 'g'},
     {"generation", required_argument, 0, 'G'},
@@ -109,6 +121,7 @@ static struct option long_options[] = {
     {"num", required_argument, 0, 'n'},
     {"offset", required_argument, 0, 'o'},
     {"or", no_argument, 0, 'O'},
+    {"qd", required_argument, 0, 'C'},
     {"quiet", no_argument, 0, 'Q'},
     {"ref-tag", required_argument, 0, 'r'},
     {"ref_tag", required_argument, 0, 'r'},
@@ -137,6 +150,7 @@ struct opts_t {
     bool do_atomic;             /* selects  WRITE ATOMIC(16 or 32) */
                                 /*  --atomic=AB  AB --> .atomic_boundary */
     bool do_combined;           /* -c DOF --> .scat_lbdof */
+    bool do_extents;            /* -e  IF is extent stream, implies -S */
     bool do_or;                 /* -O  ORWRITE(16 or 32) */
     bool do_quiet;              /* -Q  suppress some messages */
     bool do_scat_raw;
@@ -163,6 +177,7 @@ struct opts_t {
     int grpnum;         /* "Group Number", 0 to 0x3f */
     int help;
     int pi_type;        /* -1: unknown: 0: type 0 (none): 1: type 1 */
+    int qd;             /* WRITE SCATTERED commands in flight (--extents) */
     int strict;         /* > 0, report then exit on questionable meta data */
     int timeout;        /* timeout (in seconds) to abort SCSI commands */
     int verbose;        /* incremented for each -v */
@@ -213,10 +228,11 @@ usage(int do_help)
             "[--bmop=OP,PGP]\n"
             "           [--bs=BS] [--combined=DOF] [--dld=DLD] [--dpo] "
             "[--dry-run]\n"
-            "           [--fua] [--generation=EOG,NOG] [--grpnum=GN] "
-            "[--help] --in=IF\n"
-            "           [--lba=LBA,LBA...] [--normal] [--num=NUM,NUM...]\n"
-            "           [--offset=OFF[,DLEN]] [--or] [--quiet] "
+            "           [--extents] [--fua] [--generation=EOG,NOG] "
+            "[--grpnum=GN]\n"
+            "           [--help] --in=IF [--lba=LBA,LBA...] [--normal] "
+            "[--num=NUM,NUM...]\n"
+            "           [--offset=OFF[,DLEN]] [--or] [--qd=QD] [--quiet] "
             "[--ref-tag=RT]\n"
             "           [--same=NDOB] [--scat-file=SF] [--scat-raw] "
             "[--scattered=RD]\n"
@@ -229,10 +245,12 @@ usage(int do_help)
             pr2serr("\nOr the corresponding short option usage:\n"
                 "sg_write_x [-6] [-3] [-a AT] [-A AB] [-B OP,PGP] [-b BS] "
                 "[-c DOF] [-D DLD]\n"
-                "           [-d] [-x] [-f] [-G EOG,NOG] [-g GN] [-h] -i IF "
-                "[-l LBA,LBA...]\n"
-                "           [-N] [-n NUM,NUM...] [-o OFF[,DLEN]] [-O] [-Q] "
-                "[-r RT] [-M NDOB]\n"
+                "           [-d] [-x] [-e] [-f] [-G EOG,NOG] [-g GN] [-h] "
+                "-i IF\n"
+                "           [-l LBA,LBA...]\n"
+                "           [-N] [-n NUM,NUM...] [-o OFF[,DLEN]] [-O] [-C QD] "
+                "[-Q] [-r RT]\n"
+                "           [-M NDOB]\n"
                 "           [-q SF] [-R] [-S RD] [-T ID] [-s] [-t TM] [-I TO] "
                 "[-u U_A] [-v]\n"
                 "           [-V] [-w WPR] DEVICE\n"
@@ -270,6 +288,11 @@ usage(int do_help)
             "(def: clear)\n"
             "    --dry-run|-x       exit just before sending SCSI write "
             "command\n"
+            "    --extents|-e       IF is a stream of LBA range "
+            "descriptors, each\n"
+            "                       followed by its data; packed into "
+            "WRITE SCATTERED\n"
+            "                       commands\n"
             "    --fua|-f           set FUA (force unit access) field "
             "(def: clear)\n"
             "    --generation=EOG,NOG    set Expected ORWgeneration field "
@@ -303,6 +326,9 @@ usage(int do_help)
             "        |-o OFF[,DLEN]     (def: 0), then read DLEN bytes(def: "
             "rest of IF)\n"
             "    --or|-O            send ORWRITE command\n"
+            "    --qd=QD|-C QD      with --extents keep up to QD commands "
+            "in flight\n"
+            "                       (def: 1)\n"
             "    --quiet|-Q         suppress some informational messages\n"
             "    --ref-tag=RT|-r RT     expected reference tag field (def: "
             "0xffffffff)\n"
@@ -411,6 +437,13 @@ usage(int do_help)
             "             [--tag-mask=TM] [--timeout=TO] [--wrprotect=WRP] "
             "DEVICE\n"
             "\n"
+            "WRITE SCATTERED (16 or 32) from an extent stream:\n"
+            "  sg_write_x --extents --in=IF [--16] [--32] [--bs=BS] "
+            "[--dpo] [--fua]\n"
+            "             [--grpnum=GN] [--offset=OFF] [--qd=QD] "
+            "[--scattered=RD]\n"
+            "             [--timeout=TO] [--wrprotect=WRP] DEVICE\n"
+            "\n"
             "WRITE SCATTERED (16) applicable options:\n"
             "  sg_write_x --scattered --in=IF [--bs=BS] [--combined=DOF] "
             "[--dld=DLD]\n"
@@ -1494,7 +1527,7 @@ do_read_capacity(int sg_fd, struct opts_t *op)
 
 #define WANT_ZERO_EXIT 9999
 static const char * const opt_long_ctl_str =
-    "36a:A:b:B:c:dD:Efg:G:hi:I:l:M:n:No:Oq:Qr:RsS:t:T:u:vVw:x";
+    "36a:A:b:B:c:C:dD:eEfg:G:hi:I:l:M:n:No:Oq:Qr:RsS:t:T:u:vVw:x";
 
 /* command line processing, options and arguments. Returns 0 if ok,
  * returns WANT_ZERO_EXIT so upper level yields an exist status of zero.
@@ -1607,6 +1640,14 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[],
             op->scat_lbdof = (uint16_t)j;
             op->do_combined = true;
             break;
+        case 'C':
+            op->qd = sg_get_num(optarg);
+            if ((op->qd < 1) || (op->qd > MAX_QD)) {
+                pr2serr("bad argument to '--qd=', expect 1 to %d\n",
+                        MAX_QD);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
         case 'd':
             op->dpo = true;
             break;
@@ -1618,6 +1659,9 @@ parse_cmd_line(struct opts_t *op, int argc, char *argv[],
                 return SG_LIB_SYNTAX_ERROR;
             }
             break;
+        case 'e':
+            op->do_extents = true;
+            break;
         case 'f':
             op->fua = true;
             break;
@@ -2154,6 +2198,401 @@ finii:
 }
 
 
+/* State shared between the reader (main thread) and the WRITE SCATTERED
+ * workers with --extents. Each worker owns one slot: a file descriptor
+ * and a data-out buffer. The reader packs extents into any free slot then
+ * marks it ready for that slot's worker. */
+struct xs_batch_t {
+    bool stop;                  /* input exhausted or a command failed */
+    int ret;                    /* status of first failed command */
+    uint16_t lbdof;             /* LB data offset, same for all commands */
+    uint16_t max_rds;           /* LBA range descriptors per command */
+    uint32_t max_blks;          /* blocks per command */
+    uint32_t max_rd_blks;       /* blocks per LBA range descriptor */
+    uint64_t err_lba;           /* first LBA of failed command */
+    uint64_t num_cmds;
+    uint64_t num_rds;
+    uint64_t done_blks;
+    const struct opts_t * op;
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;          /* a slot became ready or free, or stop */
+};
+
+struct xs_slot_t {
+    bool ready;                 /* owned by worker while true */
+    int sg_fd;
+    uint16_t num_rd;
+    uint32_t blks;
+    uint8_t * up;               /* parameter list header, RDs then data */
+    uint8_t * free_up;
+    pthread_t tid;
+    struct xs_batch_t * bp;
+};
+
+/* Sets the WRITE SCATTERED limits from the Block limits extension VPD page.
+ * For those not reported the MAXIMUM TRANSFER LENGTH from the Block limits
+ * VPD page, then defaults, are used. RD (from --scattered=RD), when given,
+ * lowers the number of LBA range descriptors per command. */
+static void
+xs_limits(int sg_fd, const struct opts_t * op, struct xs_batch_t * bp)
+{
+    int vb = op->verbose;
+    uint32_t u;
+    uint8_t resp[64];
+
+    bp->max_rds = DEF_SCAT_MAX_RDS;
+    memset(resp, 0, sizeof(resp));
+    if ((0 == sg_ll_inquiry(sg_fd, false, true, VPD_BLOCK_LIMITS_EXT, resp,
+                            sizeof(resp), false, (vb ? (vb - 1) : 0))) &&
+        (VPD_BLOCK_LIMITS_EXT == resp[1]) &&
+        ((sg_get_unaligned_be16(resp + 2) + 4) >= 28)) {
+        bp->max_rd_blks = sg_get_unaligned_be32(resp + 16);
+        u = sg_get_unaligned_be16(resp + 22);
+        if (u > 0)
+            bp->max_rds = (uint16_t)u;
+        bp->max_blks = sg_get_unaligned_be32(resp + 24);
+    } else if (vb)
+        pr2serr("Block limits extension VPD page not available\n");
+    if (0 == bp->max_blks) {
+        memset(resp, 0, sizeof(resp));
+        if ((0 == sg_ll_inquiry(sg_fd, false, true, VPD_BLOCK_LIMITS, resp,
+                                sizeof(resp), false, (vb ? (vb - 1) : 0))) &&
+            (VPD_BLOCK_LIMITS == resp[1]))
+            bp->max_blks = sg_get_unaligned_be32(resp + 8);
+        if (0 == bp->max_blks)
+            bp->max_blks = DEF_SCAT_MAX_BLKS;
+    }
+    if ((op->scat_num_lbard > 0) && (op->scat_num_lbard < bp->max_rds))
+        bp->max_rds = op->scat_num_lbard;
+    bp->lbdof = (uint16_t)(((lbard_sz * (1 + bp->max_rds)) + op->bs_pi_do -
+                            1) / op->bs_pi_do);
+    u = (MAX_SCAT_BUFF / op->bs_pi_do) - bp->lbdof;
+    if (bp->max_blks > u)
+        bp->max_blks = u;
+    if ((0 == bp->max_rd_blks) || (bp->max_rd_blks > bp->max_blks))
+        bp->max_rd_blks = bp->max_blks;
+    if (vb)
+        pr2serr("Per WRITE SCATTERED: up to %u %ss, %u blocks (%u per "
+                "descriptor), LB data offset: %u\n", bp->max_rds, lbard_str,
+                bp->max_blks, bp->max_rd_blks, bp->lbdof);
+}
+
+static void *
+xs_worker(void * v_sp)
+{
+    int res;
+    struct xs_slot_t * sp = (struct xs_slot_t *)v_sp;
+    struct xs_batch_t * bp = sp->bp;
+    struct opts_t o = *bp->op;
+
+    o.scat_lbdof = bp->lbdof;
+    while (true) {
+        pthread_mutex_lock(&bp->mutex);
+        while ((! sp->ready) && (! bp->stop))
+            pthread_cond_wait(&bp->cv, &bp->mutex);
+        if ((! sp->ready) || bp->ret) {     /* done, or drop after error */
+            sp->ready = false;
+            pthread_mutex_unlock(&bp->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&bp->mutex);
+        o.scat_num_lbard = sp->num_rd;
+        o.numblocks = sp->blks;
+        res = do_write_x(sp->sg_fd, sp->up,
+                         (bp->lbdof + sp->blks) * o.bs_pi_do, &o);
+        pthread_mutex_lock(&bp->mutex);
+        ++bp->num_cmds;
+        if (res) {
+            if (0 == bp->ret) {
+                bp->ret = res;
+                bp->err_lba = sg_get_unaligned_be64(sp->up + lbard_sz);
+            }
+            bp->stop = true;
+        } else {
+            bp->num_rds += sp->num_rd;
+            bp->done_blks += sp->blks;
+        }
+        sp->ready = false;
+        pthread_cond_broadcast(&bp->cv);
+        pthread_mutex_unlock(&bp->mutex);
+    }
+    return NULL;
+}
+
+/* Waits for a slot that is not ready (i.e. its worker is idle) and
+ * returns it emptied, or returns NULL if a command has failed */
+static struct xs_slot_t *
+xs_get_slot(struct xs_batch_t * bp, struct xs_slot_t * slot_arr, int qd)
+{
+    int k;
+    struct xs_slot_t * sp = NULL;
+
+    pthread_mutex_lock(&bp->mutex);
+    while (0 == bp->ret) {
+        for (k = 0; k < qd; ++k) {
+            if (! slot_arr[k].ready) {
+                sp = slot_arr + k;
+                break;
+            }
+        }
+        if (sp)
+            break;
+        pthread_cond_wait(&bp->cv, &bp->mutex);
+    }
+    pthread_mutex_unlock(&bp->mutex);
+    if (sp) {
+        memset(sp->up, 0, bp->lbdof * bp->op->bs_pi_do);
+        sp->num_rd = 0;
+        sp->blks = 0;
+    }
+    return sp;
+}
+
+/* Returns true if the range of 'num' blocks at 'lba' overlaps any LBA
+ * range descriptor in slot 'sp' */
+static bool
+xs_overlap(const struct xs_slot_t * sp, uint64_t lba, uint32_t num)
+{
+    int k;
+    uint64_t rd_lba;
+    const uint8_t * rdp;
+
+    for (k = 0, rdp = sp->up + lbard_sz; k < sp->num_rd;
+         ++k, rdp += lbard_sz) {
+        rd_lba = sg_get_unaligned_be64(rdp + 0);
+        if ((lba < (rd_lba + sg_get_unaligned_be32(rdp + 8))) &&
+            (rd_lba < (lba + num)))
+            return true;
+    }
+    return false;
+}
+
+/* Hands slot 'sp' to its worker. So that later extents overwrite earlier
+ * ones, first waits for any command in flight that overlaps it. Slots in
+ * flight only change by becoming free so the checks are done unlocked. */
+static void
+xs_submit(struct xs_batch_t * bp, struct xs_slot_t * sp,
+          struct xs_slot_t * slot_arr, int qd)
+{
+    bool clash[MAX_QD];
+    int k, j;
+    const uint8_t * rdp;
+
+    pthread_mutex_lock(&bp->mutex);
+    for (k = 0; k < qd; ++k)
+        clash[k] = slot_arr[k].ready;
+    pthread_mutex_unlock(&bp->mutex);
+    for (k = 0; k < qd; ++k) {
+        if (! clash[k])
+            continue;
+        clash[k] = false;
+        for (j = 0, rdp = sp->up + lbard_sz; j < sp->num_rd;
+             ++j, rdp += lbard_sz) {
+            if (xs_overlap(slot_arr + k, sg_get_unaligned_be64(rdp + 0),
+                           sg_get_unaligned_be32(rdp + 8))) {
+                clash[k] = true;
+                break;
+            }
+        }
+    }
+    pthread_mutex_lock(&bp->mutex);
+    for (k = 0; k < qd; ++k) {
+        while (clash[k] && slot_arr[k].ready && (0 == bp->ret))
+            pthread_cond_wait(&bp->cv, &bp->mutex);
+    }
+    sp->ready = true;
+    pthread_cond_broadcast(&bp->cv);
+    pthread_mutex_unlock(&bp->mutex);
+}
+
+/* Reads extents from 'infd' until end of file. Each extent is an LBA range
+ * descriptor (32 bytes, as in the WRITE SCATTERED parameter list) followed
+ * by its data (NUM blocks). Extents are packed into WRITE SCATTERED
+ * commands up to the device's limits, merging those that are adjacent
+ * (16 byte cdbs only) and splitting those that are too large. A command
+ * is ended early if the next extent overlaps one already in it. Up to
+ * op->qd commands are in flight, each on its own file descriptor (the
+ * first uses 'sg_fd'). Returns 0 if successful, else sg3_utils error
+ * code. */
+static int
+do_extents(int sg_fd, int infd, struct opts_t * op)
+{
+    bool merge;
+    int k, res, started;
+    int ret = 0;
+    int vb = op->verbose;
+    uint32_t num, take, lim, prev_num, bs;
+    uint64_t lba, t_start;
+    uint64_t num_exts = 0;
+    double secs;
+    struct xs_slot_t * sp = NULL;
+    struct xs_slot_t * slot_arr;
+    struct xs_batch_t batch;
+    struct xs_batch_t * bp = &batch;
+    uint8_t * prev;
+    uint8_t * rdp;
+    uint8_t hdr[32];
+    char b[80];
+
+    bs = op->bs_pi_do;
+    memset(bp, 0, sizeof(*bp));
+    bp->op = op;
+    xs_limits(sg_fd, op, bp);
+    slot_arr = (struct xs_slot_t *)calloc(op->qd, sizeof(struct xs_slot_t));
+    if (NULL == slot_arr)
+        return sg_convert_errno(ENOMEM);
+    for (k = 0; k < op->qd; ++k)
+        slot_arr[k].sg_fd = -1;         /* so cleanup skips unopened slots */
+    pthread_mutex_init(&bp->mutex, NULL);
+    pthread_cond_init(&bp->cv, NULL);
+    for (k = 0; k < op->qd; ++k) {
+        sp = slot_arr + k;
+        sp->bp = bp;
+        sp->sg_fd = (0 == k) ? sg_fd :
+                    sg_cmds_open_device(op->device_name, false, vb);
+        if (sp->sg_fd < 0) {
+            pr2serr("open error: %s: %s\n", op->device_name,
+                    safe_strerror(-sp->sg_fd));
+            ret = sg_convert_errno(-sp->sg_fd);
+            break;
+        }
+        sp->up = sg_memalign((bp->lbdof + bp->max_blks) * bs, 0,
+                             &sp->free_up, false);
+        if (NULL == sp->up) {
+            pr2serr("unable to allocate %u bytes of memory\n",
+                    (bp->lbdof + bp->max_blks) * bs);
+            ret = sg_convert_errno(ENOMEM);
+            break;
+        }
+    }
+    started = 0;
+    for (k = 0; (0 == ret) && (k < op->qd); ++k, ++started) {
+        res = pthread_create(&slot_arr[k].tid, NULL, xs_worker,
+                             slot_arr + k);
+        if (res) {
+            pr2serr("pthread_create: %s\n", safe_strerror(res));
+            ret = sg_convert_errno(res);
+        }
+    }
+    sp = NULL;
+    t_start = sg_get_monotonic_ns();
+    while (0 == ret) {
+        res = sg_full_read(infd, hdr, lbard_sz);
+        if (res < 0) {
+            pr2serr("Error reading %s: %s\n", op->if_name,
+                    safe_strerror(-res));
+            ret = sg_convert_errno(-res);
+            break;
+        } else if (0 == res)
+            break;              /* end of extent stream */
+        else if (res < (int)lbard_sz) {
+            pr2serr("Short (%d byte) %s at end of %s\n", res, lbard_str,
+                    op->if_name);
+            ret = SG_LIB_FILE_ERROR;
+            break;
+        }
+        lba = sg_get_unaligned_be64(hdr + 0);
+        num = sg_get_unaligned_be32(hdr + 8);
+        ++num_exts;
+        while (num > 0) {
+            if (sp && (sp->blks >= bp->max_blks)) {
+                xs_submit(bp, sp, slot_arr, op->qd);
+                sp = NULL;
+            }
+            if (NULL == sp) {
+                sp = xs_get_slot(bp, slot_arr, op->qd);
+                if (NULL == sp)
+                    goto stop;      /* a command failed */
+            }
+            prev = sp->num_rd ? (sp->up + (lbard_sz * sp->num_rd)) : NULL;
+            prev_num = prev ? sg_get_unaligned_be32(prev + 8) : 0;
+            merge = prev && op->do_16 && (prev_num < bp->max_rd_blks) &&
+                    (lba == (sg_get_unaligned_be64(prev) + prev_num));
+            lim = bp->max_rd_blks - (merge ? prev_num : 0);
+            take = bp->max_blks - sp->blks;
+            if (take > lim)
+                take = lim;
+            if (take > num)
+                take = num;
+            if (((! merge) && (sp->num_rd >= bp->max_rds)) ||
+                xs_overlap(sp, lba, take)) {
+                xs_submit(bp, sp, slot_arr, op->qd);
+                sp = NULL;
+                continue;
+            }
+            res = sg_full_read(infd,
+                               sp->up + ((bp->lbdof + sp->blks) * bs),
+                               take * bs);
+            if (res < (int)(take * bs)) {
+                if (res < 0)
+                    pr2serr("Error reading %s: %s\n", op->if_name,
+                            safe_strerror(-res));
+                else
+                    pr2serr("Data for extent at LBA 0x%" PRIx64 " cut "
+                            "short in %s\n", lba, op->if_name);
+                ret = (res < 0) ? sg_convert_errno(-res) : SG_LIB_FILE_ERROR;
+                break;
+            }
+            if (merge)
+                sg_put_unaligned_be32(prev_num + take, prev + 8);
+            else {
+                rdp = sp->up + (lbard_sz * ++sp->num_rd);
+                memcpy(rdp, hdr, lbard_sz);
+                sg_put_unaligned_be32(take, rdp + 8);
+            }
+            sp->blks += take;
+            lba += take;
+            num -= take;
+            if (num > 0) {      /* rest of extent in another descriptor */
+                sg_put_unaligned_be64(lba, hdr + 0);
+                if (op->do_32 && (DEF_RT != sg_get_unaligned_be32(hdr + 12)))
+                    sg_put_unaligned_be32(sg_get_unaligned_be32(hdr + 12) +
+                                          take, hdr + 12);
+            }
+        }
+    }
+    if (sp && (sp->num_rd > 0))     /* write what was complete */
+        xs_submit(bp, sp, slot_arr, op->qd);
+stop:
+    pthread_mutex_lock(&bp->mutex);
+    bp->stop = true;
+    pthread_cond_broadcast(&bp->cv);
+    pthread_mutex_unlock(&bp->mutex);
+    for (k = 0; k < started; ++k)
+        pthread_join(slot_arr[k].tid, NULL);
+    secs = (sg_get_monotonic_ns() - t_start) / 1000000000.0;
+    if (vb || bp->ret || ret) {
+        pr2serr("Wrote %" PRIu64 " blocks from %" PRIu64 " extents with %"
+                PRIu64 " %s commands (%" PRIu64 " %ss) in %.2f seconds",
+                bp->done_blks, num_exts, bp->num_cmds, op->cdb_name,
+                bp->num_rds, lbard_str, secs);
+        if (secs > 0.0)
+            pr2serr(", %.1f MB/s", (bp->done_blks * (double)bs) /
+                                   (secs * 1000000.0));
+        pr2serr("\n");
+    }
+    if (bp->ret) {
+        if (0 == ret)
+            ret = bp->ret;
+        sg_get_category_sense_str(bp->ret, sizeof(b), b, vb);
+        pr2serr("%s: %s\n", op->cdb_name, b);
+        pr2serr("Failed in command whose first %s starts at LBA 0x%"
+                PRIx64 "\n", lbard_str, bp->err_lba);
+    }
+    pthread_cond_destroy(&bp->cv);
+    pthread_mutex_destroy(&bp->mutex);
+    for (k = 0; k < op->qd; ++k) {
+        sp = slot_arr + k;
+        if ((k > 0) && (sp->sg_fd >= 0))
+            sg_cmds_close_device(sp->sg_fd);
+        if (sp->free_up)
+            free(sp->free_up);
+    }
+    free(slot_arr);
+    return ret;
+}
+
+
 int
 main(int argc, char * argv[])
 {
@@ -2197,6 +2636,7 @@ main(int argc, char * argv[])
     op->app_tag = DEF_AT;       /* 2 bytes of protection information */
     op->tag_mask = DEF_TM;      /* final 2 bytes of protection information */
     op->timeout = DEF_TIMEOUT_SECS;
+    op->qd = DEF_QD;
 
     /* Process command line */
     ret = parse_cmd_line(op, argc, argv, &lba_op, &num_op);
@@ -2242,6 +2682,10 @@ main(int argc, char * argv[])
         if (vb > 1)
             pr2serr("Since both --16 and --32 given, choose --32\n");
     }
+    if (op->do_extents && (! op->do_scattered)) {
+        op->do_scattered = true;
+        op->cmd_name = "Write scattered";
+    }
     n = (int)op->do_atomic + (int)op->do_write_normal + (int)op->do_or +
         (int)op->do_same + (int)op->do_scattered + (int)op->do_stream;
     if (n > 1) {
@@ -2284,6 +2728,17 @@ main(int argc, char * argv[])
             return SG_LIB_CONTRADICT;
         }
     }
+    if (op->do_extents && (op->do_combined || op->scat_filename || lba_op ||
+                           num_op)) {
+        pr2serr("--extents takes LBA range descriptors from IF so "
+                "--combined=, --lba=,\n--num= and --scat-file= are not "
+                "allowed\n");
+        return SG_LIB_CONTRADICT;
+    }
+    if ((op->qd > 1) && (! op->do_extents)) {
+        pr2serr("--qd=QD only applies to --extents\n");
+        return SG_LIB_CONTRADICT;
+    }
     if ((NULL == op->scat_filename) && op->do_scat_raw) {
         pr2serr("--scat-raw only applies to the --scat-file=SF option\n"
                 "--scat-raw without the --scat-file=SF option is an "
@@ -2423,6 +2878,10 @@ main(int argc, char * argv[])
         pr2serr("Logic error, need block size by now\n");
         goto syntax_err_out;
     }
+    if (op->do_extents) {
+        ret = do_extents(sg_fd, infd, op);
+        goto fini;
+    }
     if (! op->ndob) {
         if (0 != (if_len % op->bs_pi_do)) {
             if (op->strict > 1) {
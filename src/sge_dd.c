@@ -0,0 +1,1612 @@
+/* A utility program for copying files. Specialised for "files" that
+ * represent devices that understand the SCSI command set.
+ *
+ * Copyright (C) 1999 - 2019 D. Gilbert and P. Allworth
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is a specialisation of the Unix "dd" command in which
+ * one or both of the given files is a scsi generic device. A logical block
+ * size ('bs') is assumed to be 512 if not given. This program complains if
+ * 'ibs' or 'obs' are given with some other value than 'bs'. If 'if' is not
+ * given or 'if=-' then stdin is assumed. If 'of' is not given or 'of=-'
+ * then stdout assumed.
+ *
+ * A non-standard argument "bpt" (blocks per transfer) is added to control
+ * the maximum number of blocks in each transfer. The default value is 128.
+ * For example if "bs=512" and "bpt=32" then a maximum of 32 blocks (16 KiB
+ * in this case) are transferred to or from the sg device in a single SCSI
+ * command.
+ *
+ * sge_dd is an event driven specialization of the sg_dd utility. Where
+ * sgp_dd uses a POSIX thread per outstanding request, sge_dd uses a single
+ * thread that queues up to 'rqd' READs and 'wqd' WRITEs on the sg devices
+ * via the sg driver's asynchronous (write()/read()) interface and waits
+ * for their completions with epoll(7). Completed READs are held in a
+ * reorder window so that WRITEs are issued in ascending block order. This
+ * utility is based on the ideas in testing/sgs_dd.c .
+ */
+
+#define _XOPEN_SOURCE 600
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#ifndef major
+#include <sys/types.h>
+#endif
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <linux/major.h>        /* for MEM_MAJOR, SCSI_GENERIC_MAJOR, etc */
+#include <linux/fs.h>           /* for BLKSSZGET and friends */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "sg_lib.h"
+#include "sg_cmds_basic.h"
+#include "sg_io_linux.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+
+static const char * version_str = "1.00 20261018";
+
+#define DEF_BLOCK_SIZE 512
+#define DEF_BLOCKS_PER_TRANSFER 128
+#define DEF_BLOCKS_PER_2048TRANSFER 32
+#define DEF_SCSI_CDBSZ 10
+#define MAX_SCSI_CDBSZ 16
+
+
+#define SENSE_BUFF_LEN 64       /* Arbitrary, could be larger */
+#define READ_CAP_REPLY_LEN 8
+#define RCAP16_REPLY_LEN 32
+
+#define DEF_TIMEOUT 60000       /* 60,000 millisecs == 60 seconds */
+
+#define DEF_QUEUE_DEPTH 8       /* default for both 'rqd' and 'wqd' */
+#define MAX_QUEUE_DEPTH 1024
+
+#ifndef RAW_MAJOR
+#define RAW_MAJOR 255   /*unlikely value */
+#endif
+
+#define FT_OTHER 1              /* filetype other than one of the following */
+#define FT_SG 2                 /* filetype is sg char device */
+#define FT_RAW 4                /* filetype is raw char device */
+#define FT_DEV_NULL 8           /* either "/dev/null" or "." as filename */
+#define FT_ST 16                /* filetype is st char device (tape) */
+#define FT_BLOCK 32             /* filetype is a block device */
+#define FT_ERROR 64             /* couldn't "stat" file */
+
+#define DEV_NULL_MINOR_NUM 3
+
+#define EBUFF_SZ 768
+
+/* Rq_elem::state values. A request element cycles through these in order */
+#define SGE_ST_FREE 0
+#define SGE_ST_RD_ISSUED 1      /* READ queued on IFILE's sg device */
+#define SGE_ST_RD_DONE 2        /* data in buffer, waiting in reorder window */
+#define SGE_ST_WR_ISSUED 3      /* WRITE queued on OFILE's sg device */
+
+#define SGE_EP_IN 1             /* epoll_event.data.u32 for IFILE */
+#define SGE_EP_OUT 2            /* epoll_event.data.u32 for OFILE */
+
+struct flags_t {
+    bool append;
+    bool coe;
+    bool dio;
+    bool direct;
+    bool dpo;
+    bool dsync;
+    bool excl;
+    bool fua;
+};
+
+typedef struct request_element
+{       /* one instance per queue slot */
+    int state;
+    bool wr;
+    int64_t blk;                /* relative to start of copy (skip or seek) */
+    int num_blks;
+    uint8_t * buffp;
+    uint8_t * alloc_bp;
+    struct sg_io_hdr io_hdr;
+    uint8_t cmd[MAX_SCSI_CDBSZ];
+    uint8_t sb[SENSE_BUFF_LEN];
+} Rq_elem;
+
+typedef struct request_collection
+{       /* one instance, only touched by the main thread */
+    int infd;
+    int64_t skip;
+    int in_type;
+    int cdbsz_in;
+    struct flags_t in_flags;
+    int64_t in_blk;             /* next relative block to read */
+    int64_t in_count;           /* blocks remaining for next read */
+    int64_t in_rem_count;       /* count of remaining in blocks */
+    int in_partial;
+    bool in_stop;
+    int outfd;
+    int64_t seek;
+    int out_type;
+    int cdbsz_out;
+    struct flags_t out_flags;
+    int64_t out_blk;            /* next relative block to write (in order) */
+    int64_t out_rem_count;      /* count of remaining out blocks */
+    int out_partial;
+    bool out_stop;
+    int bs;
+    int bpt;
+    int rqd;                    /* maximum number of queued READs */
+    int wqd;                    /* maximum number of queued WRITEs */
+    int rd_inflight;
+    int wr_inflight;
+    bool rd_q_full;             /* sg driver refused the last READ */
+    bool wr_q_full;             /* sg driver refused the last WRITE */
+    int num_elems;
+    Rq_elem * elems;
+    int epfd;
+    uint32_t next_pack_id;
+    int dio_incomplete_count;
+    int sum_of_resids;
+    int retries;                /* UNIT ATTENTIONs + ABORTED COMMANDs */
+    int q_full_count;
+    int max_rd_inflight;
+    int max_wr_inflight;
+    int debug;
+    int dry_run;
+} Rq_coll;
+
+static bool do_sync = false;
+static bool do_time = false;
+static Rq_coll rcoll;
+static struct timeval start_tm;
+static int64_t dd_count = -1;
+static int exit_status = 0;
+
+static const char * proc_allow_dio = "/proc/scsi/sg/allow_dio";
+
+static const char * my_name = "sge_dd: ";
+
+
+static void
+calc_duration_throughput(int contin)
+{
+    struct timeval end_tm, res_tm;
+    double a, b;
+
+    gettimeofday(&end_tm, NULL);
+    res_tm.tv_sec = end_tm.tv_sec - start_tm.tv_sec;
+    res_tm.tv_usec = end_tm.tv_usec - start_tm.tv_usec;
+    if (res_tm.tv_usec < 0) {
+        --res_tm.tv_sec;
+        res_tm.tv_usec += 1000000;
+    }
+    a = res_tm.tv_sec;
+    a += (0.000001 * res_tm.tv_usec);
+    b = (double)rcoll.bs * (dd_count - rcoll.out_rem_count);
+    pr2serr("time to transfer data %s %d.%06d secs",
+            (contin ? "so far" : "was"), (int)res_tm.tv_sec,
+            (int)res_tm.tv_usec);
+    if ((a > 0.00001) && (b > 511))
+        pr2serr(", %.2f MB/sec\n", b / (a * 1000000.0));
+    else
+        pr2serr("\n");
+}
+
+static void
+print_stats(const char * str)
+{
+    int64_t infull, outfull;
+
+    if (0 != rcoll.out_rem_count)
+        pr2serr("  remaining block count=%" PRId64 "\n",
+                rcoll.out_rem_count);
+    infull = dd_count - rcoll.in_rem_count;
+    pr2serr("%s%" PRId64 "+%d records in\n", str,
+            infull - rcoll.in_partial, rcoll.in_partial);
+
+    outfull = dd_count - rcoll.out_rem_count;
+    pr2serr("%s%" PRId64 "+%d records out\n", str,
+            outfull - rcoll.out_partial, rcoll.out_partial);
+}
+
+static void
+interrupt_handler(int sig)
+{
+    struct sigaction sigact;
+
+    sigact.sa_handler = SIG_DFL;
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_flags = 0;
+    sigaction(sig, &sigact, NULL);
+    pr2serr("Interrupted by signal,");
+    if (do_time)
+        calc_duration_throughput(0);
+    print_stats("");
+    kill(getpid (), sig);
+}
+
+static void
+siginfo_handler(int sig)
+{
+    if (sig) { ; }      /* unused, dummy to suppress warning */
+    pr2serr("Progress report, continuing ...\n");
+    if (do_time)
+        calc_duration_throughput(1);
+    print_stats("  ");
+}
+
+static void
+install_handler(int sig_num, void (*sig_handler) (int sig))
+{
+    struct sigaction sigact;
+    sigaction (sig_num, NULL, &sigact);
+    if (sigact.sa_handler != SIG_IGN)
+    {
+        sigact.sa_handler = sig_handler;
+        sigemptyset (&sigact.sa_mask);
+        sigact.sa_flags = 0;
+        sigaction (sig_num, &sigact, NULL);
+    }
+}
+
+static int
+dd_filetype(const char * filename)
+{
+    struct stat st;
+    size_t len = strlen(filename);
+
+    if ((1 == len) && ('.' == filename[0]))
+        return FT_DEV_NULL;
+    if (stat(filename, &st) < 0)
+        return FT_ERROR;
+    if (S_ISCHR(st.st_mode)) {
+        if ((MEM_MAJOR == major(st.st_rdev)) &&
+            (DEV_NULL_MINOR_NUM == minor(st.st_rdev)))
+            return FT_DEV_NULL;
+        if (RAW_MAJOR == major(st.st_rdev))
+            return FT_RAW;
+        if (SCSI_GENERIC_MAJOR == major(st.st_rdev))
+            return FT_SG;
+        if (SCSI_TAPE_MAJOR == major(st.st_rdev))
+            return FT_ST;
+    } else if (S_ISBLK(st.st_mode))
+        return FT_BLOCK;
+    return FT_OTHER;
+}
+
+static void
+usage()
+{
+    pr2serr("Usage: sge_dd  [bs=BS] [count=COUNT] [ibs=BS] [if=IFILE]"
+            " [iflag=FLAGS]\n"
+            "               [obs=BS] [of=OFILE] [oflag=FLAGS] "
+            "[seek=SEEK] [skip=SKIP]\n"
+            "               [--help] [--version]\n\n");
+    pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [coe=0|1] "
+            "[deb=VERB] [dio=0|1]\n"
+            "               [fua=0|1|2|3] [rqd=RQD] [sync=0|1] [time=0|1] "
+            "[verbose=VERB]\n"
+            "               [wqd=WQD] [--dry-run] [--verbose]\n"
+            "  where:\n"
+            "    bpt         is blocks_per_transfer (default is 128)\n"
+            "    bs          must be device logical block size (default "
+            "512)\n"
+            "    cdbsz       size of SCSI READ or WRITE cdb (default is 10)\n"
+            "    coe         continue on error, 0->exit (def), "
+            "1->zero + continue\n"
+            "    count       number of blocks to copy (def: device size)\n"
+            "    deb         for debug, 0->none (def), > 0->varying degrees "
+            "of debug\n");
+    pr2serr("    dio         is direct IO, 1->attempt, 0->indirect IO (def)\n"
+            "    fua         force unit access: 0->don't(def), 1->OFILE, "
+            "2->IFILE,\n"
+            "                3->OFILE+IFILE\n"
+            "    if          file or device to read from (def: stdin)\n"
+            "    iflag       comma separated list from: [coe,dio,direct,dpo,"
+            "dsync,excl,\n"
+            "                fua, null]\n"
+            "    of          file or device to write to (def: stdout), "
+            "OFILE of '.'\n"
+            "                treated as /dev/null\n"
+            "    oflag       comma separated list from: [append,coe,dio,"
+            "direct,dpo,dsync,\n"
+            "                excl,fua,null]\n"
+            "    rqd         maximum number of queued READs on IFILE (def: "
+            "8, max 1024)\n"
+            "    seek        block position to start writing to OFILE\n"
+            "    skip        block position to start reading from IFILE\n"
+            "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
+            "after copy\n"
+            "    time        0->no timing(def), 1->time plus calculate "
+            "throughput\n"
+            "    verbose     same as 'deb=VERB': increase verbosity\n"
+            "    wqd         maximum number of queued WRITEs on OFILE (def: "
+            "8, max 1024)\n"
+            "    --dry-run|-d    prepare but bypass copy/read\n"
+            "    --help|-h      output this usage message then exit\n"
+            "    --verbose|-v   increase verbosity of utility\n"
+            "    --version|-V   output version string then exit\n"
+            "Copy from IFILE to OFILE, similar to dd command\n"
+            "specialized for SCSI devices, uses a single thread with many "
+            "commands queued\n");
+}
+
+/* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
+static int
+scsi_read_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+{
+    int res;
+    uint8_t rcBuff[RCAP16_REPLY_LEN];
+
+    res = sg_ll_readcap_10(sg_fd, 0, 0, rcBuff, READ_CAP_REPLY_LEN, false, 0);
+    if (0 != res)
+        return res;
+
+    if ((0xff == rcBuff[0]) && (0xff == rcBuff[1]) && (0xff == rcBuff[2]) &&
+        (0xff == rcBuff[3])) {
+
+        res = sg_ll_readcap_16(sg_fd, 0, 0, rcBuff, RCAP16_REPLY_LEN, false,
+                               0);
+        if (0 != res)
+            return res;
+        *num_sect = sg_get_unaligned_be64(rcBuff + 0) + 1;
+        *sect_sz = sg_get_unaligned_be32(rcBuff + 8);
+    } else {
+        /* take care not to sign extend values > 0x7fffffff */
+        *num_sect = (int64_t)sg_get_unaligned_be32(rcBuff + 0) + 1;
+        *sect_sz = sg_get_unaligned_be32(rcBuff + 4);
+    }
+    return 0;
+}
+
+/* Return of 0 -> success, -1 -> failure. BLKGETSIZE64, BLKGETSIZE and */
+/* BLKSSZGET macros problematic (from <linux/fs.h> or <sys/mount.h>). */
+static int
+read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
+{
+#ifdef BLKSSZGET
+    if ((ioctl(sg_fd, BLKSSZGET, sect_sz) < 0) && (*sect_sz > 0)) {
+        perror("BLKSSZGET ioctl error");
+        return -1;
+    } else {
+ #ifdef BLKGETSIZE64
+        uint64_t ull;
+
+        if (ioctl(sg_fd, BLKGETSIZE64, &ull) < 0) {
+
+            perror("BLKGETSIZE64 ioctl error");
+            return -1;
+        }
+        *num_sect = ((int64_t)ull / (int64_t)*sect_sz);
+ #else
+        unsigned long ul;
+
+        if (ioctl(sg_fd, BLKGETSIZE, &ul) < 0) {
+            perror("BLKGETSIZE ioctl error");
+            return -1;
+        }
+        *num_sect = (int64_t)ul;
+ #endif
+    }
+    return 0;
+#else
+    *num_sect = 0;
+    *sect_sz = 0;
+    return -1;
+#endif
+}
+
+static int
+sg_build_scsi_cdb(uint8_t * cdbp, int cdb_sz, unsigned int blocks,
+                  int64_t start_block, bool write_true, bool fua, bool dpo)
+{
+    int rd_opcode[] = {0x8, 0x28, 0xa8, 0x88};
+    int wr_opcode[] = {0xa, 0x2a, 0xaa, 0x8a};
+    int sz_ind;
+
+    memset(cdbp, 0, cdb_sz);
+    if (dpo)
+        cdbp[1] |= 0x10;
+    if (fua)
+        cdbp[1] |= 0x8;
+    switch (cdb_sz) {
+    case 6:
+        sz_ind = 0;
+        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
+                                               rd_opcode[sz_ind]);
+        sg_put_unaligned_be24(0x1fffff & start_block, cdbp + 1);
+        cdbp[4] = (256 == blocks) ? 0 : (uint8_t)blocks;
+        if (blocks > 256) {
+            pr2serr("%sfor 6 byte commands, maximum number of blocks is "
+                    "256\n", my_name);
+            return 1;
+        }
+        if ((start_block + blocks - 1) & (~0x1fffff)) {
+            pr2serr("%sfor 6 byte commands, can't address blocks beyond "
+                    "%d\n", my_name, 0x1fffff);
+            return 1;
+        }
+        if (dpo || fua) {
+            pr2serr("%sfor 6 byte commands, neither dpo nor fua bits "
+                    "supported\n", my_name);
+            return 1;
+        }
+        break;
+    case 10:
+        sz_ind = 1;
+        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
+                                               rd_opcode[sz_ind]);
+        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
+        sg_put_unaligned_be16((uint16_t)blocks, cdbp + 7);
+        if (blocks & (~0xffff)) {
+            pr2serr("%sfor 10 byte commands, maximum number of blocks is "
+                    "%d\n", my_name, 0xffff);
+            return 1;
+        }
+        break;
+    case 12:
+        sz_ind = 2;
+        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
+                                               rd_opcode[sz_ind]);
+        sg_put_unaligned_be32((uint32_t)start_block, cdbp + 2);
+        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 6);
+        break;
+    case 16:
+        sz_ind = 3;
+        cdbp[0] = (uint8_t)(write_true ? wr_opcode[sz_ind] :
+                                               rd_opcode[sz_ind]);
+        sg_put_unaligned_be64((uint64_t)start_block, cdbp + 2);
+        sg_put_unaligned_be32((uint32_t)blocks, cdbp + 10);
+        break;
+    default:
+        pr2serr("%sexpected cdb size of 6, 10, 12, or 16 but got %d\n",
+                my_name, cdb_sz);
+        return 1;
+    }
+    return 0;
+}
+
+/* Queues the READ or WRITE described by 'rep' on the sg device without
+ * waiting for it to complete. Returns 0 if queued, 1 if the sg driver's
+ * queue for that file descriptor is full (try again after a completion)
+ * and -1 for other errors. */
+static int
+sg_start_io(Rq_coll * clp, Rq_elem * rep)
+{
+    struct sg_io_hdr * hp = &rep->io_hdr;
+    bool wr = rep->wr;
+    bool fua = wr ? clp->out_flags.fua : clp->in_flags.fua;
+    bool dpo = wr ? clp->out_flags.dpo : clp->in_flags.dpo;
+    bool dio = wr ? clp->out_flags.dio : clp->in_flags.dio;
+    int cdbsz = wr ? clp->cdbsz_out : clp->cdbsz_in;
+    int res;
+    int64_t blk = rep->blk + (wr ? clp->seek : clp->skip);
+
+    if (sg_build_scsi_cdb(rep->cmd, cdbsz, rep->num_blks, blk, wr, fua,
+                          dpo)) {
+        pr2serr("%sbad cdb build, start_blk=%" PRId64 ", blocks=%d\n",
+                my_name, blk, rep->num_blks);
+        return -1;
+    }
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = cdbsz;
+    hp->cmdp = rep->cmd;
+    hp->dxfer_direction = wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
+    hp->dxfer_len = clp->bs * rep->num_blks;
+    hp->dxferp = rep->buffp;
+    hp->mx_sb_len = sizeof(rep->sb);
+    hp->sbp = rep->sb;
+    hp->timeout = DEF_TIMEOUT;
+    hp->usr_ptr = rep;
+    hp->pack_id = (int)++clp->next_pack_id;
+    if (dio)
+        hp->flags |= SG_FLAG_DIRECT_IO;
+    if (clp->debug > 8) {
+        pr2serr("sg_start_io: SCSI %s, blk=%" PRId64 " num_blks=%d\n",
+               wr ? "WRITE" : "READ", blk, rep->num_blks);
+        sg_print_command(hp->cmdp);
+    }
+
+    while (((res = write(wr ? clp->outfd : clp->infd, hp,
+                         sizeof(struct sg_io_hdr))) < 0) &&
+           (EINTR == errno))
+        ;
+    if (res < 0) {
+        /* EDOM: per file descriptor command queue is full */
+        if ((EAGAIN == errno) || (EDOM == errno) || (ENOMEM == errno)) {
+            ++clp->q_full_count;
+            return 1;
+        }
+        perror("starting io on sg device, error");
+        return -1;
+    }
+    if (wr) {
+        if (++clp->wr_inflight > clp->max_wr_inflight)
+            clp->max_wr_inflight = clp->wr_inflight;
+    } else {
+        if (++clp->rd_inflight > clp->max_rd_inflight)
+            clp->max_rd_inflight = clp->rd_inflight;
+    }
+    return 0;
+}
+
+static void
+stop_both(Rq_coll * clp, int res)
+{
+    if (exit_status <= 0)
+        exit_status = res;
+    clp->in_stop = true;
+    clp->out_stop = true;
+}
+
+/* Called when the sg driver has returned the response for 'rep'. Moves
+ * 'rep' to its next state, requeues it for a retry or stops the copy. */
+static void
+sg_complete_io(Rq_coll * clp, Rq_elem * rep)
+{
+    bool wr = rep->wr;
+    int res;
+    struct sg_io_hdr * hp = &rep->io_hdr;
+    char ebuff[EBUFF_SZ];
+
+    if (wr)
+        --clp->wr_inflight;
+    else
+        --clp->rd_inflight;
+    res = sg_err_category3(hp);
+    switch (res) {
+    case SG_LIB_CAT_CLEAN:
+        break;
+    case SG_LIB_CAT_RECOVERED:
+        sg_chk_n_print3((wr ? "writing continuing": "reading continuing"),
+                        hp, false);
+        break;
+    case SG_LIB_CAT_ABORTED_COMMAND:
+    case SG_LIB_CAT_UNIT_ATTENTION:
+        /* try again with same addr, count info */
+        if (clp->debug > 8)
+            sg_chk_n_print3((wr ? "writing": "reading"), hp, false);
+        ++clp->retries;
+        /* a slot was just freed on this fd so queue full is unexpected */
+        if (0 == sg_start_io(clp, rep))
+            return;
+        pr2serr("%sunable to requeue %s, blk=%" PRId64 "\n", my_name,
+                (wr ? "WRITE" : "READ"),
+                rep->blk + (wr ? clp->seek : clp->skip));
+        stop_both(clp, SG_LIB_CAT_OTHER);
+        rep->state = SGE_ST_FREE;
+        return;
+    case SG_LIB_CAT_MEDIUM_HARD:
+        if ((wr ? clp->out_flags.coe : clp->in_flags.coe)) {
+            if (wr)
+                pr2serr(">> ignored error for out blk=%" PRId64 " for %d "
+                        "bytes\n", rep->blk + clp->seek,
+                        rep->num_blks * clp->bs);
+            else {
+                memset(rep->buffp, 0, rep->num_blks * clp->bs);
+                pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
+                        "bytes\n", rep->blk + clp->skip,
+                        rep->num_blks * clp->bs);
+            }
+            break;
+        }
+        pr2serr("error finishing sg %s command (medium)\n",
+                (wr ? "out" : "in"));
+        stop_both(clp, res);
+        rep->state = SGE_ST_FREE;
+        return;
+    case SG_LIB_CAT_NOT_READY:
+    default:
+        snprintf(ebuff, EBUFF_SZ, "%s blk=%" PRId64,
+                 wr ? "writing": "reading",
+                 rep->blk + (wr ? clp->seek : clp->skip));
+        sg_chk_n_print3(ebuff, hp, false);
+        stop_both(clp, res);
+        rep->state = SGE_ST_FREE;
+        return;
+    }
+    if ((wr ? clp->out_flags.dio : clp->in_flags.dio) &&
+        ((hp->info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+        ++clp->dio_incomplete_count; /* count dios done as indirect IO */
+    clp->sum_of_resids += hp->resid;
+    if (wr) {
+        clp->out_rem_count -= rep->num_blks;
+        rep->state = SGE_ST_FREE;
+    } else {
+        clp->in_rem_count -= rep->num_blks;
+        rep->state = SGE_ST_RD_DONE;
+    }
+    if (clp->debug > 8)
+        pr2serr("sg_complete_io: completed %s\n", wr ? "WRITE" : "READ");
+}
+
+/* Fetches all responses that are ready on sg file descriptor 'fd' (which
+ * is non-blocking). Returns 0 unless the sg driver reports an error. */
+static int
+sg_reap_io(Rq_coll * clp, int fd)
+{
+    int res;
+    Rq_elem * rep;
+    struct sg_io_hdr io_hdr;
+
+    while (true) {
+        memset(&io_hdr, 0 , sizeof(struct sg_io_hdr));
+        io_hdr.interface_id = 'S';
+        io_hdr.pack_id = -1;    /* any response will do */
+        res = read(fd, &io_hdr, sizeof(struct sg_io_hdr));
+        if (res < 0) {
+            if (EAGAIN == errno)
+                return 0;
+            if (EINTR == errno)
+                continue;
+            perror("finishing io on sg device, error");
+            return -1;
+        }
+        rep = (Rq_elem *)io_hdr.usr_ptr;
+        if ((rep < clp->elems) || (rep >= (clp->elems + clp->num_elems))) {
+            pr2serr("%sbad usr_ptr, request-response mismatch\n", my_name);
+            return -1;
+        }
+        memcpy(&rep->io_hdr, &io_hdr, sizeof(struct sg_io_hdr));
+        sg_complete_io(clp, rep);
+        if (rep->wr)
+            clp->wr_q_full = false;
+        else
+            clp->rd_q_full = false;
+    }
+}
+
+/* Synchronous read() from a non-sg IFILE. Returns true if this should be
+ * the last read (short read or error). */
+static bool
+normal_in_operation(Rq_coll * clp, Rq_elem * rep)
+{
+    bool stop_after_write = false;
+    int res;
+    int blocks = rep->num_blks;
+
+    while (((res = read(clp->infd, rep->buffp, blocks * clp->bs)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        if (clp->in_flags.coe) {
+            memset(rep->buffp, 0, blocks * clp->bs);
+            pr2serr(">> substituted zeros for in blk=%" PRId64 " for %d "
+                    "bytes, %s\n", rep->blk + clp->skip, blocks * clp->bs,
+                    safe_strerror(errno));
+            res = blocks * clp->bs;
+        } else {
+            pr2serr("error in normal read, %s\n", safe_strerror(errno));
+            stop_both(clp, SG_LIB_FILE_ERROR);
+            return true;
+        }
+    }
+    if (res < blocks * clp->bs) {
+        int o_blocks = blocks;
+
+        stop_after_write = true;
+        blocks = res / clp->bs;
+        if ((res % clp->bs) > 0) {
+            blocks++;
+            clp->in_partial++;
+        }
+        /* Reverse out + re-apply blocks on clp */
+        clp->in_blk -= o_blocks;
+        clp->in_count += o_blocks;
+        rep->num_blks = blocks;
+        clp->in_blk += blocks;
+        clp->in_count -= blocks;
+    }
+    clp->in_rem_count -= blocks;
+    return stop_after_write;
+}
+
+/* Synchronous write() to a non-sg OFILE. */
+static void
+normal_out_operation(Rq_coll * clp, Rq_elem * rep)
+{
+    int res;
+    int blocks = rep->num_blks;
+
+    while (((res = write(clp->outfd, rep->buffp, blocks * clp->bs)) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        if (clp->out_flags.coe) {
+            pr2serr(">> ignored error for out blk=%" PRId64 " for %d bytes, "
+                    "%s\n", rep->blk + clp->seek, blocks * clp->bs,
+                    safe_strerror(errno));
+            res = blocks * clp->bs;
+        } else {
+            pr2serr("error normal write, %s\n", safe_strerror(errno));
+            stop_both(clp, SG_LIB_FILE_ERROR);
+            return;
+        }
+    }
+    if (res < blocks * clp->bs) {
+        blocks = res / clp->bs;
+        if ((res % clp->bs) > 0) {
+            blocks++;
+            clp->out_partial++;
+        }
+    }
+    clp->out_rem_count -= blocks;
+}
+
+/* Starts as many READs as the queue depth and free request elements allow.
+ * READs on a non-sg IFILE complete immediately. Returns number started. */
+static int
+issue_reads(Rq_coll * clp)
+{
+    int k, res;
+    int num = 0;
+    Rq_elem * rep;
+
+    for (k = 0; k < clp->num_elems; ++k) {
+        if (clp->in_stop || (clp->in_count <= 0) || clp->rd_q_full ||
+            (clp->rd_inflight >= clp->rqd))
+            break;
+        rep = clp->elems + k;
+        if (SGE_ST_FREE != rep->state)
+            continue;
+        rep->wr = false;
+        rep->blk = clp->in_blk;
+        rep->num_blks = (clp->in_count > clp->bpt) ? clp->bpt :
+                                                     (int)clp->in_count;
+        if (FT_SG == clp->in_type) {
+            res = sg_start_io(clp, rep);
+            if (1 == res) {
+                clp->rd_q_full = true;
+                if (0 == clp->rd_inflight) {
+                    pr2serr("%ssg driver won't queue any READs\n", my_name);
+                    stop_both(clp, SG_LIB_CAT_OTHER);
+                }
+                break;
+            } else if (res < 0) {
+                pr2serr("%sinputting to sg failed, blk=%" PRId64 "\n",
+                        my_name, rep->blk + clp->skip);
+                stop_both(clp, SG_LIB_CAT_OTHER);
+                break;
+            }
+            rep->state = SGE_ST_RD_ISSUED;
+            clp->in_blk += rep->num_blks;
+            clp->in_count -= rep->num_blks;
+        } else {
+            clp->in_blk += rep->num_blks;
+            clp->in_count -= rep->num_blks;
+            if (normal_in_operation(clp, rep))
+                clp->in_stop = true;
+            if (clp->out_stop)
+                break;
+            rep->state = (rep->num_blks > 0) ? SGE_ST_RD_DONE : SGE_ST_FREE;
+        }
+        ++num;
+    }
+    return num;
+}
+
+/* Finds the element holding the next (in block order) data to be written */
+static Rq_elem *
+next_in_order(Rq_coll * clp)
+{
+    int k;
+    Rq_elem * rep;
+
+    for (k = 0; k < clp->num_elems; ++k) {
+        rep = clp->elems + k;
+        if ((SGE_ST_RD_DONE == rep->state) && (rep->blk == clp->out_blk))
+            return rep;
+    }
+    return NULL;
+}
+
+/* Starts WRITEs in ascending block order from the reorder window. WRITEs
+ * to a non-sg OFILE complete immediately. Returns number started. */
+static int
+issue_writes(Rq_coll * clp)
+{
+    int res;
+    int num = 0;
+    Rq_elem * rep;
+
+    while ((! clp->out_stop) && (! clp->wr_q_full) &&
+           (clp->wr_inflight < clp->wqd)) {
+        rep = next_in_order(clp);
+        if (NULL == rep)
+            break;
+        rep->wr = true;
+        if (FT_SG == clp->out_type) {
+            res = sg_start_io(clp, rep);
+            if (1 == res) {
+                clp->wr_q_full = true;
+                if (0 == clp->wr_inflight) {
+                    pr2serr("%ssg driver won't queue any WRITEs\n", my_name);
+                    stop_both(clp, SG_LIB_CAT_OTHER);
+                }
+                rep->wr = false;
+                break;
+            } else if (res < 0) {
+                pr2serr("%soutputting from sg failed, blk=%" PRId64 "\n",
+                        my_name, rep->blk + clp->seek);
+                stop_both(clp, SG_LIB_CAT_OTHER);
+                break;
+            }
+            rep->state = SGE_ST_WR_ISSUED;
+        } else {
+            if (FT_DEV_NULL == clp->out_type)
+                clp->out_rem_count -= rep->num_blks;
+            else
+                normal_out_operation(clp, rep);
+            rep->state = SGE_ST_FREE;
+        }
+        clp->out_blk += rep->num_blks;
+        ++num;
+    }
+    return num;
+}
+
+/* The single threaded copy engine. Keeps READs and WRITEs queued until the
+ * copy completes or an error stops it, then waits for outstanding commands
+ * to drain. */
+static void
+do_copy(Rq_coll * clp)
+{
+    int k, n, res, err;
+    struct epoll_event evs[2];
+
+    while (true) {
+        do {
+            n = issue_reads(clp);
+            n += issue_writes(clp);
+        } while (n > 0);
+        if ((0 == clp->rd_inflight) && (0 == clp->wr_inflight))
+            break;
+        n = epoll_wait(clp->epfd, evs, 2, -1);
+        if (n < 0) {
+            err = errno;
+            if (EINTR == err)
+                continue;
+            perror("epoll_wait");
+            stop_both(clp, sg_convert_errno(err));
+            break;
+        }
+        for (k = 0; k < n; ++k) {
+            res = sg_reap_io(clp, (SGE_EP_IN == evs[k].data.u32) ?
+                                  clp->infd : clp->outfd);
+            if (res) {
+                stop_both(clp, SG_LIB_CAT_OTHER);
+                return;
+            }
+        }
+    }
+}
+
+static int
+sg_prepare(Rq_coll * clp, int fd, uint32_t ep_tag)
+{
+    int res, t;
+    struct epoll_event ev;
+
+    res = ioctl(fd, SG_GET_VERSION_NUM, &t);
+    if ((res < 0) || (t < 30000)) {
+        pr2serr("%ssg driver prior to 3.x.y\n", my_name);
+        return 1;
+    }
+    t = clp->bs * clp->bpt;
+    res = ioctl(fd, SG_SET_RESERVED_SIZE, &t);
+    if (res < 0)
+        perror("sge_dd: SG_SET_RESERVED_SIZE error");
+    t = 1;
+    res = ioctl(fd, SG_SET_COMMAND_Q, &t);
+    if (res < 0)
+        perror("sge_dd: SG_SET_COMMAND_Q error");
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = ep_tag;
+    if (epoll_ctl(clp->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("sge_dd: epoll_ctl(ADD) error");
+        return 1;
+    }
+    return 0;
+}
+
+static int
+process_flags(const char * arg, struct flags_t * fp)
+{
+    char buff[256];
+    char * cp;
+    char * np;
+
+    strncpy(buff, arg, sizeof(buff));
+    buff[sizeof(buff) - 1] = '\0';
+    if ('\0' == buff[0]) {
+        pr2serr("no flag found\n");
+        return 1;
+    }
+    cp = buff;
+    do {
+        np = strchr(cp, ',');
+        if (np)
+            *np++ = '\0';
+        if (0 == strcmp(cp, "append"))
+            fp->append = true;
+        else if (0 == strcmp(cp, "coe"))
+            fp->coe = true;
+        else if (0 == strcmp(cp, "dio"))
+            fp->dio = true;
+        else if (0 == strcmp(cp, "direct"))
+            fp->direct = true;
+        else if (0 == strcmp(cp, "dpo"))
+            fp->dpo = true;
+        else if (0 == strcmp(cp, "dsync"))
+            fp->dsync = true;
+        else if (0 == strcmp(cp, "excl"))
+            fp->excl = true;
+        else if (0 == strcmp(cp, "fua"))
+            fp->fua = true;
+        else if (0 == strcmp(cp, "null"))
+            ;
+        else {
+            pr2serr("unrecognised flag: %s\n", cp);
+            return 1;
+        }
+        cp = np;
+    } while (cp);
+    return 0;
+}
+
+/* Returns the number of times 'ch' is found in string 's' given the
+ * string's length. */
+static int
+num_chs_in_str(const char * s, int slen, int ch)
+{
+    int res = 0;
+
+    while (--slen >= 0) {
+        if (ch == s[slen])
+            ++res;
+    }
+    return res;
+}
+
+
+#define STR_SZ 1024
+#define INOUTF_SZ 512
+
+int
+main(int argc, char * argv[])
+{
+    bool verbose_given = false;
+    bool version_given = false;
+    int64_t skip = 0;
+    int64_t seek = 0;
+    int ibs = 0;
+    int obs = 0;
+    int bpt_given = 0;
+    int cdbsz_given = 0;
+    char str[STR_SZ];
+    char * key;
+    char * buf;
+    char inf[INOUTF_SZ];
+    char outf[INOUTF_SZ];
+    int res, k, err, keylen;
+    int64_t in_num_sect = 0;
+    int64_t out_num_sect = 0;
+    int in_sect_sz, out_sect_sz, n, flags;
+    Rq_coll * clp = &rcoll;
+    char ebuff[EBUFF_SZ];
+
+    memset(clp, 0, sizeof(*clp));
+    clp->bpt = DEF_BLOCKS_PER_TRANSFER;
+    clp->in_type = FT_OTHER;
+    clp->out_type = FT_OTHER;
+    clp->cdbsz_in = DEF_SCSI_CDBSZ;
+    clp->cdbsz_out = DEF_SCSI_CDBSZ;
+    clp->rqd = DEF_QUEUE_DEPTH;
+    clp->wqd = DEF_QUEUE_DEPTH;
+    clp->epfd = -1;
+    inf[0] = '\0';
+    outf[0] = '\0';
+
+    for (k = 1; k < argc; k++) {
+        if (argv[k]) {
+            strncpy(str, argv[k], STR_SZ);
+            str[STR_SZ - 1] = '\0';
+        }
+        else
+            continue;
+        for (key = str, buf = key; *buf && *buf != '=';)
+            buf++;
+        if (*buf)
+            *buf++ = '\0';
+        keylen = strlen(key);
+        if (0 == strcmp(key,"bpt")) {
+            clp->bpt = sg_get_num(buf);
+            if (-1 == clp->bpt) {
+                pr2serr("%sbad argument to 'bpt='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            bpt_given = 1;
+        } else if (0 == strcmp(key,"bs")) {
+            clp->bs = sg_get_num(buf);
+            if (-1 == clp->bs) {
+                pr2serr("%sbad argument to 'bs='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"cdbsz")) {
+            clp->cdbsz_in = sg_get_num(buf);
+            clp->cdbsz_out = clp->cdbsz_in;
+            cdbsz_given = 1;
+        } else if (0 == strcmp(key,"coe")) {
+            clp->in_flags.coe = !! sg_get_num(buf);
+            clp->out_flags.coe = clp->in_flags.coe;
+        } else if (0 == strcmp(key,"count")) {
+            if (0 != strcmp("-1", buf)) {
+                dd_count = sg_get_llnum(buf);
+                if (-1LL == dd_count) {
+                    pr2serr("%sbad argument to 'count='\n", my_name);
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+            }   /* treat 'count=-1' as calculate count (same as not given) */
+        } else if ((0 == strncmp(key,"deb", 3)) ||
+                   (0 == strncmp(key,"verb", 4)))
+            clp->debug = sg_get_num(buf);
+        else if (0 == strcmp(key,"dio")) {
+            clp->in_flags.dio = !! sg_get_num(buf);
+            clp->out_flags.dio = clp->in_flags.dio;
+        } else if (0 == strcmp(key,"fua")) {
+            n = sg_get_num(buf);
+            if (n & 1)
+                clp->out_flags.fua = true;
+            if (n & 2)
+                clp->in_flags.fua = true;
+        } else if (0 == strcmp(key,"ibs")) {
+            ibs = sg_get_num(buf);
+            if (-1 == ibs) {
+                pr2serr("%sbad argument to 'ibs='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (strcmp(key,"if") == 0) {
+            if ('\0' != inf[0]) {
+                pr2serr("Second 'if=' argument??\n");
+                return SG_LIB_SYNTAX_ERROR;
+            } else {
+                memcpy(inf, buf, INOUTF_SZ);
+                inf[INOUTF_SZ - 1] = '\0';
+            }
+        } else if (0 == strcmp(key, "iflag")) {
+            if (process_flags(buf, &clp->in_flags)) {
+                pr2serr("%sbad argument to 'iflag='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"obs")) {
+            obs = sg_get_num(buf);
+            if (-1 == obs) {
+                pr2serr("%sbad argument to 'obs='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (strcmp(key,"of") == 0) {
+            if ('\0' != outf[0]) {
+                pr2serr("Second 'of=' argument??\n");
+                return SG_LIB_SYNTAX_ERROR;
+            } else {
+                memcpy(outf, buf, INOUTF_SZ);
+                outf[INOUTF_SZ - 1] = '\0';
+            }
+        } else if (0 == strcmp(key, "oflag")) {
+            if (process_flags(buf, &clp->out_flags)) {
+                pr2serr("%sbad argument to 'oflag='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"rqd")) {
+            clp->rqd = sg_get_num(buf);
+            if (-1 == clp->rqd) {
+                pr2serr("%sbad argument to 'rqd='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"seek")) {
+            seek = sg_get_llnum(buf);
+            if (-1LL == seek) {
+                pr2serr("%sbad argument to 'seek='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"skip")) {
+            skip = sg_get_llnum(buf);
+            if (-1LL == skip) {
+                pr2serr("%sbad argument to 'skip='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key,"sync"))
+            do_sync = !! sg_get_num(buf);
+        else if (0 == strcmp(key,"time"))
+            do_time = !! sg_get_num(buf);
+        else if (0 == strcmp(key,"wqd")) {
+            clp->wqd = sg_get_num(buf);
+            if (-1 == clp->wqd) {
+                pr2serr("%sbad argument to 'wqd='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if ((keylen > 1) && ('-' == key[0]) && ('-' != key[1])) {
+            res = 0;
+            n = num_chs_in_str(key + 1, keylen - 1, 'd');
+            clp->dry_run += n;
+            res += n;
+            n = num_chs_in_str(key + 1, keylen - 1, 'h');
+            if (n > 0) {
+                usage();
+                return 0;
+            }
+            n = num_chs_in_str(key + 1, keylen - 1, 'v');
+            if (n > 0)
+                verbose_given = true;
+            clp->debug += n;   /* -v  ---> --verbose */
+            res += n;
+            n = num_chs_in_str(key + 1, keylen - 1, 'V');
+            if (n > 0)
+                version_given = true;
+            res += n;
+
+            if (res < (keylen - 1)) {
+                pr2serr("Unrecognised short option in '%s', try '--help'\n",
+                        key);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if ((0 == strncmp(key, "--dry-run", 9)) ||
+                   (0 == strncmp(key, "--dry_run", 9)))
+            ++clp->dry_run;
+        else if ((0 == strncmp(key, "--help", 6)) ||
+                   (0 == strcmp(key, "-?"))) {
+            usage();
+            return 0;
+        } else if (0 == strncmp(key, "--verb", 6)) {
+            verbose_given = true;
+            ++clp->debug;      /* --verbose */
+        } else if (0 == strncmp(key, "--vers", 6))
+            version_given = true;
+        else {
+            pr2serr("Unrecognized option '%s'\n", key);
+            pr2serr("For more information use '--help'\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+
+#ifdef DEBUG
+    pr2serr("In DEBUG mode, ");
+    if (verbose_given && version_given) {
+        pr2serr("but override: '-vV' given, zero verbose and continue\n");
+        verbose_given = false;
+        version_given = false;
+        clp->debug = 0;
+    } else if (! verbose_given) {
+        pr2serr("set '-vv'\n");
+        clp->debug = 2;
+    } else
+        pr2serr("keep verbose=%d\n", clp->debug);
+#else
+    if (verbose_given && version_given)
+        pr2serr("Not in DEBUG mode, so '-vV' has no special action\n");
+#endif
+    if (version_given) {
+        pr2serr("%s%s\n", my_name, version_str);
+        return 0;
+    }
+
+    if (clp->bs <= 0) {
+        clp->bs = DEF_BLOCK_SIZE;
+        pr2serr("Assume default 'bs' ((logical) block size) of %d bytes\n",
+                clp->bs);
+    }
+    if ((ibs && (ibs != clp->bs)) || (obs && (obs != clp->bs))) {
+        pr2serr("If 'ibs' or 'obs' given must be same as 'bs'\n");
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((skip < 0) || (seek < 0)) {
+        pr2serr("skip and seek cannot be negative\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (clp->out_flags.append && (seek > 0)) {
+        pr2serr("Can't use both append and seek switches\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (clp->bpt < 1) {
+        pr2serr("bpt must be greater than 0\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    /* defaulting transfer size to 128*2048 for CD/DVDs is too large
+       for the block layer in lk 2.6 and results in an EIO on the
+       SG_IO ioctl. So reduce it in that case. */
+    if ((clp->bs >= 2048) && (0 == bpt_given))
+        clp->bpt = DEF_BLOCKS_PER_2048TRANSFER;
+    if ((clp->rqd < 1) || (clp->rqd > MAX_QUEUE_DEPTH) ||
+        (clp->wqd < 1) || (clp->wqd > MAX_QUEUE_DEPTH)) {
+        pr2serr("rqd= and wqd= must be from 1 to %d\n", MAX_QUEUE_DEPTH);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (clp->debug)
+        pr2serr("%sif=%s skip=%" PRId64 " of=%s seek=%" PRId64 " count=%"
+                PRId64 "\n", my_name, inf, skip, outf, seek, dd_count);
+
+    install_handler(SIGINT, interrupt_handler);
+    install_handler(SIGQUIT, interrupt_handler);
+    install_handler(SIGPIPE, interrupt_handler);
+    install_handler(SIGUSR1, siginfo_handler);
+
+    clp->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (clp->epfd < 0) {
+        err = errno;
+        perror("sge_dd: epoll_create1 error");
+        return sg_convert_errno(err);
+    }
+    clp->infd = STDIN_FILENO;
+    clp->outfd = STDOUT_FILENO;
+    if (inf[0] && ('-' != inf[0])) {
+        clp->in_type = dd_filetype(inf);
+
+        if (FT_ERROR == clp->in_type) {
+            pr2serr("%sunable to access %s\n", my_name, inf);
+            return SG_LIB_FILE_ERROR;
+        } else if (FT_ST == clp->in_type) {
+            pr2serr("%sunable to use scsi tape device %s\n", my_name, inf);
+            return SG_LIB_FILE_ERROR;
+        } else if (FT_SG == clp->in_type) {
+            flags = O_RDWR | O_NONBLOCK;
+            if (clp->in_flags.direct)
+                flags |= O_DIRECT;
+            if (clp->in_flags.excl)
+                flags |= O_EXCL;
+            if (clp->in_flags.dsync)
+                flags |= O_SYNC;
+
+            if ((clp->infd = open(inf, flags)) < 0) {
+                err = errno;
+                snprintf(ebuff, EBUFF_SZ, "%scould not open %s for sg "
+                         "reading", my_name, inf);
+                perror(ebuff);
+                return sg_convert_errno(err);
+            }
+            if (sg_prepare(clp, clp->infd, SGE_EP_IN))
+                return SG_LIB_FILE_ERROR;
+        }
+        else {
+            flags = O_RDONLY;
+            if (clp->in_flags.direct)
+                flags |= O_DIRECT;
+            if (clp->in_flags.excl)
+                flags |= O_EXCL;
+            if (clp->in_flags.dsync)
+                flags |= O_SYNC;
+
+            if ((clp->infd = open(inf, flags)) < 0) {
+                err = errno;
+                snprintf(ebuff, EBUFF_SZ, "%scould not open %s for reading",
+                         my_name, inf);
+                perror(ebuff);
+                return sg_convert_errno(err);
+            }
+            else if (skip > 0) {
+                off64_t offset = skip;
+
+                offset *= clp->bs;       /* could exceed 32 here! */
+                if (lseek64(clp->infd, offset, SEEK_SET) < 0) {
+                    err = errno;
+                    snprintf(ebuff, EBUFF_SZ, "%scouldn't skip to required "
+                             "position on %s", my_name, inf);
+                    perror(ebuff);
+                    return sg_convert_errno(err);
+                }
+            }
+        }
+    }
+    if (outf[0] && ('-' != outf[0])) {
+        clp->out_type = dd_filetype(outf);
+
+        if (FT_ST == clp->out_type) {
+            pr2serr("%sunable to use scsi tape device %s\n", my_name, outf);
+            return SG_LIB_FILE_ERROR;
+        }
+        else if (FT_SG == clp->out_type) {
+            flags = O_RDWR | O_NONBLOCK;
+            if (clp->out_flags.direct)
+                flags |= O_DIRECT;
+            if (clp->out_flags.excl)
+                flags |= O_EXCL;
+            if (clp->out_flags.dsync)
+                flags |= O_SYNC;
+
+            if ((clp->outfd = open(outf, flags)) < 0) {
+                err = errno;
+                snprintf(ebuff,  EBUFF_SZ, "%scould not open %s for sg "
+                         "writing", my_name, outf);
+                perror(ebuff);
+                return sg_convert_errno(err);
+            }
+
+            if (sg_prepare(clp, clp->outfd, SGE_EP_OUT))
+                return SG_LIB_FILE_ERROR;
+        }
+        else if (FT_DEV_NULL == clp->out_type)
+            clp->outfd = -1; /* don't bother opening */
+        else {
+            if (FT_RAW != clp->out_type) {
+                flags = O_WRONLY | O_CREAT;
+                if (clp->out_flags.direct)
+                    flags |= O_DIRECT;
+                if (clp->out_flags.excl)
+                    flags |= O_EXCL;
+                if (clp->out_flags.dsync)
+                    flags |= O_SYNC;
+                if (clp->out_flags.append)
+                    flags |= O_APPEND;
+
+                if ((clp->outfd = open(outf, flags, 0666)) < 0) {
+                    err = errno;
+                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for "
+                             "writing", my_name, outf);
+                    perror(ebuff);
+                    return sg_convert_errno(err);
+                }
+            }
+            else {      /* raw output file */
+                if ((clp->outfd = open(outf, O_WRONLY)) < 0) {
+                    err = errno;
+                    snprintf(ebuff, EBUFF_SZ, "%scould not open %s for raw "
+                             "writing", my_name, outf);
+                    perror(ebuff);
+                    return sg_convert_errno(err);
+                }
+            }
+            if (seek > 0) {
+                off64_t offset = seek;
+
+                offset *= clp->bs;       /* could exceed 32 bits here! */
+                if (lseek64(clp->outfd, offset, SEEK_SET) < 0) {
+                    err = errno;
+                    snprintf(ebuff, EBUFF_SZ, "%scouldn't seek to required "
+                             "position on %s", my_name, outf);
+                    perror(ebuff);
+                    return sg_convert_errno(err);
+                }
+            }
+        }
+    }
+    if ((STDIN_FILENO == clp->infd) && (STDOUT_FILENO == clp->outfd)) {
+        pr2serr("Won't default both IFILE to stdin _and_ OFILE to stdout\n");
+        pr2serr("For more information use '--help'\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((FT_SG != clp->in_type) && (FT_SG != clp->out_type) && clp->debug)
+        pr2serr("%sneither IFILE nor OFILE is a sg device so no commands "
+                "will be queued\n", my_name);
+    if (dd_count < 0) {
+        in_num_sect = -1;
+        if (FT_SG == clp->in_type) {
+            res = scsi_read_capacity(clp->infd, &in_num_sect, &in_sect_sz);
+            if (2 == res) {
+                pr2serr("Unit attention, media changed(in), continuing\n");
+                res = scsi_read_capacity(clp->infd, &in_num_sect,
+                                         &in_sect_sz);
+            }
+            if (0 != res) {
+                if (res == SG_LIB_CAT_INVALID_OP)
+                    pr2serr("read capacity not supported on %s\n", inf);
+                else if (res == SG_LIB_CAT_NOT_READY)
+                    pr2serr("read capacity failed, %s not ready\n", inf);
+                else
+                    pr2serr("Unable to read capacity on %s\n", inf);
+                in_num_sect = -1;
+            }
+        } else if (FT_BLOCK == clp->in_type) {
+            if (0 != read_blkdev_capacity(clp->infd, &in_num_sect,
+                                          &in_sect_sz)) {
+                pr2serr("Unable to read block capacity on %s\n", inf);
+                in_num_sect = -1;
+            }
+            if (clp->bs != in_sect_sz) {
+                pr2serr("logical block size on %s confusion; bs=%d, from "
+                        "device=%d\n", inf, clp->bs, in_sect_sz);
+                in_num_sect = -1;
+            }
+        }
+        if (in_num_sect > skip)
+            in_num_sect -= skip;
+
+        out_num_sect = -1;
+        if (FT_SG == clp->out_type) {
+            res = scsi_read_capacity(clp->outfd, &out_num_sect, &out_sect_sz);
+            if (2 == res) {
+                pr2serr("Unit attention, media changed(out), continuing\n");
+                res = scsi_read_capacity(clp->outfd, &out_num_sect,
+                                         &out_sect_sz);
+            }
+            if (0 != res) {
+                if (res == SG_LIB_CAT_INVALID_OP)
+                    pr2serr("read capacity not supported on %s\n", outf);
+                else if (res == SG_LIB_CAT_NOT_READY)
+                    pr2serr("read capacity failed, %s not ready\n", outf);
+                else
+                    pr2serr("Unable to read capacity on %s\n", outf);
+                out_num_sect = -1;
+            }
+        } else if (FT_BLOCK == clp->out_type) {
+            if (0 != read_blkdev_capacity(clp->outfd, &out_num_sect,
+                                          &out_sect_sz)) {
+                pr2serr("Unable to read block capacity on %s\n", outf);
+                out_num_sect = -1;
+            }
+            if (clp->bs != out_sect_sz) {
+                pr2serr("logical block size on %s confusion: bs=%d, from "
+                        "device=%d\n", outf, clp->bs, out_sect_sz);
+                out_num_sect = -1;
+            }
+        }
+        if (out_num_sect > seek)
+            out_num_sect -= seek;
+
+        if (in_num_sect > 0) {
+            if (out_num_sect > 0)
+                dd_count = (in_num_sect > out_num_sect) ? out_num_sect :
+                                                          in_num_sect;
+            else
+                dd_count = in_num_sect;
+        }
+        else
+            dd_count = out_num_sect;
+    }
+    if (clp->debug > 1)
+        pr2serr("Start of loop, count=%" PRId64 ", in_num_sect=%" PRId64
+                ", out_num_sect=%" PRId64 "\n", dd_count, in_num_sect,
+                out_num_sect);
+    if (dd_count < 0) {
+        pr2serr("Couldn't calculate count, please give one\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    if (! cdbsz_given) {
+        if ((FT_SG == clp->in_type) && (MAX_SCSI_CDBSZ != clp->cdbsz_in) &&
+            (((dd_count + skip) > UINT_MAX) || (clp->bpt > USHRT_MAX))) {
+            pr2serr("Note: SCSI command size increased to 16 bytes (for "
+                    "'if')\n");
+            clp->cdbsz_in = MAX_SCSI_CDBSZ;
+        }
+        if ((FT_SG == clp->out_type) && (MAX_SCSI_CDBSZ != clp->cdbsz_out) &&
+            (((dd_count + seek) > UINT_MAX) || (clp->bpt > USHRT_MAX))) {
+            pr2serr("Note: SCSI command size increased to 16 bytes (for "
+                    "'of')\n");
+            clp->cdbsz_out = MAX_SCSI_CDBSZ;
+        }
+    }
+
+    clp->in_count = dd_count;
+    clp->in_rem_count = dd_count;
+    clp->skip = skip;
+    clp->in_blk = 0;
+    clp->out_rem_count = dd_count;
+    clp->seek = seek;
+    clp->out_blk = 0;
+
+    /* Each queued READ or WRITE needs its own buffer. The WRITE queue
+     * allowance doubles as the reorder window for READs that complete
+     * ahead of the next block to be written. */
+    clp->num_elems = clp->rqd + clp->wqd;
+    clp->elems = (Rq_elem *)calloc(clp->num_elems, sizeof(Rq_elem));
+    if (NULL == clp->elems) {
+        pr2serr("%snot enough user memory\n", my_name);
+        return sg_convert_errno(ENOMEM);
+    }
+    for (k = 0; k < clp->num_elems; ++k) {
+        Rq_elem * rep = clp->elems + k;
+
+        rep->buffp = sg_memalign(clp->bs * clp->bpt, 0, &rep->alloc_bp,
+                                 false);
+        if (NULL == rep->buffp) {
+            pr2serr("%snot enough user memory for %d buffers\n", my_name,
+                    clp->num_elems);
+            exit_status = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+    }
+
+    if (clp->dry_run > 0) {
+        pr2serr("Due to --dry-run option, bypass copy/read\n");
+        goto fini;
+    }
+
+    if (do_time) {
+        start_tm.tv_sec = 0;
+        start_tm.tv_usec = 0;
+        gettimeofday(&start_tm, NULL);
+    }
+
+    if (clp->out_rem_count > 0)
+        do_copy(clp);
+
+    if (do_time && (start_tm.tv_sec || start_tm.tv_usec))
+        calc_duration_throughput(0);
+
+    if (do_sync) {
+        if (FT_SG == clp->out_type) {
+            pr2serr(">> Synchronizing cache on %s\n", outf);
+            res = sg_ll_sync_cache_10(clp->outfd, 0, 0, 0, 0, 0, false, 0);
+            if (SG_LIB_CAT_UNIT_ATTENTION == res) {
+                pr2serr("Unit attention(out), continuing\n");
+                res = sg_ll_sync_cache_10(clp->outfd, 0, 0, 0, 0, 0, false,
+                                          0);
+            }
+            if (0 != res)
+                pr2serr("Unable to synchronize cache\n");
+        }
+    }
+    if (clp->debug)
+        pr2serr("Maximum queued: READs=%d, WRITEs=%d; queue full=%d, "
+                "retries=%d\n", clp->max_rd_inflight, clp->max_wr_inflight,
+                clp->q_full_count, clp->retries);
+
+fini:
+    if (clp->elems) {
+        for (k = 0; k < clp->num_elems; ++k) {
+            if (clp->elems[k].alloc_bp)
+                free(clp->elems[k].alloc_bp);
+        }
+        free(clp->elems);
+    }
+    if (clp->epfd >= 0)
+        close(clp->epfd);
+    if (STDIN_FILENO != clp->infd)
+        close(clp->infd);
+    if ((STDOUT_FILENO != clp->outfd) && (FT_DEV_NULL != clp->out_type))
+        close(clp->outfd);
+    res = exit_status;
+    if ((0 != clp->out_rem_count) && (0 == clp->dry_run)) {
+        pr2serr(">>>> Some error occurred, remaining blocks=%" PRId64 "\n",
+                clp->out_rem_count);
+        if (0 == res)
+            res = SG_LIB_CAT_OTHER;
+    }
+    print_stats("");
+    if (clp->dio_incomplete_count) {
+        int fd;
+        char c;
+
+        pr2serr(">> Direct IO requested but incomplete %d times\n",
+                clp->dio_incomplete_count);
+        if ((fd = open(proc_allow_dio, O_RDONLY)) >= 0) {
+            if (1 == read(fd, &c, 1)) {
+                if ('0' == c)
+                    pr2serr(">>> %s set to '0' but should be set to '1' for "
+                            "direct IO\n", proc_allow_dio);
+            }
+            close(fd);
+        }
+    }
+    if (clp->sum_of_resids)
+        pr2serr(">> Non-zero sum of residual counts=%d\n",
+               clp->sum_of_resids);
+    return (res >= 0) ? res : SG_LIB_CAT_OTHER;
+}
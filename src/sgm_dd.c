@@ -25,7 +25,9 @@
    This version uses memory-mapped transfers (i.e. mmap() call from the user
    space) to speed transfers. If both sides of copy are sg devices
    then only the read side will be mmap-ed, while the write side will
-   use normal IO.
+   use normal IO. With ring=NUM several sg file descriptors (each with its
+   own reserve buffer) are used in rotation so the READ of one chunk
+   overlaps the WRITE of the previous one.
 
    This version is designed for the linux kernel 2.4, 2.6, 3 and 4 series.
 */
@@ -46,6 +48,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -69,7 +72,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "1.63 20190618";
+static const char * version_str = "1.64 20261018";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -106,6 +109,10 @@ static const char * version_str = "1.63 20190618";
 
 #define MIN_RESERVED_SIZE 8192
 
+#define MAX_RING_ELEMS 32
+#define RING_WRITING 1
+#define RING_DONE 2             /* READ failed after stop, nothing to write */
+
 static int sum_of_resids = 0;
 
 static int64_t dd_count = -1;
@@ -270,8 +277,9 @@ usage()
             "               [--help] [--version]\n\n");
     pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [dio=0|1] "
             "[fua=0|1|2|3]\n"
-            "               [sync=0|1] [time=0|1] [verbose=VERB] "
-            "[--dry-run] [--verbose]\n\n"
+            "               [ring=NUM] [sync=0|1] [time=0|1] [verbose=VERB] "
+            "[--dry-run]\n"
+            "               [--verbose]\n\n"
             "  where:\n"
             "    bpt         is blocks_per_transfer (default is 128)\n"
             "    bs          must be device logical block size (default "
@@ -293,6 +301,10 @@ usage()
             "    oflag       comma separated list from: [append,dio,direct,"
             "dpo,dsync,\n"
             "                excl,fua,null]\n"
+            "    ring        number of sg file descriptors per sg side used "
+            "in rotation\n"
+            "                so READs overlap WRITEs (def: 0 -> serial, "
+            "max: %d)\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
@@ -306,7 +318,8 @@ usage()
             "    --verbose|-v    increase verbosity\n"
             "    --version|-V    print version information then exit\n\n"
             "Copy from IFILE to OFILE, similar to dd command\n"
-            "specialized for SCSI devices for which mmap-ed IO attempted\n");
+            "specialized for SCSI devices for which mmap-ed IO attempted\n",
+            MAX_RING_ELEMS);
 }
 
 /* Return of 0 -> success, see sg_ll_read_capacity*() otherwise */
@@ -706,6 +719,444 @@ num_chs_in_str(const char * s, int slen, int ch)
 #define INOUTF_SZ 512
 #define EBUFF_SZ 768
 
+/* With ring=NUM there are NUM sg file descriptors on each sg side, each
+ * with its own reserve buffer. The reserve buffer on the IFILE side (or
+ * the OFILE side when IFILE is not a sg device) is mmap-ed. The elements
+ * are used in rotation with the sg driver's asynchronous interface so the
+ * READ of one chunk can overlap the WRITE of the previous chunk. */
+struct ring_elem {
+    int infd;                   /* -1 if IFILE not sg device */
+    int outfd;                  /* -1 if OFILE not sg device */
+    int state;                  /* RING_WRITING or RING_DONE */
+    int blocks;
+    int retries;
+    int64_t blk_in;
+    int64_t blk_out;
+    uint8_t * mmap_p;           /* mmap-ed reserve buffer */
+    uint8_t cdb[MAX_SCSI_CDBSZ];
+    uint8_t sense[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+};
+
+struct ring_coll {
+    int num;                    /* number of elements in ring */
+    int bpt;
+    int in_type;
+    int out_type;
+    int infd;                   /* IFILE when it is not a sg device */
+    int outfd;                  /* OFILE when it is not a sg device */
+    int cdbsz_in;
+    int cdbsz_out;
+    int mmap_len;
+    int dio_not_done;
+    struct flags_t in_flags;
+    struct flags_t out_flags;
+    struct ring_elem elem[MAX_RING_ELEMS];
+};
+
+/* Open another file descriptor on a sg device, set its reserve buffer to
+ * at least 'res_sz' bytes and mmap() it if 'mmpp' is given. Returns fd or
+ * -1 . */
+static int
+ring_open_sg(const char * fn, const struct flags_t * fp, int res_sz,
+             uint8_t ** mmpp)
+{
+    int fd, t;
+    int flags = O_RDWR | O_NONBLOCK;
+    char ebuff[EBUFF_SZ];
+
+    if (fp->direct)
+        flags |= O_DIRECT;
+    if (fp->dsync)
+        flags |= O_SYNC;
+    if ((fd = open(fn, flags)) < 0) {
+        snprintf(ebuff, EBUFF_SZ, ME "could not open %s for ring", fn);
+        perror(ebuff);
+        return -1;
+    }
+    if ((ioctl(fd, SG_GET_RESERVED_SIZE, &t) < 0) || (res_sz > t)) {
+        if (ioctl(fd, SG_SET_RESERVED_SIZE, &res_sz) < 0) {
+            perror(ME "SG_SET_RESERVED_SIZE error (ring)");
+            close(fd);
+            return -1;
+        }
+    }
+    if (mmpp) {
+        *mmpp = (uint8_t *)mmap(NULL, res_sz, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, fd, 0);
+        if (MAP_FAILED == *mmpp) {
+            *mmpp = NULL;
+            snprintf(ebuff, EBUFF_SZ, ME "error using mmap() on %s (ring)",
+                     fn);
+            perror(ebuff);
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/* Element 0 uses the file descriptors (and mmap-ed buffer) already set up
+ * by main(); elements 1 to num-1 get their own. Returns 0 if ok. */
+static int
+ring_setup(struct ring_coll * rcp, const char * inf, int infd,
+           const char * outf, int outfd, uint8_t * wrkMmap, int in_res_sz,
+           int out_res_sz)
+{
+    bool in_sg = (FT_SG == rcp->in_type);
+    bool out_sg = (FT_SG == rcp->out_type);
+    int k;
+    struct ring_elem * rep;
+
+    rcp->infd = infd;
+    rcp->outfd = outfd;
+    rcp->mmap_len = in_sg ? in_res_sz : out_res_sz;
+    for (k = 0; k < rcp->num; ++k) {
+        rep = rcp->elem + k;
+        rep->infd = -1;
+        rep->outfd = -1;
+    }
+    rep = rcp->elem;
+    rep->infd = in_sg ? infd : -1;
+    rep->outfd = out_sg ? outfd : -1;
+    rep->mmap_p = wrkMmap;
+    for (k = 1; k < rcp->num; ++k) {
+        rep = rcp->elem + k;
+        if (in_sg) {
+            rep->infd = ring_open_sg(inf, &rcp->in_flags, in_res_sz,
+                                     &rep->mmap_p);
+            if (rep->infd < 0)
+                return SG_LIB_FILE_ERROR;
+        }
+        if (out_sg) {
+            rep->outfd = ring_open_sg(outf, &rcp->out_flags, out_res_sz,
+                                      (in_sg ? NULL : &rep->mmap_p));
+            if (rep->outfd < 0)
+                return SG_LIB_FILE_ERROR;
+        }
+    }
+    if (verbose)
+        pr2serr("ring of %d elements, mmap-ed on %s side\n", rcp->num,
+                (in_sg ? "IFILE" : "OFILE"));
+    return 0;
+}
+
+/* Element 0 belongs to main() so leave it alone */
+static void
+ring_free(struct ring_coll * rcp)
+{
+    int k;
+    struct ring_elem * rep;
+
+    for (k = 1; k < rcp->num; ++k) {
+        rep = rcp->elem + k;
+        if (rep->mmap_p)
+            munmap(rep->mmap_p, rcp->mmap_len);
+        if (rep->infd >= 0)
+            close(rep->infd);
+        if (rep->outfd >= 0)
+            close(rep->outfd);
+    }
+}
+
+/* Submit a READ (on infd) or WRITE (on outfd) with the sg v3 asynchronous
+ * interface. A READ always goes to the mmap-ed buffer. A WRITE is mmap-ed
+ * when IFILE is not a sg device, otherwise the data is taken from the
+ * IFILE side's mmap-ed pages (with direct IO if oflag=dio). Returns 0 if
+ * ok, else -1 . */
+static int
+ring_start_io(struct ring_coll * rcp, struct ring_elem * rep, bool wr)
+{
+    bool fua = wr ? rcp->out_flags.fua : rcp->in_flags.fua;
+    bool dpo = wr ? rcp->out_flags.dpo : rcp->in_flags.dpo;
+    int cdbsz = wr ? rcp->cdbsz_out : rcp->cdbsz_in;
+    int k, res;
+    int64_t blk = wr ? rep->blk_out : rep->blk_in;
+    struct sg_io_hdr * hp = &rep->io_hdr;
+
+    if (sg_build_scsi_cdb(rep->cdb, cdbsz, rep->blocks, blk, wr, fua, dpo)) {
+        pr2serr(ME "bad %s cdb build, block=%" PRId64 ", blocks=%d\n",
+                (wr ? "wr" : "rd"), blk, rep->blocks);
+        return -1;
+    }
+    memset(hp, 0, sizeof(struct sg_io_hdr));
+    hp->interface_id = 'S';
+    hp->cmd_len = cdbsz;
+    hp->cmdp = rep->cdb;
+    hp->dxfer_direction = wr ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV;
+    hp->dxfer_len = blk_sz * rep->blocks;
+    hp->mx_sb_len = SENSE_BUFF_LEN;
+    hp->sbp = rep->sense;
+    hp->timeout = DEF_TIMEOUT;
+    hp->pack_id = (int)++glob_pack_id;
+    hp->usr_ptr = rep;
+    if (wr && (FT_SG == rcp->in_type)) {
+        hp->dxferp = rep->mmap_p;
+        if (rcp->out_flags.dio)
+            hp->flags |= SG_FLAG_DIRECT_IO;
+    } else
+        hp->flags |= SG_FLAG_MMAP_IO;
+    if (verbose > 2) {
+        pr2serr("    %s cdb: ", (wr ? "write" : "read"));
+        for (k = 0; k < cdbsz; ++k)
+            pr2serr("%02x ", rep->cdb[k]);
+        pr2serr("\n");
+    }
+    while (((res = write(wr ? rep->outfd : rep->infd, hp,
+                         sizeof(struct sg_io_hdr))) < 0) &&
+           ((EINTR == errno) || (EAGAIN == errno)))
+        ;
+    if (res < 0) {
+        perror(wr ? ME "starting write on sg device, error" :
+                    ME "starting read on sg device, error");
+        return -1;
+    }
+    return 0;
+}
+
+/* Waits for the command started by ring_start_io() to complete. Returns 0
+ * if ok, SG_LIB_CAT_* positive values or -1 . */
+static int
+ring_finish_io(struct ring_coll * rcp, struct ring_elem * rep, bool wr)
+{
+    int fd = wr ? rep->outfd : rep->infd;
+    int res;
+    struct pollfd pfd;
+    struct sg_io_hdr * hp = &rep->io_hdr;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    do {
+        pfd.revents = 0;
+        while (((res = poll(&pfd, 1, -1)) < 0) && (EINTR == errno))
+            ;
+        if (res < 0) {
+            perror(ME "poll() on sg device, error");
+            return -1;
+        }
+        res = read(fd, hp, sizeof(struct sg_io_hdr));
+    } while ((res < 0) && ((EINTR == errno) || (EAGAIN == errno)));
+    if (res < 0) {
+        perror(wr ? ME "finishing write on sg device, error" :
+                    ME "finishing read on sg device, error");
+        return -1;
+    }
+    if (rep != (struct ring_elem *)hp->usr_ptr) {
+        pr2serr(ME "ring: request-response mismatch\n");
+        return -1;
+    }
+    if (verbose > 2)
+        pr2serr("      duration=%u ms\n", hp->duration);
+    res = sg_err_category3(hp);
+    switch (res) {
+    case SG_LIB_CAT_CLEAN:
+        break;
+    case SG_LIB_CAT_RECOVERED:
+        sg_chk_n_print3(wr ? "Writing, continuing" : "Reading, continuing",
+                        hp, verbose > 1);
+        break;
+    case SG_LIB_CAT_NOT_READY:
+    case SG_LIB_CAT_MEDIUM_HARD:
+        return res;
+    default:
+        sg_chk_n_print3(wr ? "writing" : "reading", hp, verbose > 1);
+        return res;
+    }
+    if (! wr)
+        sum_of_resids += hp->resid;
+    else if (rcp->out_flags.dio &&
+             ((hp->info & SG_INFO_DIRECT_IO_MASK) != SG_INFO_DIRECT_IO))
+        ++rcp->dio_not_done;
+    return 0;
+}
+
+/* Like ring_finish_io() but restarts once after a unit attention or
+ * aborted command, as the serial copy loop does. */
+static int
+ring_finish_retry(struct ring_coll * rcp, struct ring_elem * rep, bool wr)
+{
+    int res;
+
+    while (1) {
+        res = ring_finish_io(rcp, rep, wr);
+        if (((SG_LIB_CAT_UNIT_ATTENTION != res) &&
+             (SG_LIB_CAT_ABORTED_COMMAND != res)) || (rep->retries > 0))
+            return res;
+        pr2serr("Unit attention or aborted command, continuing (%s)\n",
+                (wr ? "w" : "r"));
+        ++rep->retries;
+        if (ring_start_io(rcp, rep, wr))
+            return -1;
+    }
+}
+
+/* Copies dd_count blocks starting at 'skip' and 'seek'. Elements are used
+ * in order; those with a WRITE outstanding always precede those with a
+ * READ outstanding. The oldest WRITE is only waited for when the ring is
+ * full (or no READs are outstanding), so the next READs overlap it.
+ * Returns 0 if ok, else an error code; dd_count reflects blocks not yet
+ * copied. */
+static int
+ring_copy(struct ring_coll * rcp, int64_t skip, int64_t seek)
+{
+    bool stop = false;
+    bool in_sg = (FT_SG == rcp->in_type);
+    bool out_sg = (FT_SG == rcp->out_type);
+    int res, want;
+    int ret = 0;
+    int head = 0;               /* oldest element in use */
+    int tail = 0;               /* next element to use */
+    int busy = 0;
+    int rd_pend = 0;
+    int wr_pend = 0;
+    int64_t to_read = dd_count;
+    struct ring_elem * rep;
+    char ebuff[EBUFF_SZ];
+
+    while (1) {
+        while ((! stop) && (to_read > 0) && (busy < rcp->num)) {
+            rep = rcp->elem + tail;
+            rep->blocks = (to_read > rcp->bpt) ? rcp->bpt : (int)to_read;
+            rep->blk_in = skip;
+            rep->blk_out = seek;
+            rep->retries = 0;
+            if (in_sg) {
+                if (ring_start_io(rcp, rep, false)) {
+                    ret = -1;
+                    stop = true;
+                    break;
+                }
+                ++rd_pend;
+            } else {
+                want = rep->blocks * blk_sz;
+                while (((res = read(rcp->infd, rep->mmap_p, want)) < 0) &&
+                       ((EINTR == errno) || (EAGAIN == errno)))
+                    ;
+                if (verbose > 2)
+                    pr2serr("read(unix): count=%d, res=%d\n", want, res);
+                if (res < 0) {
+                    snprintf(ebuff, EBUFF_SZ, ME "reading, skip=%" PRId64
+                             " ", skip);
+                    perror(ebuff);
+                    ret = -1;
+                    stop = true;
+                    break;
+                } else if (res < want) {
+                    rep->blocks = res / blk_sz;
+                    if ((res % blk_sz) > 0) {
+                        ++rep->blocks;
+                        ++in_partial;
+                    }
+                    dd_count -= (to_read - rep->blocks);
+                    to_read = rep->blocks;
+                }
+                in_full += rep->blocks;
+                if (0 == rep->blocks)
+                    break;      /* read nothing so stop reading */
+                rep->state = RING_WRITING;
+                if (ring_start_io(rcp, rep, true)) {
+                    ret = -1;
+                    stop = true;
+                    break;
+                }
+                ++wr_pend;
+            }
+            to_read -= rep->blocks;
+            skip += rep->blocks;
+            seek += rep->blocks;
+            tail = (tail + 1) % rcp->num;
+            ++busy;
+        }
+        if (0 == busy)
+            break;
+        if ((wr_pend > 0) && (stop || (0 == rd_pend) ||
+                              (busy >= rcp->num))) {
+            rep = rcp->elem + head;
+            res = (RING_WRITING == rep->state) ?
+                  ring_finish_retry(rcp, rep, true) : 0;
+            if (0 != res) {
+                pr2serr("sg_write failed, seek=%" PRId64 "\n", rep->blk_out);
+                if (0 == ret)
+                    ret = res;
+                stop = true;
+            } else if (RING_WRITING == rep->state) {
+                out_full += rep->blocks;
+                dd_count -= rep->blocks;
+            }
+            --wr_pend;
+        } else {
+            /* oldest READ follows the outstanding WRITEs */
+            rep = rcp->elem + ((head + wr_pend) % rcp->num);
+            res = ring_finish_retry(rcp, rep, false);
+            --rd_pend;
+            if (0 != res) {
+                pr2serr("sg_read failed, skip=%" PRId64 "\n", rep->blk_in);
+                if (0 == ret)
+                    ret = res;
+                stop = true;
+            }
+            if (stop) {
+                if (wr_pend > 0) {
+                    /* can't free out of order, queue behind the WRITEs */
+                    rep->state = RING_DONE;
+                    ++wr_pend;
+                    continue;
+                }
+            } else {
+                in_full += rep->blocks;
+                if (out_sg) {
+                    rep->retries = 0;
+                    rep->state = RING_WRITING;
+                    if (0 == ring_start_io(rcp, rep, true)) {
+                        ++wr_pend;
+                        continue;
+                    }
+                    ret = -1;
+                    stop = true;
+                    if (wr_pend > 0) {
+                        rep->state = RING_DONE;
+                        ++wr_pend;
+                        continue;
+                    }
+                } else if (FT_DEV_NULL == rcp->out_type) {
+                    out_full += rep->blocks;
+                    dd_count -= rep->blocks;
+                } else {
+                    want = rep->blocks * blk_sz;
+                    while (((res = write(rcp->outfd, rep->mmap_p,
+                                         want)) < 0) &&
+                           ((EINTR == errno) || (EAGAIN == errno)))
+                        ;
+                    if (verbose > 2)
+                        pr2serr("write(unix): count=%d, res=%d\n", want, res);
+                    if (res < 0) {
+                        snprintf(ebuff, EBUFF_SZ, ME "writing, seek=%" PRId64
+                                 " ", rep->blk_out);
+                        perror(ebuff);
+                        ret = -1;
+                        stop = true;
+                    } else if (res < want) {
+                        pr2serr("output file probably full, seek=%" PRId64
+                                " ", rep->blk_out);
+                        out_full += res / blk_sz;
+                        if ((res % blk_sz) > 0)
+                            ++out_partial;
+                        ret = -1;
+                        stop = true;
+                    } else {
+                        out_full += rep->blocks;
+                        dd_count -= rep->blocks;
+                    }
+                }
+            }
+        }
+        head = (head + 1) % rcp->num;
+        --busy;
+    }
+    return ret;
+}
+
+
 int
 main(int argc, char * argv[])
 {
@@ -726,6 +1177,7 @@ main(int argc, char * argv[])
     int out_sect_sz;
     int out_type = FT_OTHER;
     int num_dio_not_done = 0;
+    int ring_num = 0;
     int ret = 0;
     int scsi_cdbsz_in = DEF_SCSI_CDBSZ;
     int scsi_cdbsz_out = DEF_SCSI_CDBSZ;
@@ -746,6 +1198,7 @@ main(int argc, char * argv[])
     char b[80];
     struct flags_t in_flags;
     struct flags_t out_flags;
+    struct ring_coll * rcp = NULL;
 
 #if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
     psz = sysconf(_SC_PAGESIZE); /* POSIX.1 (was getpagesize()) */
@@ -841,6 +1294,13 @@ main(int argc, char * argv[])
                 pr2serr(ME "bad argument to 'obs'\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key,"ring")) {
+            ring_num = sg_get_num(buf);
+            if ((ring_num < 0) || (ring_num > MAX_RING_ELEMS)) {
+                pr2serr(ME "bad argument to 'ring', expect 0 to %d\n",
+                        MAX_RING_ELEMS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
@@ -946,6 +1406,11 @@ main(int argc, char * argv[])
        SG_IO ioctl. So reduce it in that case. */
     if ((blk_sz >= 2048) && (! bpt_given))
         bpt = DEF_BLOCKS_PER_2048TRANSFER;
+    if ((ring_num > 1) && (in_flags.excl || out_flags.excl)) {
+        pr2serr("ring= opens each sg device several times so can't be used "
+                "with the\nexcl flag\n");
+        return SG_LIB_CONTRADICT;
+    }
 
 #ifdef DEBUG
     pr2serr(ME "if=%s skip=%" PRId64 " of=%s seek=%" PRId64 " count=%" PRId64
@@ -1283,6 +1748,32 @@ main(int argc, char * argv[])
         }
     }
 
+    if ((ring_num > 1) && (FT_SG != in_type) && (FT_SG != out_type)) {
+        pr2serr(">>> ring= ignored as neither IFILE nor OFILE is a sg "
+                "device\n");
+        ring_num = 0;
+    }
+    if (ring_num > 1) {
+        rcp = (struct ring_coll *)calloc(1, sizeof(struct ring_coll));
+        if (NULL == rcp) {
+            pr2serr("Not enough user memory for ring\n");
+            ret = sg_convert_errno(ENOMEM);
+            goto fini;
+        }
+        rcp->num = ring_num;
+        rcp->bpt = bpt;
+        rcp->in_type = in_type;
+        rcp->out_type = out_type;
+        rcp->cdbsz_in = scsi_cdbsz_in;
+        rcp->cdbsz_out = scsi_cdbsz_out;
+        rcp->in_flags = in_flags;
+        rcp->out_flags = out_flags;
+        ret = ring_setup(rcp, inf, infd, outf, outfd, wrkMmap, in_res_sz,
+                         out_res_sz);
+        if (ret)
+            goto fini;
+    }
+
     blocks_per = bpt;
 #ifdef DEBUG
     pr2serr("Start of loop, count=%" PRId64 ", blocks_per=%d\n", dd_count,
@@ -1303,6 +1794,11 @@ main(int argc, char * argv[])
         (FT_SG == in_type) && (FT_SG == out_type))
         pr2serr("Since both 'if' and 'of' are sg devices, only do mmap-ed "
                 "transfers on 'if'\n");
+    if (rcp) {
+        ret = ring_copy(rcp, skip, seek);
+        num_dio_not_done += rcp->dio_not_done;
+        goto copy_end;
+    }
 
     while (dd_count > 0) {
         blocks = (dd_count > blocks_per) ? blocks_per : dd_count;
@@ -1408,6 +1904,7 @@ main(int argc, char * argv[])
         seek += blocks;
     }
 
+copy_end:
     if (do_time)
         calc_duration_throughput(false);
     if (do_sync) {
@@ -1426,6 +1923,10 @@ main(int argc, char * argv[])
     }
 
 fini:
+    if (rcp) {
+        ring_free(rcp);
+        free(rcp);
+    }
     if (wrkBuff)
         free(wrkBuff);
     if (STDIN_FILENO != infd)
@@ -46,6 +46,8 @@
 #include <limits.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sched.h>
+#include <dirent.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
 #include <sys/ioctl.h>
@@ -83,7 +85,7 @@
 #include "sg_pr2serr.h"
 
 
-static const char * version_str = "5.73 20190618";
+static const char * version_str = "5.76 20261018";
 
 #define DEF_BLOCK_SIZE 512
 #define DEF_BLOCKS_PER_TRANSFER 128
@@ -102,6 +104,7 @@ static const char * version_str = "5.73 20190618";
 #define SGP_WRITE10 0x2a
 #define DEF_NUM_THREADS 4
 #define MAX_NUM_THREADS 1024  /* was SG_MAX_QUEUE (16) but no longer applies */
+#define MAX_NUMA_NODES 64
 
 #ifndef RAW_MAJOR
 #define RAW_MAJOR 255   /*unlikely value */
@@ -128,6 +131,7 @@ struct flags_t {
     bool dsync;
     bool excl;
     bool fua;
+    bool iovec;         /* pass buffer to sg driver as an iovec */
 };
 
 typedef struct request_collection
@@ -162,6 +166,12 @@ typedef struct request_collection
     pthread_mutex_t aux_mutex;  /* -/ (also serializes some printf()s */
     int debug;
     int dry_run;
+    int num_workers;            /* protected by aux_mutex */
+    int num_aff_cpus;           /* > 0 -> pin worker k to aff_cpus[k % n] */
+    int aff_node;               /* >= 0 -> pin workers to this NUMA node */
+    cpu_set_t aff_node_set;     /* CPUs belonging to aff_node */
+    int node_workers[MAX_NUMA_NODES + 1];       /* last is unknown node */
+    int64_t node_out_blks[MAX_NUMA_NODES + 1];  /* protected by aux_mutex */
 } Rq_coll;
 
 typedef struct request_element
@@ -173,6 +183,8 @@ typedef struct request_element
     int num_blks;
     uint8_t * buffp;
     uint8_t * alloc_bp;
+    struct sg_iov_buf iov_buf;  /* iflag=iovec or oflag=iovec: buffp */
+    sg_iovec_t * iov_arr;       /* iov_buf.num_chunks + 1 elements */
     struct sg_io_hdr io_hdr;
     uint8_t cmd[MAX_SCSI_CDBSZ];
     uint8_t sb[SENSE_BUFF_LEN];
@@ -185,6 +197,7 @@ typedef struct request_element
     struct flags_t out_flags;
     int debug;
     uint32_t pack_id;
+    int64_t out_done_blks;      /* blocks written by this worker */
 } Rq_elem;
 
 static sigset_t signal_set;
@@ -236,6 +249,7 @@ static struct timeval start_tm;
 static int64_t dd_count = -1;
 static int num_threads = DEF_NUM_THREADS;
 static int exit_status = 0;
+static int aff_cpus[CPU_SETSIZE];
 
 static const char * my_name = "sgp_dd: ";
 
@@ -391,10 +405,11 @@ usage()
             "[seek=SEEK] [skip=SKIP]\n"
             "               [--help] [--version]\n\n");
     pr2serr("               [bpt=BPT] [cdbsz=6|10|12|16] [coe=0|1] "
-            "[deb=VERB] [dio=0|1]\n"
-            "               [fua=0|1|2|3] [sync=0|1] [thr=THR] "
-            "[time=0|1] [verbose=VERB]\n"
-            "               [--dry-run] [--verbose]\n"
+            "[cpus=CPU_LIST]\n"
+            "               [deb=VERB] [dio=0|1] [fua=0|1|2|3] "
+            "[node=NODE|hba] [sync=0|1]\n"
+            "               [thr=THR] [time=0|1] [verbose=VERB] "
+            "[--dry-run] [--verbose]\n"
             "  where:\n"
             "    bpt         is blocks_per_transfer (default is 128)\n"
             "    bs          must be device logical block size (default "
@@ -403,6 +418,9 @@ usage()
             "    coe         continue on error, 0->exit (def), "
             "1->zero + continue\n"
             "    count       number of blocks to copy (def: device size)\n"
+            "    cpus        pin worker threads, in turn, to CPUs in "
+            "CPU_LIST (e.g.\n"
+            "                '0-3,8')\n"
             "    deb         for debug, 0->none (def), > 0->varying degrees "
             "of debug\n");
     pr2serr("    dio         is direct IO, 1->attempt, 0->indirect IO (def)\n"
@@ -412,13 +430,17 @@ usage()
             "    if          file or device to read from (def: stdin)\n"
             "    iflag       comma separated list from: [coe,dio,direct,dpo,"
             "dsync,excl,\n"
-            "                fua, null]\n"
+            "                fua,iovec,null]\n"
             "    of          file or device to write to (def: stdout), "
             "OFILE of '.'\n"
             "                treated as /dev/null\n"
             "    oflag       comma separated list from: [append,coe,dio,"
             "direct,dpo,dsync,\n"
-            "                excl,fua,null]\n"
+            "                excl,fua,iovec,null]\n"
+            "    node        pin worker threads to CPUs of NUMA node NODE; "
+            "'hba' for\n"
+            "                the node of the HBA that IFILE (or OFILE) sg "
+            "device is on\n"
             "    seek        block position to start writing to OFILE\n"
             "    skip        block position to start reading from IFILE\n"
             "    sync        0->no sync(def), 1->SYNCHRONIZE CACHE on OFILE "
@@ -524,6 +546,190 @@ read_blkdev_capacity(int sg_fd, int64_t * num_sect, int * sect_sz)
 #endif
 }
 
+/* Parses a CPU list in the format used by sysfs and taskset (e.g.
+ * "0-3,8,10-11"). Places the CPUs found, in ascending order, in 'arr'
+ * (if non-NULL) and sets them in 'csp' (if non-NULL). Returns the number
+ * of CPUs found or -1 if 'lst' is malformed. */
+static int
+parse_cpu_list(const char * lst, int * arr, cpu_set_t * csp)
+{
+    int k, lo, hi, n;
+    int num = 0;
+    cpu_set_t cs;
+    const char * cp = lst;
+    char * ep;
+
+    CPU_ZERO(&cs);
+    while (*cp && ('\n' != *cp)) {
+        lo = (int)strtol(cp, &ep, 10);
+        if ((ep == cp) || (lo < 0) || (lo >= CPU_SETSIZE))
+            return -1;
+        hi = lo;
+        if ('-' == *ep) {
+            cp = ep + 1;
+            hi = (int)strtol(cp, &ep, 10);
+            if ((ep == cp) || (hi < lo) || (hi >= CPU_SETSIZE))
+                return -1;
+        }
+        for (k = lo; k <= hi; ++k)
+            CPU_SET(k, &cs);
+        cp = ep;
+        if (',' == *cp)
+            ++cp;
+        else if (*cp && ('\n' != *cp))
+            return -1;
+    }
+    n = CPU_COUNT(&cs);
+    if (arr) {
+        for (k = 0; (k < CPU_SETSIZE) && (num < n); ++k) {
+            if (CPU_ISSET(k, &cs))
+                arr[num++] = k;
+        }
+    }
+    if (csp)
+        memcpy(csp, &cs, sizeof(cs));
+    return n;
+}
+
+/* Reads the CPUs belonging to NUMA 'node' from sysfs into 'csp'. Returns
+ * the number of CPUs or -1 if that node is not found. */
+static int
+numa_node_cpus(int node, cpu_set_t * csp)
+{
+    FILE * fp;
+    char b[1024];
+    char fn[128];
+
+    snprintf(fn, sizeof(fn), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    if (NULL == (fp = fopen(fn, "r")))
+        return -1;
+    if (NULL == fgets(b, sizeof(b), fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    return parse_cpu_list(b, NULL, csp);
+}
+
+/* Returns the NUMA node that 'cpu' belongs to, or -1 if unknown. Each
+ * /sys/devices/system/cpu/cpu<n> directory holds a node<m> link. */
+static int
+cpu_numa_node(int cpu)
+{
+    int node = -1;
+    DIR * dp;
+    struct dirent * dep;
+    char dn[128];
+
+    if (cpu < 0)
+        return -1;
+    snprintf(dn, sizeof(dn), "/sys/devices/system/cpu/cpu%d", cpu);
+    if (NULL == (dp = opendir(dn)))
+        return -1;
+    while ((dep = readdir(dp))) {
+        if ((0 == strncmp(dep->d_name, "node", 4)) &&
+            (1 == sscanf(dep->d_name + 4, "%d", &node)))
+            break;
+        node = -1;
+    }
+    closedir(dp);
+    return node;
+}
+
+/* Finds the NUMA node of the HBA that the sg device open on 'fd' is
+ * attached to. Starts at the device's sysfs directory and walks toward
+ * the root until an ancestor (typically the PCI function of the HBA) has
+ * a numa_node attribute that is not -1. Returns -1 if not found. */
+static int
+sg_dev_numa_node(int fd)
+{
+    int node = -1;
+    char * cp;
+    FILE * fp;
+    struct stat st;
+    char path[PATH_MAX];
+    char b[PATH_MAX + 16];
+
+    if ((fstat(fd, &st) < 0) || (! S_ISCHR(st.st_mode)))
+        return -1;
+    snprintf(b, sizeof(b), "/sys/dev/char/%u:%u/device",
+             major(st.st_rdev), minor(st.st_rdev));
+    if (NULL == realpath(b, path))
+        return -1;
+    while ((cp = strrchr(path, '/')) && (cp > path)) {
+        snprintf(b, sizeof(b), "%s/numa_node", path);
+        if ((fp = fopen(b, "r"))) {
+            if (1 != fscanf(fp, "%d", &node))
+                node = -1;
+            fclose(fp);
+            if (node >= 0)
+                break;
+        }
+        *cp = '\0';     /* up to parent directory */
+    }
+    return node;
+}
+
+/* Called by each worker thread before it allocates its buffer. If the
+ * user asked for it, pins the calling thread to a CPU or a NUMA node so
+ * that sg_memalign()'s zeroing places the buffer in node local memory.
+ * Returns the NUMA node the thread is running on, or -1 if unknown. */
+static int
+worker_set_affinity(Rq_coll * clp, int idx)
+{
+    int status;
+    cpu_set_t cs;
+
+    if (clp->num_aff_cpus > 0) {
+        CPU_ZERO(&cs);
+        CPU_SET(aff_cpus[idx % clp->num_aff_cpus], &cs);
+    } else if (clp->aff_node >= 0)
+        memcpy(&cs, &clp->aff_node_set, sizeof(cs));
+    else
+        return cpu_numa_node(sched_getcpu());
+    /* pid of 0 is the calling thread */
+    if (sched_setaffinity(0, sizeof(cs), &cs) < 0) {
+        char strerr_buff[STRERR_BUFF_LEN];
+
+        status = pthread_mutex_lock(&clp->aux_mutex);
+        if (0 != status) err_exit(status, "lock aux_mutex");
+        pr2serr("%sworker %d: sched_setaffinity: %s\n", my_name, idx,
+                tsafe_strerror(errno, strerr_buff));
+        status = pthread_mutex_unlock(&clp->aux_mutex);
+        if (0 != status) err_exit(status, "unlock aux_mutex");
+    }
+    return cpu_numa_node(sched_getcpu());
+}
+
+static void
+print_numa_stats(Rq_coll * clp)
+{
+    int k;
+    struct timeval end_tm;
+    double a, b;
+
+    gettimeofday(&end_tm, NULL);
+    a = (end_tm.tv_sec - start_tm.tv_sec) +
+        (0.000001 * (end_tm.tv_usec - start_tm.tv_usec));
+    for (k = 0; k <= MAX_NUMA_NODES; ++k) {
+        if (0 == clp->node_workers[k])
+            continue;
+        if (k < MAX_NUMA_NODES)
+            pr2serr("  NUMA node %d: ", k);
+        else
+            pr2serr("  NUMA node unknown: ");
+        b = (double)clp->bs * clp->node_out_blks[k];
+        pr2serr("%d worker%s, %" PRId64 " blocks out", clp->node_workers[k],
+                ((1 == clp->node_workers[k]) ? "" : "s"),
+                clp->node_out_blks[k]);
+        if ((a > 0.00001) && (b > 511))
+            pr2serr(", %.2f MB/sec\n", b / (a * 1000000.0));
+        else
+            pr2serr("\n");
+    }
+}
+
 static void *
 sig_listen_thread(void * v_clp)
 {
@@ -576,13 +782,33 @@ read_write_thread(void * v_clp)
     int sz;
     volatile bool stop_after_write = false;
     int64_t seek_skip;
-    int blocks, status;
+    int blocks, status, idx, node;
 
     clp = (Rq_coll *)v_clp;
     sz = clp->bpt * clp->bs;
     seek_skip =  clp->seek - clp->skip;
     memset(rep, 0, sizeof(Rq_elem));
-    rep->buffp = sg_memalign(sz, 0 /* page align */, &rep->alloc_bp, false);
+    status = pthread_mutex_lock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "lock aux_mutex");
+    idx = clp->num_workers++;
+    status = pthread_mutex_unlock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "unlock aux_mutex");
+    node = worker_set_affinity(clp, idx);
+    if ((node < 0) || (node >= MAX_NUMA_NODES))
+        node = MAX_NUMA_NODES;
+    /* sg_memalign() zeros the buffer so its pages are placed now, as
+     * does sg_iov_buf_alloc() which also handles SG3_UTILS_HUGEPAGES */
+    if (clp->in_flags.iovec || clp->out_flags.iovec ||
+        (SG_LIB_HP_NONE != sg_get_hugepage_mode())) {
+        rep->buffp = sg_iov_buf_alloc(&rep->iov_buf, sz, 0,
+                                      (0 == idx) && (clp->debug > 0));
+        rep->iov_arr = (sg_iovec_t *)calloc(rep->iov_buf.num_chunks + 1,
+                                            sizeof(sg_iovec_t));
+        if (NULL == rep->iov_arr)
+            rep->buffp = NULL;
+    } else
+        rep->buffp = sg_memalign(sz, 0 /* page align */, &rep->alloc_bp,
+                                 false);
     if (NULL == rep->buffp)
         err_exit(ENOMEM, "out of memory creating user buffers\n");
 
@@ -663,6 +889,7 @@ read_write_thread(void * v_clp)
         else if (FT_DEV_NULL == clp->out_type) {
             /* skip actual write operation */
             clp->out_rem_count -= blocks;
+            rep->out_done_blks += blocks;
             status = pthread_mutex_unlock(&clp->out_mutex);
             if (0 != status) err_exit(status, "unlock out_mutex");
         }
@@ -679,6 +906,14 @@ read_write_thread(void * v_clp)
     } /* end of while loop */
     if (rep->alloc_bp)
         free(rep->alloc_bp);
+    sg_iov_buf_free(&rep->iov_buf);
+    free(rep->iov_arr);
+    status = pthread_mutex_lock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "lock aux_mutex");
+    ++clp->node_workers[node];
+    clp->node_out_blks[node] += rep->out_done_blks;
+    status = pthread_mutex_unlock(&clp->aux_mutex);
+    if (0 != status) err_exit(status, "unlock aux_mutex");
     status = pthread_mutex_lock(&clp->in_mutex);
     if (0 != status) err_exit(status, "lock in_mutex");
     if (! clp->in_stop)
@@ -770,6 +1005,7 @@ normal_out_operation(Rq_coll * clp, Rq_elem * rep, int blocks)
         rep->num_blks = blocks;
     }
     clp->out_rem_count -= blocks;
+    rep->out_done_blks += blocks;
 }
 
 static int
@@ -979,6 +1215,7 @@ sg_out_operation(Rq_coll * clp, Rq_elem * rep)
             status = pthread_mutex_lock(&clp->out_mutex);
             if (0 != status) err_exit(status, "lock out_mutex");
             clp->out_rem_count -= rep->num_blks;
+            rep->out_done_blks += rep->num_blks;
             status = pthread_mutex_unlock(&clp->out_mutex);
             if (0 != status) err_exit(status, "unlock out_mutex");
             return;
@@ -999,8 +1236,9 @@ sg_start_io(Rq_elem * rep)
     bool fua = rep->wr ? rep->out_flags.fua : rep->in_flags.fua;
     bool dpo = rep->wr ? rep->out_flags.dpo : rep->in_flags.dpo;
     bool dio = rep->wr ? rep->out_flags.dio : rep->in_flags.dio;
+    bool iovec = rep->wr ? rep->out_flags.iovec : rep->in_flags.iovec;
     int cdbsz = rep->wr ? rep->cdbsz_out : rep->cdbsz_in;
-    int res;
+    int res, n;
 
     if (sg_build_scsi_cdb(rep->cmd, cdbsz, rep->num_blks, rep->blk,
                           rep->wr, fua, dpo)) {
@@ -1023,6 +1261,15 @@ sg_start_io(Rq_elem * rep)
     hp->pack_id = (int)rep->pack_id;
     if (dio)
         hp->flags |= SG_FLAG_DIRECT_IO;
+    if (iovec) {
+        /* the sg driver gathers (or scatters) the chunks of the buffer */
+        n = sg_iov_buf_segs(&rep->iov_buf, rep->buffp, hp->dxfer_len,
+                            rep->iov_arr, rep->iov_buf.num_chunks + 1);
+        if (n > 0) {
+            hp->iovec_count = n;
+            hp->dxferp = rep->iov_arr;
+        }
+    }
     if (rep->debug > 8) {
         pr2serr("sg_start_io: SCSI %s, blk=%" PRId64 " num_blks=%d\n",
                rep->wr ? "WRITE" : "READ", rep->blk, rep->num_blks);
@@ -1171,6 +1418,8 @@ process_flags(const char * arg, struct flags_t * fp)
             fp->excl = true;
         else if (0 == strcmp(cp, "fua"))
             fp->fua = true;
+        else if (0 == strcmp(cp, "iovec"))
+            fp->iovec = true;
         else if (0 == strcmp(cp, "null"))
             ;
         else {
@@ -1205,6 +1454,7 @@ main(int argc, char * argv[])
 {
     bool verbose_given = false;
     bool version_given = false;
+    bool node_hba = false;
     int64_t skip = 0;
     int64_t seek = 0;
     int ibs = 0;
@@ -1238,6 +1488,7 @@ main(int argc, char * argv[])
     clp->out_type = FT_OTHER;
     clp->cdbsz_in = DEF_SCSI_CDBSZ;
     clp->cdbsz_out = DEF_SCSI_CDBSZ;
+    clp->aff_node = -1;
     inf[0] = '\0';
     outf[0] = '\0';
 
@@ -1273,6 +1524,12 @@ main(int argc, char * argv[])
         } else if (0 == strcmp(key,"coe")) {
             clp->in_flags.coe = !! sg_get_num(buf);
             clp->out_flags.coe = clp->in_flags.coe;
+        } else if (0 == strcmp(key,"cpus")) {
+            clp->num_aff_cpus = parse_cpu_list(buf, aff_cpus, NULL);
+            if (clp->num_aff_cpus < 1) {
+                pr2serr("%sbad argument to 'cpus='\n", my_name);
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key,"count")) {
             if (0 != strcmp("-1", buf)) {
                 dd_count = sg_get_llnum(buf);
@@ -1331,6 +1588,18 @@ main(int argc, char * argv[])
                 pr2serr("%sbad argument to 'oflag='\n", my_name);
                 return SG_LIB_SYNTAX_ERROR;
             }
+        } else if (0 == strcmp(key,"node")) {
+            if (0 == strcmp(buf, "hba"))
+                node_hba = true;
+            else {
+                clp->aff_node = sg_get_num(buf);
+                if ((clp->aff_node < 0) ||
+                    (clp->aff_node >= MAX_NUMA_NODES)) {
+                    pr2serr("%sbad argument to 'node=', expect 'hba' or "
+                            "0 to %d\n", my_name, MAX_NUMA_NODES - 1);
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+            }
         } else if (0 == strcmp(key,"seek")) {
             seek = sg_get_llnum(buf);
             if (-1LL == seek) {
@@ -1432,6 +1701,12 @@ main(int argc, char * argv[])
         pr2serr("Can't use both append and seek switches\n");
         return SG_LIB_SYNTAX_ERROR;
     }
+    if ((clp->in_flags.iovec && clp->in_flags.dio) ||
+        (clp->out_flags.iovec && clp->out_flags.dio)) {
+        pr2serr("Can't use both iovec and dio, the sg driver does not do "
+                "direct IO on iovecs\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
     if (clp->bpt < 1) {
         pr2serr("bpt must be greater than 0\n");
         return SG_LIB_SYNTAX_ERROR;
@@ -1446,6 +1721,10 @@ main(int argc, char * argv[])
         usage();
         return SG_LIB_SYNTAX_ERROR;
     }
+    if ((clp->num_aff_cpus > 0) && (node_hba || (clp->aff_node >= 0))) {
+        pr2serr("Can't use both cpus= and node=\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
     if (clp->debug)
         pr2serr("%sif=%s skip=%" PRId64 " of=%s seek=%" PRId64 " count=%"
                 PRId64 "\n", my_name, inf, skip, outf, seek, dd_count);
@@ -1592,6 +1871,25 @@ main(int argc, char * argv[])
         pr2serr("For more information use '--help'\n");
         return SG_LIB_SYNTAX_ERROR;
     }
+    if (node_hba) {
+        if (FT_SG == clp->in_type)
+            clp->aff_node = sg_dev_numa_node(clp->infd);
+        if ((clp->aff_node < 0) && (FT_SG == clp->out_type))
+            clp->aff_node = sg_dev_numa_node(clp->outfd);
+        if ((clp->aff_node < 0) || (clp->aff_node >= MAX_NUMA_NODES)) {
+            pr2serr("%sunable to find NUMA node of HBA, 'node=hba' "
+                    "ignored\n", my_name);
+            clp->aff_node = -1;
+        } else if (clp->debug)
+            pr2serr("%sHBA is on NUMA node %d\n", my_name, clp->aff_node);
+    }
+    if (clp->aff_node >= 0) {
+        if (numa_node_cpus(clp->aff_node, &clp->aff_node_set) < 1) {
+            pr2serr("%sunable to find CPUs of NUMA node %d\n", my_name,
+                    clp->aff_node);
+            return SG_LIB_FILE_ERROR;
+        }
+    }
     if (dd_count < 0) {
         in_num_sect = -1;
         if (FT_SG == clp->in_type) {
@@ -1762,8 +2060,11 @@ main(int argc, char * argv[])
         }
     }   /* started worker threads and here after they have all exited */
 
-    if (do_time && (start_tm.tv_sec || start_tm.tv_usec))
+    if (do_time && (start_tm.tv_sec || start_tm.tv_usec)) {
         calc_duration_throughput(0);
+        if ((clp->num_aff_cpus > 0) || (clp->aff_node >= 0) || clp->debug)
+            print_numa_stats(clp);
+    }
 
     if (do_sync) {
         if (FT_SG == clp->out_type) {
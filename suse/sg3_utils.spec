@@ -108,6 +108,7 @@ install -m 755 scripts/rescan-scsi-bus.sh $RPM_BUILD_ROOT%{_bindir}
 %_bindir/scsi_*
 %_bindir/sginfo
 %_bindir/sgp_dd
+%_bindir/sge_dd
 %_bindir/sgm_dd
 %_bindir/scsi_logging_level
 %_bindir/rescan-scsi-bus.sh
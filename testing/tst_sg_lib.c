@@ -44,7 +44,7 @@
  * related to snprintf().
  */
 
-static const char * version_str = "1.13 20190108";
+static const char * version_str = "1.14 20261018";
 
 
 #define MAX_LINE_LEN 1024
@@ -55,6 +55,7 @@ static struct option long_options[] = {
         {"exit", no_argument, 0, 'e'},
         {"help", no_argument, 0, 'h'},
         {"hex2",  no_argument, 0, 'H'},
+        {"hexdump",  required_argument, 0, 'x'},
         {"leadin",  required_argument, 0, 'l'},
         {"num",  required_argument, 0, 'n'},
         {"printf", no_argument, 0, 'p'},
@@ -158,10 +159,11 @@ static void
 usage()
 {
     fprintf(stderr,
-            "Usage: tst_sg_lib [--exit] [--help] [--hex2] [--leadin=STR] "
-            "[--printf]\n"
-            "                  [--sense] [--unaligned] [--verbose] "
-            "[--version]\n"
+            "Usage: tst_sg_lib [--exit] [--help] [--hex2] [--hexdump=LEN] "
+            "[--leadin=STR]\n"
+            "                  [--printf] [--sense] [--unaligned] "
+            "[--verbose]\n"
+            "                  [--version]\n"
             "  where:\n"
 #if defined(__GNUC__) && ! defined(SG_LIB_FREEBSD)
             "    --byteswap=B|-b B    B is 16, 32 or 64; tests NUM "
@@ -174,6 +176,12 @@ usage()
 #endif
             "    --help|-h          print out usage message\n"
             "    --hex2|-H          test hex2* variants\n"
+            "    --hexdump=LEN|-x LEN    time NUM hex2str() and "
+            "hex2stdout() calls\n"
+            "                            each on LEN bytes, for each "
+            "format; best\n"
+            "                            with stdout redirected to "
+            "/dev/null\n"
             "    --leadin=STR|-l STR    every line output by --sense "
             "should\n"
             "                           be prefixed by STR\n"
@@ -210,6 +218,72 @@ get_exit_status_str(int exit_status, bool longer, int b_len, char * b)
 
 static uint8_t arr[64];
 
+/* Returns elapsed time, in microseconds, since 'start_tmp' */
+static uint64_t
+elapsed_usecs(const struct timespec * start_tmp)
+{
+    int64_t usecs;
+    struct timespec end_tm;
+
+    if (0 != clock_gettime(CLOCK_MONOTONIC, &end_tm))
+        return 0;
+    usecs = (int64_t)(end_tm.tv_sec - start_tmp->tv_sec) * 1000000;
+    usecs += (end_tm.tv_nsec - start_tmp->tv_nsec) / 1000;
+    return (usecs > 0) ? (uint64_t)usecs : 0;
+}
+
+/* Times 'num' calls of hex2str() (both formats) and hex2stdout() (all
+ * three no_ascii settings) on 'len' bytes. Timings go to stderr so that
+ * stdout can be sent to /dev/null. Returns 0 on success. */
+static int
+hexdump_bench(int len, int num)
+{
+    int j, k, b_len;
+    uint64_t usecs, tot_bytes;
+    uint8_t * inp;
+    char * outp;
+    struct timespec start_tm;
+    static const int hex2stdout_modes[] = {0, 1, -1};
+
+    inp = (uint8_t *)malloc(len);
+    /* hex2str() with ASCII is at most 70 chars per 16 bytes, plus leadin */
+    b_len = ((len + 15) / 16) * (80 + (leadin ? (int)strlen(leadin) : 0)) +
+            1;
+    outp = (char *)malloc(b_len);
+    if ((NULL == inp) || (NULL == outp)) {
+        fprintf(stderr, "%s: out of memory\n", __func__);
+        free(inp);
+        free(outp);
+        return 1;
+    }
+    for (k = 0; k < len; ++k)
+        inp[k] = (uint8_t)((k * 37) + (k >> 8));
+    tot_bytes = (uint64_t)len * num;
+    fprintf(stderr, "hexdump timing: %d bytes, %d iterations\n", len, num);
+    for (j = 0; j < 2; ++j) {
+        clock_gettime(CLOCK_MONOTONIC, &start_tm);
+        for (k = 0; k < num; ++k)
+            hex2str(inp, len, leadin, j, b_len, outp);
+        usecs = elapsed_usecs(&start_tm);
+        fprintf(stderr, "  hex2str(format=%d): %" PRIu64 " usecs, %.1f "
+                "MB/sec\n", j, usecs,
+                usecs ? ((double)tot_bytes / usecs) : 0.0);
+    }
+    for (j = 0; j < 3; ++j) {
+        clock_gettime(CLOCK_MONOTONIC, &start_tm);
+        for (k = 0; k < num; ++k)
+            hex2stdout(inp, len, hex2stdout_modes[j]);
+        fflush(stdout);
+        usecs = elapsed_usecs(&start_tm);
+        fprintf(stderr, "  hex2stdout(no_ascii=%d): %" PRIu64 " usecs, "
+                "%.1f MB/sec\n", hex2stdout_modes[j], usecs,
+                usecs ? ((double)tot_bytes / usecs) : 0.0);
+    }
+    free(inp);
+    free(outp);
+    return 0;
+}
+
 #define OFF 7   /* in byteswap mode, can test different alignments (def: 8) */
 
 int
@@ -220,6 +294,7 @@ main(int argc, char * argv[])
     int k, c, n, len;
     int byteswap_sz = 0;
     int do_hex2 = 0;
+    int hexdump_len = 0;
     int do_num = 1;
     int do_printf = 0;
     int do_sense = 0;
@@ -234,7 +309,7 @@ main(int argc, char * argv[])
     while (1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "b:ehHl:n:psuvV", long_options,
+        c = getopt_long(argc, argv, "b:ehHl:n:psuvVx:", long_options,
                         &option_index);
         if (c == -1)
             break;
@@ -283,6 +358,13 @@ main(int argc, char * argv[])
         case 'V':
             fprintf(stderr, "version: %s\n", version_str);
             return 0;
+        case 'x':
+            hexdump_len = sg_get_num(optarg);
+            if (hexdump_len < 1) {
+                fprintf(stderr, "--hexdump= requires a positive length\n");
+                return 1;
+            }
+            break;
         default:
             fprintf(stderr, "unrecognised switch code 0x%x ??\n", c);
             usage();
@@ -471,6 +553,11 @@ main(int argc, char * argv[])
             printf("\n");
         }
     }
+    if (hexdump_len > 0) {
+        ++did_something;
+        if (hexdump_bench(hexdump_len, do_num))
+            return 1;
+    }
     if (do_unaligned) {
         uint16_t u16 = 0x55aa;
         uint16_t u16r;
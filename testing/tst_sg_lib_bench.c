@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the BSD_LICENSE file.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <ctype.h>
+#include <errno.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sg_lib.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+/*
+ * A utility program to time frequently called functions in sg_lib and
+ * the inline functions in sg_unaligned.h . The sense data and VPD page
+ * corpora are taken from the examples and inhex directories; more can be
+ * added with --inhex=FN . Output is one line per benchmark, suitable for
+ * comparing runs (e.g. before and after a library change) with diff or
+ * join.
+ */
+
+static const char * version_str = "1.00 20261018";
+
+#define MAX_INHEX_FILES 16
+#define MAX_CORPUS_ELEMS 64
+#define DEF_NUM 200000
+#define DEF_REPEAT 5
+#define OUT_BUFF_LEN 4096
+
+
+static struct option long_options[] = {
+        {"filter", required_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {"inhex", required_argument, 0, 'i'},
+        {"list", no_argument, 0, 'l'},
+        {"num", required_argument, 0, 'n'},
+        {"repeat", required_argument, 0, 'r'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        {0, 0, 0, 0},   /* sentinel */
+};
+
+struct corpus_elem {
+    const uint8_t * bp;
+    int len;
+};
+
+struct corpus_t {
+    int num;
+    struct corpus_elem e[MAX_CORPUS_ELEMS];
+};
+
+/* examples/forwarded_sense.txt */
+static const uint8_t forwarded_sense[] = {
+    0x72, 0x6, 0x18, 0x7, 0x0, 0x0, 0x0, 0x1c,
+    0xc, 0xa, 0x1, 0x2, 0x72, 0x6, 0x18, 0x7, 0x0, 0x0, 0x0, 0x0,
+    0x0, 0xa, 0x80, 0x0, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+    0x3, 0x2, 0x0, 0x99,
+};
+
+/* examples/ref_sense.txt (user data segment referral) */
+static const uint8_t ref_sense[] = {
+    0x72, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x38,
+    0xb, 0x36, 0x1, 0x0,
+    0x0, 0x0, 0x0, 0x2, 0x11, 0x11, 0x11, 0x11, 0x22, 0x22, 0x22, 0x22,
+    0x55, 0x55, 0x55, 0x55, 0x66, 0x66, 0x66, 0x66,
+    0x1, 0x0, 0x0, 0x7, 0x2, 0x0, 0x0, 0x8,
+    0x0, 0x0, 0x0, 0x1, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77,
+    0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+    0x3, 0x0, 0x0, 0x5,
+};
+
+/* medium error, unrecovered read error, with LBA in information field */
+static const uint8_t medium_desc_sense[] = {
+    0x72, 0x3, 0x11, 0x0, 0x0, 0x0, 0x0, 0x14,
+    0x0, 0xa, 0x80, 0x0, 0x0, 0x0, 0x0, 0x0, 0x12, 0x34, 0x56, 0x78,
+    0x2, 0x6, 0x0, 0x0, 0x80, 0x0, 0x3, 0x0,
+};
+
+/* examples/sg_unmap_example.txt: invalid command operation code */
+static const uint8_t inv_op_fixed_sense[] = {
+    0x70, 0x0, 0x5, 0x0, 0x0, 0x0, 0x0, 0xa,
+    0x0, 0x0, 0x0, 0x0, 0x20, 0x0, 0x0, 0x0, 0x0, 0x0,
+};
+
+/* examples/sg_compare_and_write.txt: miscompare during verify */
+static const uint8_t miscompare_fixed_sense[] = {
+    0xf0, 0x0, 0xe, 0x0, 0x0, 0x0, 0x64, 0xa,
+    0x0, 0x0, 0x0, 0x0, 0x1d, 0x0, 0x0, 0x0, 0x0, 0x0,
+};
+
+/* unit attention: power on, reset or bus device reset */
+static const uint8_t ua_fixed_sense[] = {
+    0x70, 0x0, 0x6, 0x0, 0x0, 0x0, 0x0, 0xa,
+    0x0, 0x0, 0x0, 0x0, 0x29, 0x0, 0x0, 0x0, 0x0, 0x0,
+};
+
+/* not ready, format in progress with progress indication */
+static const uint8_t not_ready_fixed_sense[] = {
+    0x70, 0x0, 0x2, 0x0, 0x0, 0x0, 0x0, 0xa,
+    0x0, 0x0, 0x0, 0x0, 0x4, 0x4, 0x0, 0x80, 0x40, 0x0,
+};
+
+/* illegal request, invalid field in cdb, sense key specific: byte 2 */
+static const uint8_t inv_fld_fixed_sense[] = {
+    0x70, 0x0, 0x5, 0x0, 0x0, 0x0, 0x0, 0xa,
+    0x0, 0x0, 0x0, 0x0, 0x24, 0x0, 0x0, 0xc8, 0x0, 0x2,
+};
+
+/* inhex/vpd_dev_id.hex */
+static const uint8_t vpd_dev_id[] = {
+    0x00, 0x83, 0x00, 0x48, 0x01, 0x03, 0x00, 0x08,
+    0x50, 0x00, 0xc5, 0x00, 0x30, 0x11, 0xcb, 0x2b,
+    0x61, 0x93, 0x00, 0x08, 0x50, 0x00, 0xc5, 0x00,
+    0x30, 0x11, 0xcb, 0x29, 0x61, 0x94, 0x00, 0x04,
+    0x00, 0x00, 0x00, 0x01, 0x61, 0xa3, 0x00, 0x08,
+    0x50, 0x00, 0xc5, 0x00, 0x30, 0x11, 0xcb, 0x28,
+    0x03, 0x28, 0x00, 0x18, 0x6e, 0x61, 0x61, 0x2e,
+    0x35, 0x30, 0x30, 0x30, 0x43, 0x35, 0x30, 0x30,
+    0x33, 0x30, 0x31, 0x31, 0x43, 0x42, 0x32, 0x38,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+/* Common opcodes (and service actions) in a disk's command stream */
+static const int opcode_sa_arr[][2] = {
+    {0x28, 0}, {0x2a, 0}, {0x88, 0}, {0x8a, 0}, {0x0, 0}, {0x12, 0},
+    {0x25, 0}, {0x9e, 0x10}, {0xa0, 0}, {0x35, 0}, {0x91, 0}, {0x42, 0},
+    {0x4d, 0}, {0x1a, 0}, {0x5a, 0}, {0x3, 0}, {0xa3, 0xc}, {0xa3, 0xa},
+    {0x95, 0x0}, {0x94, 0x4}, {0x93, 0}, {0x89, 0}, {0x7f, 0x9},
+    {0x5e, 0x0}, {0x5f, 0x1}, {0x3b, 0x2}, {0x3c, 0x3}, {0x83, 0x10},
+    {0x84, 0x3}, {0x1c, 0}, {0x1d, 0}, {0xc0, 0},   /* last is vendor */
+};
+
+/* Numbers as they appear on command lines, with multiplier suffixes */
+static const char * llnum_arr[] = {
+    "0", "1", "512", "4096", "0x1fffff", "1k", "4m", "2g", "3+1k", "64KiB",
+    "1234567890", "ffh", "0x7fffffffffffffff", "100KB", "2t", "9999999",
+};
+
+static const char * filter_str;
+static int verbose;
+static struct corpus_t fixed_corp;      /* fixed format sense data */
+static struct corpus_t desc_corp;       /* descriptor format sense data */
+static struct corpus_t desig_corp;      /* designation descriptors */
+static struct corpus_t hex_corp;        /* all of the above, plus others */
+static char out_b[OUT_BUFF_LEN];
+static volatile uint64_t sink;  /* stop compiler removing timed code */
+static uint8_t ua_arr[64 + 8];
+
+
+static void
+usage()
+{
+    fprintf(stderr,
+            "Usage: tst_sg_lib_bench [--filter=STR] [--help] [--inhex=FN] "
+            "[--list]\n"
+            "                        [--num=NUM] [--repeat=R] [--verbose] "
+            "[--version]\n"
+            "  where:\n"
+            "    --filter=STR|-f STR    only run benchmarks whose name "
+            "contains STR\n"
+            "    --help|-h         print out usage message\n"
+            "    --inhex=FN|-i FN    add contents of FN (ASCII hex) to "
+            "a corpus;\n"
+            "                        sense data (response code 0x70 to "
+            "0x73) or a\n"
+            "                        Device Identification VPD page; may "
+            "be given\n"
+            "                        up to %d times\n"
+            "    --list|-l         list benchmark names then exit\n"
+            "    --num=NUM|-n NUM    operations per timed run (def: %d); "
+            "scaled up\n"
+            "                        for the unaligned accessors\n"
+            "    --repeat=R|-r R    timed runs per benchmark (def: %d), "
+            "minimum and\n"
+            "                       median are reported\n"
+            "    --verbose|-v      increase verbosity (e.g. show decoded "
+            "corpus)\n"
+            "    --version|-V      print version string then exit\n\n"
+            "Times sg_lib functions that decode sense data, ASC/ASCQ "
+            "pairs, opcodes\nand designation descriptors, plus "
+            "dStrHexStr(), sg_get_llnum() and the\nsg_unaligned.h "
+            "accessors. Each output line is: name, minimum ns/op,\n"
+            "median ns/op and operations per run. Lines starting with '#' "
+            "are comments.\n", MAX_INHEX_FILES, DEF_NUM, DEF_REPEAT);
+}
+
+static void
+corpus_add(struct corpus_t * cp, const uint8_t * bp, int len)
+{
+    if (cp->num < MAX_CORPUS_ELEMS) {
+        cp->e[cp->num].bp = bp;
+        cp->e[cp->num].len = len;
+        ++cp->num;
+    } else if (verbose)
+        pr2serr("corpus full, ignoring element of %d bytes\n", len);
+}
+
+static void
+add_sense(const uint8_t * bp, int len)
+{
+    if ((len < 8) || (0x70 != (0x7c & bp[0])))
+        return;
+    if (0x72 == (0x7e & bp[0]))
+        corpus_add(&desc_corp, bp, len);
+    else
+        corpus_add(&fixed_corp, bp, len);
+    corpus_add(&hex_corp, bp, len);
+}
+
+/* Each designation descriptor in a Device Identification VPD page becomes
+ * a corpus element */
+static void
+add_vpd_dev_id(const uint8_t * bp, int len)
+{
+    int off, dlen;
+    int pg_len = sg_get_unaligned_be16(bp + 2) + 4;
+
+    if (pg_len > len)
+        pg_len = len;
+    corpus_add(&hex_corp, bp, pg_len);
+    for (off = 4; (off + 4) <= pg_len; off += dlen) {
+        dlen = bp[off + 3] + 4;
+        if ((off + dlen) > pg_len)
+            break;
+        corpus_add(&desig_corp, bp + off, dlen);
+    }
+}
+
+static void
+build_corpora()
+{
+    add_sense(forwarded_sense, sizeof(forwarded_sense));
+    add_sense(ref_sense, sizeof(ref_sense));
+    add_sense(medium_desc_sense, sizeof(medium_desc_sense));
+    add_sense(inv_op_fixed_sense, sizeof(inv_op_fixed_sense));
+    add_sense(miscompare_fixed_sense, sizeof(miscompare_fixed_sense));
+    add_sense(ua_fixed_sense, sizeof(ua_fixed_sense));
+    add_sense(not_ready_fixed_sense, sizeof(not_ready_fixed_sense));
+    add_sense(inv_fld_fixed_sense, sizeof(inv_fld_fixed_sense));
+    add_vpd_dev_id(vpd_dev_id, sizeof(vpd_dev_id));
+}
+
+/* Returns 0 if ok, else an sg3_utils error code */
+static int
+load_inhex(const char * fn)
+{
+    int res, len;
+    uint8_t * bp;
+
+    res = sg_f2hex_arr_alloc(fn, false, false, &bp, &len, 0);
+    if (res) {
+        pr2serr("unable to decode %s as ASCII hex\n", fn);
+        return res;
+    }
+    if ((len >= 8) && (0x70 == (0x7c & bp[0])))
+        add_sense(bp, len);
+    else if ((len >= 8) && (0x83 == bp[1]))
+        add_vpd_dev_id(bp, len);
+    else
+        corpus_add(&hex_corp, bp, len);
+    if (verbose)
+        pr2serr("%s: %d bytes\n", fn, len);
+    return 0;   /* bp is not freed, it is referenced by a corpus */
+}
+
+static void
+show_corpora()
+{
+    int k;
+
+    for (k = 0; k < fixed_corp.num; ++k) {
+        sg_get_sense_str(NULL, fixed_corp.e[k].bp, fixed_corp.e[k].len,
+                         false, sizeof(out_b), out_b);
+        pr2serr("fixed sense [%d]:\n%s", k, out_b);
+    }
+    for (k = 0; k < desc_corp.num; ++k) {
+        sg_get_sense_str(NULL, desc_corp.e[k].bp, desc_corp.e[k].len,
+                         false, sizeof(out_b), out_b);
+        pr2serr("descriptor sense [%d]:\n%s", k, out_b);
+    }
+    for (k = 0; k < desig_corp.num; ++k) {
+        sg_get_designation_descriptor_str("  ", desig_corp.e[k].bp,
+                                          desig_corp.e[k].len, true, false,
+                                          sizeof(out_b), out_b);
+        pr2serr("designation descriptor [%d]:\n%s", k, out_b);
+    }
+}
+
+/* Each benchmark performs 'num' operations, cycling over its corpus */
+
+static void
+b_sense_str_fixed(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= fixed_corp.num)
+            j = 0;
+        sink += sg_get_sense_str(NULL, fixed_corp.e[j].bp,
+                                 fixed_corp.e[j].len, false, sizeof(out_b),
+                                 out_b);
+    }
+}
+
+static void
+b_sense_str_desc(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= desc_corp.num)
+            j = 0;
+        sink += sg_get_sense_str(NULL, desc_corp.e[j].bp, desc_corp.e[j].len,
+                                 false, sizeof(out_b), out_b);
+    }
+}
+
+static void
+b_sense_descriptors_str(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= desc_corp.num)
+            j = 0;
+        sink += sg_get_sense_descriptors_str(NULL, desc_corp.e[j].bp,
+                                             desc_corp.e[j].len,
+                                             sizeof(out_b), out_b);
+    }
+}
+
+static void
+b_err_category_fixed(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= fixed_corp.num)
+            j = 0;
+        sink += sg_err_category_sense(fixed_corp.e[j].bp,
+                                      fixed_corp.e[j].len);
+    }
+}
+
+static void
+b_err_category_desc(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= desc_corp.num)
+            j = 0;
+        sink += sg_err_category_sense(desc_corp.e[j].bp, desc_corp.e[j].len);
+    }
+}
+
+/* Sweeps asc values 0x0 to 0x7f (ascq 0 to 3) so both table hits and
+ * misses are timed; vendor specific asc values are not included. */
+static void
+b_asc_ascq_str(int num)
+{
+    int k;
+
+    for (k = 0; k < num; ++k) {
+        sg_get_asc_ascq_str((k * 7) & 0x7f, k & 0x3, sizeof(out_b), out_b);
+        sink += (uint8_t)out_b[0];
+    }
+}
+
+static void
+b_opcode_sa_name(int num)
+{
+    int k, j;
+    const int n = sizeof(opcode_sa_arr) / sizeof(opcode_sa_arr[0]);
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= n)
+            j = 0;
+        sg_get_opcode_sa_name(opcode_sa_arr[j][0], opcode_sa_arr[j][1], 0,
+                              sizeof(out_b), out_b);
+        sink += (uint8_t)out_b[0];
+    }
+}
+
+static void
+b_designation_str(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= desig_corp.num)
+            j = 0;
+        sink += sg_get_designation_descriptor_str(NULL, desig_corp.e[j].bp,
+                                                  desig_corp.e[j].len, true,
+                                                  false, sizeof(out_b),
+                                                  out_b);
+    }
+}
+
+static void
+b_dStrHexStr(int num)
+{
+    int k, j;
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= hex_corp.num)
+            j = 0;
+        sink += dStrHexStr((const char *)hex_corp.e[j].bp, hex_corp.e[j].len,
+                           "  ", 0, sizeof(out_b), out_b);
+    }
+}
+
+static void
+b_get_llnum(int num)
+{
+    int k, j;
+    const int n = sizeof(llnum_arr) / sizeof(llnum_arr[0]);
+
+    for (k = 0, j = 0; k < num; ++k, ++j) {
+        if (j >= n)
+            j = 0;
+        sink += sg_get_llnum(llnum_arr[j]);
+    }
+}
+
+/* The unaligned accessors start at all 8 offsets modulo 8 */
+static void
+b_get_be16(int num)
+{
+    int k;
+    uint64_t sum = 0;
+
+    for (k = 0; k < num; ++k)
+        sum += sg_get_unaligned_be16(ua_arr + (k & 63));
+    sink += sum;
+}
+
+static void
+b_get_be32(int num)
+{
+    int k;
+    uint64_t sum = 0;
+
+    for (k = 0; k < num; ++k)
+        sum += sg_get_unaligned_be32(ua_arr + (k & 63));
+    sink += sum;
+}
+
+static void
+b_get_be64(int num)
+{
+    int k;
+    uint64_t sum = 0;
+
+    for (k = 0; k < num; ++k)
+        sum += sg_get_unaligned_be64(ua_arr + (k & 63));
+    sink += sum;
+}
+
+static void
+b_get_be24_48(int num)
+{
+    int k;
+    uint64_t sum = 0;
+
+    for (k = 0; k < num; ++k)
+        sum += sg_get_unaligned_be24(ua_arr + (k & 63)) +
+               sg_get_unaligned_be48(ua_arr + ((k + 1) & 63));
+    sink += sum;
+}
+
+static void
+b_get_be_n(int num)
+{
+    int k;
+    uint64_t sum = 0;
+
+    for (k = 0; k < num; ++k)
+        sum += sg_get_unaligned_be(1 + (k & 7), ua_arr + (k & 63));
+    sink += sum;
+}
+
+static void
+b_get_le32_64(int num)
+{
+    int k;
+    uint64_t sum = 0;
+
+    for (k = 0; k < num; ++k)
+        sum += sg_get_unaligned_le32(ua_arr + (k & 63)) +
+               sg_get_unaligned_le64(ua_arr + ((k + 1) & 63));
+    sink += sum;
+}
+
+static void
+b_put_be16_32_64(int num)
+{
+    int k;
+
+    for (k = 0; k < num; ++k) {
+        sg_put_unaligned_be16((uint16_t)k, ua_arr + (k & 63));
+        sg_put_unaligned_be32((uint32_t)k, ua_arr + ((k + 1) & 63));
+        sg_put_unaligned_be64((uint64_t)k, ua_arr + ((k + 2) & 63));
+    }
+    sink += ua_arr[k & 63];
+}
+
+static void
+b_put_le16_32_64(int num)
+{
+    int k;
+
+    for (k = 0; k < num; ++k) {
+        sg_put_unaligned_le16((uint16_t)k, ua_arr + (k & 63));
+        sg_put_unaligned_le32((uint32_t)k, ua_arr + ((k + 1) & 63));
+        sg_put_unaligned_le64((uint64_t)k, ua_arr + ((k + 2) & 63));
+    }
+    sink += ua_arr[k & 63];
+}
+
+struct bench_t {
+    const char * name;
+    void (*func)(int num);
+    int scale;          /* multiplier for --num= */
+    const struct corpus_t * corpp;      /* skip if this corpus is empty */
+};
+
+static struct bench_t bench_arr[] = {
+    {"sense_str_fixed", b_sense_str_fixed, 1, &fixed_corp},
+    {"sense_str_desc", b_sense_str_desc, 1, &desc_corp},
+    {"sense_descriptors_str", b_sense_descriptors_str, 1, &desc_corp},
+    {"err_category_sense_fixed", b_err_category_fixed, 20, &fixed_corp},
+    {"err_category_sense_desc", b_err_category_desc, 20, &desc_corp},
+    {"asc_ascq_str", b_asc_ascq_str, 1, NULL},
+    {"opcode_sa_name", b_opcode_sa_name, 1, NULL},
+    {"designation_descriptor_str", b_designation_str, 1, &desig_corp},
+    {"dStrHexStr", b_dStrHexStr, 1, &hex_corp},
+    {"get_llnum", b_get_llnum, 5, NULL},
+    {"unaligned_get_be16", b_get_be16, 100, NULL},
+    {"unaligned_get_be32", b_get_be32, 100, NULL},
+    {"unaligned_get_be64", b_get_be64, 100, NULL},
+    {"unaligned_get_be24_be48", b_get_be24_48, 100, NULL},
+    {"unaligned_get_be_n", b_get_be_n, 100, NULL},
+    {"unaligned_get_le32_le64", b_get_le32_64, 100, NULL},
+    {"unaligned_put_be16_32_64", b_put_be16_32_64, 100, NULL},
+    {"unaligned_put_le16_32_64", b_put_le16_32_64, 100, NULL},
+    {NULL, NULL, 0, NULL},
+};
+
+/* Returns elapsed nanoseconds since 'start_tmp' */
+static uint64_t
+elapsed_nsecs(const struct timespec * start_tmp)
+{
+    int64_t nsecs;
+    struct timespec end_tm;
+
+    if (0 != clock_gettime(CLOCK_MONOTONIC, &end_tm))
+        return 0;
+    nsecs = (int64_t)(end_tm.tv_sec - start_tmp->tv_sec) * 1000000000;
+    nsecs += end_tm.tv_nsec - start_tmp->tv_nsec;
+    return (nsecs > 0) ? (uint64_t)nsecs : 0;
+}
+
+static int
+cmp_u64(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* One untimed warm up run (caches, page faults, branch predictors) then
+ * 'repeat' timed runs. The minimum is the least disturbed by other system
+ * activity so it is the better figure for comparisons. */
+static void
+run_bench(const struct bench_t * bp, int num, int repeat)
+{
+    int k;
+    int64_t n = (int64_t)num * bp->scale;
+    uint64_t * nsp;
+    struct timespec start_tm;
+
+    if (n > INT32_MAX)
+        n = INT32_MAX;
+    nsp = (uint64_t *)calloc(repeat, sizeof(uint64_t));
+    if (NULL == nsp) {
+        pr2serr("%s: out of memory\n", __func__);
+        return;
+    }
+    bp->func((int)(n / 10) + 1);
+    for (k = 0; k < repeat; ++k) {
+        clock_gettime(CLOCK_MONOTONIC, &start_tm);
+        bp->func((int)n);
+        nsp[k] = elapsed_nsecs(&start_tm);
+    }
+    qsort(nsp, repeat, sizeof(uint64_t), cmp_u64);
+    printf("%-28s %12.2f %12.2f %12" PRId64 "\n", bp->name,
+           (double)nsp[0] / n, (double)nsp[repeat / 2] / n, n);
+    fflush(stdout);
+    free(nsp);
+}
+
+int
+main(int argc, char * argv[])
+{
+    bool do_list = false;
+    int k, c, res;
+    int num = DEF_NUM;
+    int repeat = DEF_REPEAT;
+    int num_inhex = 0;
+    const char * inhex_arr[MAX_INHEX_FILES];
+    const struct bench_t * bp;
+
+    while (1) {
+        int option_index = 0;
+
+        c = getopt_long(argc, argv, "f:hi:ln:r:vV", long_options,
+                        &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'f':
+            filter_str = optarg;
+            break;
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        case 'i':
+            if (num_inhex >= MAX_INHEX_FILES) {
+                pr2serr("--inhex= given too often, limit is %d\n",
+                        MAX_INHEX_FILES);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            inhex_arr[num_inhex++] = optarg;
+            break;
+        case 'l':
+            do_list = true;
+            break;
+        case 'n':
+            num = sg_get_num(optarg);
+            if (num < 1) {
+                pr2serr("--num= expects a positive number\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'r':
+            repeat = sg_get_num(optarg);
+            if ((repeat < 1) || (repeat > 1000)) {
+                pr2serr("--repeat= expects 1 to 1000\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            break;
+        case 'v':
+            ++verbose;
+            break;
+        case 'V':
+            pr2serr("version: %s\n", version_str);
+            return 0;
+        default:
+            pr2serr("unrecognised switch code 0x%x ??\n", c);
+            usage();
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if (optind < argc) {
+        for (; optind < argc; ++optind)
+            pr2serr("Unexpected extra argument: %s\n", argv[optind]);
+        usage();
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (do_list) {
+        for (bp = bench_arr; bp->name; ++bp)
+            printf("%s\n", bp->name);
+        return 0;
+    }
+    build_corpora();
+    for (k = 0; k < num_inhex; ++k) {
+        res = load_inhex(inhex_arr[k]);
+        if (res)
+            return res;
+    }
+    for (k = 0; k < (int)sizeof(ua_arr); ++k)
+        ua_arr[k] = (uint8_t)((k * 37) + 11);
+    if (verbose > 1)
+        show_corpora();
+
+    printf("# tst_sg_lib_bench %s: repeat=%d, corpora: fixed=%d desc=%d "
+           "desig=%d hex=%d\n", version_str, repeat, fixed_corp.num,
+           desc_corp.num, desig_corp.num, hex_corp.num);
+    printf("# %-26s %12s %12s %12s\n", "name", "min_ns/op", "med_ns/op",
+           "ops");
+    for (bp = bench_arr; bp->name; ++bp) {
+        if (filter_str && (NULL == strstr(bp->name, filter_str)))
+            continue;
+        if (bp->corpp && (0 == bp->corpp->num)) {
+            printf("# %s skipped, empty corpus\n", bp->name);
+            continue;
+        }
+        run_bench(bp, num, repeat);
+    }
+    if (verbose > 2)
+        pr2serr("sink=%" PRIu64 "\n", sink);
+    return 0;
+}
@@ -24,11 +24,19 @@
 
 static int bytes_per_line = DEF_BYTES_PER_LINE;
 
-static const char * version_str = "1.11 20190527";
+static const char * version_str = "1.12 20261018";
 
 #define CHARS_PER_HEX_BYTE 3
 #define BINARY_START_COL 6
 #define MAX_LINE_LENGTH 257
+#define OUT_BUFF_LEN (64 * 1024)
+
+static const char hex_lc[] = "0123456789abcdef";
+
+/* Completed lines are gathered in out_buff and written to stdout in
+ * large chunks rather than with a printf() per line. */
+static char out_buff[OUT_BUFF_LEN];
+static int out_len = 0;
 
 
 #ifdef SG_LIB_MINGW
@@ -198,6 +206,52 @@ sg_get_llnum(const char * buf)
     }
 }
 
+static void
+flush_out(void)
+{
+    if (out_len > 0) {
+        fwrite(out_buff, 1, out_len, stdout);
+        out_len = 0;
+    }
+}
+
+/* Appends the first 'n' characters of 'b' plus a newline to out_buff */
+static void
+put_line(const char * b, int n)
+{
+    if ((out_len + n + 1) > OUT_BUFF_LEN)
+        flush_out();
+    memcpy(out_buff + out_len, b, n);
+    out_len += n;
+    out_buff[out_len++] = '\n';
+}
+
+/* Same as sprintf(cp, "%.2x", c) but without the trailing '\0' */
+static void
+put_hex_byte(char * cp, unsigned char c)
+{
+    cp[0] = hex_lc[c >> 4];
+    cp[1] = hex_lc[c & 0xf];
+}
+
+/* Same as sprintf(cp, "%.2lx", a) but without the trailing '\0'. Returns
+ * the number of characters written. */
+static int
+put_hex_addr(char * cp, long a)
+{
+    int k, n;
+    unsigned long u = (unsigned long)a;
+    unsigned long t;
+
+    for (n = 1, t = u >> 4; t; t >>= 4)
+        ++n;
+    if (n < 2)
+        n = 2;
+    for (k = n - 1; k >= 0; --k, u >>= 4)
+        cp[k] = hex_lc[u & 0xf];
+    return n;
+}
+
 static void
 dStrHex(const char* str, int len, long start, int noAddr)
 {
@@ -232,20 +286,20 @@ dStrHex(const char* str, int len, long start, int noAddr)
     memset(buff, ' ', line_length);
     buff[line_length] = '\0';
     if (0 == noAddr) {
-        k = sprintf(buff + 1, "%.2lx", a);
+        k = put_hex_addr(buff + 1, a);
         buff[k + 1] = ' ';
     }
 
     for(j = 0; j < len; j++) {
         nl = (0 == (j % bytes_per_line));
         if ((j > 0) && nl) {
-            printf("%s\n", buff);
+            put_line(buff, line_length);
             bpos = bpstart;
             cpos = cpstart;
             a += bytes_per_line;
             memset(buff,' ', line_length);
             if (0 == noAddr) {
-                k = sprintf(buff + 1, "%.2lx", a);
+                k = put_hex_addr(buff + 1, a);
                 buff[k + 1] = ' ';
             }
         }
@@ -253,14 +307,15 @@ dStrHex(const char* str, int len, long start, int noAddr)
         bpos += (nl && noAddr) ?  0 : CHARS_PER_HEX_BYTE;
         if ((bytes_per_line > 4) && ((j % bytes_per_line) == midline_space))
             bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
+        put_hex_byte(buff + bpos, c);
         buff[bpos + 2] = ' ';
         if ((c < ' ') || (c >= 0x7f))
             c='.';
         buff[cpos++] = c;
     }
     if (cpos > cpstart)
-        printf("%s\n", buff);
+        put_line(buff, line_length);
+    flush_out();
 }
 
 static void
@@ -288,19 +343,19 @@ dStrHexOnly(const char* str, int len, long start, int noAddr)
     memset(buff, ' ', line_length);
     buff[line_length] = '\0';
     if (0 == noAddr) {
-        k = sprintf(buff + 1, "%.2lx", a);
+        k = put_hex_addr(buff + 1, a);
         buff[k + 1] = ' ';
     }
 
     for(j = 0; j < len; j++) {
         nl = (0 == (j % bytes_per_line));
         if ((j > 0) && nl) {
-            printf("%s\n", buff);
+            put_line(buff, line_length);
             bpos = bpstart;
             a += bytes_per_line;
             memset(buff,' ', line_length);
             if (0 == noAddr) {
-                k = sprintf(buff + 1, "%.2lx", a);
+                k = put_hex_addr(buff + 1, a);
                 buff[k + 1] = ' ';
             }
         }
@@ -308,11 +363,12 @@ dStrHexOnly(const char* str, int len, long start, int noAddr)
         bpos += (nl && noAddr) ? 0 : CHARS_PER_HEX_BYTE;
         if ((bytes_per_line > 4) && ((j % bytes_per_line) == midline_space))
             bpos++;
-        sprintf(&buff[bpos], "%.2x", (int)(unsigned char)c);
+        put_hex_byte(buff + bpos, c);
         buff[bpos + 2] = ' ';
     }
     if (bpos > bpstart)
-        printf("%s\n", buff);
+        put_line(buff, line_length);
+    flush_out();
 }
 
 static void